@@ -14,9 +14,8 @@
  *   limitations under the License.
  */
 
+#include <algorithm>
 #include <cstring>
-#include <iomanip>
-#include <sstream>
 
 #include "blob.h"
 using namespace aft::base;
@@ -24,32 +23,87 @@ using namespace aft::base;
 
 Blob::Blob(const std::string& name, void* data, int dataLength)
 : name_(name)
+, pointer_(nullptr)
+, string_(nullptr)
+, offset_(0)
+, length_(0)
 , type_(RAWDATA)
+, rendered_(false)
 {
     addData(data, dataLength);
 }
 
 Blob::Blob(const std::string& name, Blob::Type type, const std::string& stringData)
 : name_(name)
-, data_(nullptr)
-, dataLength_(0)
+, pointer_(nullptr)
+, string_(nullptr)
+, offset_(0)
+, length_(stringData.size())
 , type_(type)
-, stringData_(stringData)
+, rendered_(false)
+{
+    setString(std::make_shared<const std::string>(stringData));
+}
+
+Blob::Blob(const std::string& name, Blob::Type type, std::string&& stringData)
+: name_(name)
+, pointer_(nullptr)
+, string_(nullptr)
+, offset_(0)
+, length_(stringData.size())
+, type_(type)
+, rendered_(false)
+{
+    setString(std::make_shared<const std::string>(std::move(stringData)));
+}
+
+Blob::Blob(const std::string& name, Type type, std::shared_ptr<const void> owner,
+           const char* bytes, size_t length)
+: name_(name)
+, pointer_(nullptr)
+, buffer_(std::move(owner), bytes)
+, string_(nullptr)
+, offset_(0)
+, length_(length)
+, type_(type)
+, rendered_(false)
 {
 
 }
 
 Blob::Blob(const Blob& other)
 : name_(other.name_)
-, data_(other.data_)
-, dataLength_(other.dataLength_)
+, pointer_(other.pointer_)
+, buffer_(other.buffer_)
+, string_(other.string_)
+, offset_(other.offset_)
+, length_(other.length_)
 , members_(other.members_)
 , type_(other.type_)
-, stringData_(other.stringData_)
+, rendered_(false)
 {
 
 }
 
+Blob::Blob(Blob&& other) noexcept
+: name_(std::move(other.name_))
+, pointer_(other.pointer_)
+, buffer_(std::move(other.buffer_))
+, string_(other.string_)
+, offset_(other.offset_)
+, length_(other.length_)
+, members_(std::move(other.members_))
+, type_(other.type_)
+, stringData_(std::move(other.stringData_))
+, rendered_(other.rendered_)
+{
+    other.pointer_ = nullptr;
+    other.string_ = nullptr;
+    other.offset_ = 0;
+    other.length_ = 0;
+    other.rendered_ = false;
+}
+
 Blob::~Blob()
 {
 
@@ -60,11 +114,39 @@ Blob& Blob::operator=(const Blob& other)
     if (&other != this)
     {
         name_ = other.name_;
-        data_ = other.data_;
-        dataLength_ = other.dataLength_;
+        pointer_ = other.pointer_;
+        buffer_ = other.buffer_;
+        string_ = other.string_;
+        offset_ = other.offset_;
+        length_ = other.length_;
         members_ = other.members_;
         type_ = other.type_;
-        stringData_ = other.stringData_;
+        rendered_ = false;
+    }
+
+    return *this;
+}
+
+Blob& Blob::operator=(Blob&& other) noexcept
+{
+    if (&other != this)
+    {
+        name_ = std::move(other.name_);
+        pointer_ = other.pointer_;
+        buffer_ = std::move(other.buffer_);
+        string_ = other.string_;
+        offset_ = other.offset_;
+        length_ = other.length_;
+        members_ = std::move(other.members_);
+        type_ = other.type_;
+        stringData_ = std::move(other.stringData_);
+        rendered_ = other.rendered_;
+
+        other.pointer_ = nullptr;
+        other.string_ = nullptr;
+        other.offset_ = 0;
+        other.length_ = 0;
+        other.rendered_ = false;
     }
 
     return *this;
@@ -72,65 +154,78 @@ Blob& Blob::operator=(const Blob& other)
 
 bool Blob::addData(void* data, int dataLength)
 {
-    data_ = data;
-    dataLength_ = dataLength;
+    pointer_ = nullptr;
+    buffer_.reset();
+    string_ = nullptr;
+    offset_ = 0;
+    length_ = 0;
+    rendered_ = false;
 
-    if (nullptr != data_) {
-        std::ostringstream oss;
-        if (dataLength_ < 0) {
-            oss << "<pointer>";
+    if (nullptr != data) {
+        if (dataLength < 0) {
+            pointer_ = data;
         }
         else
         {
-            unsigned char* charData = (unsigned char *)data_;
-            for (int idx = 0; idx < dataLength_; ++idx)
-            {
-                unsigned int ch = charData[idx];
-                oss << std::hex << std::setw(2) << std::setfill('0') << ch << " ";
-                if (idx == (dataLength_ - 1) || (idx % 16) == (dataLength_ - 1))
-                {
-                    oss << std::endl;
-                }
-            }
+            setString(std::make_shared<const std::string>((const char *)data, dataLength));
+            length_ = dataLength;
         }
-        stringData_ = oss.str();
-    }
-    else
-    {
-        stringData_ = "<null>";
     }
 
     return true;
 }
 
-bool Blob::addMember(Blob* blob)
+bool Blob::addMember(const Blob& blob)
 {
-    members_.push_back(blob);
+    members_.push_back(std::make_shared<const Blob>(blob));
+    return true;
+}
+
+bool Blob::addMember(Blob&& blob)
+{
+    members_.push_back(std::make_shared<const Blob>(std::move(blob)));
     return true;
 }
 
 int Blob::compareData(const Blob& other) const {
-    if (dataLength_ <= 0 || other.dataLength_ <= 0) {
-        if (dataLength_ > 0) {
+    int dataLength = buffer_ ? (int)length_ : -1;
+    int otherLength = other.buffer_ ? (int)other.length_ : -1;
+    if (dataLength <= 0 || otherLength <= 0) {
+        if (dataLength > 0) {
             return 1;
-        } else if (other.dataLength_ > 0) {
+        } else if (otherLength > 0) {
             return -1;
         } else {
-            return static_cast<uint8_t*>(data_) - static_cast<uint8_t*>(other.data_);
+            return static_cast<const uint8_t*>(getData()) - static_cast<const uint8_t*>(other.getData());
         }
     }
 
-    size_t szCmp = dataLength_ < other.dataLength_ ? dataLength_ : other.dataLength_;
-    return memcmp(data_, other.data_, szCmp);
+    size_t szCmp = length_ < other.length_ ? length_ : other.length_;
+    return memcmp(getBytes(), other.getBytes(), szCmp);
 }
 
 const void*
 Blob::getData() const
 {
-    return data_;
+    if (pointer_) return pointer_;
+    if (type_ != RAWDATA) return nullptr;
+
+    return getBytes();
+}
+
+const char*
+Blob::getBytes() const
+{
+    return buffer_ ? buffer_.get() + offset_ : nullptr;
 }
 
-const std::vector<Blob*>&
+size_t
+Blob::getLength() const
+{
+    return length_;
+}
+
+const std::vector<std::shared_ptr<const Blob>>&
 Blob::getMembers() const
 {
     return members_;
@@ -145,6 +240,13 @@ Blob::getName() const
 const std::string&
 Blob::getString() const
 {
+    if (isWholeString()) return *string_;
+
+    if (!rendered_)
+    {
+        render();
+        rendered_ = true;
+    }
     return stringData_;
 }
 
@@ -153,6 +255,70 @@ Blob::getType() const {
     return type_;
 }
 
+Blob Blob::slice(size_t offset, size_t length) const
+{
+    Blob retBlob(name_, nullptr, -1);
+    retBlob.type_ = type_;
+    if (buffer_)
+    {
+        if (offset > length_) offset = length_;
+        retBlob.buffer_ = buffer_;
+        retBlob.string_ = string_;
+        retBlob.offset_ = offset_ + offset;
+        retBlob.length_ = std::min(length, length_ - offset);
+    }
+    return retBlob;
+}
+
+long Blob::useCount() const
+{
+    return buffer_.use_count();
+}
+
+bool Blob::isWholeString() const
+{
+    return type_ != RAWDATA && string_ && offset_ == 0 && length_ == string_->size();
+}
+
+void Blob::setString(std::shared_ptr<const std::string> buffer)
+{
+    string_ = buffer.get();
+    buffer_ = std::shared_ptr<const char>(std::move(buffer), string_->data());
+}
+
+void Blob::render() const
+{
+    stringData_.clear();
+    if (type_ != RAWDATA)
+    {
+        if (buffer_) stringData_.assign(getBytes(), length_);
+        return;
+    }
+
+    if (pointer_)
+    {
+        stringData_ = "<pointer>";
+    }
+    else if (!buffer_)
+    {
+        stringData_ = "<null>";
+    }
+    else if (length_ > 0)
+    {
+        static const char hexDigits[] = "0123456789abcdef";
+        const unsigned char* charData = (const unsigned char *)getBytes();
+        stringData_.resize(length_ * 3 + 1);
+        char* out = &stringData_[0];
+        for (size_t idx = 0; idx < length_; ++idx)
+        {
+            *out++ = hexDigits[charData[idx] >> 4];
+            *out++ = hexDigits[charData[idx] & 0x0f];
+            *out++ = ' ';
+        }
+        *out = '\n';
+    }
+}
+
 bool Blob::operator==(const Blob& other) {
     if (this == &other) return true;
     if (type_ != other.type_) return false;
@@ -166,13 +332,14 @@ bool Blob::operator==(const Blob& other) {
         case RAWDATA:
             return compareData(other) == 0;
         case STRING:
-            return stringData_ == other.stringData_;
+            return getString() == other.getString();
         case JSON:
-            return stringData_ == other.stringData_;
+            return getString() == other.getString();
         case COMMAND:
             return false;   //TODO figure out if this is even used
         case URL:
-            return stringData_ == other.stringData_;
+        case BINARY:
+            return getString() == other.getString();
         default:
             break;
     }
@@ -195,13 +362,14 @@ bool Blob::operator<(const Blob& other) {
         case RAWDATA:
             return compareData(other) < 0;
         case STRING:
-            return stringData_ < other.stringData_;
+            return getString() < other.getString();
         case JSON:
-            return stringData_ < other.stringData_;
+            return getString() < other.getString();
         case COMMAND:
             return false;   //TODO figure out if this is even used
         case URL:
-            return stringData_ < other.stringData_;
+        case BINARY:
+            return getString() < other.getString();
         default:
             break;
     }
@@ -220,13 +388,14 @@ bool Blob::operator>(const Blob& other) {
         case RAWDATA:
             return compareData(other) > 0;
         case STRING:
-            return stringData_ > other.stringData_;
+            return getString() > other.getString();
         case JSON:
-            return stringData_ > other.stringData_;
+            return getString() > other.getString();
         case COMMAND:
             return false;   //TODO figure out if this is even used
         case URL:
-            return stringData_ > other.stringData_;
+        case BINARY:
+            return getString() > other.getString();
         default:
             break;
     }
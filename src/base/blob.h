@@ -15,6 +15,7 @@
  *   limitations under the License.
  */
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -27,8 +28,16 @@ namespace base {
  *
  *  This class holds the data that is serialize by any class that implements the
  *  SerializeContract interface.  Each Blob holds data, members (other Blobs)
- *  or both data and blobs.
+ *  or both data and blobs.  A blob owns its members.
  *  Blobs can optionally be named.
+ *
+ *  The data of a blob is held in a reference-counted buffer that the blob owns.
+ *  Copies and slices of a blob share the same buffer, so copying a blob is cheap
+ *  no matter how large the data is.  The buffer is never modified once it is
+ *  shared; addData() replaces it with a new buffer.
+ *  A blob can also reference bytes owned by something else, such as a memory mapped
+ *  file, which is kept alive as long as any blob references it.
+ *  Raw data is only rendered as a string when getString() is called.
  */
 class Blob {
 public:
@@ -38,44 +47,107 @@ public:
         STRING,
         JSON,
         COMMAND,
-        URL
+        URL,
+        BINARY      ///< Structured data in the compact binary encoding
     };
 
+    /** Construct a raw data blob.
+     *  @param name Name of the blob
+     *  @param data Data that is copied into the blob.  If dataLength is negative
+     *              then data is an opaque pointer that is held but not owned.
+     *  @param dataLength Number of bytes in data.
+     */
     Blob(const std::string& name, void* data = nullptr, int dataLength = -1);
     Blob(const std::string& name, Type type, const std::string& stringData);
+    /** Construct a blob that takes over the contents of stringData without copying. */
+    Blob(const std::string& name, Type type, std::string&& stringData);
+    /** Construct a blob that references bytes without copying them.
+     *  @param owner Object that keeps bytes valid.  It is shared by copies and slices of
+     *               this blob and released with the last of them.
+     *  @param bytes First byte of the data
+     *  @param length Number of bytes
+     */
+    Blob(const std::string& name, Type type, std::shared_ptr<const void> owner,
+         const char* bytes, size_t length);
     Blob(const Blob& other);
+    Blob(Blob&& other) noexcept;
     virtual ~Blob();
 
     /** Assign contents of other blob to this blob. */
     Blob& operator=(const Blob& other);
+    /** Move contents of other blob to this blob.  The other blob is left empty. */
+    Blob& operator=(Blob&& other) noexcept;
 
     //TODO a general read/write interface?
 
     bool addData(void* data, int dataLength = -1);
-    bool addMember(Blob* blob);
+    /** Add a copy of a blob as a member.  Members are owned by the blob and are not
+     *  changed once added, so copies of the blob share them.
+     */
+    bool addMember(const Blob& blob);
+    /** Add a blob as a member by moving it. */
+    bool addMember(Blob&& blob);
 
     int compareData(const Blob& other) const;
 
+    /** Get a pointer to the raw data, or the opaque pointer if the blob holds one.
+     *  @return the data pointer or nullptr if the blob does not hold raw data.
+     */
     const void* getData() const;
-    const std::vector<Blob*>& getMembers() const;
+    /** Get a pointer to the bytes of the blob, which is either the raw data or the string. */
+    const char* getBytes() const;
+    /** Get the number of bytes returned by getBytes(). */
+    size_t getLength() const;
+    const std::vector<std::shared_ptr<const Blob>>& getMembers() const;
     const std::string& getName() const;
 
+    /** Get the string representation of this blob.
+     *  For string blobs this is the string itself.  Raw data is rendered as a hex dump
+     *  the first time this is called, as is a copy of slices or referenced bytes.
+     *  Use getBytes() to avoid the copy.
+     */
     const std::string& getString() const;
 
     Type getType() const;
+
+    /** Create a blob that references part of this blob's data without copying it.
+     *  @param offset Offset of the first byte of the slice
+     *  @param length Number of bytes in the slice.  The slice is truncated at the end
+     *                of this blob's data.
+     *  @return the slice, which has the same name and type as this blob.
+     */
+    Blob slice(size_t offset, size_t length = std::string::npos) const;
+
+    /** Get the number of blobs that share this blob's buffer (including this one). */
+    long useCount() const;
     
     bool operator==(const Blob& other);
     bool operator!=(const Blob& other);
     bool operator<(const Blob& other);
     bool operator>(const Blob& other);
 
+protected:
+    /** Render the data as a string into stringData_. */
+    void render() const;
+    /** Check if the string representation is the whole buffer. */
+    bool isWholeString() const;
+    /** Make buffer the data of this blob. */
+    void setString(std::shared_ptr<const std::string> buffer);
+
 protected:
     std::string name_;
-    void* data_;
-    int dataLength_;
-    std::vector<Blob*> members_;
+    void* pointer_;
+    /** Start of the shared buffer, which owns the string or other bytes */
+    std::shared_ptr<const char> buffer_;
+    /** The buffer as a string, if the blob owns a string buffer */
+    const std::string* string_;
+    size_t offset_;
+    size_t length_;
+    /** Members, shared with copies of this blob */
+    std::vector<std::shared_ptr<const Blob>> members_;
     Type type_;
-    std::string stringData_;
+    mutable std::string stringData_;
+    mutable bool rendered_;
 };
 
 } // namespace base
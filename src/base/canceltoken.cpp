@@ -0,0 +1,68 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include "canceltoken.h"
+
+using namespace aft::base;
+
+
+struct CancelToken::State {
+    std::atomic<bool> cancelled{false};
+    std::mutex lock;
+    std::condition_variable wakeup;
+};
+
+namespace {
+thread_local const CancelToken* currentToken = nullptr;
+}
+
+CancelToken::CancelToken()
+    : state_(std::make_shared<State>()) {
+}
+
+void CancelToken::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(state_->lock);
+        state_->cancelled.store(true, std::memory_order_release);
+    }
+    state_->wakeup.notify_all();
+}
+
+bool CancelToken::isCancelled() const {
+    return state_->cancelled.load(std::memory_order_acquire);
+}
+
+bool CancelToken::sleepUntil(const Deadline& deadline) const {
+    std::unique_lock<std::mutex> lock(state_->lock);
+    return !state_->wakeup.wait_until(lock, deadline, [this] { return isCancelled(); });
+}
+
+const CancelToken& CancelToken::current() {
+    static const CancelToken neverCancelled;
+    return currentToken ? *currentToken : neverCancelled;
+}
+
+CancelToken::Scope::Scope(const CancelToken& token)
+    : previous_(currentToken) {
+    currentToken = &token;
+}
+
+CancelToken::Scope::~Scope() {
+    currentToken = previous_;
+}
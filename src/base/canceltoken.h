@@ -0,0 +1,76 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <memory>
+#include "datasignal.h"
+
+
+namespace aft {
+namespace base {
+
+/**
+ *  Asks running TObjects to stop at the next safe point.
+ *
+ *  Copies of a token share its state, so cancelling one cancels them all.  Code
+ *  that runs for a long time checks isCancelled() between steps, e.g., between the
+ *  children of a container, and sleeps with sleepUntil() so it wakes up when
+ *  cancelled.  Cancelling cannot be undone; use a new token to run again.
+ */
+class CancelToken
+{
+public:
+    /** Construct a token that is not cancelled. */
+    CancelToken();
+
+    /** Cancel and wake up threads sleeping on this token. */
+    void cancel();
+
+    /** Whether the token is cancelled. */
+    bool isCancelled() const;
+
+    /** Sleep until the deadline, or until cancelled.
+     *  @return false if cancelled
+     */
+    bool sleepUntil(const Deadline& deadline) const;
+
+    /** Get the token of the task running on the calling thread.
+     *  @return the token given to the innermost Scope, or a token that is never
+     *          cancelled.
+     */
+    static const CancelToken& current();
+
+    /** Makes a token the current() token of the calling thread while in scope. */
+    class Scope
+    {
+    public:
+        /** The token must outlive the scope. */
+        explicit Scope(const CancelToken& token);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const CancelToken* previous_;
+    };
+
+private:
+    struct State;
+    std::shared_ptr<State> state_;
+};
+
+} // namespace base
+} // namespace aft
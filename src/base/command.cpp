@@ -61,13 +61,18 @@ Command::run(Context* context)
     VisitorContract& runVisitor = context ? context->getVisitor() : defaultVisitor;
     
     // Do not recurse below Command level
-    if (children_ && type_ != TObjectType::TypeCommand)
+    if (children_ && type_ != TObjectType::TypeCommand && !Context::isCancelled(context))
     {
         result_ = children_->visit(runVisitor, context);
     }
 
     // set state_ as one of finished
-    //TODO check for interrupted
+    if (Context::isCancelled(context))
+    {
+        result_ = Result(Result::FATAL);
+        setState(STOPPED);
+        return result_;
+    }
     setState(!result_ ? FINISHED_BAD : FINISHED_GOOD);
     return result_;
 }
@@ -82,10 +87,8 @@ Command::setup(Context* context, const Blob* parameters)
     return base::Result(true);
 }
 
-bool Command::serialize(Blob& blob)
+bool Command::serializeTo(StructuredData& sd)
 {
-    base::StructuredData sd("Command");
-
     sd.add("name", getName());
     sd.addArray("parameters");
     std::vector<std::string>::const_iterator it;
@@ -94,12 +97,12 @@ bool Command::serialize(Blob& blob)
         sd.add("parameters.", *it);
     }
 
-    return sd.serialize(blob);
+    return true;
 }
 
 bool Command::deserialize(const Blob& blob)
 {
-    base::StructuredData sd("Command", blob.getString());
+    base::StructuredData sd("Command", blob);
     std::string name;
     std::vector<std::string> parameters;
     if (!sd.get("name", name) || !sd.getArray("parameters", parameters_))
@@ -59,8 +59,8 @@ public:
     virtual const Result setup(Context* context = nullptr, const Blob* parameters = nullptr);
 
     // Implement SerializeContract Interface
-    virtual bool serialize(Blob& blob);
     virtual bool deserialize(const Blob& blob);
+    virtual bool serializeTo(StructuredData& sd);
     
     /** Copy contents of this Command from another */
     virtual Command& operator=(const Command& other);
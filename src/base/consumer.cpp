@@ -83,11 +83,14 @@ int BaseConsumer::write(const std::vector<Result>& results)
         }
         ++ret;
     }
-    return -1;
+    return ret;
 }
 
 int BaseConsumer::write(const std::vector<Blob>& blobs)
 {
+    if (readerDelegate_) {
+        return readerDelegate_->pushData(blobs.data(), blobs.size());
+    }
     return -1;
 }
 
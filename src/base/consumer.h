@@ -116,6 +116,7 @@ public:
     /** Returns the number of objects written. */
     virtual int write(const std::vector<TObject>& objects) override;
     virtual int write(const std::vector<Result>& results) override;
+    /** Pass all blobs to the reader delegate as one batch. */
     virtual int write(const std::vector<Blob>& blobs) override;
 
     /** Register as a data writer for this consumer. */
@@ -82,6 +82,26 @@ void Context::setEnv(const std::string& name, const std::string& value)
     env_.setValue(name, value);
 }
 
+CancelToken Context::getCancelToken() const
+{
+    return cancelToken_;
+}
+
+void Context::setCancelToken(const CancelToken& token)
+{
+    cancelToken_ = token;
+}
+
+bool Context::isCancelled() const
+{
+    return cancelToken_.isCancelled() || CancelToken::current().isCancelled();
+}
+
+bool Context::isCancelled(const Context* context)
+{
+    return context ? context->isCancelled() : CancelToken::current().isCancelled();
+}
+
 const std::string&
 Context::getName() const
 {
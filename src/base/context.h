@@ -17,6 +17,7 @@
 
 #include <map>
 #include <string>
+#include "canceltoken.h"
 #include "propertyhandler.h"
 #include "result.h"
 #include "visitor.h"
@@ -68,6 +69,17 @@ public:
     /** Get the name of this context. */
     const std::string& getName() const;
 
+    /** Get the token that cancels whatever runs in this context. */
+    CancelToken getCancelToken() const;
+    /** Use a token shared with other contexts, e.g., the workers of a test suite. */
+    void setCancelToken(const CancelToken& token);
+    /** Whether running in this context, or the task running on the calling thread,
+     *  has been cancelled.
+     */
+    bool isCancelled() const;
+    /** Like isCancelled(), for code that may run without a context. */
+    static bool isCancelled(const Context* context);
+
     /** Get the singleton global Context.
      *
      *  This is used when no local context is provided.
@@ -106,6 +118,9 @@ protected:
     /** Environment variables */
     BasePropertyHandler& env_;
 
+    /** Cancels running in this context */
+    CancelToken cancelToken_;
+
     /** Default visitor */
     VisitorContract& visitor_;
 };
@@ -0,0 +1,85 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "datasignal.h"
+
+using namespace aft::base;
+
+
+DataSignal::DataSignal()
+: waiters_(0)
+, numListeners_(0)
+, nextListener_(0)
+{
+}
+
+void DataSignal::notify()
+{
+    // Order the data that was made available before the check for waiters.  A waiter
+    // registers before it checks for data, so one of the two sees the other.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) > 0)
+    {
+        // Taking the lock makes sure a waiter is not between its check and its wait
+        std::lock_guard<std::mutex> guard(lock_);
+        available_.notify_all();
+    }
+    if (numListeners_.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> guard(listenerLock_);
+        for (std::pair<int, std::function<void()>>& listener : listeners_)
+        {
+            listener.second();
+        }
+    }
+}
+
+bool DataSignal::waitUntil(const Deadline& deadline, const std::function<bool()>& ready)
+{
+    if (ready()) return true;
+
+    std::unique_lock<std::mutex> guard(lock_);
+    waiters_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool isReady = available_.wait_until(guard, deadline, ready);
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    return isReady;
+}
+
+int DataSignal::addListener(const std::function<void()>& listener)
+{
+    std::lock_guard<std::mutex> guard(listenerLock_);
+    int id = nextListener_++;
+    listeners_.emplace_back(id, listener);
+    numListeners_.store(listeners_.size(), std::memory_order_relaxed);
+    // Order the listener before whatever data the caller checks for next
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return id;
+}
+
+void DataSignal::removeListener(int id)
+{
+    std::lock_guard<std::mutex> guard(listenerLock_);
+    for (size_t idx = 0; idx < listeners_.size(); ++idx)
+    {
+        if (listeners_[idx].first == id)
+        {
+            listeners_.erase(listeners_.begin() + idx);
+            break;
+        }
+    }
+    numListeners_.store(listeners_.size(), std::memory_order_relaxed);
+}
@@ -0,0 +1,76 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+
+namespace aft {
+namespace base {
+
+/** The time until which a wait for data lasts. */
+using Deadline = std::chrono::steady_clock::time_point;
+
+/**
+ *  Lets threads wait until data is available instead of polling for it.
+ *
+ *  Whoever makes data available calls notify() afterwards.  It only takes the lock
+ *  when a thread is waiting, so lock-free queues stay lock-free while nobody waits.
+ *  Listeners are called on every notify(), so one thread can watch many signals.
+ */
+class DataSignal
+{
+public:
+    DataSignal();
+    DataSignal(const DataSignal&) = delete;
+    DataSignal& operator=(const DataSignal&) = delete;
+
+    /** Wake the threads that are waiting. */
+    void notify();
+
+    /** Wait until ready returns true, or until the deadline.
+     *  @param ready Checks if data is available.  It is called again after every
+     *               notify() and must not block.
+     *  @return the last result of ready
+     */
+    bool waitUntil(const Deadline& deadline, const std::function<bool()>& ready);
+
+    /** Add a listener that notify() calls.  It must be quick and must not block.
+     *  @return an id for removeListener()
+     */
+    int addListener(const std::function<void()>& listener);
+    /** Remove a listener.  Once this returns the listener is not running. */
+    void removeListener(int id);
+
+private:
+    std::mutex lock_;
+    std::condition_variable available_;
+    std::atomic<int> waiters_;
+
+    std::mutex listenerLock_;
+    std::vector<std::pair<int, std::function<void()>>> listeners_;
+    std::atomic<int> numListeners_;
+    int nextListener_;
+};
+
+} // namespace base
+} // namespace aft
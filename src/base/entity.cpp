@@ -49,9 +49,10 @@ Entity::Entity(const std::string& name, TObject* tObject, MatchLevel matchLevel)
 
 Entity::Entity(const std::string& name, const TObjectType& toType, const std::string& toName)
 : name_(name)
-, tObject_(new TObjectMatcher(toType, toName))
+, matcher_(std::make_shared<TObjectMatcher>(toType, toName))
 , matchLevel_(LevelTOType)
 {
+    tObject_ = matcher_.get();
     if (!toName.empty())
     {
         matchLevel_ = LevelTOName;
@@ -61,6 +62,7 @@ Entity::Entity(const std::string& name, const TObjectType& toType, const std::st
 Entity::Entity(const Entity& other)
 : name_(other.name_)
 , tObject_(other.tObject_)
+, matcher_(other.matcher_)
 , matchLevel_(other.matchLevel_) {
     
 }
@@ -70,6 +72,16 @@ Entity::getTObject() const {
     return tObject_;
 }
 
+const std::string&
+Entity::getName() const {
+    return name_;
+}
+
+Entity::MatchLevel
+Entity::getMatchLevel() const {
+    return matchLevel_;
+}
+
 bool Entity::matches(const TObject& other) const
 {
     if (*tObject_ == other) return true;
@@ -108,6 +120,7 @@ bool Entity::matches(const Entity& other) const
 Entity& Entity::operator=(const Entity& other) {
     name_ = other.name_;
     tObject_ = other.tObject_;
+    matcher_ = other.matcher_;
     matchLevel_ = other.matchLevel_;
     return *this;
 }
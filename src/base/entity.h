@@ -18,6 +18,7 @@
  *   limitations under the License.
  */
 #include "tobject.h"
+#include <memory>
 #include <string>
 
 namespace aft {
@@ -46,7 +47,8 @@ public:
     Entity(const std::string& name, TObject* tObject, MatchLevel matchLevel = LevelTOName);
 
     /** Construct a named entity used for matching other entities.
-     *  A TObject is synthesized to hold the matching values. */
+     *  A TObject is synthesized to hold the matching values, and is shared by
+     *  copies of the entity. */
     Entity(const std::string& name, const TObjectType& toType,
            const std::string& toName = std::string());
 
@@ -56,6 +58,12 @@ public:
 
     const TObject* getTObject() const;
 
+    /** Get the name of this entity */
+    const std::string& getName() const;
+
+    /** Get the level this entity matches others at */
+    MatchLevel getMatchLevel() const;
+
     /**
      *  Check if a given TObject matches this entity's requirements.
      */
@@ -74,6 +82,7 @@ public:
 private:
     std::string name_;
     TObject* tObject_;
+    std::shared_ptr<TObject> matcher_;  // Synthesized tObject_, if any
     MatchLevel matchLevel_;
 };
 
@@ -0,0 +1,185 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "executor.h"
+
+using namespace aft::base;
+
+
+namespace {
+/** Deque of tasks owned by one worker. */
+struct Worker {
+    std::mutex lock;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+};
+}
+
+class aft::base::ExecutorImpl
+{
+public:
+    ExecutorImpl(unsigned int numThreads)
+    : running_(true)
+    , pending_(0)
+    , idle_(0)
+    , next_(0)
+    {
+        for (unsigned int idx = 0; idx < numThreads; ++idx) {
+            workers_.emplace_back(new Worker);
+        }
+        for (unsigned int idx = 0; idx < numThreads; ++idx) {
+            workers_[idx]->thread = std::thread(&ExecutorImpl::work, this, idx);
+        }
+    }
+
+    ~ExecutorImpl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepLock_);
+            running_ = false;
+        }
+        wakeup_.notify_all();
+        for (auto& worker : workers_) {
+            worker->thread.join();
+        }
+    }
+
+    void submit(std::function<void()> task)
+    {
+        // Own tasks go to the back of the worker's deque, others are spread out
+        const int self = current();
+        const size_t idx = self >= 0 ? self : next_.fetch_add(1) % workers_.size();
+        {
+            std::lock_guard<std::mutex> lock(workers_[idx]->lock);
+            workers_[idx]->tasks.push_back(std::move(task));
+        }
+        pending_.fetch_add(1);
+        if (idle_.load() > 0) {
+            { std::lock_guard<std::mutex> lock(sleepLock_); }
+            wakeup_.notify_one();
+        }
+    }
+
+    /** Take the newest task of worker self, or else steal the oldest of another. */
+    bool take(int self, std::function<void()>& task)
+    {
+        if (pending_.load() == 0) return false;
+
+        const size_t count = workers_.size();
+        const size_t first = self >= 0 ? self : next_.load() % count;
+        for (size_t offset = 0; offset < count; ++offset) {
+            Worker& worker = *workers_[(first + offset) % count];
+            std::lock_guard<std::mutex> lock(worker.lock);
+            if (worker.tasks.empty()) continue;
+
+            if (offset == 0 && self >= 0) {
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+            } else {
+                task = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+            }
+            pending_.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    /** Index of the calling thread's worker in this executor, or -1. */
+    int current() const
+    {
+        return currentExecutor == this ? currentWorker : -1;
+    }
+
+    void work(int self)
+    {
+        currentExecutor = this;
+        currentWorker = self;
+        std::function<void()> task;
+        for (;;) {
+            if (take(self, task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepLock_);
+            idle_.fetch_add(1);
+            wakeup_.wait(lock, [this] { return pending_.load() > 0 || !running_; });
+            idle_.fetch_sub(1);
+            if (!running_ && pending_.load() == 0) break;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex sleepLock_;
+    std::condition_variable wakeup_;
+    bool running_;
+    std::atomic<size_t> pending_;
+    std::atomic<int> idle_;
+    std::atomic<size_t> next_;
+
+    static thread_local const ExecutorImpl* currentExecutor;
+    static thread_local int currentWorker;
+};
+
+thread_local const ExecutorImpl* ExecutorImpl::currentExecutor = nullptr;
+thread_local int ExecutorImpl::currentWorker = -1;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+Executor::Executor(unsigned int numThreads)
+: impl_(*new ExecutorImpl(numThreads > 0
+                          ? numThreads : std::max(1u, std::thread::hardware_concurrency())))
+{
+}
+
+Executor::~Executor()
+{
+    delete &impl_;
+}
+
+void Executor::submit(std::function<void()> task)
+{
+    impl_.submit(std::move(task));
+}
+
+bool Executor::runPending()
+{
+    std::function<void()> task;
+    if (!impl_.take(impl_.current(), task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+bool Executor::onWorker() const
+{
+    return impl_.current() >= 0;
+}
+
+unsigned int Executor::size() const
+{
+    return static_cast<unsigned int>(impl_.workers_.size());
+}
@@ -0,0 +1,66 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <functional>
+
+
+namespace aft {
+namespace base {
+// Forward reference
+class ExecutorImpl;
+
+/**
+ *  Fixed set of worker threads that run tasks, one deque per worker.
+ *
+ *  A worker pushes and pops the tasks it submits at the back of its own deque, and
+ *  steals from the front of the other deques when its own is empty.  Tasks from
+ *  other threads are spread over the deques.  Idle workers sleep until a task is
+ *  submitted.
+ */
+class Executor
+{
+public:
+    /** Start the workers.
+     *  @param numThreads Number of worker threads, 0 for one per core.
+     */
+    explicit Executor(unsigned int numThreads = 0);
+    /** Run the tasks that are left, then stop the workers. */
+    ~Executor();
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /** Queue a task to run on one of the workers. */
+    void submit(std::function<void()> task);
+
+    /** Run one queued task on the calling thread, if there is one.
+     *  Used to help out instead of blocking, e.g., while waiting for a task.
+     *  @return true if a task was run.
+     */
+    bool runPending();
+
+    /** Whether the calling thread is one of the workers of this executor. */
+    bool onWorker() const;
+
+    /** Number of worker threads. */
+    unsigned int size() const;
+
+private:
+    ExecutorImpl& impl_;
+};
+
+} // namespace base
+} // namespace aft
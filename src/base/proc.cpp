@@ -43,6 +43,11 @@ bool BaseProc::hasObject(ProductType productType) {
     return hasObject(productType);
 }
 
+bool BaseProc::waitForData(const Deadline& deadline) {
+    // Subclasses override hasData(), which the producer does not see
+    return ProducerContract::waitForData(deadline);
+}
+
 bool BaseProc::registerDataCallback(const ReaderContract* reader) {
     return producer_.registerDataCallback(reader);
 }
@@ -15,6 +15,7 @@
  *   limitations under the License.
  */
 
+#include <atomic>
 #include "base/consumer.h"
 #include "base/producer.h"
 
@@ -22,6 +23,53 @@
 namespace aft {
 namespace base {
 
+/**
+ *  Counts of the blobs that crossed one input or output of a proc.
+ */
+struct EdgeCounters
+{
+    unsigned long blobs;    ///< Blobs that crossed the edge
+    unsigned long bytes;    ///< Total length of those blobs
+    unsigned long refused;  ///< Blobs the edge did not take
+};
+
+/**
+ *  Thread safe EdgeCounters for procs to update as blobs cross an edge.
+ */
+class EdgeCounter
+{
+public:
+    EdgeCounter()
+    : blobs_(0)
+    , bytes_(0)
+    , refused_(0)
+    {  }
+
+    /** Count a blob that crossed the edge. */
+    void passed(size_t length)
+    {
+        blobs_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add(length, std::memory_order_relaxed);
+    }
+    /** Count blobs the edge did not take. */
+    void refused(unsigned long count = 1)
+    {
+        refused_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    EdgeCounters get() const
+    {
+        return EdgeCounters{ blobs_.load(std::memory_order_relaxed),
+                             bytes_.load(std::memory_order_relaxed),
+                             refused_.load(std::memory_order_relaxed) };
+    }
+
+private:
+    std::atomic<unsigned long> blobs_;
+    std::atomic<unsigned long> bytes_;
+    std::atomic<unsigned long> refused_;
+};
+
 class ReaderWriterContract : public ReaderContract, public WriterContract
 {
 
@@ -49,6 +97,8 @@ public:
     virtual Result read(Blob& blob) override;
     virtual bool hasData() override;
     virtual bool hasObject(ProductType productType) override;
+    /** Poll hasData() until it is true or until the deadline. */
+    virtual bool waitForData(const Deadline& deadline) override;
     
     /** Register to receive a callback when data is available. */
     virtual bool registerDataCallback(const ReaderContract* reader) override;
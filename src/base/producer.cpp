@@ -15,6 +15,7 @@
  */
 
 #include <algorithm>
+#include <thread>
 
 #include "blob.h"
 #include "consumer.h"
@@ -24,8 +25,56 @@
 
 using namespace aft::base;
 
+// How often BaseProducer::waitForData() checks producers that do not notify
+static const std::chrono::milliseconds PollInterval(1);
+
+size_t ReaderContract::pushData(const Blob* blobs, size_t count)
+{
+    size_t pushed = 0;
+    while (pushed < count && pushData(blobs[pushed]))
+    {
+        ++pushed;
+    }
+    return pushed;
+}
+
+bool ProducerContract::waitForData(const Deadline& deadline)
+{
+    // Back off from short sleeps to 1 ms ones
+    std::chrono::microseconds pause(50);
+    while (!hasData())
+    {
+        Deadline now = std::chrono::steady_clock::now();
+        if (now >= deadline) return false;
+
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(pause, deadline - now));
+        if (pause < std::chrono::milliseconds(1)) pause *= 2;
+    }
+    return true;
+}
+
+Result ProducerContract::readUntil(Blob& blob, const Deadline& deadline)
+{
+    // Another reader may take the data first, so wait again
+    while (waitForData(deadline))
+    {
+        if (read(blob)) return true;
+    }
+    return false;
+}
+
+int ProducerContract::watchData(const std::function<void()>& listener)
+{
+    return -1;
+}
+
+void ProducerContract::unwatchData(int id)
+{
+}
+
 BaseProducer::BaseProducer(WriterContract* writerDelegate)
     : writerDelegate_(writerDelegate)
+    , notified_(false)
 {
 }
 
@@ -81,6 +130,37 @@ bool BaseProducer::hasObject(ProductType productType)
     return false;
 }
 
+bool BaseProducer::waitForData(const Deadline& deadline)
+{
+    while (true)
+    {
+        // A producer that never called notifyData() may never wake the wait
+        Deadline until = deadline;
+        if (!notified_.load(std::memory_order_acquire))
+        {
+            until = std::min(deadline, std::chrono::steady_clock::now() + PollInterval);
+        }
+        if (signal_.waitUntil(until, [this] { return hasData(); })) return true;
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+    }
+}
+
+int BaseProducer::watchData(const std::function<void()>& listener)
+{
+    return signal_.addListener(listener);
+}
+
+void BaseProducer::unwatchData(int id)
+{
+    signal_.removeListener(id);
+}
+
+void BaseProducer::notifyData()
+{
+    notified_.store(true, std::memory_order_release);
+    signal_.notify();
+}
+
 bool BaseProducer::registerDataCallback(const ReaderContract* reader)
 {
     if (!reader) return false;
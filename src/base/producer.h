@@ -15,7 +15,9 @@
  *   limitations under the License.
  */
 
+#include <atomic>
 #include <vector>
+#include "base/datasignal.h"
 #include "base/producttype.h"
 #include "base/result.h"
 
@@ -46,6 +48,14 @@ public:
      *  @return true if the reader consumed the data, otherwise false
      */
     virtual bool pushData(const Blob& blob) = 0;
+    /** Called to deliver several Blobs to readers at once.
+     *  The default implementation delivers them one at a time.  Readers override it
+     *  to take the whole batch with one lock, system call or allocation.
+     *  @param blobs First of the blobs to deliver
+     *  @param count Number of blobs
+     *  @return the number of blobs consumed, which stops at the first blob that is not.
+     */
+    virtual size_t pushData(const Blob* blobs, size_t count);
     
     /** Indicate if the reader can accept data */
     virtual bool roomForData() const = 0;
@@ -76,6 +86,26 @@ public:
     virtual bool hasData() = 0;
     virtual bool hasObject(ProductType productType) = 0;
 
+    /** Wait until data is available or until the deadline.
+     *  The default implementation polls hasData().  Producers that can wake waiting
+     *  threads override it; BaseProducer wakes them on notifyData().
+     *  @return true if data is available, otherwise false.
+     */
+    virtual bool waitForData(const Deadline& deadline);
+    /** Read a Blob, waiting until the deadline for one to be available.
+     *  @return true if the blob was read.
+     */
+    Result readUntil(Blob& blob, const Deadline& deadline);
+
+    /** Call a listener whenever data may have become available, so one thread can
+     *  watch many producers.  The default does not support it.  A producer that
+     *  returns an id must call the listener every time data arrives.
+     *  @return an id for unwatchData(), or -1 if the producer must be polled instead.
+     */
+    virtual int watchData(const std::function<void()>& listener);
+    /** Stop calling a listener.  Once this returns the listener is not running. */
+    virtual void unwatchData(int id);
+
     /** Register to receive a callback when data is available. */
     virtual bool registerDataCallback(const ReaderContract* reader) = 0;
     /** Unregister callback from receiving any more data. */
@@ -84,6 +114,10 @@ public:
 
 /**
  *  Base implementation of the ProducerContract interface.
+ *
+ *  Subclasses whose data arrives after a reader checked for it, e.g., from another
+ *  thread, call notifyData() when it does.  Until a producer has called it,
+ *  waitForData() also polls hasData(), since the producer may never call it.
  */
 class BaseProducer : public ProducerContract
 {
@@ -100,12 +134,24 @@ public:
     virtual Result read(Blob& blob) override;
     virtual bool hasData() override;
     virtual bool hasObject(ProductType productType) override;
+    /** Wait until hasData() is true when checked after a notifyData(), or the deadline.
+     *  Checks every millisecond as well while notifyData() has never been called.
+     */
+    virtual bool waitForData(const Deadline& deadline) override;
+    /** Call a listener on every notifyData(). */
+    virtual int watchData(const std::function<void()>& listener) override;
+    virtual void unwatchData(int id) override;
 
     /** Register to receive a callback when data is available. */
     virtual bool registerDataCallback(const ReaderContract* reader) override;
     /** Unregister callback from receiving any more data. */
     virtual bool unregisterDataCallback(const ReaderContract* reader) override;
 
+    /** Wake threads in waitForData() and call the watchData() listeners.  Producers
+     *  whose data arrives from other threads call this when it does.
+     */
+    void notifyData();
+
     /** Start loop reading from the writer delegate and writing to the readers.
      *
      *  TODO This method may need to either be overloaded or templatize.
@@ -115,6 +161,8 @@ public:
 protected:
     WriterContract* writerDelegate_;
     std::vector<ReaderContract*> readers_;
+    DataSignal signal_;
+    std::atomic<bool> notified_;    // notifyData() was called
 };
 
 } // namespace base
@@ -41,6 +41,9 @@ enum class ParcelType
     BLOB_LINE,
     BLOB_PARAGRAPH,
     BLOB_FILE,
+    BLOB_DELIMITED,         ///< Records that end with a delimiter
+    BLOB_LENGTH_PREFIXED,   ///< Binary records that follow their length
+    BLOB_FIXED_SIZE,        ///< Binary records that all have the same size
     RESULT,
     TOBJECT
 };
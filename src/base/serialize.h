@@ -21,6 +21,7 @@ namespace base
 {
 // Forward reference
 class Blob;
+class StructuredData;
 
 /**
  *  Interface that classes must implement to serialize to and from a Blob.
@@ -43,6 +44,19 @@ public:
      *  @return true if deserization was successful, otherwise false.
      */
     virtual bool deserialize(const Blob& blob) = 0;
+
+    /** Serialize the object into structured data.
+     *
+     *  The structured data may be a subtree of the structured data of a containing
+     *  object, so that nested objects are serialized in a single pass with one final
+     *  unparse.  See StructuredData::addObject().
+     *  @param sd structured data that receives the members of the object
+     *  @return true if serialization was successful.  The default implementation
+     *          returns false, in which case callers fall back to serialize(Blob&).
+     *          A class that overrides serialize(Blob&) must also override this if a
+     *          base class implements it, or its members are lost when nested.
+     */
+    virtual bool serializeTo(StructuredData& sd) { return false; }
 };
 
 } // namespace base
@@ -15,7 +15,10 @@
  */
 
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <sstream>
 
 #include <json/json.h>
@@ -36,6 +39,14 @@ void StructuredDataDelegate::setSDName(StructuredData& sd, const StructuredDataN
     sd.name_ = name;     // take advantage of our friendship. again.
 }
 
+void StructuredDataDelegate::setDelegate(StructuredData& sd, StructuredDataDelegate* delegate)
+{
+    if (sd.delegate_ != delegate) {
+        delete sd.delegate_;
+        sd.delegate_ = delegate;
+    }
+}
+
 
 /** Implement the StructuredDataDelegate interface via internal json. */
 class JsonDataDelegate : public StructuredDataDelegate
@@ -43,17 +54,21 @@ class JsonDataDelegate : public StructuredDataDelegate
 public:
     JsonDataDelegate();
     JsonDataDelegate(const JsonDataDelegate& other);
+    /** Construct a delegate for a subtree that is owned by another delegate. */
+    explicit JsonDataDelegate(Json::Value& subtree);
     virtual ~JsonDataDelegate();
 
     virtual bool add(const StructuredDataName& name, int intValue);
     virtual bool add(const StructuredDataName& name, const std::string& value);
     virtual bool add(const StructuredDataName& name, const StructuredData& value);
     virtual bool addArray(const StructuredDataName& name);
+    virtual bool addSubtree(const StructuredDataName& name, StructuredData& subtree);
     virtual bool get(const StructuredDataName& name, int& intValue) const;
     virtual bool get(const StructuredDataName& name, std::string& value) const;
     virtual bool get(const StructuredDataName& name, StructuredData& value) const;
     virtual bool getArray(const StructuredDataName& name, 
                           std::vector<std::string>& values) const;
+    virtual bool getArray(const StructuredDataName& name, std::vector<Blob>& values) const;
 
     virtual bool getMembers(std::vector<std::string>& names) const;
 
@@ -64,7 +79,10 @@ public:
 
     virtual Type type(const StructuredDataName& name);
 
-private:
+protected:
+    /** Encode a single value, as used for array elements that are not strings. */
+    virtual void write(const Json::Value& value, std::string& strData) const;
+
     Json::Value* getJsonPtr(const StructuredDataName& name,
                             bool pathOnly = false) const;
 
@@ -88,26 +106,315 @@ private:
                       bool pathOnly = false) const;
     Json::Value* makePathJson(const StructuredDataName& name);
 
-private:
+protected:
     Json::Value& json_;
+    bool ownsJson_;
 };
 
+/**
+ *  Implement the StructuredDataDelegate interface via internal json that is
+ *  encoded as CBOR (RFC 7049).
+ *
+ *  Only definite lengths are written or accepted.  Since the internal representation
+ *  is the same as JsonDataDelegate, the two delegates can be mixed when adding or
+ *  getting sub-structured data.
+ */
+class BinaryDataDelegate : public JsonDataDelegate
+{
+public:
+    BinaryDataDelegate() { }
+    explicit BinaryDataDelegate(Json::Value& subtree) : JsonDataDelegate(subtree) { }
+
+    virtual bool parse(const StructuredDataName& name, const std::string& strData);
+    virtual bool unparse(const StructuredDataName& name, std::string& strData);
+    virtual Format getFormat() const { return BINARY; }
+
+protected:
+    virtual void write(const Json::Value& value, std::string& strData) const;
+};
+
+namespace {
+
+// CBOR major types
+const uint8_t CborUnsigned = 0;
+const uint8_t CborNegative = 1;
+const uint8_t CborBytes = 2;
+const uint8_t CborText = 3;
+const uint8_t CborArray = 4;
+const uint8_t CborMap = 5;
+const uint8_t CborSimple = 7;
+
+const char CborFalse = '\xf4';
+const char CborTrue = '\xf5';
+const char CborNull = '\xf6';
+const char CborDouble = '\xfb';
+
+/** Deepest nesting accepted when decoding */
+const int CborMaxDepth = 256;
+
+void cborPutHead(std::string& out, uint8_t major, uint64_t value)
+{
+    const char type = static_cast<char>(major << 5);
+    int bytes;
+    if (value < 24) {
+        out.push_back(type | static_cast<char>(value));
+        return;
+    } else if (value <= 0xff) {
+        out.push_back(type | 24);
+        bytes = 1;
+    } else if (value <= 0xffff) {
+        out.push_back(type | 25);
+        bytes = 2;
+    } else if (value <= 0xffffffff) {
+        out.push_back(type | 26);
+        bytes = 4;
+    } else {
+        out.push_back(type | 27);
+        bytes = 8;
+    }
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<char>(value >> shift));
+    }
+}
+
+void cborEncode(const Json::Value& value, std::string& out)
+{
+    switch (value.type()) {
+    case Json::nullValue:
+        out.push_back(CborNull);
+        break;
+    case Json::booleanValue:
+        out.push_back(value.asBool() ? CborTrue : CborFalse);
+        break;
+    case Json::intValue:
+    {
+        Json::LargestInt intValue = value.asLargestInt();
+        if (intValue >= 0) {
+            cborPutHead(out, CborUnsigned, static_cast<uint64_t>(intValue));
+        } else {
+            cborPutHead(out, CborNegative, static_cast<uint64_t>(-1 - intValue));
+        }
+    }
+        break;
+    case Json::uintValue:
+        cborPutHead(out, CborUnsigned, value.asLargestUInt());
+        break;
+    case Json::realValue:
+    {
+        double real = value.asDouble();
+        uint64_t bits;
+        memcpy(&bits, &real, sizeof(bits));
+        out.push_back(CborDouble);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<char>(bits >> shift));
+        }
+    }
+        break;
+    case Json::stringValue:
+    {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        value.getString(&begin, &end);
+        cborPutHead(out, CborText, end - begin);
+        out.append(begin, end - begin);
+    }
+        break;
+    case Json::arrayValue:
+        cborPutHead(out, CborArray, value.size());
+        for (Json::ArrayIndex idx = 0; idx < value.size(); ++idx) {
+            cborEncode(value[idx], out);
+        }
+        break;
+    case Json::objectValue:
+        cborPutHead(out, CborMap, value.size());
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            const char* end = nullptr;
+            const char* name = it.memberName(&end);
+            cborPutHead(out, CborText, end - name);
+            out.append(name, end - name);
+            cborEncode(*it, out);
+        }
+        break;
+    }
+}
+
+/** Decoder for the subset of CBOR written by cborEncode() */
+class CborReader
+{
+public:
+    CborReader(const std::string& data)
+    : pos_(reinterpret_cast<const uint8_t*>(data.data()))
+    , end_(pos_ + data.size())
+    {
+    }
+
+    /** Decode a single top-level value, which must use all of the data. */
+    bool read(Json::Value& value)
+    {
+        return readValue(value, 0) && pos_ == end_;
+    }
+
+private:
+    bool readHead(uint8_t& major, uint8_t& info, uint64_t& value)
+    {
+        if (pos_ == end_) return false;
+        major = *pos_ >> 5;
+        info = *pos_ & 0x1f;
+        ++pos_;
+        if (info < 24) {
+            value = info;
+            return true;
+        }
+        if (major == CborSimple || info > 27) {
+            // floats and simple values are decoded by the caller
+            value = 0;
+            return info <= 27;
+        }
+        size_t bytes = size_t(1) << (info - 24);
+        if (size_t(end_ - pos_) < bytes) return false;
+        value = 0;
+        while (bytes--) {
+            value = (value << 8) | *pos_++;
+        }
+        return true;
+    }
+
+    bool readString(std::string& str, uint64_t length)
+    {
+        if (uint64_t(end_ - pos_) < length) return false;
+        str.assign(reinterpret_cast<const char*>(pos_), length);
+        pos_ += length;
+        return true;
+    }
+
+    bool readValue(Json::Value& value, int depth)
+    {
+        if (depth > CborMaxDepth) return false;
+
+        uint8_t major;
+        uint8_t info;
+        uint64_t head;
+        if (!readHead(major, info, head)) return false;
+
+        switch (major) {
+        case CborUnsigned:
+            if (head <= uint64_t(std::numeric_limits<Json::Int64>::max())) {
+                value = Json::Value(static_cast<Json::Int64>(head));
+            } else {
+                value = Json::Value(static_cast<Json::UInt64>(head));
+            }
+            return true;
+        case CborNegative:
+            if (head > uint64_t(std::numeric_limits<Json::Int64>::max())) return false;
+            value = Json::Value(-1 - static_cast<Json::Int64>(head));
+            return true;
+        case CborBytes:
+        case CborText:
+        {
+            if (uint64_t(end_ - pos_) < head) return false;
+            const char* begin = reinterpret_cast<const char*>(pos_);
+            value = Json::Value(begin, begin + head);
+            pos_ += head;
+            return true;
+        }
+        case CborArray:
+            // every element takes at least one byte
+            if (uint64_t(end_ - pos_) < head) return false;
+            value = Json::Value(Json::arrayValue);
+            if (head > 0) {
+                value.resize(static_cast<Json::ArrayIndex>(head));
+            }
+            for (Json::ArrayIndex idx = 0; idx < head; ++idx) {
+                if (!readValue(value[idx], depth + 1)) return false;
+            }
+            return true;
+        case CborMap:
+            if (uint64_t(end_ - pos_) < head * 2) return false;
+            value = Json::Value(Json::objectValue);
+            for (uint64_t idx = 0; idx < head; ++idx) {
+                uint64_t length;
+                if (!readHead(major, info, length) || major != CborText) return false;
+                if (!readString(key_, length)) return false;
+                if (!readValue(value[key_], depth + 1)) return false;
+            }
+            return true;
+        case CborSimple:
+            return readSimple(value, info);
+        default:
+            return false;
+        }
+    }
+
+    bool readSimple(Json::Value& value, uint8_t info)
+    {
+        switch (info) {
+        case 20:
+            value = Json::Value(false);
+            return true;
+        case 21:
+            value = Json::Value(true);
+            return true;
+        case 22:
+        case 23:
+            value = Json::Value();
+            return true;
+        case 26:
+        {
+            if (end_ - pos_ < 4) return false;
+            uint32_t bits = 0;
+            for (int idx = 0; idx < 4; ++idx) bits = (bits << 8) | *pos_++;
+            float real;
+            memcpy(&real, &bits, sizeof(real));
+            value = Json::Value(static_cast<double>(real));
+            return true;
+        }
+        case 27:
+        {
+            if (end_ - pos_ < 8) return false;
+            uint64_t bits = 0;
+            for (int idx = 0; idx < 8; ++idx) bits = (bits << 8) | *pos_++;
+            double real;
+            memcpy(&real, &bits, sizeof(real));
+            value = Json::Value(real);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+private:
+    const uint8_t* pos_;
+    const uint8_t* end_;
+    std::string key_;
+};
+
+} // namespace
+
 
 JsonDataDelegate::JsonDataDelegate()
     : json_(*new Json::Value(Json::objectValue))
+    , ownsJson_(true)
 {
     //TODO possibly set json_ name
 }
 
 JsonDataDelegate::JsonDataDelegate(const JsonDataDelegate& other)
 : json_(*new Json::Value(other.json_))
+, ownsJson_(true)
 {
     //TODO possibly set json_ name
 }
 
+JsonDataDelegate::JsonDataDelegate(Json::Value& subtree)
+: json_(subtree)
+, ownsJson_(false)
+{
+}
+
 JsonDataDelegate::~JsonDataDelegate()
 {
-    delete &json_;
+    if (ownsJson_) delete &json_;
 }
 
 bool JsonDataDelegate::add(const StructuredDataName& name, int intValue)
@@ -233,6 +540,44 @@ bool JsonDataDelegate::addArray(const StructuredDataName& name) {
     return true;
 }
 
+bool JsonDataDelegate::addSubtree(const StructuredDataName& name, StructuredData& subtree)
+{
+    Json::Value* target = nullptr;
+    if (name.getPath().empty()) {
+        if (name.getName().empty() || json_.type() != Json::objectValue) {
+            return false;
+        }
+        target = &(json_[name.getName()] = Json::Value(Json::objectValue));
+    }
+    else {
+        Json::Value* val = getJsonPtr(name, true);
+        if (!val) {
+            val = makePathJson(name.getParent());
+        }
+        if (!val) {
+            return false;
+        }
+        if (name.getName().empty()) {
+            if (!val->isArray()) {
+                return false;
+            }
+            target = &val->append(Json::Value(Json::objectValue));
+        } else {
+            target = &((*val)[name.getName()] = Json::Value(Json::objectValue));
+        }
+    }
+
+    // Object and array members are held in maps, so target stays put while the
+    // rest of the tree is being built.
+    if (getFormat() == BINARY) {
+        setDelegate(subtree, new BinaryDataDelegate(*target));
+    } else {
+        setDelegate(subtree, new JsonDataDelegate(*target));
+    }
+    setSDName(subtree, name);
+    return true;
+}
+
 bool JsonDataDelegate::get(const StructuredDataName& name, int& intValue) const {
     if (nullptr == getJsonPtr(name, false)) return false;
     Json::Value* val = getJsonPtr(name, true);
@@ -317,15 +662,46 @@ bool JsonDataDelegate::getArray(const StructuredDataName& name,
         {
             values.push_back(jval.asString());
         } else {
-            Json::FastWriter writer;
-            std::string strData = writer.write(jval);
-            values.push_back(strData);
+            std::string strData;
+            write(jval, strData);
+            values.push_back(std::move(strData));
         }
     }
 
     return true;
 }
 
+bool JsonDataDelegate::getArray(const StructuredDataName& name,
+                                std::vector<Blob>& values) const
+{
+    if (name.getName().empty()) return false;
+
+    Json::Value* val = getJsonPtr(name);
+    if (!val || !val->isArray()) return false;
+    const Blob::Type elementType = getFormat() == BINARY ? Blob::BINARY : Blob::STRING;
+    values.reserve(values.size() + val->size());
+    for (int idx = 0; idx < (int)val->size(); ++idx)
+    {
+        Json::Value& jval = (*val)[idx];
+        if (jval.isConvertibleTo(Json::stringValue))
+        {
+            values.emplace_back(name.getName(), Blob::STRING, jval.asString());
+        } else {
+            std::string strData;
+            write(jval, strData);
+            values.emplace_back(name.getName(), elementType, std::move(strData));
+        }
+    }
+
+    return true;
+}
+
+void JsonDataDelegate::write(const Json::Value& value, std::string& strData) const
+{
+    Json::FastWriter writer;
+    strData = writer.write(value);
+}
+
 bool JsonDataDelegate::getMembers(std::vector<std::string>& names) const {
     names = json_.getMemberNames();
     return true;
@@ -512,6 +888,68 @@ JsonDataDelegate::type(const StructuredDataName& name)
     return retType;
 }
 
+bool BinaryDataDelegate::parse(const StructuredDataName& name, const std::string& strData) {
+    if (strData.empty()) {
+        return false;
+    }
+
+    Json::Value* target = getJsonPtr(name);
+    if (!target) return false;
+
+    Json::Value value;
+    CborReader reader(strData);
+    if (!reader.read(value)) {
+        std::cout << "Error parsing binary structured data" << std::endl;
+        return false;
+    }
+    target->swap(value);
+    return true;
+}
+
+bool BinaryDataDelegate::unparse(const StructuredDataName& name, std::string& strData) {
+    Json::Value* value = getJsonPtr(name);
+    if (!value) return false;
+
+    strData.clear();
+    cborEncode(*value, strData);
+    return true;
+}
+
+void BinaryDataDelegate::write(const Json::Value& value, std::string& strData) const
+{
+    strData.clear();
+    cborEncode(value, strData);
+}
+
+////////////////////////////
+
+bool StructuredDataDelegate::getArray(const StructuredDataName& name,
+                                      std::vector<Blob>& values) const
+{
+    std::vector<std::string> strValues;
+    if (!getArray(name, strValues)) return false;
+
+    for (auto& strValue : strValues) {
+        values.emplace_back(name.getName(), Blob::STRING, std::move(strValue));
+    }
+    return true;
+}
+
+StructuredDataDelegate*
+StructuredDataDelegate::create(Format format)
+{
+    if (format == BINARY) {
+        return new BinaryDataDelegate;
+    }
+    return new JsonDataDelegate;
+}
+
+StructuredDataDelegate*
+StructuredDataDelegate::create(const Blob& blob)
+{
+    return create(blob.getType() == Blob::BINARY ? BINARY : TEXT);
+}
+
 ////////////////////////////
 
 StructuredData::StructuredData(const StructuredDataName& name,
@@ -521,7 +959,8 @@ StructuredData::StructuredData(const StructuredDataName& name,
     , delegate_(delegate ? delegate : new JsonDataDelegate) {
 
     if (!fromString.empty()) {
-        Blob blob("", Blob::STRING, fromString);
+        Blob blob("", delegate_->getFormat() == StructuredDataDelegate::BINARY
+                          ? Blob::BINARY : Blob::STRING, fromString);
         deserialize(blob);
     }
 }
@@ -529,7 +968,7 @@ StructuredData::StructuredData(const StructuredDataName& name,
 StructuredData::StructuredData(const StructuredDataName& name, const Blob& blob,
                                StructuredDataDelegate* delegate)
 : name_(name)
-, delegate_(delegate ? delegate : new JsonDataDelegate)
+, delegate_(delegate ? delegate : StructuredDataDelegate::create(blob))
 {
     const void* data = blob.getData();
     if (data) // This is a special case where an SD pointer is copied here.
@@ -538,6 +977,14 @@ StructuredData::StructuredData(const StructuredDataName& name, const Blob& blob,
         const JsonDataDelegate* sdDelegate = static_cast<const JsonDataDelegate *>(data);
         delegate_ = new JsonDataDelegate(*sdDelegate);
     }
+    else if (blob.getType() == Blob::STRING || blob.getType() == Blob::JSON ||
+             blob.getType() == Blob::BINARY)
+    {
+        if (!blob.getString().empty())
+        {
+            deserialize(blob);
+        }
+    }
     else
     {
         std::string fromString = blob.getString();
@@ -560,6 +1007,11 @@ bool StructuredData::add(const StructuredDataName& name, const Blob& blob)
     {
         return delegate_->parse(name, blob.getString());
     }
+    if (blob.getType() == Blob::BINARY)
+    {
+        StructuredData data(name, blob);
+        return delegate_->add(name, data);
+    }
 
     //TODO add struct to include type, name and string
     //TODO handle blob members
@@ -597,6 +1049,26 @@ bool StructuredData::addArray(const StructuredDataName& name)
     return delegate_->addArray(name);
 }
 
+bool StructuredData::addObject(const StructuredDataName& name, SerializeContract& object)
+{
+    StructuredData subtree(name.getName());
+    const bool shared = delegate_->addSubtree(name, subtree);
+    if (shared && object.serializeTo(subtree))
+    {
+        return true;
+    }
+
+    // Fall back to serializing the object to a blob in the format of this structured data
+    Blob blob("", getFormat() == StructuredDataDelegate::BINARY ? Blob::BINARY : Blob::STRING,
+              std::string());
+    if (!object.serialize(blob))
+    {
+        return false;
+    }
+    StructuredData data(name.getName(), blob);
+    return shared ? subtree.add("", data) : add(name, data);
+}
+
 bool StructuredData::get(const StructuredDataName& name, Blob& blob) const
 {
     std::string strData;
@@ -643,6 +1115,12 @@ bool StructuredData::getArray(const StructuredDataName& name,
     return delegate_->getArray(name, values);
 }
 
+bool StructuredData::getArray(const StructuredDataName& name,
+                              std::vector<Blob>& values) const
+{
+    return delegate_->getArray(name, values);
+}
+
 bool StructuredData::getMembers(std::vector<std::string>& names) const {
     return delegate_->getMembers(names);
 }
@@ -656,6 +1134,11 @@ void StructuredData::setName(const StructuredDataName& name) {
     name_ = name;
 }
 
+StructuredDataDelegate::Format
+StructuredData::getFormat() const {
+    return delegate_->getFormat();
+}
+
 bool StructuredData::isArray(const StructuredDataName& name) const
 {
     return delegate_->type(name) == StructuredDataDelegate::ARRAY;
@@ -707,7 +1190,9 @@ bool StructuredData::serialize(Blob& blob)
 {
     std::string strData;
     if (delegate_->unparse("", strData)) {
-        blob = Blob(name_.getName(true), Blob::STRING, strData); // or JSON?
+        const Blob::Type type = delegate_->getFormat() == StructuredDataDelegate::BINARY
+                                    ? Blob::BINARY : Blob::STRING; // or JSON?
+        blob = Blob(name_.getName(true), type, std::move(strData));
         return true;
     }
     return false;
@@ -715,11 +1200,22 @@ bool StructuredData::serialize(Blob& blob)
 
 bool StructuredData::deserialize(const Blob& blob)
 {
-    if (blob.getType() != Blob::STRING && blob.getType() != Blob::JSON)
+    if (blob.getType() != Blob::STRING && blob.getType() != Blob::JSON &&
+        blob.getType() != Blob::BINARY)
     {
         return false;
     }
 
+    const StructuredDataDelegate::Format format = blob.getType() == Blob::BINARY
+                                                      ? StructuredDataDelegate::BINARY
+                                                      : StructuredDataDelegate::TEXT;
+    if (delegate_->getFormat() != format && dynamic_cast<JsonDataDelegate *>(delegate_))
+    {
+        // The built-in delegates share a representation, so just switch the encoding.
+        delete delegate_;
+        delegate_ = StructuredDataDelegate::create(format);
+    }
+
 //    name_ = StructuredDataName(blob.getName());
 //    return delegate_->parse(name_, blob.getString());
     return delegate_->parse("", blob.getString());
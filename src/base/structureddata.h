@@ -39,6 +39,13 @@ public:
         NOTFOUND, INT, STRING, STRUCTUREDDATA, ARRAY
     };
 
+    /** The encoding used by parse() and unparse(). */
+    enum Format
+    {
+        TEXT,       ///< Human readable text (json)
+        BINARY      ///< Compact, length-prefixed binary (CBOR)
+    };
+
     /** Destruct a StructuredDataDelegate */
     virtual ~StructuredDataDelegate() { }
 
@@ -49,6 +56,14 @@ public:
     /** Add a named sub-structured data to the structured data. */
     virtual bool add(const StructuredDataName& name, const StructuredData& value) = 0;
     virtual bool addArray(const StructuredDataName& name) = 0;
+    /** Add a named, empty sub-structured data and make subtree refer to it, so that
+     *  anything added to subtree is written directly into this structured data.
+     *  @return false if the delegate does not support subtrees, otherwise true.
+     */
+    virtual bool addSubtree(const StructuredDataName& name, StructuredData& subtree)
+    {
+        return false;
+    }
 
     virtual bool get(const StructuredDataName& name, int& intValue) const = 0;
     virtual bool get(const StructuredDataName& name, std::string& value) const = 0;
@@ -57,6 +72,10 @@ public:
     /** Get all elements of an array. */
     virtual bool getArray(const StructuredDataName& name, 
                           std::vector<std::string>& values) const = 0;
+    /** Get all elements of an array as blobs.
+     *  Elements that are not strings are encoded in the format of this delegate.
+     */
+    virtual bool getArray(const StructuredDataName& name, std::vector<Blob>& values) const;
 
     /** Get the name of all top-level elements. */
     virtual bool getMembers(std::vector<std::string>& names) const = 0;
@@ -66,6 +85,9 @@ public:
     /** Get a string representation of the structured data */
     virtual bool unparse(const StructuredDataName& name, std::string& strData) = 0;
 
+    /** Get the encoding used by parse() and unparse(). */
+    virtual Format getFormat() const { return TEXT; }
+
     /** Remove a structured data member.
      *  @param name hierarchical name of member
      *  @return true if member was removed, otherwise false.
@@ -84,11 +106,29 @@ public:
      */
     static StructuredDataDelegate* getDelegate(StructuredData& sd);
 
+    /** Create one of the built-in delegates.
+     *  @param format the encoding of the delegate
+     *  @return a new delegate, owned by the caller
+     */
+    static StructuredDataDelegate* create(Format format);
+
+    /** Create the built-in delegate for the encoding of a blob.
+     *  Blob::BINARY blobs get a binary delegate, all others get a json delegate.
+     */
+    static StructuredDataDelegate* create(const Blob& blob);
+
     /** Set the name of a StructuredData
      *  @param sd reference to StructuredData
      *  @param name Name to assign to sd
      */
     void setSDName(StructuredData& sd, const StructuredDataName& name) const;
+
+protected:
+    /** Replace the delegate of a StructuredData
+     *  @param sd reference to StructuredData
+     *  @param delegate new delegate, which sd takes ownership of
+     */
+    static void setDelegate(StructuredData& sd, StructuredDataDelegate* delegate);
 };
 
 /**
@@ -118,7 +158,9 @@ public:
      *              If blob contains a data pointer, then it is cast directly as the internal 
      *              structure (json, etc.).
      *  @param delegate the object that handles the actual implementation. If the
-     *             delegate is not provided, then the default json delegate is used.
+     *             delegate is not provided, then the delegate is chosen by the blob type:
+     *             binary for Blob::BINARY, otherwise json.  An empty blob can be used to
+     *             just select the format.
      */
     StructuredData(const StructuredDataName& name, const Blob& blob,
                    StructuredDataDelegate* delegate = nullptr);
@@ -154,6 +196,17 @@ public:
      */
     bool addArray(const StructuredDataName& name);
 
+    /** Add a named object that serializes itself directly into this structured data.
+     *
+     *  The object's SerializeContract::serializeTo() writes into a subtree of this
+     *  structured data, so nothing is unparsed or parsed.  If the object or the delegate
+     *  does not support that, then the object is serialized to a blob which is added.
+     *  @param name Name of the object.  If adding an element to an array, then name
+     *              specifies the array name plus a trailing dot (".").
+     *  @return true if the object was added, otherwise false.
+     */
+    bool addObject(const StructuredDataName& name, SerializeContract& object);
+
     /** Get a named blob from the structured data. */
     bool get(const StructuredDataName& name, Blob& blob) const;
     /** Get a named sub-structured data from the structured data. */
@@ -169,6 +222,11 @@ public:
     /** Get all elements of an array. */
     bool getArray(const StructuredDataName& name, 
                   std::vector<std::string>& values) const;
+    /** Get all elements of an array as blobs.
+     *  String elements are Blob::STRING blobs.  Other elements hold serialized structured
+     *  data in the format of this structured data.
+     */
+    bool getArray(const StructuredDataName& name, std::vector<Blob>& values) const;
 
     /** Get the name of all top-level elements.
      *  @param names string vector where element names are written.
@@ -179,6 +237,9 @@ public:
     const StructuredDataName& getName() const;
     void setName(const StructuredDataName& name);
 
+    /** Get the format that serialize() writes. */
+    StructuredDataDelegate::Format getFormat() const;
+
     /** Check if the given element name is an array. */
     bool isArray(const StructuredDataName& name) const;
 
@@ -201,7 +262,12 @@ public:
     //TODO: freeze(Gas,Water,Ice), inheritance
 
     // Implement SerializeContract Interface
+    /** Serialize to a Blob::STRING or Blob::BINARY blob, depending on the delegate format. */
     virtual bool serialize(Blob& blob);
+    /** Deserialize from a string or binary blob.
+     *  If a built-in delegate has a different format than the blob, then it is replaced
+     *  by one of the blob's format.
+     */
     virtual bool deserialize(const Blob& blob);
 
 protected:
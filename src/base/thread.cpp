@@ -15,14 +15,21 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+#include "callback.h"
+#include "canceltoken.h"
 #include "context.h"
+#include "executor.h"
 #include "thread.h"
-#include "osdep/platform.h"
 
 using namespace aft::base;
-using namespace aft::osdep;
 using namespace std;
 
 ThreadManager* ThreadManager::instance_ = 0;
@@ -33,44 +40,298 @@ class aft::base::ThreadManagerImpl
 public:
     void addThread(ThreadHandler* thread)
     {
-        unique_lock<mutex> lck(mutex_);
-        threads_.push_back(thread);
+        thread->registeredTObject_ = thread->getTObject();
+        thread->generation_ = nextGeneration_.fetch_add(1, memory_order_relaxed);
+        Shard& shard = shardOf(thread->registeredTObject_);
+        unique_lock<mutex> lck(shard.mutex_);
+        shard.threads_.emplace(thread->registeredTObject_,
+                               Entry{ thread, thread->generation_ });
     }
 
+    /** Find the handler most recently added for tObject. */
     ThreadHandler* findThread(const TObject* tObject)
     {
-        unique_lock<mutex> lck(mutex_);
-        for (auto* thread : threads_) {
-            if (thread->getTObject() == tObject) {
-                return thread;
+        Shard& shard = shardOf(tObject);
+        unique_lock<mutex> lck(shard.mutex_);
+        auto range = shard.threads_.equal_range(tObject);
+        ThreadHandler* found = nullptr;
+        uint64_t newest = 0;
+        for (auto it = range.first; it != range.second; ++it) {
+            if (!found || it->second.generation > newest) {
+                found = it->second.thread;
+                newest = it->second.generation;
             }
         }
-        
-        return nullptr;
+        return found;
     }
 
+    // Called from ~ThreadHandler, so only uses what the registry stored
     void removeThread(ThreadHandler* thread)
     {
-        unique_lock<mutex> lck(mutex_);
-        auto it = find(threads_.begin(), threads_.end(), thread);
-        if (it != threads_.end())
-        {
-            threads_.erase(it);
+        Shard& shard = shardOf(thread->registeredTObject_);
+        unique_lock<mutex> lck(shard.mutex_);
+        auto range = shard.threads_.equal_range(thread->registeredTObject_);
+        for (auto it = range.first; it != range.second; ++it) {
+            // A new handler at the same address has a new generation
+            if (it->second.thread == thread && it->second.generation == thread->generation_)
+            {
+                shard.threads_.erase(it);
+                return;
+            }
         }
     }
 
     void stopAll(bool force)
     {
-        unique_lock<mutex> lck(mutex_);
-        for (auto* thread : threads_) {
-            thread->stop(force);
+        for (Shard& shard : shards_) {
+            unique_lock<mutex> lck(shard.mutex_);
+            for (auto& entry : shard.threads_) {
+                entry.second.thread->stop(force);
+            }
+        }
+    }
+
+    /** Get the executor, starting its threads the first time. */
+    Executor& executor()
+    {
+        Executor* executor = executor_.load(memory_order_acquire);
+        if (executor) return *executor;
+
+        unique_lock<mutex> lck(executorMutex_);
+        if (!executor_.load()) {
+            const unsigned int numThreads = maxThreads_ > 0
+                ? maxThreads_ : max(4u, std::thread::hardware_concurrency());
+            executor_.store(new Executor(numThreads), memory_order_release);
+        }
+        return *executor_.load();
+    }
+
+    /** Get the executor if its threads are started, otherwise nullptr. */
+    Executor* startedExecutor() const
+    {
+        return executor_.load(memory_order_acquire);
+    }
+
+    bool setMaxThreads(unsigned int maxThreads)
+    {
+        unique_lock<mutex> lck(executorMutex_);
+        if (executor_.load()) return false;
+        maxThreads_ = maxThreads;
+        return true;
+    }
+
+    unsigned int getMaxThreads()
+    {
+        unique_lock<mutex> lck(executorMutex_);
+        if (executor_.load()) return executor_.load()->size();
+        return maxThreads_ > 0 ? maxThreads_ : max(4u, std::thread::hardware_concurrency());
+    }
+
+    ~ThreadManagerImpl()
+    {
+        delete executor_.load();
+    }
+
+private:
+    /** Registered handler, told apart from earlier handlers at the same address */
+    struct Entry {
+        ThreadHandler* thread;
+        uint64_t generation;
+    };
+
+    /** Part of the registry with a lock of its own */
+    struct Shard {
+        mutex mutex_;
+        unordered_multimap<const TObject*, Entry> threads_;
+        // Keeps the locks of neighbouring shards off the same cache line
+        char padding_[64];
+    };
+
+    static constexpr size_t NumShards = 64;
+
+    Shard& shardOf(const TObject* tObject)
+    {
+        // Fibonacci hashing spreads neighbouring addresses over the shards,
+        // the top 6 bits pick one of 64
+        static_assert(NumShards == 64, "shard index uses 6 bits");
+        const uint64_t key = reinterpret_cast<uintptr_t>(tObject) >> 4;
+        return shards_[(key * 0x9E3779B97F4A7C15ull) >> 58];
+    }
+
+    Shard shards_[NumShards];
+    atomic<uint64_t> nextGeneration_{1};
+
+    atomic<Executor*> executor_{nullptr};
+    mutex executorMutex_;
+    unsigned int maxThreads_ = 0;
+};
+
+
+namespace {
+/** State shared by a TaskHandler and its queued task. */
+struct TaskState {
+    TaskState(TObject* a_tObject, Context* a_context)
+    : tObject(a_tObject)
+    , context(a_context)
+    , callback(nullptr)
+    , started(false)
+    , stopped(false)
+    , done(false)
+    , result(false)
+    {  }
+
+    TObject* tObject;
+    Context* context;
+    mutex lock;
+    condition_variable finished;
+    Callback* callback;
+    CancelToken token;
+    bool started;
+    bool stopped;
+    bool done;
+    Result result;
+};
+
+// Run the tobject from within a worker
+void runTask(TaskState& state)
+{
+    bool stopped;
+    {
+        unique_lock<mutex> lck(state.lock);
+        stopped = state.stopped;
+    }
+
+    Result result(false);
+    if (!stopped)
+    {
+        CancelToken::Scope scope(state.token);
+        result = state.tObject->run(state.context);
+    }
+
+    Callback* callback;
+    {
+        unique_lock<mutex> lck(state.lock);
+        callback = state.callback;
+    }
+    if (callback)
+    {
+        callback->callback(&result);
+    }
+
+    state.tObject->setState(state.token.isCancelled() ? TObject::STOPPED
+                                                      : TObject::FINISHED_GOOD);
+    {
+        unique_lock<mutex> lck(state.lock);
+        state.result = result;
+        state.done = true;
+    }
+    state.finished.notify_all();
+}
+
+/**
+ *  Handle to a TObject that is run as a task on the executor.
+ *  @copydoc aft::base::ThreadHandler
+ */
+class TaskHandler : public ThreadHandler
+{
+public:
+    TaskHandler(TObject* tObject, Context* context, ThreadManagerImpl& manager)
+    : state_(make_shared<TaskState>(tObject, context))
+    , manager_(manager)
+    {  }
+
+    virtual ~TaskHandler()
+    {
+        stop(true);
+        wait();
+    }
+
+    virtual Result getResult()
+    {
+        unique_lock<mutex> lck(state_->lock);
+        if (state_->done) return state_->result;
+        return state_->tObject->getResult();
+    }
+
+    virtual TObject::State getState()
+    {
+        return state_->tObject->getState();
+    }
+
+    virtual TObject* getTObject() const
+    {
+        return state_->tObject;
+    }
+
+    virtual void notify(Callback* callback)
+    {
+        unique_lock<mutex> lck(state_->lock);
+        state_->callback = callback;
+    }
+
+    virtual bool unnotify(Callback* callback)
+    {
+        unique_lock<mutex> lck(state_->lock);
+        state_->callback = nullptr;
+        return true;
+    }
+
+    virtual void run()
+    {
+        {
+            unique_lock<mutex> lck(state_->lock);
+            if (state_->started) return;
+            state_->started = true;
+            if (state_->stopped)
+            {
+                state_->done = true;
+                return;
+            }
+        }
+        shared_ptr<TaskState> state = state_;
+        manager_.executor().submit([state] { runTask(*state); });
+    }
+
+    // Running TObjects stop at their next check of the token, even if force
+    virtual void stop(bool force)
+    {
+        unique_lock<mutex> lck(state_->lock);
+        state_->stopped = true;
+        state_->token.cancel();
+    }
+
+    virtual Result wait()
+    {
+        Executor* executor = manager_.startedExecutor();
+        const bool helping = executor && executor->onWorker();
+        unique_lock<mutex> lck(state_->lock);
+        if (!state_->started) return Result(false);
+
+        while (!state_->done)
+        {
+            if (!helping)
+            {
+                state_->finished.wait(lck);
+                continue;
+            }
+            // Run other tasks meanwhile, so tasks that wait for tasks cannot
+            // tie up all of the workers
+            lck.unlock();
+            const bool ran = executor->runPending();
+            lck.lock();
+            if (!ran && !state_->done)
+            {
+                state_->finished.wait_for(lck, chrono::milliseconds(1));
+            }
         }
+        return state_->result;
     }
 
 private:
-    vector<ThreadHandler*> threads_;
-    mutex mutex_;
+    shared_ptr<TaskState> state_;
+    ThreadManagerImpl& manager_;
 };
+}
 
 
 ThreadHandler::~ThreadHandler()
@@ -111,9 +372,19 @@ void ThreadManager::stopAll(bool force)
 
 ThreadHandler* ThreadManager::thread(TObject* tObject, Context* context)
 {
-    ThreadHandler* threadHandler = new PlatformThreadHandler(tObject, context);
+    ThreadHandler* threadHandler = new TaskHandler(tObject, context, impl_);
     impl_.addThread(threadHandler);
 
     return threadHandler;
 }
 
+bool ThreadManager::setMaxThreads(unsigned int maxThreads)
+{
+    return impl_.setMaxThreads(maxThreads);
+}
+
+unsigned int ThreadManager::getMaxThreads() const
+{
+    return impl_.getMaxThreads();
+}
+
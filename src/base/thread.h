@@ -14,6 +14,7 @@
  *   See the License for the specific language governing permissions and
  *   limitations under the License.
  */
+#include <cstdint>
 #include "result.h"
 #include "tobject.h"
 
@@ -82,20 +83,30 @@ public:
     /**
      *  Stop a running thread.
      *
-     *  @param force if true then the thread will be forcibly terminated.
+     *  Stopping is cooperative: the CancelToken of the thread is cancelled, and the
+     *  TObject stops at its next check, e.g., between the children of a container.
+     *  A thread that has not started yet does not run the TObject.
+     *  @param force kept for compatibility; threads are never killed.
      */
     virtual void stop(bool force = false) = 0;
 
     /** Wait for this thread to exit. */
     virtual Result wait() = 0;
+
+private:
+    // Set by the ThreadManager registry when the handler is added
+    const TObject* registeredTObject_ = nullptr;
+    uint64_t generation_ = 0;
+    friend ThreadManagerImpl;
 };
 
 
 /**
  *  Single place to create threads from other parts of the library.
  *
- *  Internally, this class uses the osdep mechanism to instantiate the
- *  correct ThreadHandler sub-class.
+ *  TObjects are run as tasks on a work-stealing Executor with a capped number of
+ *  threads, so starting many TObjects does not start as many OS threads.  The
+ *  ThreadHandler returned is a handle to the task.
  */
 class ThreadManager
 {
@@ -114,7 +125,7 @@ public:
      *  Stop all running threads.
      *
      *  Call stop on all ThreadHandlers
-     *  @param force if true then the threads will be forcibly terminated.
+     *  @param force passed on to ThreadHandler::stop()
      */
     /** Call stop on all ThreadHandlers */
     void stopAll(bool force = false);
@@ -128,6 +139,19 @@ public:
      */
     ThreadHandler* thread(TObject* tObject, Context* context = 0);
 
+    /**
+     *  Set the most threads used to run TObjects.
+     *
+     *  The threads are started when the first TObject is run, after which the
+     *  number cannot change.
+     *  @param maxThreads Number of threads, 0 for one per core (at least 4).
+     *  @return false if the threads are already started.
+     */
+    bool setMaxThreads(unsigned int maxThreads);
+
+    /** Get the most threads used to run TObjects. */
+    unsigned int getMaxThreads() const;
+
 private:
     ThreadManager(Context* context = 0);
     virtual ~ThreadManager();
@@ -62,18 +62,17 @@ TOBlob::operator bool() const {
     return value_;
 }
 
-bool TOBlob::serialize(Blob& blob)
+bool TOBlob::serializeTo(StructuredData& sd)
 {
-    if (!TObject::serialize(blob))
+    if (!TObject::serializeMembers(sd))
     {
         return false;
     }
 
-    StructuredData sd(TObjectType::NameBasicType, blob);
     sd.add("blobtype", value_->getType());
     sd.add("value", value_->getString());
 
-    return sd.serialize(blob);
+    return true;
 }
 
 bool TOBlob::deserialize(const Blob& blob) {
@@ -157,16 +156,15 @@ TOBool::operator bool() const
     return value_;
 }
 
-bool TOBool::serialize(Blob& blob)
+bool TOBool::serializeTo(StructuredData& sd)
 {
-    if (!TObject::serialize(blob)) {
+    if (!TObject::serializeMembers(sd)) {
         return false;
     }
     
-    StructuredData sd(TObjectType::NameBasicType, blob);
     sd.add("value", value_);
     
-    return sd.serialize(blob);
+    return true;
 }
 
 bool TOBool::deserialize(const Blob& blob)
@@ -285,17 +283,16 @@ TOInteger::operator bool() const
     return value_;
 }
 
-bool TOInteger::serialize(Blob& blob)
+bool TOInteger::serializeTo(StructuredData& sd)
 {
-    if (!TObject::serialize(blob))
+    if (!TObject::serializeMembers(sd))
     {
         return false;
     }
     
-    StructuredData sd(TObjectType::NameBasicType, blob);
     sd.add("value", value_);
     
-    return sd.serialize(blob);
+    return true;
 }
 
 bool TOInteger::deserialize(const Blob& blob)
@@ -331,17 +328,16 @@ TOString::operator bool() const
     return !value_.empty();
 }
 
-bool TOString::serialize(Blob& blob)
+bool TOString::serializeTo(StructuredData& sd)
 {
-    if (!TObject::serialize(blob))
+    if (!TObject::serializeMembers(sd))
     {
         return false;
     }
     
-    StructuredData sd(TObjectType::NameBasicType, blob);
     sd.add("value", value_);
     
-    return sd.serialize(blob);
+    return true;
 }
 
 bool TOString::deserialize(const Blob& blob)
@@ -197,7 +197,7 @@ public:
     virtual operator bool() const;
     virtual int compare(const TOBlob& other) const;
 
-    bool serialize(Blob& blob);
+    bool serializeTo(StructuredData& sd);
     bool deserialize(const Blob& blob);
 };
     
@@ -213,7 +213,7 @@ public:
     bool supportsOperation(const Operation& operation);
     
     virtual operator bool() const;
-    bool serialize(Blob& blob);
+    bool serializeTo(StructuredData& sd);
     bool deserialize(const Blob& blob);
 };
 
@@ -229,7 +229,7 @@ public:
     bool supportsOperation(const Operation& operation);
 
     virtual operator bool() const;
-    bool serialize(Blob& blob);
+    bool serializeTo(StructuredData& sd);
     bool deserialize(const Blob& blob);
 };
 
@@ -242,7 +242,7 @@ public:
     TOString(const std::string& value, const std::string& name = std::string());
 
     virtual operator bool() const;
-    bool serialize(Blob& blob);
+    bool serializeTo(StructuredData& sd);
     bool deserialize(const Blob& blob);
 };
 
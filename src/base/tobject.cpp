@@ -265,25 +265,45 @@ bool TObject::supportsOperation(const Operation& operation)
 
 bool
 TObject::serialize(Blob& blob)
+{
+    // The blob type selects the format
+    base::StructuredData sd(getType().name(), std::string(), StructuredDataDelegate::create(blob));
+
+    // Subclasses add their members in serializeTo(), so there is just one unparse.
+    // If serializeTo() is not overridden nothing is written, so add the TObject members.
+    if (!serializeTo(sd))
+    {
+        std::vector<std::string> names;
+        if (!sd.getMembers(names) || !names.empty() || !serializeMembers(sd))
+        {
+            return false;
+        }
+    }
+    return sd.serialize(blob);
+}
+
+bool
+TObject::serializeTo(StructuredData& sd)
+{
+    // Not handled: a subclass may only override serialize(), so nested objects must
+    // fall back to it
+    return false;
+}
+
+bool
+TObject::serializeMembers(StructuredData& sd)
 {
     if (state_ == INVALID) {
         return false;
     }
 
-    base::StructuredData sd("TObject");
-
     //TODO perhaps annotate serialized names of base TObject members (underscore, caps, etc.)
     sd.add("type", getType().name());
     sd.add("name", getName());
     sd.add("state", getState());    // Not always possible to deserialize to this state
     sd.add("result", getResult().asString());   //TODO replace when result is serializable
 
-    bool retval = sd.serialize(blob);
-
-    //TODO shortcut for subclasses to avoid parse/unparse of StructuredData
-    //blob.addData(StructuredDataDelegate::getDelegate(sd));
-    
-    return retval;
+    return true;
 }
 
 bool
@@ -407,7 +427,8 @@ TObjectContainer::run(Context* context)
     if (children_)
     {
         for (iterator_ = children_->begin();
-             iterator_ != children_->end() && result_.getType() != Result::FATAL;
+             iterator_ != children_->end() && result_.getType() != Result::FATAL &&
+             !Context::isCancelled(context);     // stop between children when cancelled
              ++iterator_)
         {
             TObject* tobj = iterator_.get();
@@ -419,7 +440,12 @@ TObjectContainer::run(Context* context)
     }
 
     // set state_ as one of finished
-    //TODO check for interrupted
+    if (Context::isCancelled(context))
+    {
+        result_ = Result(Result::FATAL);
+        setState(STOPPED);
+        return result_;
+    }
     setState(!result_ ? FINISHED_BAD : FINISHED_GOOD);
     return result_;
 }
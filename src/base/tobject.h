@@ -152,8 +152,14 @@ public:
     virtual bool supportsOperation(const Operation& operation);
 
     // Implement SerializeContract
+    /** Serialize via serializeTo(), which subclasses override to add their members. */
     virtual bool serialize(Blob& blob);
     virtual bool deserialize(const Blob& blob);
+    /** Returns false (not handled) unless overridden, so that subclasses that only
+     *  override serialize() are serialized with it when nested in other objects.
+     *  Overrides call serializeMembers() and then add their own members.
+     */
+    virtual bool serializeTo(StructuredData& sd);
 
     //TODO implement pluggable contract
     //TODO cast operators for frequent autoconversions:
@@ -161,6 +167,9 @@ public:
     //TODO usage counter
 
 protected:
+    /** Add the TObject members (type, name, state and result) to sd. */
+    bool serializeMembers(StructuredData& sd);
+
     TObjectType& type_;
     std::string name_;
     State state_;
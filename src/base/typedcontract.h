@@ -0,0 +1,260 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <cstddef>
+#include "base/consumer.h"
+#include "base/producer.h"
+
+namespace aft
+{
+namespace base
+{
+// Forward reference
+class Blob;
+class Result;
+class TObject;
+
+/**
+ *  The ProductType of a product class, known at compile time.
+ */
+template<typename T> struct ProductTypeOf;
+template<> struct ProductTypeOf<TObject> { static constexpr ProductType value = ProductType::TOBJECT; };
+template<> struct ProductTypeOf<Result>  { static constexpr ProductType value = ProductType::RESULT; };
+template<> struct ProductTypeOf<Blob>    { static constexpr ProductType value = ProductType::BLOB; };
+
+/**
+ *  Interface for producers of a single product type.
+ *
+ *  Unlike ProducerContract there is one take() per type instead of overloads for every
+ *  type, and take() just returns false when there is nothing to read, so callers do
+ *  not check hasData() before each item.  Batches are taken with one virtual call.
+ */
+template<typename T>
+class TypedProducer
+{
+public:
+    virtual ~TypedProducer() = default;
+
+    /** Take the next item.
+     *  @return true if an item was taken, false if none is available.
+     */
+    virtual bool take(T& item) = 0;
+    /** Take up to count items.  The default takes them one at a time.
+     *  @return the number of items taken into the front of items.
+     */
+    virtual size_t take(T* items, size_t count)
+    {
+        size_t taken = 0;
+        while (taken < count && take(items[taken]))
+        {
+            ++taken;
+        }
+        return taken;
+    }
+    virtual bool hasData() = 0;
+};
+
+/**
+ *  Interface for consumers of a single product type.
+ */
+template<typename T>
+class TypedConsumer
+{
+public:
+    virtual ~TypedConsumer() = default;
+
+    /** Put an item.
+     *  @return true if the item was consumed.
+     */
+    virtual bool put(const T& item) = 0;
+    /** Put up to count items.  The default puts them one at a time.
+     *  @return the number of items consumed, which stops at the first that is not.
+     */
+    virtual size_t put(const T* items, size_t count)
+    {
+        size_t consumed = 0;
+        while (consumed < count && put(items[consumed]))
+        {
+            ++consumed;
+        }
+        return consumed;
+    }
+    virtual bool canAcceptData() = 0;
+};
+
+/**
+ *  A TypedProducer that takes from any ProducerContract.
+ *  The read() overload for T is picked at compile time.
+ */
+template<typename T>
+class ContractProducer : public TypedProducer<T>
+{
+public:
+    ContractProducer(ProducerContract& producer)
+    : producer_(producer)
+    {  }
+
+    using TypedProducer<T>::take;
+    virtual bool take(T& item) override
+    {
+        return producer_.read(item);
+    }
+    virtual bool hasData() override
+    {
+        return producer_.hasData();
+    }
+
+private:
+    ProducerContract& producer_;
+};
+
+/**
+ *  A TypedConsumer that puts to any ConsumerContract.
+ */
+template<typename T>
+class ContractConsumer : public TypedConsumer<T>
+{
+public:
+    ContractConsumer(ConsumerContract& consumer)
+    : consumer_(consumer)
+    {  }
+
+    virtual bool put(const T& item) override
+    {
+        return consumer_.write(item);
+    }
+    /** Put the items with one batch write.  The vector holds copies of the items.
+     *  Consumers whose batch write fails with -1 get the items one at a time.
+     */
+    virtual size_t put(const T* items, size_t count) override
+    {
+        int written = consumer_.write(std::vector<T>(items, items + count));
+        if (written >= 0) return written;
+
+        return TypedConsumer<T>::put(items, count);
+    }
+    virtual bool canAcceptData() override
+    {
+        return consumer_.canAcceptData();
+    }
+
+private:
+    ConsumerContract& consumer_;
+};
+
+/**
+ *  A ProducerContract for code that reads a TypedProducer through the old interface.
+ *  Reads of other product types return false.
+ */
+template<typename T>
+class ProducerBridge : public ProducerContract
+{
+public:
+    ProducerBridge(TypedProducer<T>& producer)
+    : producer_(producer)
+    {  }
+
+    virtual Result read(TObject& object) override  { return readAs(object); }
+    virtual Result read(Result& result) override   { return readAs(result); }
+    virtual Result read(Blob& blob) override       { return readAs(blob); }
+    virtual bool hasData() override
+    {
+        return producer_.hasData();
+    }
+    virtual bool hasObject(ProductType productType) override
+    {
+        return productType == ProductTypeOf<T>::value && producer_.hasData();
+    }
+    virtual bool registerDataCallback(const ReaderContract* reader) override
+    {
+        return false;
+    }
+    virtual bool unregisterDataCallback(const ReaderContract* reader) override
+    {
+        return false;
+    }
+
+private:
+    bool readAs(T& item)
+    {
+        return producer_.take(item);
+    }
+    template<typename Other>
+    bool readAs(Other& item)
+    {
+        return false;
+    }
+
+    TypedProducer<T>& producer_;
+};
+
+/**
+ *  A ConsumerContract for code that writes a TypedConsumer through the old interface.
+ *  Writes of other product types return false.
+ */
+template<typename T>
+class ConsumerBridge : public ConsumerContract
+{
+public:
+    ConsumerBridge(TypedConsumer<T>& consumer)
+    : consumer_(consumer)
+    {  }
+
+    virtual bool canAcceptData() override
+    {
+        return consumer_.canAcceptData();
+    }
+    virtual Result write(const TObject& object) override  { return writeAs(object); }
+    virtual Result write(const Result& result) override   { return writeAs(result); }
+    virtual Result write(const Blob& blob) override       { return writeAs(blob); }
+    virtual int write(const std::vector<TObject>& objects) override  { return writeAs(objects); }
+    virtual int write(const std::vector<Result>& results) override   { return writeAs(results); }
+    virtual int write(const std::vector<Blob>& blobs) override       { return writeAs(blobs); }
+    virtual bool registerWriteCallback(const WriterContract* writer) override
+    {
+        return false;
+    }
+    virtual bool unregisterWriteCallback(const WriterContract* writer) override
+    {
+        return false;
+    }
+
+private:
+    bool writeAs(const T& item)
+    {
+        return consumer_.put(item);
+    }
+    int writeAs(const std::vector<T>& items)
+    {
+        return consumer_.put(items.data(), items.size());
+    }
+    template<typename Other>
+    bool writeAs(const Other& item)
+    {
+        return false;
+    }
+    template<typename Other>
+    int writeAs(const std::vector<Other>& items)
+    {
+        return 0;
+    }
+
+    TypedConsumer<T>& consumer_;
+};
+
+} // namespace base
+} // namespace aft
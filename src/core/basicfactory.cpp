@@ -101,6 +101,7 @@ BasicCommandFactory::construct(const std::string& name, const base::Blob* blob,
         //TODO general json parser
         break;
     case base::Blob::STRING:
+    case base::Blob::BINARY:
     {
         base::StructuredData sd("");
         if (!sd.deserialize(*blob)) break;
@@ -14,28 +14,72 @@
  *   limitations under the License.
  */
 
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <fcntl.h>
 #include <fstream>
+#include <mutex>
+#include <thread>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
 
 #include "base/blob.h"
 #include "base/producer.h"
 #include "base/result.h"
 #include "base/tobject.h"
+#include "core/logger.h"
 #include "fileconsumer.h"
 
 
 using namespace aft::base;
 using namespace aft::core;
 
+// Most buffers given to one writev()
+static const size_t MaxIovecs = 1024;
+
+// Get the bytes that a FileConsumer writes for a blob.
+static void getBytes(const Blob& blob, const char*& bytes, size_t& length)
+{
+    if (blob.getType() != Blob::RAWDATA && blob.getBytes())
+    {
+        // Write the bytes in place, so slices are not copied to a string first
+        bytes = blob.getBytes();
+        length = blob.getLength();
+    }
+    else
+    {
+        const std::string& strBlob = blob.getString();
+        bytes = strBlob.c_str();
+        length = strBlob.length();
+    }
+}
+
+// Sync the data of a file to storage.
+static bool syncFile(int fd)
+{
+#if __APPLE__
+    return fsync(fd) == 0;
+#else
+    return fdatasync(fd) == 0;
+#endif
+}
+
 
 class aft::core::FileWriterImpl : public aft::base::ReaderContract
 {
 public:
     FileWriterImpl(const std::string& fileName, bool overwrite);
+    FileWriterImpl(const std::string& fileName, bool overwrite,
+                   const FileConsumer::AsyncPolicy& policy);
     virtual ~FileWriterImpl();
 
     virtual bool pushData(const TObject& object) override;
     virtual bool pushData(const Result& result) override;
     virtual bool pushData(const Blob& blob) override;
+    virtual size_t pushData(const Blob* blobs, size_t count) override;
 
     bool roomForData() const;
     bool roomForObject(ProductType productType) const;
@@ -43,17 +87,74 @@ public:
     bool is_open();
     bool open();
     void close();
+    bool sync();
 
 private:
+    /** Queue blobs for the writer thread, waiting for room as needed.
+     *  @return the number of blobs queued
+     */
+    size_t queue(const Blob* blobs, size_t count);
+    /** Write groups of queued blobs until closed. */
+    void writeLoop();
+    /** Check if the queued blobs should be written now. */
+    bool mustWrite() const;
+    /** Write a group of blobs with as few writev() calls as possible. */
+    bool writeGroup(std::vector<Blob>& group);
+
     std::string fileName_;
     bool overwrite_;
     std::ofstream outfile_;
     std::string buffer_;
+
+    // Asynchronous mode
+    bool async_;
+    FileConsumer::AsyncPolicy policy_;
+    int fd_;
+    std::thread writer_;
+    mutable std::mutex lock_;
+    std::condition_variable queued_;    // signals the writer thread
+    std::condition_variable written_;   // signals threads in write() or sync()
+    std::vector<Blob> ring_;
+    size_t head_;
+    size_t count_;
+    size_t queuedBytes_;
+    std::chrono::steady_clock::time_point firstQueued_;
+    unsigned long syncRequests_;
+    unsigned long syncsDone_;
+    bool closing_;
+    bool failed_;
 };
 
 FileWriterImpl::FileWriterImpl(const std::string& fileName, bool overwrite)
     : fileName_(fileName)
     , overwrite_(overwrite)
+    , async_(false)
+    , fd_(-1)
+    , head_(0)
+    , count_(0)
+    , queuedBytes_(0)
+    , syncRequests_(0)
+    , syncsDone_(0)
+    , closing_(false)
+    , failed_(false)
+{
+}
+
+FileWriterImpl::FileWriterImpl(const std::string& fileName, bool overwrite,
+                               const FileConsumer::AsyncPolicy& policy)
+    : fileName_(fileName)
+    , overwrite_(overwrite)
+    , async_(true)
+    , policy_(policy)
+    , fd_(-1)
+    , ring_(policy.capacity > 0 ? policy.capacity : 1, Blob(""))
+    , head_(0)
+    , count_(0)
+    , queuedBytes_(0)
+    , syncRequests_(0)
+    , syncsDone_(0)
+    , closing_(false)
+    , failed_(false)
 {
 }
 
@@ -74,14 +175,32 @@ bool FileWriterImpl::pushData(const Result& result)
 
 bool FileWriterImpl::pushData(const Blob& blob)
 {
-    const std::string& strBlob = blob.getString();
-    outfile_.write(strBlob.c_str(), strBlob.length());
+    return pushData(&blob, 1) == 1;
+}
+
+size_t FileWriterImpl::pushData(const Blob* blobs, size_t count)
+{
+    if (async_) return queue(blobs, count);
+
+    // Flush once for the whole batch
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        const char* bytes;
+        size_t length;
+        getBytes(blobs[idx], bytes, length);
+        outfile_.write(bytes, length);
+    }
     outfile_.flush();
 
-    return !(outfile_.rdstate() & std::ofstream::failbit);
+    return (outfile_.rdstate() & std::ofstream::failbit) ? 0 : count;
 }
 
 bool FileWriterImpl::roomForData() const {
+    if (async_)
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        return fd_ >= 0 && !failed_ && count_ < ring_.size();
+    }
     return outfile_.good();
 }
 
@@ -94,6 +213,11 @@ bool FileWriterImpl::roomForObject(ProductType productType) const {
 
 bool FileWriterImpl::is_open()
 {
+    if (async_)
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        return fd_ >= 0;
+    }
     return outfile_.is_open();
 }
 
@@ -104,18 +228,217 @@ bool FileWriterImpl::open()
         return false;
     }
 
+    if (async_)
+    {
+        int fd = ::open(fileName_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) return false;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            fd_ = fd;
+        }
+
+        writer_ = std::thread(&FileWriterImpl::writeLoop, this);
+        return true;
+    }
+
     outfile_.open(fileName_.c_str(), std::ofstream::out);
     return outfile_.is_open();
 }
 
 void FileWriterImpl::close()
 {
+    if (writer_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            closing_ = true;
+        }
+        queued_.notify_one();
+        writer_.join();
+    }
+    int fd = -1;
+    {
+        // Writers waiting for room check fd_ under the lock
+        std::lock_guard<std::mutex> guard(lock_);
+        std::swap(fd, fd_);
+    }
+    written_.notify_all();
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
     if (outfile_.is_open())
     {
         outfile_.close();
     }
 }
 
+bool FileWriterImpl::sync()
+{
+    if (!async_)
+    {
+        outfile_.flush();
+        if (!outfile_.good()) return false;
+
+        // The stream has no descriptor, but syncing any descriptor syncs the file
+        int fd = ::open(fileName_.c_str(), O_WRONLY);
+        bool synced = fd >= 0 && syncFile(fd);
+        if (fd >= 0) ::close(fd);
+        return synced;
+    }
+
+    std::unique_lock<std::mutex> guard(lock_);
+    if (fd_ < 0) return false;
+
+    unsigned long request = ++syncRequests_;
+    queued_.notify_one();
+    written_.wait(guard, [&] { return syncsDone_ >= request || failed_; });
+    return !failed_;
+}
+
+size_t FileWriterImpl::queue(const Blob* blobs, size_t count)
+{
+    size_t queued = 0;
+    std::unique_lock<std::mutex> guard(lock_);
+    while (queued < count)
+    {
+        written_.wait(guard, [&] { return count_ < ring_.size() || failed_ || fd_ < 0; });
+        if (failed_ || fd_ < 0) break;
+
+        bool wasEmpty = count_ == 0;
+        if (wasEmpty)
+        {
+            firstQueued_ = std::chrono::steady_clock::now();
+        }
+        // Fill as much of the ring as there is room for
+        for (; queued < count && count_ < ring_.size(); ++queued)
+        {
+            Blob& slot = ring_[(head_ + count_) % ring_.size()];
+            slot = blobs[queued];
+            ++count_;
+            queuedBytes_ += slot.getLength();
+        }
+
+        // The writer thread only needs to wake up when a threshold is reached
+        if (mustWrite() || wasEmpty)
+        {
+            queued_.notify_one();
+        }
+    }
+    return queued;
+}
+
+bool FileWriterImpl::mustWrite() const
+{
+    if (count_ == 0) return syncRequests_ > syncsDone_;
+
+    return closing_ || count_ == ring_.size() || syncRequests_ > syncsDone_ ||
+           (policy_.flushBytes == 0 && policy_.flushMilliseconds == 0) ||
+           (policy_.flushBytes > 0 && queuedBytes_ >= policy_.flushBytes);
+}
+
+void FileWriterImpl::writeLoop()
+{
+    std::vector<Blob> group;
+    group.reserve(ring_.size());
+
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;)
+    {
+        // Wait until a group must be written or the oldest queued blob is due
+        while (!mustWrite() && !(closing_ && count_ == 0))
+        {
+            if (count_ > 0 && policy_.flushMilliseconds > 0)
+            {
+                std::chrono::steady_clock::time_point due =
+                    firstQueued_ + std::chrono::milliseconds(policy_.flushMilliseconds);
+                if (queued_.wait_until(guard, due) == std::cv_status::timeout) break;
+            }
+            else
+            {
+                queued_.wait(guard);
+            }
+        }
+
+        // Take the group, so blobs can be queued while it is written
+        while (count_ > 0)
+        {
+            group.push_back(std::move(ring_[head_]));
+            ring_[head_] = Blob("");
+            head_ = (head_ + 1) % ring_.size();
+            --count_;
+        }
+        queuedBytes_ = 0;
+        unsigned long request = syncRequests_;
+        bool closing = closing_;
+        written_.notify_all();
+
+        guard.unlock();
+        bool ok = writeGroup(group);
+        if (ok && (policy_.syncData || request > syncsDone_))
+        {
+            ok = syncFile(fd_);
+        }
+        group.clear();
+        guard.lock();
+
+        if (!ok)
+        {
+            failed_ = true;
+            aftlog << loglevel(Error) << "FileConsumer: cannot write " << fileName_ << std::endl;
+        }
+        syncsDone_ = request;
+        written_.notify_all();
+
+        if (closing && count_ == 0) break;
+    }
+}
+
+bool FileWriterImpl::writeGroup(std::vector<Blob>& group)
+{
+    struct iovec iov[MaxIovecs];
+    size_t next = 0;
+    while (next < group.size())
+    {
+        size_t used = 0;
+        for (; next < group.size() && used < MaxIovecs; ++next)
+        {
+            const char* bytes;
+            size_t length;
+            getBytes(group[next], bytes, length);
+            if (length == 0) continue;
+
+            iov[used].iov_base = const_cast<char*>(bytes);
+            iov[used].iov_len = length;
+            ++used;
+        }
+
+        // Write all buffers, picking up after partial writes
+        struct iovec* pending = iov;
+        while (used > 0)
+        {
+            ssize_t count = writev(fd_, pending, used);
+            if (count < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            while (used > 0 && (size_t)count >= pending->iov_len)
+            {
+                count -= pending->iov_len;
+                ++pending;
+                --used;
+            }
+            if (used > 0)
+            {
+                pending->iov_base = (char *)pending->iov_base + count;
+                pending->iov_len -= count;
+            }
+        }
+    }
+    return true;
+}
+
 
 FileConsumer::FileConsumer(const std::string& fileName, bool overwrite)
     : writer_(new FileWriterImpl(fileName, overwrite))
@@ -123,6 +446,13 @@ FileConsumer::FileConsumer(const std::string& fileName, bool overwrite)
     writer_->open();
 }
 
+FileConsumer::FileConsumer(const std::string& fileName, bool overwrite,
+                           const AsyncPolicy& policy)
+    : writer_(new FileWriterImpl(fileName, overwrite, policy))
+{
+    writer_->open();
+}
+
 FileConsumer::~FileConsumer()
 {
     writer_->close();
@@ -144,7 +474,17 @@ Result FileConsumer::write(const Blob& blob)
     return writer_->pushData(blob);
 }
 
+int FileConsumer::write(const std::vector<Blob>& blobs)
+{
+    return writer_->pushData(blobs.data(), blobs.size());
+}
+
 bool FileConsumer::canAcceptData()
 {
-    return writer_->is_open();
+    return writer_->is_open() && writer_->roomForData();
+}
+
+bool FileConsumer::sync()
+{
+    return writer_->sync();
 }
@@ -39,11 +39,33 @@ class FileWriterImpl;
  *  Similar to the comment in fileproducer.h, a hint for the "type" of file would
  *  be helpful.  By "type" I mean is the file raw, TObjects only, Results, Blobs, string,
  *  serialized data, json, etc.
- *  This class uses std::ofstream to write the file.
+ *  This class uses std::ofstream to write the file, flushing after every write.
+ *
+ *  An asynchronous FileConsumer instead queues blobs in a bounded ring, and a
+ *  background thread writes them in groups with writev() according to an AsyncPolicy.
+ *  Durability: a successful write() only means the blob is queued.  The data reaches
+ *  the operating system when the writer thread writes its group, and survives a crash
+ *  of this process from then on.  It survives a system crash only after sync() returns
+ *  true, or after a group is written when AsyncPolicy::syncData is set.  Destroying the
+ *  consumer writes everything that is queued, but does not sync it.
  */
 class FileConsumer : public aft::base::BaseConsumer
 {
 public:
+    /** When an asynchronous FileConsumer writes queued blobs to the file. */
+    struct AsyncPolicy
+    {
+        /** Write when this many bytes are queued.  Zero writes whenever anything is. */
+        size_t flushBytes = 0;
+        /** Write blobs at the latest this long after they are queued.  Zero means no limit,
+         *  which only makes sense with flushBytes. */
+        unsigned int flushMilliseconds = 0;
+        /** The most blobs that are queued.  write() waits while the ring is full. */
+        size_t capacity = 1024;
+        /** Sync the file to storage after each group is written. */
+        bool syncData = false;
+    };
+
     /** Construct a FileConsumer
      *
      *  @param fileName name with optional path of file to write.
@@ -51,14 +73,29 @@ public:
      *                   if false will not overwrite an existing file.
      */
     FileConsumer(const std::string& fileName, bool overwrite = false);
+    /** Construct an asynchronous FileConsumer
+     *
+     *  @param fileName name with optional path of file to write.
+     *  @param overwrite if true will overwrite an existing file and
+     *                   if false will not overwrite an existing file.
+     *  @param policy when queued blobs are written.
+     */
+    FileConsumer(const std::string& fileName, bool overwrite, const AsyncPolicy& policy);
     virtual ~FileConsumer();
 
     virtual base::Result write(const aft::base::TObject& object);
     virtual base::Result write(const aft::base::Result& result);
     virtual base::Result write(const aft::base::Blob& blob);
+    /** Write all blobs with one flush, or queue them with one lock if asynchronous. */
+    virtual int write(const std::vector<aft::base::Blob>& blobs);
     /** Returns true if write can be called on this consumer without blocking */
     virtual bool canAcceptData();
 
+    /** Write everything written so far to the file and sync the file to storage.
+     *  @return true if all data was written and synced, otherwise false.
+     */
+    bool sync();
+
 protected:
     FileWriterImpl* writer_;
 };
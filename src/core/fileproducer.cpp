@@ -14,13 +14,21 @@
  *   limitations under the License.
  */
 
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
-#include <strings.h>
+#include <memory>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "base/blob.h"
 #include "base/consumer.h"
 #include "base/result.h"
 #include "base/tobject.h"
+#include "core/logger.h"
 #include "fileproducer.h"
 
 using namespace aft::base;
@@ -29,35 +37,296 @@ using namespace aft::core;
 
 static const char* WORD_SEPERATORS = " \t\n\r;:()/#*";
 
-// Utility function for extracting the next word token from file.
-static bool getWord(std::ifstream& ifile, std::string& strWord)
+// Lookup table of WORD_SEPERATORS, so words are scanned without a search per byte.
+class SeparatorTable
 {
-    strWord.clear();
-    int ch;
-    while ((ch = ifile.get()) != EOF)
-    {
-        if (index(WORD_SEPERATORS, ch)) break;
+public:
+    SeparatorTable()
+        {
+            memset(isSeparator_, 0, sizeof(isSeparator_));
+            for (const char* sep = WORD_SEPERATORS; *sep; ++sep)
+            {
+                isSeparator_[(unsigned char)*sep] = true;
+            }
+        }
 
-        strWord.push_back(ch);
-    }
+    /** Find the first byte from begin that is (or is not) a separator. */
+    const char* find(const char* begin, const char* end, bool separator) const
+        {
+            while (begin < end && isSeparator_[(unsigned char)*begin] != separator) ++begin;
+            return begin;
+        }
 
-    return !strWord.empty();
-}
+private:
+    bool isSeparator_[256];
+};
+
+static const SeparatorTable separators;
+
+// Size of the blocks read from a file by BlockScanner
+static const size_t DefaultBlockSize = 64 * 1024;
+
+/**
+ *  A read-only memory mapping of a whole file.
+ *
+ *  Blobs read from the mapping share ownership of it, so it is unmapped when both the
+ *  reader and the last blob are gone.
+ */
+class MappedFile
+{
+public:
+    MappedFile(const char* data, size_t size) : data_(data), size_(size) { }
+    ~MappedFile() { if (data_) munmap((void *)data_, size_); }
+
+    static std::shared_ptr<MappedFile> map(const std::string& fileName)
+        {
+            std::shared_ptr<MappedFile> mapping;
+            int fd = ::open(fileName.c_str(), O_RDONLY);
+            if (fd < 0) return mapping;
+
+            struct stat info;
+            if (fstat(fd, &info) != 0)
+            {
+                info.st_size = -1;
+            }
+            else if (info.st_size > 0)
+            {
+                void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED)
+                {
+                    madvise(data, info.st_size, MADV_SEQUENTIAL);
+                    mapping = std::make_shared<MappedFile>((const char *)data, info.st_size);
+                }
+            }
+            else if (info.st_size == 0)
+            {
+                // Empty files cannot be mapped, but they open fine.
+                mapping = std::make_shared<MappedFile>(nullptr, 0);
+            }
+            ::close(fd);
+
+            return mapping;
+        }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+/**
+ *  Splits a file into records, either from a stream or from a mapping.
+ *
+ *  A stream is read in large blocks into a reusable buffer.  A record stays contiguous
+ *  in the buffer, which grows when a record is longer than the buffer, so records of
+ *  any length are found without a read per byte.  A mapping is scanned in place.
+ *  Found records are valid until the next scan.
+ */
+class BlockScanner
+{
+public:
+    BlockScanner(std::istream& input, size_t blockSize = DefaultBlockSize)
+        : input_(input)
+        , buffer_(blockSize)
+        , data_(buffer_.data())
+        , begin_(0)
+        , end_(0)
+        , mapped_(false)
+        {   }
+
+    /** Scan a mapping instead of the stream. */
+    void map(const MappedFile& mapping)
+        {
+            data_ = mapping.data();
+            begin_ = 0;
+            end_ = mapping.size();
+            mapped_ = true;
+        }
+
+    /** Check if there is more data, reading a block if needed. */
+    bool hasData()
+        {
+            return begin_ < end_ || fill();
+        }
+
+    /** Find the next record that ends with delimiter, which is not part of the record.
+     *  @param maxLength Longer records are returned in pieces of this length
+     *  @return false if there is no more data, otherwise true.
+     */
+    bool scanUntil(const std::string& delimiter, size_t maxLength,
+                   const char*& record, size_t& length)
+        {
+            size_t scanned = 0;     // bytes from begin_ known not to start the delimiter
+            for (;;)
+            {
+                const char* begin = data_ + begin_;
+                size_t available = end_ - begin_;
+                while (scanned < available)
+                {
+                    const char* found = (const char *)memchr(begin + scanned, delimiter[0],
+                                                             available - scanned);
+                    if (!found)
+                    {
+                        scanned = available;
+                    }
+                    else if (found + delimiter.size() > begin + available)
+                    {
+                        // Need more data to tell if this is the delimiter
+                        scanned = found - begin;
+                        break;
+                    }
+                    else if (memcmp(found, delimiter.data(), delimiter.size()) == 0)
+                    {
+                        size_t foundLength = found - begin;
+                        if (foundLength > maxLength) return take(maxLength, 0, record, length);
+                        return take(foundLength, delimiter.size(), record, length);
+                    }
+                    else
+                    {
+                        scanned = found - begin + 1;
+                    }
+                }
+
+                if (scanned >= maxLength) return take(maxLength, 0, record, length);
+                if (!fill())
+                {
+                    // The last record has no delimiter
+                    return available > 0 && take(available, 0, record, length);
+                }
+            }
+        }
+
+    /** Find the next record of count bytes.
+     *  @return false if there are less than count bytes left, otherwise true.
+     */
+    bool scanCount(size_t count, const char*& record, size_t& length)
+        {
+            while (end_ - begin_ < count)
+            {
+                if (!fill()) return false;
+            }
+            return take(count, 0, record, length);
+        }
+
+    /** Find the next word, skipping separators before and after it. */
+    bool scanWord(const char*& record, size_t& length)
+        {
+            skipSeparators();
+            size_t scanned = 0;
+            for (;;)
+            {
+                const char* begin = data_ + begin_;
+                const char* wordEnd = separators.find(begin + scanned, data_ + end_, true);
+                scanned = wordEnd - begin;
+                if (wordEnd < data_ + end_ || !fill()) break;
+            }
+            if (scanned == 0) return false;
+
+            take(scanned, 0, record, length);
+            // Skip trailing separators that are already buffered, since reading more
+            // would move the record.  This way hasData() is false after the last word.
+            begin_ = separators.find(data_ + begin_, data_ + end_, false) - data_;
+            return true;
+        }
+
+    /** Find the rest of the data. */
+    bool scanAll(const char*& record, size_t& length)
+        {
+            while (fill()) { }
+            return begin_ < end_ && take(end_ - begin_, 0, record, length);
+        }
+
+    /** Skip bytes while they are ch. */
+    void skip(char ch)
+        {
+            do
+            {
+                while (begin_ < end_ && data_[begin_] == ch) ++begin_;
+            } while (begin_ == end_ && fill());
+        }
+
+    /** Skip the rest of the data. */
+    void discard()
+        {
+            while (fill()) begin_ = end_;
+            begin_ = end_;
+        }
+
+private:
+    /** Skip word separators. */
+    void skipSeparators()
+        {
+            do
+            {
+                begin_ = separators.find(data_ + begin_, data_ + end_, false) - data_;
+            } while (begin_ == end_ && fill());
+        }
+
+    bool take(size_t count, size_t skip, const char*& record, size_t& length)
+        {
+            record = data_ + begin_;
+            length = count;
+            begin_ += count + skip;
+            return true;
+        }
+
+    /** Read the next block after the unscanned data, making room if needed. */
+    bool fill()
+        {
+            if (mapped_) return false;
+
+            if (begin_ > 0)
+            {
+                memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+                end_ -= begin_;
+                begin_ = 0;
+            }
+            if (end_ == buffer_.size())
+            {
+                buffer_.resize(buffer_.size() * 2);
+                data_ = buffer_.data();
+            }
+
+            input_.read(buffer_.data() + end_, buffer_.size() - end_);
+            size_t count = input_.gcount();
+            end_ += count;
+            return count > 0;
+        }
+
+    std::istream& input_;
+    std::vector<char> buffer_;
+    const char* data_;
+    size_t begin_;
+    size_t end_;
+    bool mapped_;
+};
 
 
 class aft::core::FileReaderImpl : public aft::base::WriterContract
 {
 public:
-    FileReaderImpl(const std::string& fileName, aft::base::ParcelType parcelType)
+    FileReaderImpl(const std::string& fileName, aft::base::ParcelType parcelType, bool mapped)
         : fileName_(fileName)
         , parcelType_(parcelType)
+        , mapped_(mapped)
+        , scanner_(infile_)
+        , maxLength_(std::string::npos)
+        , delimiter_("\n")
+        , recordSize_(1)
+        , prefixSize_(4)
         {   }
     virtual ~FileReaderImpl() { }
 
     /** Returns the type of product this writer has ready to write. */
     virtual ProductType hasData()
         {
-            if (infile_.peek() == EOF) return ProductType::NONE;
+            if (parcelType_ == ParcelType::RESULT || parcelType_ == ParcelType::TOBJECT ||
+                !scanner_.hasData())
+            {
+                return ProductType::NONE;
+            }
 
             return ProductType::BLOB;
         }
@@ -73,45 +342,51 @@ public:
         }
     virtual bool getData(Blob& blob)
         {
+            const char* record = nullptr;
+            size_t length = 0;
             bool retval = false;
+            Blob::Type type = Blob::STRING;
 
             switch (parcelType_) {
             case ParcelType::BLOB_CHARACTER:
-            {
-                int ch = infile_.get();
-                if (ch != EOF)
-                {
-                    buffer_ = ch;
-                    retval = true;
-                }
-            }
+                retval = scanner_.scanCount(1, record, length);
                 break;
             case ParcelType::BLOB_WORD:
-                retval = getWord(infile_, buffer_);
+                retval = scanner_.scanWord(record, length);
                 break;
             case ParcelType::BLOB_LINE:
-            {
-                char lineBuf[1024];
-                infile_.getline(lineBuf, 1024);
-                if (infile_.gcount() > 0)
-                {
-                    buffer_ = lineBuf;
-                    retval = true;
-                }
-            }
+                retval = scanner_.scanUntil("\n", maxLength_, record, length);
                 break;
             case ParcelType::BLOB_PARAGRAPH:
-                //TODO implement
+                scanner_.skip('\n');
+                retval = scanner_.scanUntil("\n\n", maxLength_, record, length);
+                if (retval)
+                {
+                    // Keep the record while skipping the rest of the blank lines
+                    emit(blob, type, record, length);
+                    scanner_.skip('\n');
+                    return true;
+                }
                 break;
             case ParcelType::BLOB_FILE:
-            {
-                if (infile_.peek() != EOF)
+                retval = scanner_.scanAll(record, length);
+                break;
+            case ParcelType::BLOB_DELIMITED:
+                retval = scanner_.scanUntil(delimiter_, maxLength_, record, length);
+                break;
+            case ParcelType::BLOB_LENGTH_PREFIXED:
+                type = Blob::RAWDATA;
+                retval = getLengthPrefixed(record, length);
+                break;
+            case ParcelType::BLOB_FIXED_SIZE:
+                type = Blob::RAWDATA;
+                retval = scanner_.hasData() && scanner_.scanCount(recordSize_, record, length);
+                if (!retval && scanner_.hasData())
                 {
-                    buffer_ = std::string(std::istreambuf_iterator<char>(infile_),
-                                          std::istreambuf_iterator<char>());
-                    retval = true;
+                    aftlog << loglevel(Error) << "FileProducer: " << fileName_
+                           << " ends with a partial record" << std::endl;
+                    scanner_.discard();
                 }
-            }
                 break;
             case ParcelType::RESULT:
             case ParcelType::TOBJECT:
@@ -120,19 +395,42 @@ public:
 
             if (retval)
             {
-                Blob retBlob("", Blob::STRING, buffer_);
-                blob = retBlob;
+                emit(blob, type, record, length);
             }
 
             return retval;
         }
     bool open()
         {
-            infile_.open(fileName_.c_str());
+            if (mapped_)
+            {
+                mapping_ = MappedFile::map(fileName_);
+                if (mapping_) scanner_.map(*mapping_);
+                return mapping_ != nullptr;
+            }
+            infile_.open(fileName_.c_str(), std::ios::in | std::ios::binary);
             return infile_.is_open();
         }
+    void setMaxLength(size_t maxLength)
+        {
+            maxLength_ = maxLength > 0 ? maxLength : std::string::npos;
+        }
+    void setDelimiter(const std::string& delimiter)
+        {
+            if (!delimiter.empty()) delimiter_ = delimiter;
+        }
+    void setRecordSize(size_t recordSize)
+        {
+            if (recordSize > 0) recordSize_ = recordSize;
+        }
+    void setLengthPrefixSize(size_t prefixSize)
+        {
+            if (prefixSize > 0 && prefixSize <= sizeof(uint64_t)) prefixSize_ = prefixSize;
+        }
     void close()
         {
+            // Blobs still referencing the mapping keep it alive
+            mapping_.reset();
             if (infile_.is_open())
             {
                 infile_.close();
@@ -140,18 +438,69 @@ public:
         }
 
 private:
+    /** Get a record that follows its big-endian length. */
+    bool getLengthPrefixed(const char*& record, size_t& length)
+        {
+            if (!scanner_.hasData()) return false;
+
+            const char* prefix;
+            uint64_t recordLength = 0;
+            if (scanner_.scanCount(prefixSize_, prefix, length))
+            {
+                for (size_t idx = 0; idx < prefixSize_; ++idx)
+                {
+                    recordLength = (recordLength << 8) | (unsigned char)prefix[idx];
+                }
+                if (recordLength > maxLength_)
+                {
+                    aftlog << loglevel(Error) << "FileProducer: " << fileName_
+                           << " has a record of " << recordLength << " bytes" << std::endl;
+                }
+                else if (scanner_.scanCount(recordLength, record, length))
+                {
+                    return true;
+                }
+                else
+                {
+                    aftlog << loglevel(Error) << "FileProducer: " << fileName_
+                           << " ends with a partial record" << std::endl;
+                }
+            }
+            scanner_.discard();
+            return false;
+        }
+
+    /** Make blob refer to the mapping or hold a copy of the buffered record. */
+    void emit(Blob& blob, Blob::Type type, const char* record, size_t length)
+        {
+            if (mapped_)
+            {
+                blob = Blob("", type, mapping_, record, length);
+            }
+            else
+            {
+                blob = Blob("", type, std::string(record, length));
+            }
+        }
+
     std::string fileName_;
     ParcelType parcelType_;
     std::ifstream infile_;
-    std::string buffer_;
+    bool mapped_;
+    std::shared_ptr<MappedFile> mapping_;
+    BlockScanner scanner_;
+    size_t maxLength_;
+    std::string delimiter_;
+    size_t recordSize_;
+    size_t prefixSize_;
 };
 
 
 
 //TODO : BaseProducer(new FileReaderImpl ...)
-FileProducer::FileProducer(const std::string& fileName, ParcelType parcelType)
+FileProducer::FileProducer(const std::string& fileName, ParcelType parcelType, bool mapped)
     : BaseProducer(0)
-    , reader_(new FileReaderImpl(fileName, parcelType))
+    , reader_(new FileReaderImpl(fileName, parcelType, mapped))
 {
     writerDelegate_ = reader_;
     reader_->open();
@@ -178,6 +527,26 @@ Result FileProducer::read(Blob& blob)
     return reader_->getData(blob);
 }
 
+void FileProducer::setMaxLineLength(size_t maxLength)
+{
+    reader_->setMaxLength(maxLength);
+}
+
+void FileProducer::setDelimiter(const std::string& delimiter)
+{
+    reader_->setDelimiter(delimiter);
+}
+
+void FileProducer::setRecordSize(size_t recordSize)
+{
+    reader_->setRecordSize(recordSize);
+}
+
+void FileProducer::setLengthPrefixSize(size_t prefixSize)
+{
+    reader_->setLengthPrefixSize(prefixSize);
+}
+
 bool FileProducer::hasData()
 {
     return reader_->hasData() == ProductType::BLOB;
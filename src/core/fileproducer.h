@@ -36,14 +36,22 @@ class FileReaderImpl;
  *
  *  Ideally, a hint can indicate whether file has TObjects, Results, etc.
  *  Otherwise this class generates string blobs with the contents of the file.
- *  This class uses std::ifstream to read the file.
+ *  This class reads the file in large blocks with std::ifstream, or it can memory map
+ *  the file.  When mapped, each blob references its part of the mapping instead of a
+ *  copy, which suits large files.  Use Blob::getBytes() and Blob::getLength() to keep
+ *  it that way.
  */
 class FileProducer : public aft::base::BaseProducer
 {
 public:
-    /** Construct a FileProducer */
+    /** Construct a FileProducer
+     *  @param fileName Name of the file to read
+     *  @param parcelType How the file is divided into blobs
+     *  @param mapped If true, memory map the file instead of reading it with a stream.
+     */
     FileProducer(const std::string& fileName,
-                 base::ParcelType parcelType = base::ParcelType::BLOB_FILE);
+                 base::ParcelType parcelType = base::ParcelType::BLOB_FILE,
+                 bool mapped = false);
     virtual ~FileProducer();
 
     /** Not yet implemented. */
@@ -52,13 +60,31 @@ public:
     virtual base::Result read(aft::base::Result& result);
     /** Read blobs from the file.
      *
-     *  The data in the blob is either a character, word, text line or the whole file,
-     *  depending on this FileProducer's ParcelType.
+     *  The data in the blob is either a character, word, text line, paragraph, record
+     *  or the whole file, depending on this FileProducer's ParcelType.
+     *  Words are never empty since consecutive separators are skipped.  Paragraphs are
+     *  separated by one or more blank lines.  Records read as BLOB_LENGTH_PREFIXED or
+     *  BLOB_FIXED_SIZE are Blob::RAWDATA blobs; the others are Blob::STRING blobs.
      *  @param blob Reference of a blob object where the file contents is copied.
      *  @return true if data is copied, otherwise false
      */
     virtual base::Result read(aft::base::Blob& blob);
     virtual bool hasData();
+
+    /** Limit the length of blobs read as lines, paragraphs or records.
+     *  Longer lines, paragraphs and delimited records are read as several blobs of at
+     *  most maxLength bytes.  A longer length-prefixed record ends the file with an error.
+     *  @param maxLength Maximum length.  Zero means no limit, which is the default.
+     */
+    void setMaxLineLength(size_t maxLength);
+    /** Set the delimiter of BLOB_DELIMITED records.  The default is a newline. */
+    void setDelimiter(const std::string& delimiter);
+    /** Set the size of BLOB_FIXED_SIZE records.  The default is 1 byte. */
+    void setRecordSize(size_t recordSize);
+    /** Set the size of the big-endian length before BLOB_LENGTH_PREFIXED records.
+     *  @param prefixSize 1 to 8 bytes.  The default is 4 bytes.
+     */
+    void setLengthPrefixSize(size_t prefixSize);
     virtual bool hasObject(aft::base::ProductType productType);
 
 protected:
@@ -22,6 +22,7 @@
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <unordered_map>
 
 #include "logger.h"
 using namespace aft;
@@ -55,12 +56,9 @@ static unsigned int getCurrentTime(char* buf, size_t bufSize)
 
 LogStreamBuf::LogStreamBuf(AftLogType logType)
     : logType_(logType)
-    , logLevel_(Debug)
     , preambleSize_(24)
 {
     if (logType == LOG) preambleSize_ = 0;
-
-    setbuf(buf_ + preambleSize_, sizeof(buf_) - preambleSize_);
 }
 
 LogStreamBuf::~LogStreamBuf()
@@ -68,51 +66,97 @@ LogStreamBuf::~LogStreamBuf()
 
 }
 
+bool LogStreamBuf::open(const std::string& file)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    if (file_.is_open()) file_.close();
+    return file_.open(file.c_str(), ios::out) != nullptr;
+}
+
+bool LogStreamBuf::is_open() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    return file_.is_open();
+}
+
+void LogStreamBuf::close()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    file_.close();
+}
+
+LogStreamBuf::Line& LogStreamBuf::line() const
+{
+    thread_local std::unordered_map<const LogStreamBuf*, Line> lines;
+
+    auto it = lines.find(this);
+    if (it == lines.end())
+    {
+        it = lines.emplace(this, Line{ std::string(), Debug }).first;
+    }
+    return it->second;
+}
+
+AftLogLevel LogStreamBuf::getLogLevel() const
+{
+    return line().level;
+}
+
+void LogStreamBuf::setLogLevel(AftLogLevel level)
+{
+    line().level = level;
+}
+
+LogStreamBuf::int_type LogStreamBuf::overflow(int_type c)
+{
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        line().text.push_back(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize LogStreamBuf::xsputn(const char* s, std::streamsize count)
+{
+    line().text.append(s, count);
+    return count;
+}
 
 int LogStreamBuf::sync()
 {
-    //cout << hex << "before sync logstream, pbase=" << static_cast<void*>(pbase())
-    //     << ", pptr= " << static_cast<void*>(pptr())
-    //     << ", epptr=" << static_cast<void*>(epptr()) << endl;
+    Line& pending = line();
+    const AftLogLevel level = pending.level;
+    pending.level = Debug;    // Reset to default loglevel
+    if (pending.text.empty())
+    {
+        return 0;
+    }
 
     // Send non-debug logs to audit, too
-    if (logType_ == LOG && logLevel_ > Debug)
+    if (logType_ == LOG && level > Debug)
     {
-        aftaudit.setLogLevel(logLevel_);
-        aftaudit.write(buf_, pptr() - buf_);
+        aftaudit.setLogLevel(level);
+        aftaudit.write(pending.text.data(), pending.text.size());
         aftaudit.flush();
     }
 
+    std::lock_guard<std::mutex> guard(lock_);
     if (preambleSize_ > 20)
     {
         //TODO peek that last char is newline
-        char timestamp[preambleSize_ + 1];
-        unsigned int szPreamble = getCurrentTime(timestamp, preambleSize_);
-        strncpy(buf_, timestamp, szPreamble);
-        memset(&buf_[szPreamble], ' ', preambleSize_ - szPreamble);
-        if (logLevel_ >= Trace && logLevel_ <= Fatal)
+        char preamble[preambleSize_ + 1];
+        unsigned int szPreamble = getCurrentTime(preamble, preambleSize_);
+        memset(&preamble[szPreamble], ' ', preambleSize_ - szPreamble);
+        if (level >= Trace && level <= Fatal)
         {
-            buf_[szPreamble - 1] = LevelLetter[logLevel_];
+            preamble[szPreamble - 1] = LevelLetter[level];
         }
-
-        int savePos = pptr() - buf_;
-        setp(buf_, epptr());
-        pbump(savePos);
-    }
-    //cout << hex << "after sync logstream, pbase=" << static_cast<void*>(pbase())
-    //     << ", pptr= " << static_cast<void*>(pptr())
-    //     << ", epptr=" << static_cast<void*>(epptr()) << endl;
-
-    int ret = filebuf::sync();
-
-    if (preambleSize_ > 20)
-    {
-        setp(buf_ + preambleSize_, epptr());
+        file_.sputn(preamble, preambleSize_);
     }
+    file_.sputn(pending.text.data(), pending.text.size());
+    pending.text.clear();
 
-    setLogLevel(Debug);    // Reset to default loglevel
-
-    return ret;
+    return file_.pubsync();
 }
 
 
@@ -143,12 +187,10 @@ Logger::openLogFile(const std::string& file, bool buffered)
 
     if (buffered)
     {
-        if (streamBuf_.is_open()) streamBuf_.close();
-
-        if (!streamBuf_.open(logFile.c_str(), ios::out))
+        if (!streamBuf_.open(logFile))
         {
             cerr << "Could not open file " << logFile << ".  Using /dev/null instead." << endl;
-            streamBuf_.open("/dev/null", ios::out);
+            streamBuf_.open("/dev/null");
         }
         ostream::rdbuf(&streamBuf_);
     } else {
@@ -16,6 +16,8 @@
  */
 
 #include <fstream>
+#include <mutex>
+#include <string>
 
 namespace aft
 {
@@ -47,22 +49,48 @@ enum AftLogType {
 };
 
 
-class LogStreamBuf : public std::filebuf {
+/**
+ *  Stream buffer of a Logger.
+ *
+ *  Each thread collects the line it is writing, and its log level, on its own.  sync()
+ *  writes the whole line to the log file under a lock, so lines logged by different
+ *  threads at the same time are not mixed.
+ */
+class LogStreamBuf : public std::streambuf {
 public:
     LogStreamBuf(AftLogType logType);
     virtual ~LogStreamBuf();
 
+    bool open(const std::string& file);
+    bool is_open() const;
+    void close();
+
     virtual int sync();
 
-    AftLogLevel getLogLevel() const { return logLevel_; }
-    void setLogLevel(AftLogLevel level) { logLevel_ = level; }
+    /** Get the log level of the line that the calling thread is writing. */
+    AftLogLevel getLogLevel() const;
+    /** Set the log level of the line that the calling thread is writing. */
+    void setLogLevel(AftLogLevel level);
+
+protected:
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(const char* s, std::streamsize count);
 
 private:
-    AftLogType  logType_;
-    AftLogLevel logLevel_;
+    struct Line
+    {
+        std::string text;
+        AftLogLevel level;
+    };
+
+    /** Get the line of the calling thread. */
+    Line& line() const;
 
+    AftLogType  logType_;
     unsigned int preambleSize_;
-    char buf_[1024];
+
+    mutable std::mutex lock_;   // Guards file_
+    std::filebuf file_;
 };
 
 /**
@@ -0,0 +1,280 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "base/blob.h"
+#include "base/datasignal.h"
+#include "mergerproc.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+
+// How often inputs that cannot be watched are checked while waiting
+static const std::chrono::milliseconds PollInterval(1);
+
+
+// Internal implementation class
+class aft::core::MergerProcImpl
+{
+public:
+    struct Input
+    {
+        Input(ProducerContract* producer)
+        : producer(producer)
+        , queued(false)
+        , watchId(-1)
+        {  }
+
+        ProducerContract* producer;
+        EdgeCounter counter;
+        std::atomic<bool> queued;   // In the ready set
+        int watchId;                // Listener id, or -1 if the input is polled
+    };
+
+    typedef std::vector<std::unique_ptr<Input>> Inputs;
+
+    MergerProcImpl()
+    : numPolled_(0)
+    , next_(0)
+    , wakeups_(0)
+    {  }
+
+    ~MergerProcImpl()
+    {
+        for (std::unique_ptr<Input>& input : inputs_)
+        {
+            if (input->watchId >= 0) input->producer->unwatchData(input->watchId);
+        }
+    }
+
+    Inputs::iterator find(const ProducerContract* producer)
+    {
+        return std::find_if(inputs_.begin(), inputs_.end(),
+                            [producer](const std::unique_ptr<Input>& input)
+                            { return input->producer == producer; });
+    }
+
+    /** Put an input at the back of the ready set.  Called by the inputs' listeners
+     *  with the producer's lock held, so it does not take mutex_.
+     */
+    void markReady(Input* input)
+    {
+        if (!input->queued.exchange(true))
+        {
+            std::lock_guard<std::mutex> lock(readyLock_);
+            ready_.push_back(input);
+        }
+        wakeups_.fetch_add(1, std::memory_order_seq_cst);
+        signal_.notify();
+    }
+
+    Input* popReady()
+    {
+        std::lock_guard<std::mutex> lock(readyLock_);
+        if (ready_.empty()) return nullptr;
+
+        Input* input = ready_.front();
+        ready_.pop_front();
+        input->queued.store(false);
+        return input;
+    }
+
+    bool isReady()
+    {
+        std::lock_guard<std::mutex> lock(readyLock_);
+        return !ready_.empty();
+    }
+
+    /** Add the inputs that cannot be watched and have data to the ready set.  Starts
+     *  after the input where the last check started, so no input is always first.
+     */
+    void sweep()
+    {
+        for (size_t idx = 0; idx < inputs_.size(); ++idx)
+        {
+            Input* input = inputs_[(next_ + idx) % inputs_.size()].get();
+            if (input->watchId < 0 && !input->queued && input->producer->hasData())
+            {
+                markReady(input);
+            }
+        }
+        if (!inputs_.empty()) next_ = (next_ + 1) % inputs_.size();
+    }
+
+    bool read(Blob& blob)
+    {
+        bool swept = false;
+        while (true)
+        {
+            Input* input = popReady();
+            if (!input)
+            {
+                if (swept || numPolled_ == 0) return false;
+                sweep();
+                swept = true;
+                continue;
+            }
+
+            if (input->producer->read(blob))
+            {
+                input->counter.passed(blob.getLength());
+                // Inputs that reported data while this one was read are ahead of it,
+                // so a busy input cannot keep the others from being read
+                if (input->producer->hasData()) markReady(input);
+                return true;
+            }
+            // Another reader emptied it first, so try the next input
+        }
+    }
+
+    bool hasData()
+    {
+        if (isReady()) return true;
+        if (numPolled_ == 0) return false;
+        sweep();
+        return isReady();
+    }
+
+    std::mutex mutex_;
+    Inputs inputs_;
+    std::atomic<int> numPolled_;         // Inputs that cannot be watched
+    size_t next_;
+    std::mutex readyLock_;
+    std::deque<Input*> ready_;
+    std::atomic<unsigned long> wakeups_; // Inputs marked ready
+    DataSignal signal_;
+};
+
+
+MergerProc::MergerProc()
+: base::BaseProc(0, 0)
+, impl_(*new MergerProcImpl)
+{
+}
+
+MergerProc::~MergerProc()
+{
+    delete &impl_;
+}
+
+bool MergerProc::addInput(ProducerContract* input)
+{
+    if (!input) return false;
+
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    if (impl_.find(input) != impl_.inputs_.end()) return false;
+
+    impl_.inputs_.emplace_back(new MergerProcImpl::Input(input));
+    MergerProcImpl::Input* added = impl_.inputs_.back().get();
+    added->watchId = input->watchData([this, added] { impl_.markReady(added); });
+    if (added->watchId < 0) ++impl_.numPolled_;
+    // Data that came before the watch started does not call the listener
+    if (input->hasData()) impl_.markReady(added);
+    return true;
+}
+
+bool MergerProc::removeInput(ProducerContract* input)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    MergerProcImpl::Inputs::iterator it = impl_.find(input);
+    if (it == impl_.inputs_.end()) return false;
+
+    MergerProcImpl::Input* removed = it->get();
+    if (removed->watchId >= 0) input->unwatchData(removed->watchId);
+    else --impl_.numPolled_;
+    {
+        std::lock_guard<std::mutex> readyLock(impl_.readyLock_);
+        impl_.ready_.erase(std::remove(impl_.ready_.begin(), impl_.ready_.end(), removed),
+                           impl_.ready_.end());
+    }
+    impl_.inputs_.erase(it);
+    return true;
+}
+
+size_t MergerProc::numInputs() const
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    return impl_.inputs_.size();
+}
+
+EdgeCounters MergerProc::getCounters(size_t input) const
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    if (input >= impl_.inputs_.size()) return EdgeCounters{ 0, 0, 0 };
+
+    return impl_.inputs_[input]->counter.get();
+}
+
+// Producer contract
+Result MergerProc::read(base::TObject& object)
+{
+    return false;
+}
+
+Result MergerProc::read(base::Result& result)
+{
+    return false;
+}
+
+Result MergerProc::read(base::Blob& blob)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    return impl_.read(blob);
+}
+
+bool MergerProc::hasData()
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    return impl_.hasData();
+}
+
+bool MergerProc::hasObject(base::ProductType productType)
+{
+    return productType == ProductType::BLOB ? hasData() : false;
+}
+
+bool MergerProc::waitForData(const base::Deadline& deadline)
+{
+    while (true)
+    {
+        // Inputs that cannot be watched are checked every poll interval
+        Deadline until = deadline;
+        if (impl_.numPolled_ > 0)
+        {
+            until = std::min(deadline, std::chrono::steady_clock::now() + PollInterval);
+        }
+        const unsigned long wakeups = impl_.wakeups_.load(std::memory_order_seq_cst);
+        if (hasData()) return true;
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        impl_.signal_.waitUntil(until, [this, wakeups] {
+            return impl_.wakeups_.load(std::memory_order_seq_cst) != wakeups;
+        });
+    }
+}
+
+// Consumer contract
+bool MergerProc::canAcceptData()
+{
+    return false;
+}
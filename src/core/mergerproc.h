@@ -0,0 +1,75 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "base/proc.h"
+
+namespace aft
+{
+namespace core
+{
+// Forward reference
+class MergerProcImpl;
+
+
+/**
+ *  A proc that reads blobs from several inputs as one stream.
+ *
+ *  Inputs that have data wait their turn in a ready set.  Each read takes one blob
+ *  from the input at the front and puts it at the back if it still has data, so busy
+ *  inputs take turns and one cannot starve the others.  Inputs join the ready set
+ *  from their watchData() listeners when they report data; inputs that cannot be
+ *  watched are only checked once the ready set runs out.
+ */
+class MergerProc : public aft::base::BaseProc
+{
+public:
+    MergerProc();
+    virtual ~MergerProc();
+
+    /** Add an input.  Inputs can be added and removed while blobs are read.
+     *  @return false if the input is null or already added, otherwise true.
+     */
+    bool addInput(base::ProducerContract* input);
+    /** Remove an input.
+     *  @return false if the input was not added, otherwise true.
+     */
+    bool removeInput(base::ProducerContract* input);
+    /** Get the number of inputs. */
+    size_t numInputs() const;
+    /** Get the counts of blobs read from an input, in the order they were added. */
+    base::EdgeCounters getCounters(size_t input) const;
+
+    // Producer contract
+    virtual base::Result read(base::TObject& object);
+    virtual base::Result read(base::Result& result);
+    /** Read a blob from the next input in the ready set. */
+    virtual base::Result read(base::Blob& blob);
+    virtual bool hasData();
+    virtual bool hasObject(base::ProductType productType);
+    /** Wait until any input has data or until the deadline. */
+    virtual bool waitForData(const base::Deadline& deadline);
+
+    // Consumer contract
+    /** Returns false.  Data comes from the inputs. */
+    virtual bool canAcceptData();
+
+private:
+    MergerProcImpl& impl_;
+};
+
+} // namespace core
+} // namespace aft
@@ -0,0 +1,576 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "base/blob.h"
+#include "multioutlet.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+// Points on the hash ring for each member, so keys spread evenly
+static const int VirtualNodes = 64;
+// How often members that cannot be watched are checked while waiting
+static const std::chrono::milliseconds PollInterval(1);
+
+
+/** Mix the bits of a value, from splitmix64. */
+static uint64_t mix(uint64_t value)
+{
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+/** FNV-1a hash of some bytes. */
+static uint64_t hashBytes(const char* bytes, size_t length)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t idx = 0; idx < length; ++idx)
+    {
+        hash = (hash ^ (unsigned char)bytes[idx]) * 0x100000001b3ull;
+    }
+    return mix(hash);
+}
+
+/** Wait until a consumer has room, or until the deadline. */
+static bool waitForRoom(ConsumerContract* consumer, const Deadline& deadline)
+{
+    std::chrono::microseconds pause(50);
+    while (!consumer->canAcceptData())
+    {
+        Deadline now = std::chrono::steady_clock::now();
+        if (now >= deadline) return false;
+
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(pause, deadline - now));
+        if (pause < std::chrono::milliseconds(1)) pause *= 2;
+    }
+    return true;
+}
+
+
+/**
+ *  A prod, cons or proc plugged into a MultiOutlet.
+ */
+struct Member
+{
+    Member(const void* key, ProducerContract* reader, ConsumerContract* writer)
+    : key(key)
+    , reader(reader)
+    , writer(writer)
+    , inFlight(0)
+    , queued(false)
+    , watchId(-1)
+    {  }
+
+    const void* key;            // What was plugged in
+    ProducerContract* reader;   // Null if the member cannot be read
+    ConsumerContract* writer;   // Null if the member cannot be written
+    EdgeCounter counter;
+    std::atomic<int> inFlight;  // Writes in progress
+    std::atomic<bool> queued;   // In the ready set
+    int watchId;                // Listener id, or -1 if the member is polled
+};
+
+
+class aft::core::MultiOutletImpl
+{
+public:
+    MultiOutletImpl(MultiOutlet::Policy policy, std::chrono::milliseconds timeout)
+    : policy_(policy)
+    , timeout_(timeout)
+    , numPolled_(0)
+    , readCursor_(0)
+    , writeCursor_(0)
+    , wakeups_(0)
+    {  }
+
+    ~MultiOutletImpl()
+    {
+        for (std::unique_ptr<Member>& member : members_)
+        {
+            if (member->watchId >= 0) member->reader->unwatchData(member->watchId);
+        }
+    }
+
+    /** Add a member.  Listeners are added and removed without membersLock_, since a
+     *  producer calls them with its own lock held and they take readyLock_ and the
+     *  signal's lock, which waiting readers hold while they check for data.
+     */
+    bool add(const void* key, ProducerContract* reader, ConsumerContract* writer)
+    {
+        if (!key) return false;
+
+        std::lock_guard<std::mutex> changeLock(changeLock_);
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(membersLock_);
+            if (find(key) != members_.end()) return false;
+        }
+
+        std::unique_ptr<Member> added(new Member(key, reader, writer));
+        Member* member = added.get();
+        if (reader)
+        {
+            member->watchId = reader->watchData([this, member] { markReady(member); });
+        }
+        {
+            std::lock_guard<std::shared_timed_mutex> lock(membersLock_);
+            members_.push_back(std::move(added));
+            if (reader && member->watchId < 0) ++numPolled_;
+            buildRing();
+        }
+        // Data that came before the watch started does not call the listener
+        if (reader && reader->hasData()) markReady(member);
+        return true;
+    }
+
+    bool remove(const void* key)
+    {
+        std::lock_guard<std::mutex> changeLock(changeLock_);
+        std::unique_ptr<Member> removed;
+        {
+            std::lock_guard<std::shared_timed_mutex> lock(membersLock_);
+            std::vector<std::unique_ptr<Member>>::iterator it = find(key);
+            if (it == members_.end()) return false;
+
+            removed = std::move(*it);
+            members_.erase(it);
+            if (removed->reader && removed->watchId < 0) --numPolled_;
+            buildRing();
+        }
+
+        if (removed->watchId >= 0) removed->reader->unwatchData(removed->watchId);
+        // The listener may have queued the member again until it was unwatched.  The
+        // exclusive lock waits for readers that took it from the ready set.
+        std::lock_guard<std::shared_timed_mutex> lock(membersLock_);
+        std::lock_guard<std::mutex> readyLock(readyLock_);
+        ready_.erase(std::remove(ready_.begin(), ready_.end(), removed.get()), ready_.end());
+        return true;
+    }
+
+    std::vector<std::unique_ptr<Member>>::iterator find(const void* key)
+    {
+        return std::find_if(members_.begin(), members_.end(),
+                            [key](const std::unique_ptr<Member>& member)
+                            { return member->key == key; });
+    }
+
+    /** Put the writers' virtual nodes on the hash ring.  The caller holds the lock. */
+    void buildRing()
+    {
+        ring_.clear();
+        for (std::unique_ptr<Member>& member : members_)
+        {
+            if (!member->writer) continue;
+            for (int node = 0; node < VirtualNodes; ++node)
+            {
+                uint64_t point = mix((uint64_t)(uintptr_t)member->key * VirtualNodes + node);
+                ring_.emplace_back(point, member.get());
+            }
+        }
+        std::sort(ring_.begin(), ring_.end());
+    }
+
+    // Ready set
+
+    void markReady(Member* member)
+    {
+        if (!member->queued.exchange(true))
+        {
+            std::lock_guard<std::mutex> lock(readyLock_);
+            ready_.push_back(member);
+        }
+        wakeups_.fetch_add(1, std::memory_order_seq_cst);
+        signal_.notify();
+    }
+
+    Member* popReady()
+    {
+        std::lock_guard<std::mutex> lock(readyLock_);
+        if (ready_.empty()) return nullptr;
+
+        Member* member = ready_.front();
+        ready_.pop_front();
+        member->queued.store(false);
+        return member;
+    }
+
+    /** Check the members that cannot be watched.  The caller holds the shared lock. */
+    void sweep()
+    {
+        for (std::unique_ptr<Member>& member : members_)
+        {
+            if (member->reader && member->watchId < 0 && !member->queued && member->reader->hasData())
+            {
+                markReady(member.get());
+            }
+        }
+    }
+
+    bool hasData()
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(membersLock_);
+        if (policy_ == MultiOutlet::IN_ORDER)
+        {
+            for (std::unique_ptr<Member>& member : members_)
+            {
+                if (member->reader && member->reader->hasData()) return true;
+            }
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> readyLock(readyLock_);
+            if (!ready_.empty()) return true;
+        }
+        if (numPolled_ == 0) return false;
+        sweep();
+        std::lock_guard<std::mutex> readyLock(readyLock_);
+        return !ready_.empty();
+    }
+
+    // Reads
+
+    bool readReady(Blob& blob)
+    {
+        bool swept = false;
+        while (true)
+        {
+            Member* member = popReady();
+            if (!member)
+            {
+                if (swept || numPolled_ == 0) return false;
+                sweep();
+                swept = true;
+                continue;
+            }
+            if (member->reader->read(blob))
+            {
+                member->counter.passed(blob.getLength());
+                // Producers only report new data, so keep one that still has some
+                if (member->reader->hasData()) markReady(member);
+                return true;
+            }
+        }
+    }
+
+    bool readInOrder(Blob& blob)
+    {
+        size_t start = readCursor_;
+        for (size_t idx = 0; idx < members_.size(); ++idx)
+        {
+            size_t pos = (start + idx) % members_.size();
+            Member* member = members_[pos].get();
+            if (!member->reader) continue;
+
+            Deadline deadline = std::chrono::steady_clock::now() + timeout_;
+            if (member->reader->waitForData(deadline) && member->reader->read(blob))
+            {
+                member->counter.passed(blob.getLength());
+                readCursor_ = pos + 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Writes
+
+    bool writeTo(Member* member, const Blob& blob)
+    {
+        member->inFlight.fetch_add(1, std::memory_order_relaxed);
+        bool written = member->writer->write(blob);
+        member->inFlight.fetch_sub(1, std::memory_order_relaxed);
+        if (written)
+        {
+            member->counter.passed(blob.getLength());
+        }
+        else
+        {
+            member->counter.refused();
+        }
+        return written;
+    }
+
+    bool writeFirstReady(const Blob& blob)
+    {
+        for (std::unique_ptr<Member>& member : members_)
+        {
+            if (member->writer && member->writer->canAcceptData() && writeTo(member.get(), blob))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool writeInOrder(const Blob& blob)
+    {
+        size_t start = writeCursor_;
+        for (size_t idx = 0; idx < members_.size(); ++idx)
+        {
+            size_t pos = (start + idx) % members_.size();
+            Member* member = members_[pos].get();
+            if (!member->writer) continue;
+
+            Deadline deadline = std::chrono::steady_clock::now() + timeout_;
+            if (!waitForRoom(member->writer, deadline))
+            {
+                member->counter.refused();
+                continue;
+            }
+            if (writeTo(member, blob))
+            {
+                writeCursor_ = pos + 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool writeLeastLoaded(const Blob& blob)
+    {
+        Member* least = nullptr;
+        int leastInFlight = 0;
+        unsigned long leastWritten = 0;
+        for (std::unique_ptr<Member>& member : members_)
+        {
+            if (!member->writer || !member->writer->canAcceptData()) continue;
+
+            int inFlight = member->inFlight.load(std::memory_order_relaxed);
+            unsigned long written = member->counter.get().blobs;
+            if (!least || inFlight < leastInFlight ||
+                (inFlight == leastInFlight && written < leastWritten))
+            {
+                least = member.get();
+                leastInFlight = inFlight;
+                leastWritten = written;
+            }
+        }
+        return least && writeTo(least, blob);
+    }
+
+    bool writeHashed(const Blob& blob)
+    {
+        if (ring_.empty()) return false;
+
+        uint64_t hash = blob.getName().empty() ? hashBytes(blob.getBytes(), blob.getLength())
+                                               : hashBytes(blob.getName().data(), blob.getName().size());
+        std::vector<std::pair<uint64_t, Member*>>::iterator it
+            = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(hash, (Member*)nullptr));
+        if (it == ring_.end()) it = ring_.begin();
+        return writeTo(it->second, blob);
+    }
+
+    /** Write a blob to the member picked by the policy.  The caller holds the lock. */
+    bool write(const Blob& blob)
+    {
+        switch (policy_)
+        {
+        case MultiOutlet::IN_ORDER:
+            return writeInOrder(blob);
+        case MultiOutlet::LEAST_LOADED:
+            return writeLeastLoaded(blob);
+        case MultiOutlet::CONSISTENT_HASH:
+            return writeHashed(blob);
+        case MultiOutlet::FIRST_READY:
+            break;
+        }
+        return writeFirstReady(blob);
+    }
+
+    MultiOutlet::Policy policy_;
+    std::chrono::milliseconds timeout_;
+
+    std::shared_timed_mutex membersLock_;
+    std::vector<std::unique_ptr<Member>> members_;
+    std::vector<std::pair<uint64_t, Member*>> ring_;
+    std::atomic<int> numPolled_;         // Readers that cannot be watched
+    std::atomic<size_t> readCursor_;
+    std::atomic<size_t> writeCursor_;
+
+    std::mutex changeLock_;              // Serializes add() and remove()
+
+    std::mutex readyLock_;
+    std::deque<Member*> ready_;
+    std::atomic<unsigned long> wakeups_; // Members marked ready
+    DataSignal signal_;
+};
+
+
+MultiOutlet::MultiOutlet(const std::string& name, Policy policy, std::chrono::milliseconds timeout)
+: impl_(*new MultiOutletImpl(policy, timeout))
+, name_(name)
+{
+}
+
+MultiOutlet::~MultiOutlet()
+{
+    delete &impl_;
+}
+
+const std::string& MultiOutlet::name() const
+{
+    return name_;
+}
+
+MultiOutlet::Policy MultiOutlet::policy() const
+{
+    return impl_.policy_;
+}
+
+bool MultiOutlet::plugin(ProducerContract* producer)
+{
+    return impl_.add(producer, producer, nullptr);
+}
+
+bool MultiOutlet::plugin(ProcContract* proc)
+{
+    return impl_.add(proc, proc, proc);
+}
+
+bool MultiOutlet::plugin(ConsumerContract* consumer)
+{
+    return impl_.add(consumer, nullptr, consumer);
+}
+
+bool MultiOutlet::unplug(ProducerContract* producer)
+{
+    return impl_.remove(producer);
+}
+
+bool MultiOutlet::unplug(ProcContract* proc)
+{
+    return impl_.remove(proc);
+}
+
+bool MultiOutlet::unplug(ConsumerContract* consumer)
+{
+    return impl_.remove(consumer);
+}
+
+size_t MultiOutlet::size() const
+{
+    std::shared_lock<std::shared_timed_mutex> lock(impl_.membersLock_);
+    return impl_.members_.size();
+}
+
+EdgeCounters MultiOutlet::getCounters(size_t member) const
+{
+    std::shared_lock<std::shared_timed_mutex> lock(impl_.membersLock_);
+    if (member >= impl_.members_.size()) return EdgeCounters{ 0, 0, 0 };
+
+    return impl_.members_[member]->counter.get();
+}
+
+// Producer contract
+Result MultiOutlet::read(base::TObject& object)
+{
+    return false;
+}
+
+Result MultiOutlet::read(base::Result& result)
+{
+    return false;
+}
+
+Result MultiOutlet::read(base::Blob& blob)
+{
+    std::shared_lock<std::shared_timed_mutex> lock(impl_.membersLock_);
+    if (impl_.policy_ == IN_ORDER) return impl_.readInOrder(blob);
+    return impl_.readReady(blob);
+}
+
+bool MultiOutlet::hasData()
+{
+    return impl_.hasData();
+}
+
+bool MultiOutlet::hasObject(base::ProductType productType)
+{
+    return productType == ProductType::BLOB && hasData();
+}
+
+bool MultiOutlet::waitForData(const base::Deadline& deadline)
+{
+    while (true)
+    {
+        // Members that cannot be watched are checked every poll interval
+        Deadline until = deadline;
+        if (impl_.numPolled_ > 0 || impl_.policy_ == IN_ORDER)
+        {
+            until = std::min(deadline, std::chrono::steady_clock::now() + PollInterval);
+        }
+        // Wait for a member to be marked ready rather than checking for data under
+        // the signal's lock, which the members' listeners take
+        const unsigned long wakeups = impl_.wakeups_.load(std::memory_order_seq_cst);
+        if (hasData()) return true;
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        impl_.signal_.waitUntil(until, [this, wakeups] {
+            return impl_.wakeups_.load(std::memory_order_seq_cst) != wakeups;
+        });
+    }
+}
+
+// Consumer contract
+bool MultiOutlet::canAcceptData()
+{
+    std::shared_lock<std::shared_timed_mutex> lock(impl_.membersLock_);
+    for (std::unique_ptr<Member>& member : impl_.members_)
+    {
+        if (member->writer && member->writer->canAcceptData()) return true;
+    }
+    return false;
+}
+
+Result MultiOutlet::write(const base::TObject& object)
+{
+    return false;
+}
+
+Result MultiOutlet::write(const base::Result& result)
+{
+    return false;
+}
+
+Result MultiOutlet::write(const base::Blob& blob)
+{
+    std::shared_lock<std::shared_timed_mutex> lock(impl_.membersLock_);
+    return impl_.write(blob);
+}
+
+int MultiOutlet::write(const std::vector<base::Blob>& blobs)
+{
+    std::shared_lock<std::shared_timed_mutex> lock(impl_.membersLock_);
+    int written = 0;
+    for (const Blob& blob : blobs)
+    {
+        if (!impl_.write(blob)) break;
+        ++written;
+    }
+    return written;
+}
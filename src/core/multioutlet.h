@@ -0,0 +1,110 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <chrono>
+#include <string>
+#include "base/proc.h"
+
+namespace aft
+{
+namespace core
+{
+// Forward reference
+class MultiOutletImpl;
+
+/**
+ *  An outlet that controls several prods, cons and procs using a selector policy.
+ *
+ *  Reads come from members that are ready.  Members that can be watched report when
+ *  they get data, like an epoll set, and only members that cannot be watched are
+ *  checked with hasData().  Writes go to a member picked by the policy.  A test case
+ *  can plug in several emulated endpoints and spread its load across them.
+ */
+class MultiOutlet : public base::BaseProc
+{
+public:
+    /** How members are picked for reads and writes. */
+    enum Policy
+    {
+        FIRST_READY,        ///< Read from the first member to have data, write to the first with room
+        IN_ORDER,           ///< Take members in turn, waiting up to the timeout for each
+        LEAST_LOADED,       ///< Write to the member with the fewest writes in progress
+        CONSISTENT_HASH     ///< Write to the member that owns the blob's key
+    };
+
+    /** Construct a MultiOutlet.
+     *  @param name Name of the outlet
+     *  @param policy How members are picked
+     *  @param timeout How long IN_ORDER waits for each member
+     */
+    MultiOutlet(const std::string& name, Policy policy = FIRST_READY,
+                std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+    virtual ~MultiOutlet();
+
+    const std::string& name() const;
+    Policy policy() const;
+
+    /** Add a member.  Members can be added and removed while in use.
+     *  @return false if it is null or already a member, otherwise true.
+     */
+    bool plugin(base::ProducerContract* producer);
+    bool plugin(base::ProcContract* proc);
+    bool plugin(base::ConsumerContract* consumer);
+    /** Remove a member.  Once this returns it is not in use by this outlet.
+     *  @return false if it is not a member, otherwise true.
+     */
+    bool unplug(base::ProducerContract* producer);
+    bool unplug(base::ProcContract* proc);
+    bool unplug(base::ConsumerContract* consumer);
+
+    /** Get the number of members. */
+    size_t size() const;
+    /** Get the counts of blobs read from and written to a member, in the order they
+     *  were added.  Writes the member did not take, or had no room for within the
+     *  IN_ORDER timeout, count as refused.
+     */
+    base::EdgeCounters getCounters(size_t member) const;
+
+    // Producer contract
+    virtual base::Result read(base::TObject& object);
+    virtual base::Result read(base::Result& result);
+    virtual base::Result read(base::Blob& blob);
+    virtual bool hasData();
+    virtual bool hasObject(base::ProductType productType);
+    /** Wait until a member has data or until the deadline. */
+    virtual bool waitForData(const base::Deadline& deadline);
+
+    // Consumer contract
+    virtual bool canAcceptData();
+    virtual base::Result write(const base::TObject& object);
+    virtual base::Result write(const base::Result& result);
+    /** Write a blob to the member picked by the policy.  CONSISTENT_HASH keys blobs by
+     *  their name, or by their bytes if they have no name.
+     */
+    virtual base::Result write(const base::Blob& blob);
+    /** Write blobs one at a time as write(const Blob&) does, until one is not taken.
+     *  @return the number of blobs written
+     */
+    virtual int write(const std::vector<base::Blob>& blobs);
+
+private:
+    MultiOutletImpl& impl_;
+    std::string name_;
+};
+
+} // namespace core
+} // namespace aft
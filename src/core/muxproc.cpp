@@ -0,0 +1,218 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "base/blob.h"
+#include "muxproc.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+
+// Internal implementation class
+class aft::core::MuxProcImpl
+{
+public:
+    template<typename T>
+    struct Edge
+    {
+        Edge(T* end)
+        : end(end)
+        {  }
+
+        T* end;
+        EdgeCounter counter;
+    };
+
+    MuxProcImpl()
+    : input_(0)
+    , output_(0)
+    {  }
+
+    Edge<ProducerContract>* input()
+    {
+        return input_ < inputs_.size() ? inputs_[input_].get() : nullptr;
+    }
+    Edge<ConsumerContract>* output()
+    {
+        return output_ < outputs_.size() ? outputs_[output_].get() : nullptr;
+    }
+
+    template<typename T>
+    static EdgeCounters counters(const std::vector<std::unique_ptr<Edge<T>>>& edges, size_t idx)
+    {
+        return idx < edges.size() ? edges[idx]->counter.get() : EdgeCounters{ 0, 0, 0 };
+    }
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Edge<ProducerContract>>> inputs_;
+    std::vector<std::unique_ptr<Edge<ConsumerContract>>> outputs_;
+    size_t input_;
+    size_t output_;
+};
+
+
+MuxProc::MuxProc()
+: base::BaseProc(0, 0)
+, impl_(*new MuxProcImpl)
+{
+}
+
+MuxProc::~MuxProc()
+{
+    delete &impl_;
+}
+
+bool MuxProc::addInput(ProducerContract* input)
+{
+    if (!input) return false;
+
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    impl_.inputs_.emplace_back(new MuxProcImpl::Edge<ProducerContract>(input));
+    return true;
+}
+
+bool MuxProc::addOutput(ConsumerContract* output)
+{
+    if (!output) return false;
+
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    impl_.outputs_.emplace_back(new MuxProcImpl::Edge<ConsumerContract>(output));
+    return true;
+}
+
+bool MuxProc::selectInput(size_t input)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    if (input >= impl_.inputs_.size()) return false;
+
+    impl_.input_ = input;
+    return true;
+}
+
+bool MuxProc::selectOutput(size_t output)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    if (output >= impl_.outputs_.size()) return false;
+
+    impl_.output_ = output;
+    return true;
+}
+
+EdgeCounters MuxProc::getInputCounters(size_t input) const
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    return MuxProcImpl::counters(impl_.inputs_, input);
+}
+
+EdgeCounters MuxProc::getOutputCounters(size_t output) const
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    return MuxProcImpl::counters(impl_.outputs_, output);
+}
+
+// Producer contract
+Result MuxProc::read(base::TObject& object)
+{
+    return false;
+}
+
+Result MuxProc::read(base::Result& result)
+{
+    return false;
+}
+
+Result MuxProc::read(base::Blob& blob)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    MuxProcImpl::Edge<ProducerContract>* input = impl_.input();
+    if (!input || !input->end->read(blob)) return false;
+
+    input->counter.passed(blob.getLength());
+    return true;
+}
+
+bool MuxProc::hasData()
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    MuxProcImpl::Edge<ProducerContract>* input = impl_.input();
+    return input && input->end->hasData();
+}
+
+bool MuxProc::hasObject(base::ProductType productType)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    MuxProcImpl::Edge<ProducerContract>* input = impl_.input();
+    return input && input->end->hasObject(productType);
+}
+
+bool MuxProc::waitForData(const base::Deadline& deadline)
+{
+    // The selected input can change while waiting, so poll
+    return ProducerContract::waitForData(deadline);
+}
+
+// Consumer contract
+bool MuxProc::canAcceptData()
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    MuxProcImpl::Edge<ConsumerContract>* output = impl_.output();
+    return output && output->end->canAcceptData();
+}
+
+Result MuxProc::write(const base::TObject& object)
+{
+    return false;
+}
+
+Result MuxProc::write(const base::Result& result)
+{
+    return false;
+}
+
+Result MuxProc::write(const base::Blob& blob)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    MuxProcImpl::Edge<ConsumerContract>* output = impl_.output();
+    if (!output) return false;
+
+    if (!output->end->write(blob))
+    {
+        output->counter.refused();
+        return false;
+    }
+    output->counter.passed(blob.getLength());
+    return true;
+}
+
+int MuxProc::write(const std::vector<base::Blob>& blobs)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    MuxProcImpl::Edge<ConsumerContract>* output = impl_.output();
+    if (!output) return 0;
+
+    int written = output->end->write(blobs);
+    if (written < 0) written = 0;
+    for (int idx = 0; idx < written; ++idx)
+    {
+        output->counter.passed(blobs[idx].getLength());
+    }
+    if ((size_t)written < blobs.size()) output->counter.refused(blobs.size() - written);
+    return written;
+}
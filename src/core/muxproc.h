@@ -0,0 +1,82 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "base/proc.h"
+
+namespace aft
+{
+namespace core
+{
+// Forward reference
+class MuxProcImpl;
+
+
+/**
+ *  A proc that switches between inputs and between outputs.
+ *
+ *  Reads come from the selected input and writes go to the selected output, so a
+ *  model can change where its data comes from or goes to without replugging.
+ */
+class MuxProc : public aft::base::BaseProc
+{
+public:
+    MuxProc();
+    virtual ~MuxProc();
+
+    /** Add an input.  The first input added is selected.
+     *  @return false if the input is null, otherwise true.
+     */
+    bool addInput(base::ProducerContract* input);
+    /** Add an output.  The first output added is selected.
+     *  @return false if the output is null, otherwise true.
+     */
+    bool addOutput(base::ConsumerContract* output);
+    /** Select the input to read from.
+     *  @return false if there is no such input, otherwise true.
+     */
+    bool selectInput(size_t input);
+    /** Select the output to write to.
+     *  @return false if there is no such output, otherwise true.
+     */
+    bool selectOutput(size_t output);
+    /** Get the counts of blobs read from an input. */
+    base::EdgeCounters getInputCounters(size_t input) const;
+    /** Get the counts of blobs written to an output. */
+    base::EdgeCounters getOutputCounters(size_t output) const;
+
+    // Producer contract
+    virtual base::Result read(base::TObject& object);
+    virtual base::Result read(base::Result& result);
+    virtual base::Result read(base::Blob& blob);
+    virtual bool hasData();
+    virtual bool hasObject(base::ProductType productType);
+    virtual bool waitForData(const base::Deadline& deadline);
+
+    // Consumer contract
+    virtual bool canAcceptData();
+
+    virtual base::Result write(const base::TObject& object);
+    virtual base::Result write(const base::Result& result);
+    virtual base::Result write(const base::Blob& blob);
+    virtual int write(const std::vector<base::Blob>& blobs);
+
+private:
+    MuxProcImpl& impl_;
+};
+
+} // namespace core
+} // namespace aft
@@ -16,7 +16,13 @@
  *   See the License for the specific language governing permissions and
  *   limitations under the License.
  */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include "outlet.h"
+#include "outletindex.h"
 #include "base/blob.h"
 #include "base/structureddata.h"
 
@@ -40,6 +46,9 @@ class DummyProc : public ProcContract {
     virtual bool hasObject(ProductType productType) override {
         return false;
     }
+    virtual bool waitForData(const Deadline& deadline) override {
+        return false;
+    }
     virtual bool registerDataCallback(const ReaderContract* reader) override {
         return false;
     }
@@ -76,43 +85,126 @@ class DummyProc : public ProcContract {
     }
 };
 
-class aft::core::OutletImpl {
-public:
-    OutletImpl()
+/**
+ *  What is plugged into an Outlet.  A binding is never changed once published.
+ *  Plugging in or unplugging publishes a new one and retires the old one.
+ */
+struct Binding {
+    Binding(ProcContract& dummy)
     : type(OutletType::None)
     , consumer(nullptr)
     , producer(nullptr)
-    , proc(nullptr) {  }
-    
-    bool okForInput() const {
-        return (OutletType::In == type && nullptr != producer) ||
-        (OutletType::InOut == type && nullptr != proc);
+    , proc(nullptr)
+    , reader(&dummy)
+    , writer(&dummy) {  }
+
+    OutletType type;
+    ConsumerContract* consumer;
+    ProducerContract* producer;
+    ProcContract* proc;
+    ProducerContract* reader;   // What reads go to, never null
+    ConsumerContract* writer;   // What writes go to, never null
+};
+
+/**
+ *  Reads and writes load the current binding without a lock.  Each one counts
+ *  itself in the active count of the current epoch while it uses the binding.
+ *  Rebinding publishes the new binding, then flips the epoch and waits for the
+ *  old epoch's count to drain, twice, so no operation still uses the old binding.
+ *  While it waits, the operation that drains the count wakes it.
+ */
+class aft::core::OutletImpl {
+public:
+    /** Longest time that waitForData() holds on to one binding. */
+    static constexpr std::chrono::milliseconds WaitSlice{ 10 };
+
+    OutletImpl()
+    : current(new Binding(dummyProc))
+    , epoch(0)
+    , draining(false) {
+        active[0] = 0;
+        active[1] = 0;
     }
-    
-    ProducerContract& reader() {
-        if (nullptr != producer && OutletType::In == type) {
-            return *producer;
+    ~OutletImpl() {
+        delete current.load();
+    }
+
+    /** Holds the current binding for the length of one operation. */
+    class Guard {
+    public:
+        Guard(OutletImpl& impl)
+        : impl_(impl)
+        , epoch_(impl.epoch.load(std::memory_order_relaxed) & 1) {
+            impl_.active[epoch_].fetch_add(1, std::memory_order_seq_cst);
+            // Ordered after the count, so a rebind either sees the count or this
+            // sees the new binding.  It is a plain acquiring load on x86 and ARMv8.
+            binding_ = impl_.current.load(std::memory_order_seq_cst);
         }
-        else if (nullptr != proc && OutletType::InOut == type) {
-            return *proc;
+        ~Guard() {
+            // Ordered before the draining check, so a rebind either sees the count
+            // drop or is woken
+            if (impl_.active[epoch_].fetch_sub(1, std::memory_order_seq_cst) == 1 &&
+                impl_.draining.load(std::memory_order_seq_cst)) {
+                std::lock_guard<std::mutex> lock(impl_.drainMutex);
+                impl_.drained.notify_all();
+            }
         }
-        return dummyProc;
-    }
-    ConsumerContract& writer() {
-        if (nullptr != consumer && OutletType::Out == type) {
-            return *consumer;
+        const Binding* operator->() const {
+            return binding_;
+        }
+    private:
+        OutletImpl& impl_;
+        unsigned int epoch_;
+        const Binding* binding_;
+    };
+
+    /** Start a binding for the given things, with reader and writer set from them. */
+    Binding* bind(ConsumerContract* consumer, ProducerContract* producer, ProcContract* proc) {
+        Binding* binding = new Binding(dummyProc);
+        binding->consumer = consumer;
+        binding->producer = producer;
+        binding->proc = proc;
+        if (proc) {
+            binding->type = OutletType::InOut;
+            binding->reader = proc;
+            binding->writer = proc;
+        } else if (producer) {
+            binding->type = OutletType::In;
+            binding->reader = producer;
+        } else if (consumer) {
+            binding->type = OutletType::Out;
+            binding->writer = consumer;
         }
-        else if (nullptr != proc && OutletType::InOut == type) {
-            return *proc;
+        return binding;
+    }
+
+    /** Publish a binding and retire the old one once no operation uses it.
+     *  The caller holds rebindMutex.
+     */
+    void publish(Binding* binding) {
+        Binding* old = current.exchange(binding, std::memory_order_seq_cst);
+        draining.store(true, std::memory_order_seq_cst);
+        for (int flip = 0; flip < 2; ++flip) {
+            unsigned int previous = epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+            std::unique_lock<std::mutex> lock(drainMutex);
+            drained.wait(lock, [&] {
+                return active[previous].load(std::memory_order_seq_cst) == 0;
+            });
         }
-        return dummyProc;
+        draining.store(false, std::memory_order_relaxed);
+        delete old;
     }
+
 public:
-    OutletType type;
-    ConsumerContract* consumer;
-    ProducerContract* producer;
-    ProcContract* proc;
-    
+    std::atomic<Binding*> current;
+    std::atomic<unsigned int> epoch;
+    std::atomic<long> active[2];
+    std::mutex rebindMutex;
+
+    std::atomic<bool> draining;             // A rebind waits for active to drain
+    std::mutex drainMutex;
+    std::condition_variable drained;
+
     Outlet::EntityList consumed;
     Outlet::EntityList produced;
     Outlet::EntityList required;
@@ -120,14 +212,18 @@ private:
     DummyProc dummyProc;
 };
 
+constexpr std::chrono::milliseconds OutletImpl::WaitSlice;
+
 ///////////////////////////////////////////////////////////
 
 Outlet::Outlet(const std::string& name)
 : impl_(*new OutletImpl)
-, name_(name) {
+, name_(name)
+, index_(nullptr) {
 }
 
 Outlet::~Outlet() {
+    if (index_) index_->remove(this);
     delete &impl_;
 }
 
@@ -138,65 +234,85 @@ Outlet::name() const {
 
 OutletType
 Outlet::type() const {
-    return impl_.type;
+    OutletImpl::Guard binding(impl_);
+    return binding->type;
 }
 
 bool Outlet::plugin(ProducerContract* producer) {
-    if (OutletType::None != type()) return false;
-    
-    impl_.producer = producer;
-    impl_.type = OutletType::In;
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    if (OutletType::None != impl_.current.load()->type) return false;
+
+    impl_.publish(impl_.bind(nullptr, producer, nullptr));
     return true;
 }
 
 bool Outlet::plugin(ProcContract* proc) {
-    if (OutletType::None != type()) return false;
-    
-    impl_.proc = proc;
-    impl_.type = OutletType::InOut;
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    if (OutletType::None != impl_.current.load()->type) return false;
+
+    impl_.publish(impl_.bind(nullptr, nullptr, proc));
     return true;
 }
 
 bool Outlet::plugin(ConsumerContract* consumer) {
-    if (OutletType::None != type()) return false;
-    
-    impl_.consumer = consumer;
-    impl_.type = OutletType::Out;
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    if (OutletType::None != impl_.current.load()->type) return false;
+
+    impl_.publish(impl_.bind(consumer, nullptr, nullptr));
+    return true;
+}
+
+bool Outlet::replug(ProducerContract* producer) {
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    impl_.publish(impl_.bind(nullptr, producer, nullptr));
+    return true;
+}
+
+bool Outlet::replug(ProcContract* proc) {
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    impl_.publish(impl_.bind(nullptr, nullptr, proc));
+    return true;
+}
+
+bool Outlet::replug(ConsumerContract* consumer) {
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    impl_.publish(impl_.bind(consumer, nullptr, nullptr));
     return true;
 }
 
 bool Outlet::unplug() {
-    impl_.type = OutletType::None;
-    impl_.consumer = nullptr;
-    impl_.proc = nullptr;
-    impl_.producer = nullptr;
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    impl_.publish(impl_.bind(nullptr, nullptr, nullptr));
     return true;
 }
 
 bool Outlet::unplug(ProducerContract* producer) {
-    if (OutletType::In != type() || producer != impl_.producer) {
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    const Binding* binding = impl_.current.load();
+    if (OutletType::In != binding->type || producer != binding->producer) {
         return false;
     }
-    impl_.type = OutletType::None;
-    impl_.producer = nullptr;
+    impl_.publish(impl_.bind(nullptr, nullptr, nullptr));
     return true;
 }
 
 bool Outlet::unplug(ProcContract* proc) {
-    if (OutletType::InOut != type()) return false;
-    if (nullptr != proc && proc != impl_.proc) return false;
-    
-    impl_.type = OutletType::None;
-    impl_.proc = nullptr;
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    const Binding* binding = impl_.current.load();
+    if (OutletType::InOut != binding->type) return false;
+    if (nullptr != proc && proc != binding->proc) return false;
+
+    impl_.publish(impl_.bind(nullptr, nullptr, nullptr));
     return true;
 }
 
 bool Outlet::unplug(ConsumerContract* consumer) {
-    if (OutletType::Out != type()) return false;
-    if (nullptr != consumer && consumer != impl_.consumer) return false;
-    
-    impl_.type = OutletType::None;
-    impl_.consumer = nullptr;
+    std::lock_guard<std::mutex> lock(impl_.rebindMutex);
+    const Binding* binding = impl_.current.load();
+    if (OutletType::Out != binding->type) return false;
+    if (nullptr != consumer && consumer != binding->consumer) return false;
+
+    impl_.publish(impl_.bind(nullptr, nullptr, nullptr));
     return true;
 }
 
@@ -214,50 +330,83 @@ const Outlet::EntityList& Outlet::requires() const {
 
 void Outlet::consumes(const EntityList& entities) {
     impl_.consumed = entities;
+    if (index_) index_->update(this);
 }
 
 void Outlet::provides(const EntityList& entities) {
     impl_.produced = entities;
+    if (index_) index_->update(this);
 }
 
 void Outlet::requires(const EntityList& entities) {
     impl_.required = entities;
+    if (index_) index_->update(this);
 }
 
 Result Outlet::read(TObject& object) {
-    return impl_.reader().read(object);
+    OutletImpl::Guard binding(impl_);
+    return binding->reader->read(object);
 }
 
 Result Outlet::read(Result& result) {
-    return impl_.reader().read(result);
+    OutletImpl::Guard binding(impl_);
+    return binding->reader->read(result);
 }
 
 Result Outlet::read(Blob& blob) {
-    return impl_.reader().read(blob);
+    OutletImpl::Guard binding(impl_);
+    return binding->reader->read(blob);
 }
 
 bool Outlet::hasData() {
-    return impl_.reader().hasData();
+    OutletImpl::Guard binding(impl_);
+    return binding->reader->hasData();
 }
 
 bool Outlet::hasObject(ProductType productType) {
-    return impl_.reader().hasObject(productType);
+    OutletImpl::Guard binding(impl_);
+    return binding->reader->hasObject(productType);
+}
+
+bool Outlet::waitForData(const Deadline& deadline) {
+    // Wait in slices, so a rebind does not wait for the whole wait and the rest of
+    // the wait uses the new binding
+    while (true) {
+        const Deadline slice = std::min(deadline,
+                                        std::chrono::steady_clock::now() + OutletImpl::WaitSlice);
+        {
+            OutletImpl::Guard binding(impl_);
+            if (binding->reader->waitForData(slice)) return true;
+        }
+        // Stop if the wait is over, or the reader gave up before the slice was
+        const Deadline now = std::chrono::steady_clock::now();
+        if (now >= deadline || now < slice) return false;
+    }
 }
 
 bool Outlet::canAcceptData() {
-    return impl_.writer().canAcceptData();
+    OutletImpl::Guard binding(impl_);
+    return binding->writer->canAcceptData();
 }
 
 Result Outlet::write(const TObject& object) {
-    return impl_.writer().write(object);
+    OutletImpl::Guard binding(impl_);
+    return binding->writer->write(object);
 }
 
 Result Outlet::write(const Result& result) {
-    return impl_.writer().write(result);
+    OutletImpl::Guard binding(impl_);
+    return binding->writer->write(result);
 }
 
 Result Outlet::write(const Blob& blob) {
-    return impl_.writer().write(blob);
+    OutletImpl::Guard binding(impl_);
+    return binding->writer->write(blob);
+}
+
+int Outlet::write(const std::vector<Blob>& blobs) {
+    OutletImpl::Guard binding(impl_);
+    return binding->writer->write(blobs);
 }
 
 bool Outlet::operator==(const Outlet& other) const {
@@ -266,15 +415,18 @@ bool Outlet::operator==(const Outlet& other) const {
 }
 
 bool Outlet::serialize(base::Blob& blob) {
-    StructuredData sd("Outlet");
+    StructuredData sd("Outlet", std::string(), StructuredDataDelegate::create(blob));
 
+    return serializeTo(sd) && sd.serialize(blob);
+}
+
+bool Outlet::serializeTo(base::StructuredData& sd) {
     sd.add("name", name_);
-    
-    return sd.serialize(blob);
+    return true;
 }
 
 bool Outlet::deserialize(const base::Blob& blob) {
-    StructuredData sd("Outlet", blob.getString());
+    StructuredData sd("Outlet", blob);
     std::string name;
     if (!sd.get("name", name)) {
         return false;
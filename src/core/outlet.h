@@ -34,6 +34,7 @@ class ProducerContract;
 namespace core {
 // Forward references
 class OutletImpl;
+class OutletIndex;
 
 /** Type of Outlet. This is determined by which prod, cons or proc is plugged in. */
 enum class OutletType {
@@ -48,6 +49,11 @@ enum class OutletType {
  *  Outlets can be placed at input/output positions within the model and later,
  *  at run-time, the outlet is hooked up with the consumers and providers that
  *  perform the I/O. Thus this class allows dynamic, late binding of I/O for models.
+ *
+ *  Outlets can be plugged, replugged and unplugged while other threads read and write
+ *  them.  Reads and writes do not lock.  Rebinding returns once no read or write still
+ *  uses the old binding, so what was unplugged can then be deleted.  A read or write
+ *  must not rebind its own outlet, since it would wait for itself.
  */
 class Outlet : public base::BaseProc, public base::SerializeContract {
 public:
@@ -63,6 +69,12 @@ public:
     bool plugin(base::ProducerContract* producer);
     bool plugin(base::ProcContract* proc);
     bool plugin(base::ConsumerContract* consumer);
+    /** Replace whatever is plugged in without a gap where nothing is.
+     *  @return True if successful, otherwise false.
+     */
+    bool replug(base::ProducerContract* producer);
+    bool replug(base::ProcContract* proc);
+    bool replug(base::ConsumerContract* consumer);
     /** Unplug everything from the Outlet.
      *  @return True if successful, otherwise false.
      */
@@ -77,6 +89,7 @@ public:
     bool unplug(base::ConsumerContract* consumer);
 
     // An Entity can be at TObject type level, or an actual named TObject.
+    // Setting a list reindexes the outlet in the OutletIndex it is in, if any.
     const EntityList& consumes() const;
     const EntityList& provides() const;
     const EntityList& requires() const;
@@ -90,21 +103,29 @@ public:
     virtual base::Result read(base::Blob& blob) override;
     virtual bool hasData() override;
     virtual bool hasObject(base::ProductType productType) override;
+    /** Wait for data from whatever is plugged in.  Fails at once if nothing is. */
+    virtual bool waitForData(const base::Deadline& deadline) override;
 
     // Implement ProcContract (ConsumerContract)
     virtual bool canAcceptData() override;
     virtual base::Result write(const base::TObject& object) override;
     virtual base::Result write(const base::Result& result) override;
     virtual base::Result write(const base::Blob& blob) override;
+    /** Write a batch of blobs to whatever is plugged in. */
+    virtual int write(const std::vector<base::Blob>& blobs) override;
 
     bool operator==(const Outlet& other) const;
 
     virtual bool serialize(base::Blob& blob) override;
     virtual bool deserialize(const base::Blob& blob) override;
+    virtual bool serializeTo(base::StructuredData& sd) override;
 
 private:
+    friend class OutletIndex;
+
     OutletImpl& impl_;
     std::string name_;
+    OutletIndex* index_;
 };
         
 } // namespace core
@@ -0,0 +1,224 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include "base/tobject.h"
+#include "outlet.h"
+#include "outletindex.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+using OutletList = OutletIndex::OutletList;
+
+namespace {
+const int NumRoles = 3;
+
+/** Remove an outlet from a bucket, keeping the order of the others. */
+template <typename Map, typename Key>
+void removeFromBucket(Map& buckets, const Key& key, Outlet* outlet) {
+    auto it = buckets.find(key);
+    if (it == buckets.end()) return;
+
+    OutletList& bucket = it->second;
+    bucket.erase(std::remove(bucket.begin(), bucket.end(), outlet), bucket.end());
+    if (bucket.empty()) {
+        buckets.erase(it);
+    }
+}
+} // namespace
+
+/**
+ *  Buckets of outlets for one role.  TObjectTypes are registered singletons, so
+ *  their address is their key.
+ */
+struct RoleIndex {
+    std::unordered_map<const TObjectType*, OutletList> byType;
+    std::unordered_map<std::string, OutletList> byName;
+    OutletList any;     // Outlets with any entity at all
+};
+
+/** What an outlet was indexed with, so it can be removed after its lists change. */
+struct IndexedOutlet {
+    Outlet::EntityList entities[NumRoles];
+    size_t order;
+};
+
+class aft::core::OutletIndexImpl {
+public:
+    OutletIndexImpl()
+    : nextOrder(0) { }
+
+    static const Outlet::EntityList& entities(const Outlet& outlet, int role) {
+        switch (static_cast<OutletIndex::Role>(role)) {
+        case OutletIndex::Role::Consumes: return outlet.consumes();
+        case OutletIndex::Role::Provides: return outlet.provides();
+        default:                          return outlet.requires();
+        }
+    }
+
+    /** Insert keeping buckets in the order outlets were first indexed */
+    void insert(OutletList& bucket, Outlet* outlet) {
+        size_t order = outlets[outlet].order;
+        auto before = [this](Outlet* a, size_t b) { return outlets[a].order < b; };
+        auto pos = std::lower_bound(bucket.begin(), bucket.end(), order, before);
+        if (pos == bucket.end() || *pos != outlet) {
+            bucket.insert(pos, outlet);
+        }
+    }
+
+    void index(Outlet* outlet) {
+        IndexedOutlet& indexed = outlets[outlet];
+        for (int role = 0; role < NumRoles; ++role) {
+            indexed.entities[role] = entities(*outlet, role);
+            RoleIndex& roleIndex = roles[role];
+            for (auto& entity : indexed.entities[role]) {
+                const TObject* tObject = entity.getTObject();
+                insert(roleIndex.byType[&tObject->getType()], outlet);
+                insert(roleIndex.byName[tObject->getName()], outlet);
+            }
+            if (!indexed.entities[role].empty()) {
+                insert(roleIndex.any, outlet);
+            }
+        }
+    }
+
+    void unindex(Outlet* outlet) {
+        IndexedOutlet& indexed = outlets[outlet];
+        for (int role = 0; role < NumRoles; ++role) {
+            RoleIndex& roleIndex = roles[role];
+            for (auto& entity : indexed.entities[role]) {
+                const TObject* tObject = entity.getTObject();
+                removeFromBucket(roleIndex.byType, &tObject->getType(), outlet);
+                removeFromBucket(roleIndex.byName, tObject->getName(), outlet);
+            }
+            roleIndex.any.erase(std::remove(roleIndex.any.begin(), roleIndex.any.end(), outlet),
+                                roleIndex.any.end());
+            indexed.entities[role].clear();
+        }
+    }
+
+    /** The bucket holding every outlet that can match the wanted entity, or nullptr. */
+    const OutletList* bucket(const RoleIndex& roleIndex, const Entity& wanted) const {
+        const TObject* tObject = wanted.getTObject();
+        if (Entity::LevelAny == wanted.getMatchLevel()) {
+            return &roleIndex.any;
+        }
+        if (Entity::LevelTOType == wanted.getMatchLevel()) {
+            auto it = roleIndex.byType.find(&tObject->getType());
+            return it == roleIndex.byType.end() ? nullptr : &it->second;
+        }
+        // Name matches, and the exact matches other levels allow, share the name
+        auto it = roleIndex.byName.find(tObject->getName());
+        return it == roleIndex.byName.end() ? nullptr : &it->second;
+    }
+
+    /** Check an outlet from the name bucket, which only holds candidates
+     *  when wanted matches below the name level. */
+    bool matches(Outlet* outlet, int role, const Entity& wanted) const {
+        Entity::MatchLevel level = wanted.getMatchLevel();
+        if (Entity::LevelAny == level || Entity::LevelTOType == level ||
+            Entity::LevelTOName == level) {
+            return true;
+        }
+        for (auto& entity : outlets.at(outlet).entities[role]) {
+            if (wanted.matches(entity)) return true;
+        }
+        return false;
+    }
+
+    std::unordered_map<Outlet*, IndexedOutlet> outlets;
+    RoleIndex roles[NumRoles];
+    size_t nextOrder;
+};
+
+
+OutletIndex::OutletIndex()
+: impl_(*new OutletIndexImpl) {
+
+}
+
+OutletIndex::~OutletIndex() {
+    clear();
+    delete &impl_;
+}
+
+bool OutletIndex::add(Outlet* outlet) {
+    if (nullptr == outlet || nullptr != outlet->index_) return false;
+
+    outlet->index_ = this;
+    impl_.outlets[outlet].order = impl_.nextOrder++;
+    impl_.index(outlet);
+    return true;
+}
+
+bool OutletIndex::remove(Outlet* outlet) {
+    if (nullptr == outlet || this != outlet->index_) return false;
+
+    impl_.unindex(outlet);
+    impl_.outlets.erase(outlet);
+    outlet->index_ = nullptr;
+    return true;
+}
+
+void OutletIndex::update(Outlet* outlet) {
+    if (nullptr == outlet || this != outlet->index_) return;
+
+    impl_.unindex(outlet);
+    impl_.index(outlet);
+}
+
+void OutletIndex::clear() {
+    for (auto& entry : impl_.outlets) {
+        entry.first->index_ = nullptr;
+    }
+    impl_.outlets.clear();
+    for (auto& roleIndex : impl_.roles) {
+        roleIndex = RoleIndex();
+    }
+}
+
+size_t OutletIndex::size() const {
+    return impl_.outlets.size();
+}
+
+bool OutletIndex::find(Role role, const Entity& wanted, OutletList& outlets) const {
+    int r = static_cast<int>(role);
+    const OutletList* bucket = impl_.bucket(impl_.roles[r], wanted);
+    if (nullptr == bucket) return false;
+
+    bool found = false;
+    for (auto outlet : *bucket) {
+        if (impl_.matches(outlet, r, wanted)) {
+            outlets.push_back(outlet);
+            found = true;
+        }
+    }
+    return found;
+}
+
+Outlet* OutletIndex::first(Role role, const Entity& wanted) const {
+    int r = static_cast<int>(role);
+    const OutletList* bucket = impl_.bucket(impl_.roles[r], wanted);
+    if (nullptr == bucket) return nullptr;
+
+    for (auto outlet : *bucket) {
+        if (impl_.matches(outlet, r, wanted)) return outlet;
+    }
+    return nullptr;
+}
@@ -0,0 +1,82 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/entity.h"
+#include <vector>
+
+namespace aft {
+namespace core {
+// Forward references
+class Outlet;
+class OutletIndexImpl;
+
+/**
+ *  Index of what outlets consume, provide and require.
+ *
+ *  Entities are indexed by TObject type and by TObject name, so finding the outlets
+ *  that match an entity looks up one bucket instead of scanning every outlet.
+ *  Outlets are indexed when added and reindexed when their entity lists change.
+ *  The index is not locked; it is changed and searched by the thread that owns it.
+ */
+class OutletIndex {
+public:
+    using OutletList = std::vector<Outlet*>;
+
+    /** Which entity list of an outlet to search */
+    enum class Role {
+        Consumes,
+        Provides,
+        Requires
+    };
+
+public:
+    OutletIndex();
+    ~OutletIndex();
+    OutletIndex(const OutletIndex&) = delete;
+    OutletIndex& operator=(const OutletIndex&) = delete;
+
+    /** Index an outlet.  An outlet can be in one index at a time.
+     *  @return True if added, false if it already is in an index.
+     */
+    bool add(Outlet* outlet);
+    /** Remove an outlet from the index.
+     *  @return True if removed, false if it was not in this index.
+     */
+    bool remove(Outlet* outlet);
+    /** Reindex an outlet after its entity lists changed. Called by Outlet. */
+    void update(Outlet* outlet);
+    /** Remove all outlets */
+    void clear();
+
+    /** Number of outlets in the index */
+    size_t size() const;
+
+    /** Find the outlets whose role list has an entity matching the wanted one.
+     *  Outlets are listed in the order they were indexed.
+     *  @return True if any outlet was appended to outlets.
+     */
+    bool find(Role role, const base::Entity& wanted, OutletList& outlets) const;
+    /** Find the first outlet whose role list has an entity matching the wanted one.
+     *  @return The outlet or nullptr if none.
+     */
+    Outlet* first(Role role, const base::Entity& wanted) const;
+
+private:
+    OutletIndexImpl& impl_;
+};
+
+} // namespace core
+} // namespace aft
@@ -0,0 +1,449 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/blob.h"
+#include "base/consumer.h"
+#include "base/producer.h"
+#include "base/typedcontract.h"
+#include "pipeline.h"
+#include "queueproc.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+// How long an idle worker waits before it looks at the edges again, when an edge
+// cannot signal that it can move blobs
+static const std::chrono::milliseconds IdleWait(1);
+// How long an idle worker waits when every producer signals new data.  Producers that
+// get data without notifying their listeners are still looked at this often.
+static const std::chrono::milliseconds WatchedIdleWait(50);
+
+
+/**
+ *  Puts blobs to a ReaderContract, the way a producer's flowData() delivers them to
+ *  its registered readers.
+ */
+class ReaderConsumer : public TypedConsumer<Blob>
+{
+public:
+    ReaderConsumer(ReaderContract& reader)
+    : reader_(reader)
+    {  }
+
+    virtual bool put(const Blob& blob) override
+    {
+        return reader_.pushData(blob);
+    }
+    virtual size_t put(const Blob* blobs, size_t count) override
+    {
+        return reader_.pushData(blobs, count);
+    }
+    virtual bool canAcceptData() override
+    {
+        return reader_.roomForData() && reader_.roomForObject(ProductType::BLOB);
+    }
+
+private:
+    ReaderContract& reader_;
+};
+
+
+/**
+ *  A producer to consumer connection and the blobs it holds between activations.
+ *
+ *  Blobs are moved through the typed contracts, so a batch costs one call on each
+ *  side.  Producers and consumers that only have the untyped contracts are adapted.
+ */
+class Edge
+{
+public:
+    Edge(ProducerContract* producer, ConsumerContract* consumer, size_t batchSize)
+    : source_(producer)
+    , sink_(dynamic_cast<const void*>(consumer))
+    , reader_(nullptr)
+    , watchId_(-1)
+    , producer_(typedProducer(producer))
+    , consumer_(typedConsumer(consumer))
+    , slots_(batchSize, Blob(""))
+    , count_(0)
+    , held_(false)
+    , busy_(false)
+    , moved_(0)
+    {  }
+
+    /** Construct an edge to a reader that is registered with the producer. */
+    Edge(ProducerContract* producer, ReaderContract* reader, size_t batchSize)
+    : source_(producer)
+    , sink_(dynamic_cast<const void*>(reader))
+    , reader_(reader)
+    , watchId_(-1)
+    , producer_(typedProducer(producer))
+    , consumer_(nullptr)
+    , slots_(batchSize, Blob(""))
+    , count_(0)
+    , held_(false)
+    , busy_(false)
+    , moved_(0)
+    {
+        consumerAdapter_.reset(new ReaderConsumer(*reader));
+        consumer_ = consumerAdapter_.get();
+    }
+
+    ~Edge()
+    {
+        unwatch();
+        if (reader_) source_->unregisterDataCallback(reader_);
+    }
+
+    /** Try to take the edge, so only one worker activates it at a time. */
+    bool claim()
+    {
+        bool expected = false;
+        return busy_.compare_exchange_strong(expected, true, std::memory_order_acquire);
+    }
+    void release()
+    {
+        busy_.store(false, std::memory_order_release);
+    }
+
+    /** Move up to a batch of blobs.
+     *  @return the number of blobs written to the consumer
+     */
+    size_t activate()
+    {
+        held_ = false;
+        if (!consumer_->canAcceptData())
+        {
+            held_ = count_ > 0 || producer_->hasData();
+            return 0;
+        }
+
+        count_ += producer_->take(slots_.data() + count_, slots_.size() - count_);
+        if (count_ == 0) return 0;
+
+        size_t written = consumer_->put(slots_.data(), count_);
+        // Keep what the consumer did not take for the next activation
+        std::move(slots_.begin() + written, slots_.begin() + count_, slots_.begin());
+        count_ -= written;
+        held_ = count_ > 0;
+        moved_.fetch_add(written, std::memory_order_relaxed);
+        return written;
+    }
+
+    /** Check if the last activation left blobs that the consumer had no room for. */
+    bool held() const
+    {
+        return held_;
+    }
+
+    /** Check if the edge has nothing to move. */
+    bool idle()
+    {
+        return count_ == 0 && !producer_->hasData();
+    }
+
+    /** Call a listener when the producer may have data.
+     *  @return false if the producer must be polled instead.
+     */
+    bool watch(const std::function<void()>& listener)
+    {
+        watchId_ = source_->watchData(listener);
+        return watchId_ >= 0;
+    }
+    void unwatch()
+    {
+        if (watchId_ >= 0) source_->unwatchData(watchId_);
+        watchId_ = -1;
+    }
+
+    /** Get the producer and consumer objects, as their most derived addresses. */
+    const void* source() const
+    {
+        return dynamic_cast<const void*>(source_);
+    }
+    const void* sink() const
+    {
+        return sink_;
+    }
+
+    unsigned long moved() const
+    {
+        return moved_.load(std::memory_order_relaxed);
+    }
+
+private:
+    TypedProducer<Blob>* typedProducer(ProducerContract* producer)
+    {
+        TypedProducer<Blob>* typed = dynamic_cast<TypedProducer<Blob>*>(producer);
+        if (typed) return typed;
+
+        producerAdapter_.reset(new ContractProducer<Blob>(*producer));
+        return producerAdapter_.get();
+    }
+    TypedConsumer<Blob>* typedConsumer(ConsumerContract* consumer)
+    {
+        TypedConsumer<Blob>* typed = dynamic_cast<TypedConsumer<Blob>*>(consumer);
+        if (typed) return typed;
+
+        consumerAdapter_.reset(new ContractConsumer<Blob>(*consumer));
+        return consumerAdapter_.get();
+    }
+
+    ProducerContract* source_;
+    const void* sink_;
+    ReaderContract* reader_;        // Registered with source_, if the edge is to a reader
+    int watchId_;
+    std::unique_ptr<TypedProducer<Blob>> producerAdapter_;
+    std::unique_ptr<TypedConsumer<Blob>> consumerAdapter_;
+    TypedProducer<Blob>* producer_;
+    TypedConsumer<Blob>* consumer_;
+    std::vector<Blob> slots_;       // Blobs waiting for the consumer are at the front
+    size_t count_;
+    bool held_;
+    std::atomic<bool> busy_;
+    std::atomic<unsigned long> moved_;
+};
+
+
+class aft::core::PipelineImpl
+{
+public:
+    PipelineImpl(unsigned int workers, unsigned int batchSize)
+    : numWorkers_(workers > 0 ? workers : std::max(1u, std::thread::hardware_concurrency()))
+    , batchSize_(batchSize > 0 ? batchSize : 1)
+    , running_(false)
+    , next_(0)
+    , wakeups_(0)
+    , pollProducers_(false)
+    {  }
+
+    /** Activate edges until stopped. */
+    void work()
+    {
+        while (running_.load(std::memory_order_acquire))
+        {
+            // Data that arrives after this wakes the worker, even if the pass misses it
+            const unsigned long wakeups = wakeups_.load(std::memory_order_seq_cst);
+
+            // Each worker starts at a different edge so they spread out
+            size_t moved = 0;
+            bool held = false;
+            size_t first = next_.fetch_add(1, std::memory_order_relaxed);
+            for (size_t idx = 0; idx < edges_.size(); ++idx)
+            {
+                Edge& edge = *edges_[(first + idx) % edges_.size()];
+                if (edge.claim())
+                {
+                    moved += edge.activate();
+                    held = held || edge.held();
+                    edge.release();
+                }
+            }
+
+            if (moved == 0)
+            {
+                // Consumers do not signal when they have room again, so held blobs
+                // are tried again soon, as are producers that cannot be watched
+                const std::chrono::milliseconds wait =
+                    held || pollProducers_ ? IdleWait : WatchedIdleWait;
+                idle_.waitUntil(std::chrono::steady_clock::now() + wait, [&] {
+                    return !running_.load(std::memory_order_acquire) ||
+                           wakeups_.load(std::memory_order_seq_cst) != wakeups;
+                });
+            }
+        }
+    }
+
+    /** Wake idle workers, as a producer may have data. */
+    void wake()
+    {
+        wakeups_.fetch_add(1, std::memory_order_seq_cst);
+        idle_.notify();
+    }
+
+    /** Check if every edge is idle.  Only reliable while no worker is activating. */
+    bool drained()
+    {
+        for (std::unique_ptr<Edge>& edge : edges_)
+        {
+            if (!edge->claim()) return false;
+            bool idle = edge->idle();
+            edge->release();
+            if (!idle) return false;
+        }
+        return true;
+    }
+
+    /** Check if the producer of an edge is the consumer of another edge. */
+    bool fed(const Edge& edge) const
+    {
+        for (const std::unique_ptr<Edge>& other : edges_)
+        {
+            if (other->sink() == edge.source()) return true;
+        }
+        return false;
+    }
+
+    /** Check that a queue can be shared by the edges that read and write it, which
+     *  workers activate at the same time.
+     *  @param reading true if the new edge reads from the queue
+     *  @param writing true if the new edge writes to the queue
+     */
+    bool canShare(const QueueProc* queue, bool reading, bool writing) const
+    {
+        const void* address = dynamic_cast<const void*>(queue);
+        size_t readers = reading ? 1 : 0;
+        size_t writers = writing ? 1 : 0;
+        for (const std::unique_ptr<Edge>& edge : edges_)
+        {
+            if (edge->source() == address) ++readers;
+            if (edge->sink() == address) ++writers;
+        }
+
+        switch (queue->getConcurrency())
+        {
+        case QueueProc::UNSYNCHRONIZED:
+            return readers + writers <= 1;
+        case QueueProc::SPSC:
+            return readers <= 1 && writers <= 1;
+        case QueueProc::MPMC:
+            break;
+        }
+        return true;
+    }
+
+    unsigned int numWorkers_;
+    size_t batchSize_;
+    std::vector<std::unique_ptr<Edge>> edges_;
+    std::vector<std::thread> workers_;
+    std::atomic<bool> running_;
+    std::atomic<size_t> next_;
+    std::atomic<unsigned long> wakeups_;
+    bool pollProducers_;            // Some producer cannot be watched
+    DataSignal idle_;
+};
+
+
+Pipeline::Pipeline(unsigned int workers, unsigned int batchSize)
+: impl_(*new PipelineImpl(workers, batchSize))
+{
+}
+
+Pipeline::~Pipeline()
+{
+    stop();
+    delete &impl_;
+}
+
+bool Pipeline::connect(ProducerContract* producer, ConsumerContract* consumer)
+{
+    if (!producer || !consumer || impl_.running_) return false;
+
+    const QueueProc* queue = dynamic_cast<const QueueProc*>(producer);
+    if (queue && !impl_.canShare(queue, true, false)) return false;
+    queue = dynamic_cast<const QueueProc*>(consumer);
+    if (queue && !impl_.canShare(queue, false, true)) return false;
+
+    impl_.edges_.emplace_back(new Edge(producer, consumer, impl_.batchSize_));
+    return true;
+}
+
+bool Pipeline::connect(ProducerContract* producer, ReaderContract* reader)
+{
+    if (!producer || !reader || impl_.running_) return false;
+
+    const QueueProc* queue = dynamic_cast<const QueueProc*>(producer);
+    if (queue && !impl_.canShare(queue, true, false)) return false;
+    if (!producer->registerDataCallback(reader)) return false;
+
+    impl_.edges_.emplace_back(new Edge(producer, reader, impl_.batchSize_));
+    return true;
+}
+
+bool Pipeline::start()
+{
+    if (impl_.running_) return false;
+
+    // Producers fed by another edge get data from a worker, which then looks at the
+    // edges again anyway, so only the others are watched
+    impl_.pollProducers_ = false;
+    for (std::unique_ptr<Edge>& edge : impl_.edges_)
+    {
+        if (!impl_.fed(*edge) && !edge->watch([this] { impl_.wake(); }))
+        {
+            impl_.pollProducers_ = true;
+        }
+    }
+
+    impl_.running_ = true;
+    for (unsigned int idx = 0; idx < impl_.numWorkers_; ++idx)
+    {
+        impl_.workers_.emplace_back(&PipelineImpl::work, &impl_);
+    }
+    return true;
+}
+
+void Pipeline::stop()
+{
+    if (!impl_.running_) return;
+
+    impl_.running_ = false;
+    impl_.idle_.notify();
+    for (std::thread& worker : impl_.workers_)
+    {
+        worker.join();
+    }
+    impl_.workers_.clear();
+    for (std::unique_ptr<Edge>& edge : impl_.edges_)
+    {
+        edge->unwatch();
+    }
+}
+
+bool Pipeline::drain(const Deadline& deadline)
+{
+    // Edges feed each other, so look until every edge is idle on two passes in a row
+    int idlePasses = 0;
+    while (idlePasses < 2)
+    {
+        idlePasses = impl_.drained() ? idlePasses + 1 : 0;
+        if (idlePasses < 2)
+        {
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+            if (!impl_.running_) return idlePasses > 0;
+            std::this_thread::sleep_for(IdleWait);
+        }
+    }
+    return true;
+}
+
+unsigned long Pipeline::moved() const
+{
+    unsigned long total = 0;
+    for (const std::unique_ptr<Edge>& edge : impl_.edges_)
+    {
+        total += edge->moved();
+    }
+    return total;
+}
@@ -0,0 +1,102 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "base/datasignal.h"
+
+namespace aft
+{
+namespace base
+{
+// Forward reference
+class ConsumerContract;
+class ProducerContract;
+class ReaderContract;
+}
+
+namespace core
+{
+// Forward reference
+class PipelineImpl;
+
+/**
+ *  Runs a graph of producers, procs and consumers on a pool of worker threads.
+ *
+ *  Each edge connects a producer to a consumer, or to a reader registered with the
+ *  producer as for flowData().  Workers take turns activating the edges.  An
+ *  activation reads up to a batch of blobs from the producer and writes them to the
+ *  consumer or pushes them to the reader in one call.  An edge whose consumer has no
+ *  room (canAcceptData(), which a BaseConsumer answers from its reader's roomForData())
+ *  or whose reader has no room (roomForData() and roomForObject()) is skipped until it
+ *  does, so slow consumers hold blobs back in their producers instead of having them
+ *  piled up in between.
+ *
+ *  Blobs that a consumer does not take are held by the edge and written first on the
+ *  next activation, so none are lost.
+ *
+ *  Idle workers sleep until a producer signals new data through watchData().  While
+ *  some producer cannot be watched, or some consumer has no room for held blobs, they
+ *  look at the edges again every millisecond instead.
+ *
+ *  Each edge is activated by one worker at a time, but different edges run at the
+ *  same time, so a QueueProc shared by edges must allow it.  An UNSYNCHRONIZED queue
+ *  can only be used by one edge, an SPSC ring by one edge that writes it and one that
+ *  reads it, and an MPMC ring by any number of edges.
+ */
+class Pipeline
+{
+public:
+    /** Construct a pipeline
+     *  @param workers Number of worker threads.  Zero uses one per core.
+     *  @param batchSize Most blobs moved over an edge per activation.
+     */
+    Pipeline(unsigned int workers = 0, unsigned int batchSize = 64);
+    /** Stop the workers and destruct the pipeline. */
+    ~Pipeline();
+
+    /** Add an edge from producer to consumer.  Edges can only be added while stopped.
+     *  A proc is connected by adding an edge to it and an edge from it.
+     *  @return true if the edge was added, or false if it is not allowed for a
+     *          QueueProc it shares with other edges.
+     */
+    bool connect(base::ProducerContract* producer, base::ConsumerContract* consumer);
+    /** Add an edge from producer to reader, and register the reader with the producer.
+     *  The pipeline unregisters it when it is destructed.
+     *  @return true if the edge was added, otherwise false.
+     */
+    bool connect(base::ProducerContract* producer, base::ReaderContract* reader);
+
+    /** Start the workers.
+     *  @return false if already running, otherwise true.
+     */
+    bool start();
+    /** Stop the workers after their current activations. */
+    void stop();
+
+    /** Wait until no edge has blobs to move, or until the deadline.
+     *  @return true if the pipeline is drained, otherwise false.
+     */
+    bool drain(const base::Deadline& deadline);
+
+    /** Get the number of blobs written to consumers over all edges. */
+    unsigned long moved() const;
+
+private:
+    PipelineImpl& impl_;
+};
+
+} // namespace core
+} // namespace aft
@@ -5,7 +5,10 @@
 //  Copyright © 2016 Andy Warner. All rights reserved.
 //
 
+#include <algorithm>
+#include <atomic>
 #include <queue>
+#include <vector>
 
 #include "base/blob.h"
 #include "queueproc.h"
@@ -13,22 +16,22 @@
 using namespace aft::base;
 using namespace aft::core;
 
+// Size of a cache line, which the ring indices are padded to
+static const size_t CacheLineSize = 64;
+// Capacity of rings created without a maxSize
+static const size_t DefaultRingSize = 1024;
+
 // Internal implementation class
 class aft::core::QueueProcImpl : public WriterContract, public ReaderContract
 {
 public:
-    QueueProcImpl(unsigned int maxSize)
-    : maxSize_(maxSize)
-    {  }
     virtual ~QueueProcImpl()
     {  }
 
     /** Returns the type of product this writer has ready to write. */
     virtual ProductType hasData()
     {
-        if (queue_.empty()) return ProductType::NONE;
-
-        return ProductType::BLOB;
+        return empty() ? ProductType::NONE : ProductType::BLOB;
     }
     
     /** Return true if data was written. */
@@ -40,13 +43,16 @@ public:
     {
         return false;
     }
-    virtual bool getData(Blob& blob)
+    virtual bool getData(Blob& blob) = 0;
+    /** Take up to count blobs.  The default takes them one at a time. */
+    virtual size_t getData(Blob* blobs, size_t count)
     {
-        if (queue_.empty()) return false;
-        
-        blob = queue_.front();
-        queue_.pop();
-        return true;
+        size_t taken = 0;
+        while (taken < count && getData(blobs[taken]))
+        {
+            ++taken;
+        }
+        return taken;
     }
 
     // Reader contract
@@ -59,32 +65,320 @@ public:
         return false;
     }
     virtual bool pushData(const Blob& blob)
+    {
+        Blob copy(blob);
+        return pushData(std::move(copy));
+    }
+    using ReaderContract::pushData;
+    /** Queue a blob by moving it.  The blob is only moved if it is queued. */
+    virtual bool pushData(Blob&& blob) = 0;
+
+    virtual bool roomForData() const = 0;
+    bool roomForObject(ProductType productType) const
+    {
+        return productType == ProductType::BLOB && roomForData();
+    }
+
+    bool waitForData(const Deadline& deadline)
+    {
+        return signal_.waitUntil(deadline, [this] { return !empty(); });
+    }
+    DataSignal& signal()
+    {
+        return signal_;
+    }
+
+protected:
+    virtual bool empty() const = 0;
+
+    /** Signaled after every push */
+    DataSignal signal_;
+};
+
+/**
+ *  Queue for use by one thread at a time.
+ */
+class UnsynchronizedQueue : public QueueProcImpl
+{
+public:
+    UnsynchronizedQueue(unsigned int maxSize)
+    : maxSize_(maxSize)
+    {  }
+
+    virtual bool getData(Blob& blob)
+    {
+        if (queue_.empty()) return false;
+        
+        blob = std::move(queue_.front());
+        queue_.pop();
+        return true;
+    }
+
+    using QueueProcImpl::pushData;
+    virtual bool pushData(Blob&& blob)
     {
         if (queue_.size() < maxSize_)
         {
-            queue_.push(blob);
+            queue_.push(std::move(blob));
+            signal_.notify();
             return true;
         }
         return false;
     }
+    virtual size_t pushData(const Blob* blobs, size_t count)
+    {
+        // Check the room once for the whole batch
+        size_t room = queue_.size() < maxSize_ ? maxSize_ - queue_.size() : 0;
+        size_t pushed = count < room ? count : room;
+        for (size_t idx = 0; idx < pushed; ++idx)
+        {
+            queue_.push(blobs[idx]);
+        }
+        if (pushed > 0) signal_.notify();
+        return pushed;
+    }
     bool roomForData() const
     {
         return queue_.size() < maxSize_;
     }
-    bool roomForObject(ProductType productType) const
+
+protected:
+    bool empty() const
     {
-        return productType == ProductType::BLOB && roomForData();
+        return queue_.empty();
     }
 
 private:
     unsigned int maxSize_;
-    std::queue<base::Blob> queue_;
+    std::queue<Blob> queue_;
+};
+
+/** Round a ring size up to a power of two. */
+static size_t ringSize(int maxSize)
+{
+    size_t wanted = maxSize > 0 ? maxSize : DefaultRingSize;
+    size_t size = 1;
+    while (size < wanted) size <<= 1;
+    return size;
+}
+
+/** An atomic index alone on its cache line, so writers and readers do not share one. */
+struct PaddedIndex
+{
+    char before[CacheLineSize];
+    std::atomic<size_t> value;
+    char after[CacheLineSize - sizeof(std::atomic<size_t>)];
+
+    PaddedIndex() : value(0) { }
+};
+
+/**
+ *  Lock-free ring for one writing thread and one reading thread.
+ *
+ *  Each side caches the other side's index and only reloads it when the ring looks
+ *  full or empty, so the indices' cache lines rarely move between cores.
+ */
+class SpscRing : public QueueProcImpl
+{
+public:
+    SpscRing(int maxSize)
+    : slots_(ringSize(maxSize), Blob(""))
+    , mask_(slots_.size() - 1)
+    , cachedHead_(0)
+    , cachedTail_(0)
+    {  }
+
+    virtual bool getData(Blob& blob)
+    {
+        size_t head = head_.value.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.value.load(std::memory_order_acquire);
+            if (head == cachedTail_) return false;
+        }
+
+        blob = std::move(slots_[head & mask_]);
+        head_.value.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    virtual size_t getData(Blob* blobs, size_t count)
+    {
+        // Load the writer's index once for the whole batch
+        size_t head = head_.value.load(std::memory_order_relaxed);
+        if (cachedTail_ - head < count)
+        {
+            cachedTail_ = tail_.value.load(std::memory_order_acquire);
+        }
+        size_t taken = std::min(count, cachedTail_ - head);
+        for (size_t idx = 0; idx < taken; ++idx)
+        {
+            blobs[idx] = std::move(slots_[(head + idx) & mask_]);
+        }
+        if (taken > 0) head_.value.store(head + taken, std::memory_order_release);
+        return taken;
+    }
+
+    using QueueProcImpl::pushData;
+    virtual bool pushData(Blob&& blob)
+    {
+        size_t tail = tail_.value.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == slots_.size())
+        {
+            cachedHead_ = head_.value.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == slots_.size()) return false;
+        }
+
+        slots_[tail & mask_] = std::move(blob);
+        tail_.value.store(tail + 1, std::memory_order_release);
+        signal_.notify();
+        return true;
+    }
+    bool roomForData() const
+    {
+        return tail_.value.load(std::memory_order_relaxed) -
+               head_.value.load(std::memory_order_acquire) < slots_.size();
+    }
+
+protected:
+    bool empty() const
+    {
+        return head_.value.load(std::memory_order_relaxed) ==
+               tail_.value.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<Blob> slots_;
+    size_t mask_;
+    PaddedIndex head_;      // next slot to read, written by the reader
+    size_t cachedHead_;     // used by the writer
+    PaddedIndex tail_;      // next slot to write, written by the writer
+    size_t cachedTail_;     // used by the reader
 };
 
+/**
+ *  Lock-free ring for any number of writing and reading threads.
+ *
+ *  Every slot has a sequence number that tells whether it is ready to be written or
+ *  read for a given position, so threads only contend on claiming positions.
+ */
+class MpmcRing : public QueueProcImpl
+{
+public:
+    MpmcRing(int maxSize)
+    : slots_(ringSize(maxSize))
+    , mask_(slots_.size() - 1)
+    {
+        for (size_t idx = 0; idx < slots_.size(); ++idx)
+        {
+            slots_[idx].sequence.store(idx, std::memory_order_relaxed);
+        }
+    }
+
+    virtual bool getData(Blob& blob)
+    {
+        size_t pos = readPos_.value.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = slots_[pos & mask_];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            long diff = (long)sequence - (long)(pos + 1);
+            if (diff == 0)
+            {
+                if (readPos_.value.compare_exchange_weak(pos, pos + 1,
+                                                         std::memory_order_relaxed))
+                {
+                    blob = std::move(slot.blob);
+                    slot.sequence.store(pos + slots_.size(), std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;   // empty
+            }
+            else
+            {
+                pos = readPos_.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    using QueueProcImpl::pushData;
+    virtual bool pushData(Blob&& blob)
+    {
+        size_t pos = writePos_.value.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = slots_[pos & mask_];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            long diff = (long)sequence - (long)pos;
+            if (diff == 0)
+            {
+                if (writePos_.value.compare_exchange_weak(pos, pos + 1,
+                                                          std::memory_order_relaxed))
+                {
+                    slot.blob = std::move(blob);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    signal_.notify();
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;   // full
+            }
+            else
+            {
+                pos = writePos_.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    bool roomForData() const
+    {
+        size_t pos = writePos_.value.load(std::memory_order_relaxed);
+        return slots_[pos & mask_].sequence.load(std::memory_order_acquire) == pos;
+    }
+
+protected:
+    bool empty() const
+    {
+        size_t pos = readPos_.value.load(std::memory_order_relaxed);
+        return slots_[pos & mask_].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+private:
+    struct Slot
+    {
+        Slot() : blob("") { }
+        std::atomic<size_t> sequence;
+        Blob blob;
+    };
+
+    std::vector<Slot> slots_;
+    size_t mask_;
+    PaddedIndex writePos_;
+    PaddedIndex readPos_;
+};
 
-QueueProc::QueueProc(int maxSize)
+static QueueProcImpl* createQueue(int maxSize, QueueProc::Concurrency concurrency)
+{
+    switch (concurrency)
+    {
+    case QueueProc::SPSC:
+        return new SpscRing(maxSize);
+    case QueueProc::MPMC:
+        return new MpmcRing(maxSize);
+    case QueueProc::UNSYNCHRONIZED:
+        break;
+    }
+    return new UnsynchronizedQueue(maxSize);
+}
+
+
+QueueProc::QueueProc(int maxSize, Concurrency concurrency)
 : base::BaseProc(0, 0)
-, impl_(*new QueueProcImpl(maxSize))
+, impl_(*createQueue(maxSize, concurrency))
+, concurrency_(concurrency)
 {
     
 }
@@ -94,6 +388,11 @@ QueueProc::~QueueProc()
     delete &impl_;
 }
 
+QueueProc::Concurrency QueueProc::getConcurrency() const
+{
+    return concurrency_;
+}
+
 // Producer contract
 Result QueueProc::read(base::TObject& object)
 {
@@ -120,6 +419,21 @@ bool QueueProc::hasObject(base::ProductType productType)
     return impl_.hasData() == productType;
 }
 
+bool QueueProc::waitForData(const base::Deadline& deadline)
+{
+    return impl_.waitForData(deadline);
+}
+
+int QueueProc::watchData(const std::function<void()>& listener)
+{
+    return impl_.signal().addListener(listener);
+}
+
+void QueueProc::unwatchData(int id)
+{
+    impl_.signal().removeListener(id);
+}
+
 // Consumer contract
 bool QueueProc::canAcceptData()
 {
@@ -140,3 +454,34 @@ Result QueueProc::write(const base::Blob& blob)
 {
     return impl_.pushData(blob);
 }
+
+Result QueueProc::write(base::Blob&& blob)
+{
+    return impl_.pushData(std::move(blob));
+}
+
+int QueueProc::write(const std::vector<base::Blob>& blobs)
+{
+    return impl_.pushData(blobs.data(), blobs.size());
+}
+
+// Typed contracts
+bool QueueProc::take(base::Blob& blob)
+{
+    return impl_.getData(blob);
+}
+
+size_t QueueProc::take(base::Blob* blobs, size_t count)
+{
+    return impl_.getData(blobs, count);
+}
+
+bool QueueProc::put(const base::Blob& blob)
+{
+    return impl_.pushData(blob);
+}
+
+size_t QueueProc::put(const base::Blob* blobs, size_t count)
+{
+    return impl_.pushData(blobs, count);
+}
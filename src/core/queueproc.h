@@ -19,6 +19,7 @@
 
 #include "base/callback.h"
 #include "base/proc.h"
+#include "base/typedcontract.h"
 
 namespace aft
 {
@@ -30,19 +31,46 @@ class QueueProcImpl;
 
 /**
  *  A Queue Producer/Consumer.
+ *
+ *  The default queue is for one thread at a time.  The ring queues can be written and
+ *  read by different threads without locks.  Their slots are allocated up front.
+ *  The typed contracts take and put batches of blobs with one call.
  */
-class QueueProc : public aft::base::BaseProc
+class QueueProc : public aft::base::BaseProc,
+                  public aft::base::TypedProducer<aft::base::Blob>,
+                  public aft::base::TypedConsumer<aft::base::Blob>
 {
 public:
-    QueueProc(int maxSize = -1);
+    /** How a QueueProc can be shared between threads. */
+    enum Concurrency
+    {
+        UNSYNCHRONIZED,     ///< One thread at a time
+        SPSC,               ///< Ring for one writing thread and one reading thread
+        MPMC                ///< Ring for any number of writing and reading threads
+    };
+
+    /** Construct a QueueProc
+     *  @param maxSize Most blobs that can be queued.  Rings round it up to a power of
+     *                 two, and hold 1024 blobs if it is not given.
+     *  @param concurrency How the queue can be shared between threads.
+     */
+    QueueProc(int maxSize = -1, Concurrency concurrency = UNSYNCHRONIZED);
     virtual ~QueueProc();
 
+    /** Get how the queue can be shared between threads. */
+    Concurrency getConcurrency() const;
+
     // Producer contract
     virtual base::Result read(base::TObject& object);
     virtual base::Result read(base::Result& result);
     virtual base::Result read(base::Blob& blob);
     virtual bool hasData();
     virtual bool hasObject(base::ProductType productType);
+    /** Wait until a blob is queued or until the deadline.  Writes wake waiting threads. */
+    virtual bool waitForData(const base::Deadline& deadline);
+    /** Call a listener after every write. */
+    virtual int watchData(const std::function<void()>& listener);
+    virtual void unwatchData(int id);
 
     // Consumer contract
     virtual bool canAcceptData();
@@ -50,6 +78,18 @@ public:
     virtual base::Result write(const base::TObject& object);
     virtual base::Result write(const base::Result& result);
     virtual base::Result write(const base::Blob& blob);
+    /** Queue a blob by moving it.  The blob is only moved if it is queued. */
+    base::Result write(base::Blob&& blob);
+    /** Queue as many blobs as there is room for. */
+    virtual int write(const std::vector<base::Blob>& blobs);
+
+    // Typed contracts
+    virtual bool take(base::Blob& blob);
+    /** Take up to count blobs.  The SPSC ring checks the writer's index once. */
+    virtual size_t take(base::Blob* blobs, size_t count);
+    virtual bool put(const base::Blob& blob);
+    /** Put as many blobs as there is room for. */
+    virtual size_t put(const base::Blob* blobs, size_t count);
 
     //TODO values and callbacks for low water/highwater
     bool setLowWater(int lowValue, base::Callback* lowWaterAction);
@@ -57,6 +97,7 @@ public:
 
 private:
     QueueProcImpl& impl_;
+    const Concurrency concurrency_;
 };
 
 } // namespace core
@@ -0,0 +1,415 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "robotprocs.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+static const uint64_t NanosPerSecond = 1000000000;
+
+
+RobotProc::RobotProc(ConsumerContract* output)
+: base::BaseProc(0, 0)
+, output_(output)
+, seen_(0)
+{
+}
+
+RobotProc::~RobotProc()
+{
+}
+
+void RobotProc::setOutput(ConsumerContract* output)
+{
+    output_ = output;
+}
+
+ConsumerContract* RobotProc::getOutput() const
+{
+    return output_;
+}
+
+unsigned long RobotProc::getSeen() const
+{
+    return seen_;
+}
+
+EdgeCounters RobotProc::getCounters() const
+{
+    return counter_.get();
+}
+
+bool RobotProc::canAcceptData()
+{
+    return output_ && output_->canAcceptData();
+}
+
+Result RobotProc::write(const base::TObject& object)
+{
+    return false;
+}
+
+Result RobotProc::write(const base::Result& result)
+{
+    return false;
+}
+
+bool RobotProc::forward(const Blob& blob)
+{
+    if (output_->write(blob))
+    {
+        counter_.passed(blob.getLength());
+        return true;
+    }
+    counter_.refused();
+    return false;
+}
+
+int RobotProc::forward(const std::vector<Blob>& blobs, size_t count)
+{
+    if (count == 0) return 0;
+
+    int written = count == blobs.size()
+                  ? output_->write(blobs)
+                  : output_->write(std::vector<Blob>(blobs.begin(), blobs.begin() + count));
+    if (written < 0) written = 0;
+    for (int idx = 0; idx < written; ++idx)
+    {
+        counter_.passed(blobs[idx].getLength());
+    }
+    if ((size_t)written < count) counter_.refused(count - written);
+    return written;
+}
+
+// -------------------------------------
+
+ThrottleProc::ThrottleProc(unsigned long ratePerSecond, unsigned long burst, ConsumerContract* output)
+: RobotProc(output)
+{
+    setRate(ratePerSecond, burst);
+}
+
+void ThrottleProc::setRate(unsigned long ratePerSecond, unsigned long burst)
+{
+    rate_ = ratePerSecond;
+    capacity_ = std::max(burst, 1ul) * NanosPerSecond;
+    credit_ = capacity_;
+    last_ = std::chrono::steady_clock::now();
+}
+
+void ThrottleProc::refill()
+{
+    if (credit_ == capacity_)
+    {
+        // Idle at full, so only move the clock
+        last_ = std::chrono::steady_clock::now();
+        return;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count();
+    last_ = now;
+
+    // Check for a full bucket first so the product cannot overflow
+    if (elapsed >= (capacity_ - credit_) / rate_ + 1)
+    {
+        credit_ = capacity_;
+    }
+    else
+    {
+        credit_ = std::min(capacity_, credit_ + elapsed * rate_);
+    }
+}
+
+unsigned long ThrottleProc::available()
+{
+    if (rate_ == 0) return capacity_ / NanosPerSecond;
+
+    refill();
+    return credit_ / NanosPerSecond;
+}
+
+bool ThrottleProc::canAcceptData()
+{
+    return RobotProc::canAcceptData() && available() > 0;
+}
+
+Result ThrottleProc::write(const base::Blob& blob)
+{
+    if (!output_ || available() == 0) return false;
+
+    ++seen_;
+    if (!forward(blob)) return false;
+
+    if (rate_ != 0) credit_ -= NanosPerSecond;
+    return true;
+}
+
+int ThrottleProc::write(const std::vector<base::Blob>& blobs)
+{
+    if (!output_) return 0;
+
+    size_t count = rate_ == 0 ? blobs.size() : std::min<size_t>(blobs.size(), available());
+    int written = forward(blobs, count);
+    seen_ += written;
+    if (rate_ != 0) credit_ -= written * NanosPerSecond;
+    return written;
+}
+
+// -------------------------------------
+
+SampleProc::SampleProc(Mode mode, unsigned long n, ConsumerContract* output, unsigned long seed)
+: RobotProc(output)
+, mode_(mode)
+, n_(std::max(n, 1ul))
+, random_(seed)
+, weight_(0.0)
+, next_(0)
+{
+    if (mode_ == RESERVOIR)
+    {
+        samples_.reserve(n_);
+        weight_ = std::exp(std::log(uniform()) / n_);
+        skipAhead();
+    }
+}
+
+const std::vector<Blob>& SampleProc::getSamples() const
+{
+    return samples_;
+}
+
+double SampleProc::uniform()
+{
+    // In (0, 1], so its log is finite
+    return 1.0 - std::generate_canonical<double, 53>(random_);
+}
+
+void SampleProc::skipAhead()
+{
+    // Algorithm L: jump straight to the next blob that replaces a sample, so
+    // blobs in between cost only a count.  next_ counts blobs from 1.
+    double skip = std::floor(std::log(uniform()) / std::log(1.0 - weight_));
+    next_ = (next_ == 0 ? n_ : next_) + (skip < 1e18 ? (unsigned long)skip : ~0ul / 2) + 1;
+}
+
+void SampleProc::keep(const Blob& blob)
+{
+    ++seen_;
+    if (samples_.size() < n_)
+    {
+        samples_.push_back(blob);
+    }
+    else if (seen_ == next_)
+    {
+        samples_[random_() % n_] = blob;
+        weight_ *= std::exp(std::log(uniform()) / n_);
+        skipAhead();
+    }
+}
+
+bool SampleProc::canAcceptData()
+{
+    if (mode_ == RESERVOIR || (seen_ + 1) % n_ != 0) return true;
+    return RobotProc::canAcceptData();
+}
+
+Result SampleProc::write(const base::Blob& blob)
+{
+    if (mode_ == RESERVOIR)
+    {
+        keep(blob);
+        return true;
+    }
+
+    // Only count the blob once the output takes it, so it is retried
+    if ((seen_ + 1) % n_ == 0 && (!output_ || !forward(blob))) return false;
+    ++seen_;
+    return true;
+}
+
+int SampleProc::write(const std::vector<base::Blob>& blobs)
+{
+    if (mode_ == RESERVOIR)
+    {
+        for (const Blob& blob : blobs)
+        {
+            keep(blob);
+        }
+        return blobs.size();
+    }
+
+    // Pick every Nth blob, then pass them on together
+    picked_.clear();
+    size_t offset = n_ - 1 - seen_ % n_;
+    for (size_t idx = offset; idx < blobs.size(); idx += n_)
+    {
+        picked_.push_back(blobs[idx]);
+    }
+    if (picked_.empty())
+    {
+        seen_ += blobs.size();
+        return blobs.size();
+    }
+
+    int written = output_ ? forward(picked_, picked_.size()) : 0;
+    // Blobs up to the first picked one that the output did not take are consumed
+    size_t consumed = written == (int)picked_.size() ? blobs.size() : offset + written * n_;
+    seen_ += consumed;
+    return consumed;
+}
+
+// -------------------------------------
+
+BurstProc::BurstProc(double speed, int maxSize)
+: base::BaseProc(0, 0)
+, maxSize_(maxSize < 0 ? ~(size_t)0 : maxSize)
+, speed_(speed)
+, replaying_(false)
+, firstCaptured_(0)
+{
+}
+
+void BurstProc::setSpeed(double speed)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    speed_ = speed;
+    replaying_ = false;
+}
+
+BurstProc::Clock::time_point BurstProc::due()
+{
+    const Stamped& front = queue_.front();
+    if (!replaying_)
+    {
+        replaying_ = true;
+        start_ = Clock::now();
+        firstCaptured_ = front.captured;
+    }
+    if (speed_ <= 0.0) return start_;
+
+    double offset = (front.captured - firstCaptured_).count() / speed_;
+    return start_ + std::chrono::nanoseconds((int64_t)offset);
+}
+
+Result BurstProc::read(base::TObject& object)
+{
+    return false;
+}
+
+Result BurstProc::read(base::Result& result)
+{
+    return false;
+}
+
+Result BurstProc::read(base::Blob& blob)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.empty()) return false;
+    Clock::time_point frontDue = due();
+    if (frontDue > Clock::now()) return false;
+
+    blob = std::move(queue_.front().blob);
+    queue_.pop_front();
+    return true;
+}
+
+bool BurstProc::hasData()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.empty()) return false;
+    Clock::time_point frontDue = due();
+    return frontDue <= Clock::now();
+}
+
+bool BurstProc::hasObject(base::ProductType productType)
+{
+    return productType == ProductType::BLOB && hasData();
+}
+
+bool BurstProc::waitForData(const base::Deadline& deadline)
+{
+    while (true)
+    {
+        // Wait for a write if empty, otherwise until the front blob is due
+        Deadline until = deadline;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!queue_.empty())
+            {
+                Clock::time_point frontDue = due();
+                if (frontDue <= Clock::now()) return true;
+                until = std::min(until, frontDue);
+            }
+        }
+        if (Clock::now() >= deadline) return false;
+        signal_.waitUntil(until, [this] { return hasData(); });
+    }
+}
+
+bool BurstProc::canAcceptData()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() < maxSize_;
+}
+
+Result BurstProc::write(const base::TObject& object)
+{
+    return false;
+}
+
+Result BurstProc::write(const base::Result& result)
+{
+    return false;
+}
+
+Result BurstProc::write(const base::Blob& blob)
+{
+    return write(blob, Clock::now().time_since_epoch());
+}
+
+Result BurstProc::write(const base::Blob& blob, std::chrono::nanoseconds captured)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.size() >= maxSize_) return false;
+
+        queue_.push_back(Stamped{ captured, blob });
+    }
+    signal_.notify();
+    return true;
+}
+
+int BurstProc::write(const std::vector<base::Blob>& blobs)
+{
+    std::chrono::nanoseconds captured = Clock::now().time_since_epoch();
+    size_t written = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const Blob& blob : blobs)
+        {
+            if (queue_.size() >= maxSize_) break;
+            queue_.push_back(Stamped{ captured, blob });
+            ++written;
+        }
+    }
+    if (written > 0) signal_.notify();
+    return written;
+}
@@ -0,0 +1,236 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "base/blob.h"
+#include "base/proc.h"
+
+namespace aft
+{
+namespace core
+{
+
+/**
+ *  Robots manipulate a stream from the outside: they throttle it, sample it or
+ *  change its timing.
+ *
+ *  RobotProc is the base of the robots that pass the blobs written to them straight
+ *  on to an output, without queueing them.  They are written by one thread at a time,
+ *  such as a Pipeline edge.
+ */
+class RobotProc : public aft::base::BaseProc
+{
+public:
+    /** Construct a robot that passes blobs to output, which it does not own. */
+    RobotProc(base::ConsumerContract* output = nullptr);
+    virtual ~RobotProc();
+
+    /** Set the consumer that blobs are passed to. */
+    void setOutput(base::ConsumerContract* output);
+    base::ConsumerContract* getOutput() const;
+
+    /** Get the number of blobs written to this robot. */
+    unsigned long getSeen() const;
+    /** Get the counts of blobs passed to the output, and those it refused. */
+    base::EdgeCounters getCounters() const;
+
+    // Consumer contract
+    /** Returns true if there is an output and it can accept data. */
+    virtual bool canAcceptData();
+
+    using base::BaseProc::write;
+    virtual base::Result write(const base::TObject& object);
+    virtual base::Result write(const base::Result& result);
+
+protected:
+    /** Pass a blob to the output and count it. */
+    bool forward(const base::Blob& blob);
+    /** Pass the first count blobs to the output as one batch and count them.
+     *  @return the number of blobs the output took
+     */
+    int forward(const std::vector<base::Blob>& blobs, size_t count);
+
+    base::ConsumerContract* output_;
+    unsigned long seen_;
+    base::EdgeCounter counter_;
+};
+
+/**
+ *  A robot that limits the rate of blobs passed to its output with a token bucket.
+ *
+ *  The bucket fills at the rate and holds up to a burst of blobs, timed to the
+ *  nanosecond.  When it is empty canAcceptData() is false and writes are not taken,
+ *  so the writer is held back rather than blobs being dropped.
+ */
+class ThrottleProc : public RobotProc
+{
+public:
+    /** Construct a throttle.
+     *  @param ratePerSecond Blobs passed per second.  Zero does not limit the rate.
+     *  @param burst Most blobs passed at once after the robot has been idle.
+     *  @param output Consumer that blobs are passed to.
+     */
+    ThrottleProc(unsigned long ratePerSecond, unsigned long burst = 1,
+                 base::ConsumerContract* output = nullptr);
+
+    /** Change the rate and burst.  The bucket starts full. */
+    void setRate(unsigned long ratePerSecond, unsigned long burst = 1);
+    /** Get the number of blobs that can be passed now. */
+    unsigned long available();
+
+    virtual bool canAcceptData();
+    virtual base::Result write(const base::Blob& blob);
+    /** Pass as many blobs as there are tokens for in one batch. */
+    virtual int write(const std::vector<base::Blob>& blobs);
+
+private:
+    /** Add the tokens earned since the last refill. */
+    void refill();
+
+    unsigned long rate_;
+    // Tokens are kept in units of one nanosecond at the rate, so refills are exact
+    uint64_t capacity_;
+    uint64_t credit_;
+    std::chrono::steady_clock::time_point last_;
+};
+
+/**
+ *  A robot that passes a sample of its blobs to its output.
+ *
+ *  ONE_IN_N passes every Nth blob and drops the rest.  RESERVOIR keeps N blobs
+ *  picked uniformly at random from all blobs written so far, for getSamples().
+ */
+class SampleProc : public RobotProc
+{
+public:
+    enum Mode
+    {
+        ONE_IN_N,           ///< Pass every Nth blob to the output
+        RESERVOIR           ///< Keep a random sample of N blobs
+    };
+
+    /** Construct a sampler.
+     *  @param mode How blobs are sampled.
+     *  @param n Sampling interval or reservoir size.  Zero is taken as one.
+     *  @param output Consumer that ONE_IN_N blobs are passed to.
+     *  @param seed Seed for picking RESERVOIR samples.
+     */
+    SampleProc(Mode mode, unsigned long n, base::ConsumerContract* output = nullptr,
+               unsigned long seed = std::mt19937_64::default_seed);
+
+    /** Get the blobs kept in the reservoir.  Empty in ONE_IN_N mode. */
+    const std::vector<base::Blob>& getSamples() const;
+
+    /** Returns true if the next blob is dropped or kept, or the output can accept it. */
+    virtual bool canAcceptData();
+    virtual base::Result write(const base::Blob& blob);
+    /** Sample the blobs and pass the picked ones to the output in one batch. */
+    virtual int write(const std::vector<base::Blob>& blobs);
+
+private:
+    /** Get a random number in (0, 1]. */
+    double uniform();
+    /** Keep the blob if it is picked for the reservoir. */
+    void keep(const base::Blob& blob);
+    /** Work out which blob replaces a sample next. */
+    void skipAhead();
+
+    Mode mode_;
+    unsigned long n_;
+    std::vector<base::Blob> samples_;
+    std::vector<base::Blob> picked_;
+    std::mt19937_64 random_;
+    double weight_;
+    unsigned long next_;
+};
+
+/**
+ *  A proc that replays blobs with their original spacing, sped up by a factor.
+ *
+ *  Blobs written are stamped with the time they arrive, or with a given capture
+ *  time.  Reading starts the replay clock, and each blob can only be read once its
+ *  time, divided by the speed, has passed.  A speed of 0 replays them as fast as
+ *  they are read.  Unlike the other robots it queues blobs, so it can be written
+ *  and read by different threads.
+ */
+class BurstProc : public aft::base::BaseProc
+{
+public:
+    /** Construct a BurstProc.
+     *  @param speed How many times faster than captured to replay.
+     *  @param maxSize Most blobs that can be queued, or -1 for no limit.
+     */
+    BurstProc(double speed = 1.0, int maxSize = -1);
+
+    /** Change the replay speed.  The replay clock restarts from the next blob. */
+    void setSpeed(double speed);
+
+    // Producer contract
+    virtual base::Result read(base::TObject& object);
+    virtual base::Result read(base::Result& result);
+    /** Read the next blob if it is due. */
+    virtual base::Result read(base::Blob& blob);
+    /** Returns true if the next blob is due. */
+    virtual bool hasData();
+    virtual bool hasObject(base::ProductType productType);
+    /** Wait until the next blob is due or until the deadline. */
+    virtual bool waitForData(const base::Deadline& deadline);
+
+    // Consumer contract
+    virtual bool canAcceptData();
+
+    virtual base::Result write(const base::TObject& object);
+    virtual base::Result write(const base::Result& result);
+    /** Queue a blob stamped with the time it arrives. */
+    virtual base::Result write(const base::Blob& blob);
+    /** Queue a blob captured at a given time.  Times are relative to any start, but
+     *  must not go backwards.
+     */
+    base::Result write(const base::Blob& blob, std::chrono::nanoseconds captured);
+    /** Queue blobs that all arrive now. */
+    virtual int write(const std::vector<base::Blob>& blobs);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    /** Get when the front blob is due.  The caller holds the lock. */
+    Clock::time_point due();
+
+    struct Stamped
+    {
+        std::chrono::nanoseconds captured;
+        base::Blob blob;
+    };
+
+    std::mutex mutex_;
+    std::deque<Stamped> queue_;
+    size_t maxSize_;
+    double speed_;
+    bool replaying_;
+    Clock::time_point start_;               // When the replay clock started
+    std::chrono::nanoseconds firstCaptured_; // Capture time at the replay start
+    base::DataSignal signal_;
+};
+
+} // namespace core
+} // namespace aft
@@ -14,6 +14,9 @@
  *   limitations under the License.
  */
 
+#include <string>
+#include <vector>
+
 #include "base/consumer.h"
 #include "base/producer.h"
 #include "base/result.h"
@@ -56,6 +59,25 @@ RunContext::RunContext(const std::string& name, TestCase* testCase)
                 &impl_.propHandler);
 }
 
+RunContext::RunContext(const base::Context& parent, const std::string& name,
+                       TestCase* testCase)
+    : base::Context(parent.getVisitor(), name)
+    , impl_(*new RunContextImpl(testCase)) {
+    addProperty(base::PropertyHandler::handlerTypeName(base::HandlerType::Run),
+                &impl_.propHandler);
+
+    setCancelToken(parent.getCancelToken());
+
+    std::vector<std::string> names;
+    parent.getEnvironment().getPropertyNames(names);
+    for (const auto& envName : names) {
+        std::string value;
+        if (parent.getEnv(envName, value)) {
+            setEnv(envName, value);
+        }
+    }
+}
+
 RunContext::~RunContext() {
     delete &impl_;
 }
@@ -32,6 +32,13 @@ class TestCase;
 class RunContext : public aft::base::Context {
 public:
     RunContext(const std::string& name, TestCase* testCase);
+    /** Construct a context for running test cases beside parent, i.e., on a worker.
+     *
+     *  The new context shares the visitor and CancelToken of parent and starts with
+     *  a copy of its environment, but has its own RunPropertyHandler so outlets,
+     *  transports and the last result are not shared.
+     */
+    RunContext(const base::Context& parent, const std::string& name, TestCase* testCase);
     virtual ~RunContext();
     
     /** Get the singleton global RunContext.
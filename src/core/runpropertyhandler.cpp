@@ -81,6 +81,10 @@ void RunPropertyHandler::removeOutlet(const std::string& name) {
     impl_->testCase_->removeOutlet(name);
 }
 
+Outlet* RunPropertyHandler::resolveOutlet(const base::Entity& wanted) {
+    return impl_->testCase_->resolve(wanted);
+}
+
 void RunPropertyHandler::addConsumer(const std::string& name, base::ConsumerContract* consumer) {
     auto outlet = new Outlet(PrefixCons + name);
     outlet->plugin(consumer);
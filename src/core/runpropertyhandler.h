@@ -12,6 +12,7 @@ namespace aft {
 namespace base {
 // Forward reference
 class ConsumerContract;
+class Entity;
 class ProcContract;
 class ProducerContract;
 }
@@ -38,6 +39,10 @@ public:
     void addOutlet(const std::string& name, Outlet* outlet);
     Outlet* getOutlet(const std::string& name);
     void removeOutlet(const std::string& name);
+    /** Find the outlet that provides what a command wants, before it runs.
+     *  @return The outlet or nullptr if no outlet of the test case provides it.
+     */
+    Outlet* resolveOutlet(const base::Entity& wanted);
     
     void addConsumer(const std::string& name, base::ConsumerContract* consumer);
     void addProducer(const std::string& name, base::ProducerContract* producer);
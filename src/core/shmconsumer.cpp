@@ -0,0 +1,60 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/blob.h"
+#include "shmconsumer.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+
+ShmConsumer::ShmConsumer(const std::string& name, size_t capacity)
+: ring_(name, capacity) {
+
+}
+
+ShmConsumer::~ShmConsumer() {
+
+}
+
+bool ShmConsumer::isOpen() const {
+    return ring_.isOpen();
+}
+
+bool ShmConsumer::waitForRoom(const Blob& blob, const Deadline& deadline) {
+    return ring_.waitForRoom(blob.getName().size(), blob.getLength(), deadline);
+}
+
+bool ShmConsumer::canAcceptData() {
+    return ring_.hasRoom(0, 0);
+}
+
+Result ShmConsumer::write(const TObject& object) {
+    return false;
+}
+
+Result ShmConsumer::write(const Result& result) {
+    return false;
+}
+
+Result ShmConsumer::write(const Blob& blob) {
+    return ring_.push(blob);
+}
+
+int ShmConsumer::write(const std::vector<Blob>& blobs) {
+    if (!ring_.isOpen()) return -1;
+
+    return int(ring_.push(blobs.data(), blobs.size()));
+}
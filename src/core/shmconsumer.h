@@ -0,0 +1,59 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/consumer.h"
+#include "base/datasignal.h"
+#include "shmring.h"
+
+namespace aft {
+namespace core {
+
+/**
+ *  Consumer that writes blobs to a shared memory ring, which another process reads
+ *  with a ShmProducer or ShmProc.
+ *
+ *  Writes do not wait for room.  Use canAcceptData() or waitForRoom() first.
+ */
+class ShmConsumer : public base::BaseConsumer {
+public:
+    /** Construct a ShmConsumer
+     *  @param name Name of the ring
+     *  @param capacity Bytes the ring holds, if this end creates it
+     */
+    ShmConsumer(const std::string& name, size_t capacity = 1 << 20);
+    virtual ~ShmConsumer();
+
+    /** Check if the ring was opened */
+    bool isOpen() const;
+    /** Wait until there is room for a blob, or the deadline. */
+    bool waitForRoom(const base::Blob& blob, const base::Deadline& deadline);
+
+    /** Returns true if there is room for at least an empty blob */
+    virtual bool canAcceptData() override;
+    /** Not supported. */
+    virtual base::Result write(const base::TObject& object) override;
+    /** Not supported. */
+    virtual base::Result write(const base::Result& result) override;
+    virtual base::Result write(const base::Blob& blob) override;
+    /** Write as many blobs as there is room for, with one wakeup. */
+    virtual int write(const std::vector<base::Blob>& blobs) override;
+
+private:
+    ShmRing ring_;
+};
+
+} // namespace core
+} // namespace aft
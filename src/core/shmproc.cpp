@@ -0,0 +1,69 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/blob.h"
+#include "shmproc.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+
+ShmProc::ShmProc(const std::string& readName, const std::string& writeName, size_t capacity)
+: in_(readName, capacity)
+, out_(writeName, capacity) {
+
+}
+
+ShmProc::~ShmProc() {
+
+}
+
+bool ShmProc::isOpen() const {
+    return in_.isOpen() && out_.isOpen();
+}
+
+bool ShmProc::waitForRoom(const Blob& blob, const Deadline& deadline) {
+    return out_.waitForRoom(blob.getName().size(), blob.getLength(), deadline);
+}
+
+Result ShmProc::read(Blob& blob) {
+    return in_.pop(blob);
+}
+
+bool ShmProc::hasData() {
+    return in_.hasData();
+}
+
+bool ShmProc::hasObject(ProductType productType) {
+    return ProductType::BLOB == productType && in_.hasData();
+}
+
+bool ShmProc::waitForData(const Deadline& deadline) {
+    return in_.waitForData(deadline);
+}
+
+bool ShmProc::canAcceptData() {
+    return out_.hasRoom(0, 0);
+}
+
+Result ShmProc::write(const Blob& blob) {
+    return out_.push(blob);
+}
+
+int ShmProc::write(const std::vector<Blob>& blobs) {
+    if (!out_.isOpen()) return -1;
+
+    return int(out_.push(blobs.data(), blobs.size()));
+}
@@ -0,0 +1,66 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/proc.h"
+#include "shmring.h"
+
+namespace aft {
+namespace core {
+
+/**
+ *  Proc that reads blobs from one shared memory ring and writes them to another, so
+ *  two processes can talk both ways.  The other process swaps the ring names.
+ *
+ *  Blobs read reference their bytes in the ring.  Writes do not wait for room.
+ */
+class ShmProc : public base::BaseProc {
+public:
+    /** Construct a ShmProc
+     *  @param readName Name of the ring to read from
+     *  @param writeName Name of the ring to write to
+     *  @param capacity Bytes each ring holds, if this end creates it
+     */
+    ShmProc(const std::string& readName, const std::string& writeName,
+            size_t capacity = 1 << 20);
+    virtual ~ShmProc();
+
+    /** Check if both rings were opened */
+    bool isOpen() const;
+    /** Wait until there is room for a blob, or the deadline. */
+    bool waitForRoom(const base::Blob& blob, const base::Deadline& deadline);
+
+    using base::BaseProc::read;
+    using base::BaseProc::write;
+
+    // Producer contract
+    virtual base::Result read(base::Blob& blob) override;
+    virtual bool hasData() override;
+    virtual bool hasObject(base::ProductType productType) override;
+    virtual bool waitForData(const base::Deadline& deadline) override;
+
+    // Consumer contract
+    virtual bool canAcceptData() override;
+    virtual base::Result write(const base::Blob& blob) override;
+    /** Write as many blobs as there is room for, with one wakeup. */
+    virtual int write(const std::vector<base::Blob>& blobs) override;
+
+private:
+    ShmRing in_;
+    ShmRing out_;
+};
+
+} // namespace core
+} // namespace aft
@@ -0,0 +1,62 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/blob.h"
+#include "shmproducer.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+
+ShmProducer::ShmProducer(const std::string& name, size_t capacity)
+: ring_(name, capacity) {
+
+}
+
+ShmProducer::~ShmProducer() {
+
+}
+
+bool ShmProducer::isOpen() const {
+    return ring_.isOpen();
+}
+
+Result ShmProducer::read(TObject& object) {
+    return false;
+}
+
+Result ShmProducer::read(Result& result) {
+    return false;
+}
+
+Result ShmProducer::read(Blob& blob) {
+    return ring_.pop(blob);
+}
+
+bool ShmProducer::hasData() {
+    return ring_.hasData();
+}
+
+bool ShmProducer::hasObject(ProductType productType) {
+    return ProductType::BLOB == productType && ring_.hasData();
+}
+
+bool ShmProducer::waitForData(const Deadline& deadline) {
+    return ring_.waitForData(deadline);
+}
+
+int ShmProducer::watchData(const std::function<void()>& listener) {
+    return -1;
+}
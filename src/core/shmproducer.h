@@ -0,0 +1,58 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/producer.h"
+#include "shmring.h"
+
+namespace aft {
+namespace core {
+
+/**
+ *  Producer of the blobs another process writes to a shared memory ring with a
+ *  ShmConsumer or ShmProc.
+ *
+ *  Blobs reference their bytes in the ring instead of a copy.  See ShmRing.
+ */
+class ShmProducer : public base::BaseProducer {
+public:
+    /** Construct a ShmProducer
+     *  @param name Name of the ring
+     *  @param capacity Bytes the ring holds, if this end creates it
+     */
+    ShmProducer(const std::string& name, size_t capacity = 1 << 20);
+    virtual ~ShmProducer();
+
+    /** Check if the ring was opened */
+    bool isOpen() const;
+
+    /** Not supported. */
+    virtual base::Result read(base::TObject& object) override;
+    /** Not supported. */
+    virtual base::Result read(base::Result& result) override;
+    virtual base::Result read(base::Blob& blob) override;
+    virtual bool hasData() override;
+    virtual bool hasObject(base::ProductType productType) override;
+    /** Sleep until the writer wakes the ring, or the deadline. */
+    virtual bool waitForData(const base::Deadline& deadline) override;
+    /** Not supported, since writes come from another process.  Poll instead. */
+    virtual int watchData(const std::function<void()>& listener) override;
+
+private:
+    ShmRing ring_;
+};
+
+} // namespace core
+} // namespace aft
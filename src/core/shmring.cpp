@@ -0,0 +1,431 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+#include "base/blob.h"
+#include "shmring.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+namespace {
+const uint32_t Magic = 0x41465452;      // "AFTR"
+const uint32_t Version = 1;
+const size_t MinCapacity = 4096;
+// How long the end that did not create the ring waits for the creator to set it up
+const std::chrono::seconds AttachTimeout(1);
+// How often waits check again where there is no futex
+const std::chrono::microseconds PollInterval(100);
+
+/** Start of the shared memory.  The writer and reader indexes are on their own lines. */
+struct Header {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t capacity;
+    // Written by the writer
+    alignas(64) std::atomic<uint64_t> head;
+    std::atomic<uint32_t> dataSeq;
+    std::atomic<uint32_t> dataWaiters;
+    std::atomic<uint64_t> roomWanted;   // Room a waiting writer is woken for
+    // Written by the reader
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> roomSeq;
+    std::atomic<uint32_t> roomWaiters;
+};
+const size_t HeaderSize = (sizeof(Header) + 63) & ~size_t(63);
+
+/** What precedes the name and bytes of each blob in the ring. */
+struct Record {
+    enum State : uint32_t {
+        WRITTEN = 1,
+        RELEASED,       // The reader is done with it
+        SKIP            // Fills the end of the ring when a blob does not fit there
+    };
+    std::atomic<uint32_t> state;
+    uint32_t type;
+    uint32_t nameLength;
+    uint32_t length;
+};
+
+/** Records are aligned to their header, so there is always room for a SKIP record. */
+size_t recordSize(size_t nameLength, size_t dataLength) {
+    return (sizeof(Record) + nameLength + dataLength + sizeof(Record) - 1) &
+           ~(sizeof(Record) - 1);
+}
+
+/** Wake the other process if it sleeps on seq. */
+void wake(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters) {
+    seq.fetch_add(1);
+#ifdef __linux__
+    if (waiters.load() > 0) {
+        syscall(SYS_futex, &seq, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+#endif
+}
+
+/** Sleep until seq is no longer value, or the deadline. */
+void sleepOn(std::atomic<uint32_t>& seq, uint32_t value, const Deadline& deadline) {
+#ifdef __linux__
+    auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+    if (left <= 0) return;
+    struct timespec timeout = { time_t(left / 1000000000), long(left % 1000000000) };
+    // Not FUTEX_PRIVATE_FLAG, since the other process wakes it
+    syscall(SYS_futex, &seq, FUTEX_WAIT, value, &timeout, nullptr, 0);
+#else
+    std::this_thread::sleep_for(PollInterval);
+#endif
+}
+
+/** Wait until ready() or the deadline.  Counting the waiter before checking again
+ *  means the other side either sees the waiter or this sees what it did. */
+template <typename Ready>
+bool waitOn(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters,
+            const Deadline& deadline, Ready ready) {
+    while (!ready()) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        waiters.fetch_add(1);
+        uint32_t value = seq.load();
+        if (!ready()) {
+            sleepOn(seq, value, deadline);
+        }
+        waiters.fetch_sub(1);
+    }
+    return true;
+}
+
+/** One process's mapping of a ring.  Blobs read from the ring keep it mapped. */
+struct Mapping {
+    Mapping(void* base, size_t size)
+    : base(base)
+    , size(size)
+    , header(static_cast<Header*>(base))
+    , data(static_cast<char*>(base) + HeaderSize)
+    , mask(header->capacity - 1)
+    , readPos(0) { }
+    ~Mapping() {
+        munmap(base, size);
+    }
+
+    Record* at(uint64_t pos) {
+        return reinterpret_cast<Record*>(data + (pos & mask));
+    }
+
+    /** Give the writer the space of the records at the tail that the reader is done with. */
+    void reclaim() {
+        std::lock_guard<std::mutex> lock(reclaimLock);
+        uint64_t start = header->tail.load(std::memory_order_relaxed);
+        uint64_t end = readPos.load(std::memory_order_acquire);
+        uint64_t tail = start;
+        while (tail != end) {
+            Record* record = at(tail);
+            uint32_t state = record->state.load(std::memory_order_acquire);
+            if (Record::RELEASED != state && Record::SKIP != state) break;
+            tail += recordSize(record->nameLength, record->length);
+        }
+        if (tail != start) {
+            header->tail.store(tail);
+            // Wake a waiting writer when there is plenty of room, or when reading
+            // frees no more, rather than for every blob
+            uint64_t head = header->head.load();
+            if (header->roomWaiters.load() > 0 &&
+                (end == head || mask + 1 - (head - tail) >= header->roomWanted.load())) {
+                wake(header->roomSeq, header->roomWaiters);
+            }
+        }
+    }
+
+    void* base;
+    size_t size;
+    Header* header;
+    char* data;
+    uint64_t mask;
+    std::atomic<uint64_t> readPos;      // Records before it have been read
+    std::mutex reclaimLock;             // Blobs are released from any thread
+};
+
+/** Deleter of the blobs read from a ring, which releases their record. */
+struct Release {
+    std::shared_ptr<Mapping> mapping;
+
+    void operator()(const void* bytes) const {
+        Record* record = static_cast<Record*>(const_cast<void*>(bytes));
+        record->state.store(Record::RELEASED, std::memory_order_release);
+        mapping->reclaim();
+    }
+};
+} // namespace
+
+
+class aft::core::ShmRingImpl {
+public:
+    ShmRingImpl(const std::string& a_name)
+    : name(a_name.empty() || a_name[0] != '/' ? "/" + a_name : a_name)
+    , created(false)
+    , head(0)
+    , cachedTail(0)
+    , cachedHead(0)
+    , readPos(0) { }
+    ~ShmRingImpl() {
+        mapping.reset();
+        if (created) {
+            shm_unlink(name.c_str());
+        }
+    }
+
+    bool open(size_t capacity);
+
+    /** Check if bytes more fit after head, reading the tail again if needed. */
+    bool room(uint64_t head, uint64_t bytes) {
+        uint64_t capacity = mapping->mask + 1;
+        if (head + bytes - cachedTail <= capacity) return true;
+        cachedTail = mapping->header->tail.load();
+        return head + bytes - cachedTail <= capacity;
+    }
+
+    /** Largest record, which always fits once the reader catches up even after a SKIP */
+    uint64_t maxRecord() const {
+        return (mapping->mask + 1) / 2;
+    }
+
+    /** Size of the SKIP record needed before a record of size written at head */
+    uint64_t skipBefore(uint64_t head, uint64_t size) {
+        uint64_t left = mapping->mask + 1 - (head & mapping->mask);
+        return left < size ? left : 0;
+    }
+
+    /** Move past SKIP records.  @return true if a blob is next. */
+    bool skipToData() {
+        Mapping& m = *mapping;
+        for (;;) {
+            if (readPos == cachedHead) {
+                cachedHead = m.header->head.load();
+                if (readPos == cachedHead) return false;
+            }
+            Record* record = m.at(readPos);
+            if (Record::SKIP != record->state.load(std::memory_order_relaxed)) return true;
+            readPos += recordSize(0, record->length);
+            m.readPos.store(readPos, std::memory_order_release);
+        }
+    }
+
+    std::string name;
+    bool created;
+    std::shared_ptr<Mapping> mapping;
+    uint64_t head;          // Writer's copy of the head
+    uint64_t cachedTail;    // Tail when the writer last looked
+    uint64_t cachedHead;    // Head when the reader last looked
+    uint64_t readPos;       // Reader's copy of the read position
+};
+
+bool ShmRingImpl::open(size_t capacity) {
+    size_t size = MinCapacity;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        created = true;
+        if (ftruncate(fd, HeaderSize + size) != 0) {
+            close(fd);
+            return false;
+        }
+    } else if (EEXIST == errno) {
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) return false;
+        // The creator may not have sized it yet
+        auto deadline = std::chrono::steady_clock::now() + AttachTimeout;
+        struct stat st;
+        while (fstat(fd, &st) != 0 || size_t(st.st_size) <= HeaderSize) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                close(fd);
+                return false;
+            }
+            std::this_thread::sleep_for(PollInterval);
+        }
+        size = st.st_size - HeaderSize;
+    } else {
+        return false;
+    }
+
+    void* base = mmap(nullptr, HeaderSize + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == base) return false;
+
+    Header* header = static_cast<Header*>(base);
+    if (created) {
+        new (header) Header();
+        header->version = Version;
+        header->capacity = size;
+        header->magic.store(Magic, std::memory_order_release);
+    } else {
+        auto deadline = std::chrono::steady_clock::now() + AttachTimeout;
+        while (Magic != header->magic.load(std::memory_order_acquire)) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                munmap(base, HeaderSize + size);
+                return false;
+            }
+            std::this_thread::sleep_for(PollInterval);
+        }
+        if (Version != header->version || size != header->capacity) {
+            munmap(base, HeaderSize + size);
+            return false;
+        }
+    }
+
+    mapping = std::make_shared<Mapping>(base, HeaderSize + size);
+    head = header->head.load();
+    cachedTail = header->tail.load();
+    cachedHead = head;
+    readPos = cachedTail;
+    mapping->readPos = readPos;
+    return true;
+}
+
+
+ShmRing::ShmRing(const std::string& name, size_t capacity)
+: impl_(*new ShmRingImpl(name)) {
+    impl_.open(capacity);
+}
+
+ShmRing::~ShmRing() {
+    delete &impl_;
+}
+
+bool ShmRing::isOpen() const {
+    return impl_.mapping != nullptr;
+}
+
+size_t ShmRing::capacity() const {
+    return impl_.mapping ? impl_.mapping->mask + 1 : 0;
+}
+
+bool ShmRing::push(const Blob& blob) {
+    return push(&blob, 1) == 1;
+}
+
+size_t ShmRing::push(const Blob* blobs, size_t count) {
+    if (!impl_.mapping) return 0;
+
+    Mapping& m = *impl_.mapping;
+    uint64_t head = impl_.head;
+    size_t pushed = 0;
+    for (; pushed < count; ++pushed) {
+        const Blob& blob = blobs[pushed];
+        const std::string& name = blob.getName();
+        size_t length = blob.getLength();
+        uint64_t size = recordSize(name.size(), length);
+        uint64_t skip = impl_.skipBefore(head, size);
+        if (size > impl_.maxRecord() || !impl_.room(head, skip + size)) break;
+
+        if (skip > 0) {
+            Record* filler = m.at(head);
+            filler->type = 0;
+            filler->nameLength = 0;
+            filler->length = uint32_t(skip - sizeof(Record));
+            filler->state.store(Record::SKIP, std::memory_order_relaxed);
+            head += skip;
+        }
+        Record* record = m.at(head);
+        record->type = uint32_t(blob.getType());
+        record->nameLength = uint32_t(name.size());
+        record->length = uint32_t(length);
+        char* bytes = reinterpret_cast<char*>(record + 1);
+        memcpy(bytes, name.data(), name.size());
+        if (length > 0) {
+            memcpy(bytes + name.size(), blob.getBytes(), length);
+        }
+        record->state.store(Record::WRITTEN, std::memory_order_relaxed);
+        head += size;
+    }
+
+    if (pushed > 0) {
+        // Publishes the records, then one wakeup for the batch
+        impl_.head = head;
+        m.header->head.store(head);
+        wake(m.header->dataSeq, m.header->dataWaiters);
+    }
+    return pushed;
+}
+
+bool ShmRing::hasRoom(size_t nameLength, size_t dataLength) {
+    if (!impl_.mapping) return false;
+
+    uint64_t size = recordSize(nameLength, dataLength);
+    if (size > impl_.maxRecord()) return false;
+    return impl_.room(impl_.head, impl_.skipBefore(impl_.head, size) + size);
+}
+
+bool ShmRing::waitForRoom(size_t nameLength, size_t dataLength, const Deadline& deadline) {
+    if (!impl_.mapping || recordSize(nameLength, dataLength) > impl_.maxRecord()) {
+        return false;
+    }
+
+    // Wait for a quarter of the ring, so the writer is not woken for each blob read
+    Header* header = impl_.mapping->header;
+    uint64_t size = recordSize(nameLength, dataLength);
+    header->roomWanted.store(std::max(impl_.skipBefore(impl_.head, size) + size,
+                                      (impl_.mapping->mask + 1) / 4));
+    return waitOn(header->roomSeq, header->roomWaiters, deadline,
+                  [&]() { return hasRoom(nameLength, dataLength); });
+}
+
+bool ShmRing::pop(Blob& blob) {
+    if (!impl_.mapping || !impl_.skipToData()) return false;
+
+    Mapping& m = *impl_.mapping;
+    Record* record = m.at(impl_.readPos);
+    const char* bytes = reinterpret_cast<const char*>(record + 1);
+    std::shared_ptr<const void> owner(record, Release{ impl_.mapping });
+    blob = Blob(std::string(bytes, record->nameLength), Blob::Type(int32_t(record->type)),
+                std::move(owner), bytes + record->nameLength, record->length);
+    impl_.readPos += recordSize(record->nameLength, record->length);
+    m.readPos.store(impl_.readPos, std::memory_order_release);
+    return true;
+}
+
+bool ShmRing::hasData() {
+    return impl_.mapping && impl_.skipToData();
+}
+
+bool ShmRing::waitForData(const Deadline& deadline) {
+    if (!impl_.mapping) return false;
+
+    Header* header = impl_.mapping->header;
+    return waitOn(header->dataSeq, header->dataWaiters, deadline,
+                  [this]() { return hasData(); });
+}
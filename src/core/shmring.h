@@ -0,0 +1,89 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/datasignal.h"
+#include <string>
+
+namespace aft {
+namespace base {
+// Forward reference
+class Blob;
+}
+
+namespace core {
+// Forward reference
+class ShmRingImpl;
+
+/**
+ *  Ring of blobs in POSIX shared memory, written by one process and read by another.
+ *
+ *  Writing copies a blob's name and bytes into the ring once.  Reading returns a blob
+ *  that references its bytes in the ring, so they are not copied again.  The space of
+ *  a blob is reused once the reader and every copy or slice of the blob are done with
+ *  it, so readers that keep blobs must copy them or the ring fills up.  A blob with its
+ *  name takes at most half the capacity.
+ *  Waiting for data or space sleeps on a futex in the ring on Linux and polls elsewhere.
+ *
+ *  Whichever end opens the ring first creates it, and the creator removes its name
+ *  when closed.  Each end is used by one thread at a time.
+ */
+class ShmRing {
+public:
+    /** Open a ring, creating it if it does not exist.
+     *  @param name Name of the shared memory object, with or without a leading slash
+     *  @param capacity Bytes of blobs the ring holds if it is created.  It is rounded up
+     *                  to a power of two of at least 4096.
+     */
+    ShmRing(const std::string& name, size_t capacity = 1 << 20);
+    ~ShmRing();
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    /** Check if the ring was opened */
+    bool isOpen() const;
+    /** Capacity of the ring in bytes */
+    size_t capacity() const;
+
+    // Writer end
+    /** Copy a blob into the ring.
+     *  @return true if written, false if there is no room or the blob never fits.
+     */
+    bool push(const base::Blob& blob);
+    /** Copy as many blobs as there is room for, then wake the reader once.
+     *  @return the number of blobs written.
+     */
+    size_t push(const base::Blob* blobs, size_t count);
+    /** Check if there is room for a blob with the given name and data lengths. */
+    bool hasRoom(size_t nameLength, size_t dataLength);
+    /** Wait until there is room for a blob of a given size, or the deadline. */
+    bool waitForRoom(size_t nameLength, size_t dataLength, const base::Deadline& deadline);
+
+    // Reader end
+    /** Read the next blob, which references its bytes in the ring.
+     *  @return true if a blob was read.
+     */
+    bool pop(base::Blob& blob);
+    /** Check if there is a blob to read */
+    bool hasData();
+    /** Wait until there is a blob to read, or the deadline. */
+    bool waitForData(const base::Deadline& deadline);
+
+private:
+    ShmRingImpl& impl_;
+};
+
+} // namespace core
+} // namespace aft
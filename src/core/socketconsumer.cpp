@@ -0,0 +1,75 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/blob.h"
+#include "socketconsumer.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+
+SocketConsumer::SocketConsumer(const std::string& address, ParcelType parcelType)
+: stream_(SocketStream::connect(address), parcelType) {
+
+}
+
+SocketConsumer::SocketConsumer(int fd, ParcelType parcelType)
+: stream_(fd, parcelType) {
+
+}
+
+SocketConsumer::~SocketConsumer() {
+
+}
+
+bool SocketConsumer::isOpen() const {
+    return stream_.isOpen();
+}
+
+void SocketConsumer::setDelimiter(const std::string& delimiter) {
+    stream_.setDelimiter(delimiter);
+}
+
+void SocketConsumer::setLengthPrefixSize(size_t prefixSize) {
+    stream_.setLengthPrefixSize(prefixSize);
+}
+
+bool SocketConsumer::waitForRoom(const Deadline& deadline) {
+    return stream_.waitForRoom(deadline);
+}
+
+bool SocketConsumer::flush(const Deadline& deadline) {
+    return stream_.flush(deadline);
+}
+
+bool SocketConsumer::canAcceptData() {
+    return stream_.canAcceptData();
+}
+
+Result SocketConsumer::write(const TObject& object) {
+    return false;
+}
+
+Result SocketConsumer::write(const Result& result) {
+    return false;
+}
+
+Result SocketConsumer::write(const Blob& blob) {
+    return stream_.write(blob);
+}
+
+int SocketConsumer::write(const std::vector<Blob>& blobs) {
+    return int(stream_.write(blobs.data(), blobs.size()));
+}
@@ -0,0 +1,64 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/consumer.h"
+#include "socketstream.h"
+
+namespace aft {
+namespace core {
+
+/**
+ *  Consumer that frames blobs and sends them on a socket.
+ *
+ *  Writes do not block.  What the socket does not take at once is sent from the
+ *  SocketReactor thread, and writes are refused while too much is not sent yet.
+ *  See SocketStream for the framing.
+ */
+class SocketConsumer : public base::BaseConsumer {
+public:
+    /** Construct a SocketConsumer that connects to unix:<path> or tcp:<host>:<port>
+     *  @param parcelType How blobs are framed
+     */
+    SocketConsumer(const std::string& address,
+                   base::ParcelType parcelType = base::ParcelType::BLOB_LINE);
+    /** Construct a SocketConsumer that takes over a connected socket */
+    SocketConsumer(int fd, base::ParcelType parcelType = base::ParcelType::BLOB_LINE);
+    virtual ~SocketConsumer();
+
+    /** Check if the socket is still open */
+    bool isOpen() const;
+    void setDelimiter(const std::string& delimiter);
+    void setLengthPrefixSize(size_t prefixSize);
+    /** Wait until writes are not refused, or the deadline. */
+    bool waitForRoom(const base::Deadline& deadline);
+    /** Wait until everything written is sent, or the deadline. */
+    bool flush(const base::Deadline& deadline);
+
+    virtual bool canAcceptData() override;
+    /** Not supported. */
+    virtual base::Result write(const base::TObject& object) override;
+    /** Not supported. */
+    virtual base::Result write(const base::Result& result) override;
+    virtual base::Result write(const base::Blob& blob) override;
+    /** Send as many blobs as there is room for with one system call. */
+    virtual int write(const std::vector<base::Blob>& blobs) override;
+
+private:
+    SocketStream stream_;
+};
+
+} // namespace core
+} // namespace aft
@@ -0,0 +1,87 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/blob.h"
+#include "socketproc.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+
+SocketProc::SocketProc(const std::string& address, ParcelType parcelType)
+: stream_(SocketStream::connect(address), parcelType) {
+
+}
+
+SocketProc::SocketProc(int fd, ParcelType parcelType)
+: stream_(fd, parcelType) {
+
+}
+
+SocketProc::~SocketProc() {
+
+}
+
+bool SocketProc::isOpen() const {
+    return stream_.isOpen();
+}
+
+bool SocketProc::atEnd() {
+    return stream_.atEnd();
+}
+
+SocketStream& SocketProc::stream() {
+    return stream_;
+}
+
+bool SocketProc::flush(const Deadline& deadline) {
+    return stream_.flush(deadline);
+}
+
+Result SocketProc::read(Blob& blob) {
+    return stream_.read(blob);
+}
+
+bool SocketProc::hasData() {
+    return stream_.hasData();
+}
+
+bool SocketProc::hasObject(ProductType productType) {
+    return ProductType::BLOB == productType && stream_.hasData();
+}
+
+bool SocketProc::waitForData(const Deadline& deadline) {
+    return stream_.waitForData(deadline);
+}
+
+int SocketProc::watchData(const std::function<void()>& listener) {
+    return stream_.watchData(listener);
+}
+
+void SocketProc::unwatchData(int id) {
+    stream_.unwatchData(id);
+}
+
+bool SocketProc::canAcceptData() {
+    return stream_.canAcceptData();
+}
+
+Result SocketProc::write(const Blob& blob) {
+    return stream_.write(blob);
+}
+
+int SocketProc::write(const std::vector<Blob>& blobs) {
+    return int(stream_.write(blobs.data(), blobs.size()));
+}
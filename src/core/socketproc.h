@@ -0,0 +1,69 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/proc.h"
+#include "socketstream.h"
+
+namespace aft {
+namespace core {
+
+/**
+ *  Proc that reads blobs from a socket and writes blobs to the same socket, to emulate
+ *  a component at either end of a connection.  See SocketStream for the framing.
+ */
+class SocketProc : public base::BaseProc {
+public:
+    /** Construct a SocketProc that connects to unix:<path> or tcp:<host>:<port>
+     *  @param parcelType How bytes are split into blobs, and blobs are framed
+     */
+    SocketProc(const std::string& address,
+               base::ParcelType parcelType = base::ParcelType::BLOB_LINE);
+    /** Construct a SocketProc that takes over a connected socket */
+    SocketProc(int fd, base::ParcelType parcelType = base::ParcelType::BLOB_LINE);
+    virtual ~SocketProc();
+
+    /** Check if the socket is still open */
+    bool isOpen() const;
+    /** Check if the other end stopped sending and every blob has been read */
+    bool atEnd();
+    /** The stream, to set its framing */
+    SocketStream& stream();
+    /** Wait until everything written is sent, or the deadline. */
+    bool flush(const base::Deadline& deadline);
+
+    using base::BaseProc::read;
+    using base::BaseProc::write;
+
+    // Producer contract
+    virtual base::Result read(base::Blob& blob) override;
+    virtual bool hasData() override;
+    virtual bool hasObject(base::ProductType productType) override;
+    virtual bool waitForData(const base::Deadline& deadline) override;
+    virtual int watchData(const std::function<void()>& listener) override;
+    virtual void unwatchData(int id) override;
+
+    // Consumer contract
+    virtual bool canAcceptData() override;
+    virtual base::Result write(const base::Blob& blob) override;
+    /** Send as many blobs as there is room for with one system call. */
+    virtual int write(const std::vector<base::Blob>& blobs) override;
+
+private:
+    SocketStream stream_;
+};
+
+} // namespace core
+} // namespace aft
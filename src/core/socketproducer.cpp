@@ -0,0 +1,91 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/blob.h"
+#include "socketproducer.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+
+SocketProducer::SocketProducer(const std::string& address, ParcelType parcelType)
+: stream_(SocketStream::connect(address), parcelType) {
+
+}
+
+SocketProducer::SocketProducer(int fd, ParcelType parcelType)
+: stream_(fd, parcelType) {
+
+}
+
+SocketProducer::~SocketProducer() {
+
+}
+
+bool SocketProducer::isOpen() const {
+    return stream_.isOpen();
+}
+
+bool SocketProducer::atEnd() {
+    return stream_.atEnd();
+}
+
+void SocketProducer::setMaxLineLength(size_t maxLength) {
+    stream_.setMaxLength(maxLength);
+}
+
+void SocketProducer::setDelimiter(const std::string& delimiter) {
+    stream_.setDelimiter(delimiter);
+}
+
+void SocketProducer::setRecordSize(size_t recordSize) {
+    stream_.setRecordSize(recordSize);
+}
+
+void SocketProducer::setLengthPrefixSize(size_t prefixSize) {
+    stream_.setLengthPrefixSize(prefixSize);
+}
+
+Result SocketProducer::read(TObject& object) {
+    return false;
+}
+
+Result SocketProducer::read(Result& result) {
+    return false;
+}
+
+Result SocketProducer::read(Blob& blob) {
+    return stream_.read(blob);
+}
+
+bool SocketProducer::hasData() {
+    return stream_.hasData();
+}
+
+bool SocketProducer::hasObject(ProductType productType) {
+    return ProductType::BLOB == productType && stream_.hasData();
+}
+
+bool SocketProducer::waitForData(const Deadline& deadline) {
+    return stream_.waitForData(deadline);
+}
+
+int SocketProducer::watchData(const std::function<void()>& listener) {
+    return stream_.watchData(listener);
+}
+
+void SocketProducer::unwatchData(int id) {
+    stream_.unwatchData(id);
+}
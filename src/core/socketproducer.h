@@ -0,0 +1,68 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/producer.h"
+#include "socketstream.h"
+
+namespace aft {
+namespace core {
+
+/**
+ *  Producer of the blobs read from a socket.
+ *
+ *  The socket is read on the SocketReactor thread, which wakes waitForData() and calls
+ *  watchData() listeners when blobs arrive.  See SocketStream for the framing.
+ */
+class SocketProducer : public base::BaseProducer {
+public:
+    /** Construct a SocketProducer that connects to unix:<path> or tcp:<host>:<port>
+     *  @param parcelType How bytes are split into blobs
+     */
+    SocketProducer(const std::string& address,
+                   base::ParcelType parcelType = base::ParcelType::BLOB_LINE);
+    /** Construct a SocketProducer that takes over a connected socket */
+    SocketProducer(int fd, base::ParcelType parcelType = base::ParcelType::BLOB_LINE);
+    virtual ~SocketProducer();
+
+    /** Check if the socket is still open */
+    bool isOpen() const;
+    /** Check if the other end stopped sending and every blob has been read */
+    bool atEnd();
+
+    /** Limit the length of blobs, like FileProducer::setMaxLineLength() */
+    void setMaxLineLength(size_t maxLength);
+    void setDelimiter(const std::string& delimiter);
+    void setRecordSize(size_t recordSize);
+    void setLengthPrefixSize(size_t prefixSize);
+
+    /** Not supported. */
+    virtual base::Result read(base::TObject& object) override;
+    /** Not supported. */
+    virtual base::Result read(base::Result& result) override;
+    /** Read a blob, which references the buffer it was read into. */
+    virtual base::Result read(base::Blob& blob) override;
+    virtual bool hasData() override;
+    virtual bool hasObject(base::ProductType productType) override;
+    virtual bool waitForData(const base::Deadline& deadline) override;
+    virtual int watchData(const std::function<void()>& listener) override;
+    virtual void unwatchData(int id) override;
+
+private:
+    SocketStream stream_;
+};
+
+} // namespace core
+} // namespace aft
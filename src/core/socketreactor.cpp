@@ -0,0 +1,158 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <cerrno>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "core/logger.h"
+#include "socketreactor.h"
+
+using namespace aft::core;
+
+// Most events handled per epoll_wait
+static const int MaxEvents = 64;
+// Event data of the eventfd that stops the thread.  Sockets are numbered from 1.
+static const uint64_t StopId = 0;
+
+/**
+ *  The reactor thread dispatches events with dispatchLock held, which add() and remove()
+ *  take so remove() does not return while a handler runs.  Event data is a registration number
+ *  instead of the handler, so events already returned for a socket that was just
+ *  removed, or whose descriptor was reused, are dropped.
+ */
+class aft::core::SocketReactorImpl {
+public:
+    SocketReactorImpl()
+    : epollFd(epoll_create1(EPOLL_CLOEXEC))
+    , stopFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+    , nextId(StopId + 1) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = StopId;
+        if (epollFd < 0 || stopFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &event) != 0) {
+            aftlog << loglevel(Error) << "SocketReactor: cannot create epoll" << std::endl;
+            return;
+        }
+        thread = std::thread([this] { run(); });
+    }
+    ~SocketReactorImpl() {
+        if (thread.joinable()) {
+            uint64_t one = 1;
+            if (write(stopFd, &one, sizeof(one)) == sizeof(one)) {
+                thread.join();
+            } else {
+                thread.detach();
+            }
+        }
+        if (stopFd >= 0) close(stopFd);
+        if (epollFd >= 0) close(epollFd);
+    }
+
+    void run() {
+        struct epoll_event events[MaxEvents];
+        for (;;) {
+            int count = epoll_wait(epollFd, events, MaxEvents, -1);
+            if (count < 0) {
+                if (EINTR == errno) continue;
+                aftlog << loglevel(Error) << "SocketReactor: epoll_wait failed" << std::endl;
+                return;
+            }
+
+            std::lock_guard<std::recursive_mutex> lock(dispatchLock);
+            for (int idx = 0; idx < count; ++idx) {
+                if (StopId == events[idx].data.u64) return;
+
+                auto it = handlers.find(events[idx].data.u64);
+                if (it != handlers.end()) {
+                    it->second->handleEvents(events[idx].events);
+                }
+            }
+        }
+    }
+
+    int epollFd;
+    int stopFd;
+    std::thread thread;
+    std::recursive_mutex dispatchLock;
+    std::unordered_map<uint64_t, SocketHandler*> handlers;     // By registration
+    std::mutex registryLock;    // Not held by handlers, so modify() never waits for one
+    std::unordered_map<int, uint64_t> registrations;            // By descriptor
+    uint64_t nextId;
+};
+
+
+SocketReactor::SocketReactor()
+: impl_(*new SocketReactorImpl) {
+
+}
+
+SocketReactor::~SocketReactor() {
+    delete &impl_;
+}
+
+SocketReactor* SocketReactor::instance() {
+    static SocketReactor reactor;
+    return &reactor;
+}
+
+bool SocketReactor::add(int fd, uint32_t events, SocketHandler* handler) {
+    if (fd < 0 || nullptr == handler) return false;
+
+    std::lock_guard<std::recursive_mutex> lock(impl_.dispatchLock);
+    std::lock_guard<std::mutex> registryLock(impl_.registryLock);
+    if (impl_.registrations.count(fd) > 0) return false;
+
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.u64 = impl_.nextId;
+    if (epoll_ctl(impl_.epollFd, EPOLL_CTL_ADD, fd, &event) != 0) return false;
+
+    impl_.handlers[impl_.nextId] = handler;
+    impl_.registrations[fd] = impl_.nextId++;
+    return true;
+}
+
+bool SocketReactor::modify(int fd, uint32_t events) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(impl_.registryLock);
+        auto it = impl_.registrations.find(fd);
+        if (it == impl_.registrations.end()) return false;
+        id = it->second;
+    }
+
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.u64 = id;
+    return epoll_ctl(impl_.epollFd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void SocketReactor::remove(int fd) {
+    std::lock_guard<std::recursive_mutex> lock(impl_.dispatchLock);
+    std::lock_guard<std::mutex> registryLock(impl_.registryLock);
+    auto it = impl_.registrations.find(fd);
+    if (it == impl_.registrations.end()) return;
+
+    epoll_ctl(impl_.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    impl_.handlers.erase(it->second);
+    impl_.registrations.erase(it);
+}
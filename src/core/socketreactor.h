@@ -0,0 +1,66 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <cstdint>
+
+namespace aft {
+namespace core {
+// Forward reference
+class SocketReactorImpl;
+
+/**
+ *  Interface of what handles the events of a socket registered with the SocketReactor.
+ */
+class SocketHandler {
+public:
+    virtual ~SocketHandler() = default;
+
+    /** Handle epoll events on the reactor thread.  It must not block. */
+    virtual void handleEvents(uint32_t events) = 0;
+};
+
+/**
+ *  One thread that waits on epoll for the events of all sockets and calls their handlers.
+ *
+ *  Sockets are level triggered, so a handler that leaves data unread is called again.
+ *  Handlers can add, change and remove sockets, their own included.
+ */
+class SocketReactor {
+public:
+    /** Get the reactor, starting its thread the first time. */
+    static SocketReactor* instance();
+
+    /** Register a socket.
+     *  @param events epoll events to wait for, such as EPOLLIN
+     *  @return true if added.
+     */
+    bool add(int fd, uint32_t events, SocketHandler* handler);
+    /** Change the events to wait for.  It does not wait for a handler that is running. */
+    bool modify(int fd, uint32_t events);
+    /** Unregister a socket.  Once this returns its handler is not running and is not
+     *  called again, so it can be deleted.
+     */
+    void remove(int fd);
+
+private:
+    SocketReactor();
+    ~SocketReactor();
+
+    SocketReactorImpl& impl_;
+};
+
+} // namespace core
+} // namespace aft
@@ -0,0 +1,795 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "base/blob.h"
+#include "core/logger.h"
+#include "socketreactor.h"
+#include "socketstream.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+namespace {
+// Size of the pooled read buffers
+const size_t BufferSize = 64 * 1024;
+// Most buffers kept in the pool
+const size_t MaxPooled = 256;
+// Bytes read but not taken before reading pauses
+const size_t MaxQueued = 4 << 20;
+// Bytes written but not sent before writes are refused
+const size_t MaxPending = 4 << 20;
+// Reads per event, so one busy socket does not starve the others
+const int MaxReadsPerEvent = 16;
+// Most blobs and framing sent with one system call
+const size_t MaxIovecs = 64;
+
+// The same separators as FileProducer
+const char* WordSeparators = " \t\n\r;:()/#*";
+
+bool isSeparator(char ch) {
+    return '\0' != ch && nullptr != strchr(WordSeparators, ch);
+}
+
+/**
+ *  Read buffers that are reused once no blob references them.  It lives until the
+ *  process exits, since blobs can outlive every stream.
+ */
+class BufferPool {
+public:
+    static BufferPool& instance() {
+        static BufferPool* pool = new BufferPool;
+        return *pool;
+    }
+
+    /** Get a buffer of at least size bytes.  Larger ones than BufferSize are not pooled. */
+    std::shared_ptr<char> acquire(size_t size) {
+        if (size > BufferSize) {
+            return std::shared_ptr<char>(new char[size], std::default_delete<char[]>());
+        }
+
+        char* buffer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (!free_.empty()) {
+                buffer = free_.back();
+                free_.pop_back();
+            }
+        }
+        if (nullptr == buffer) {
+            buffer = new char[BufferSize];
+        }
+        return std::shared_ptr<char>(buffer, [this](char* released) { release(released); });
+    }
+
+private:
+    void release(char* buffer) {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (free_.size() < MaxPooled) {
+            free_.push_back(buffer);
+        } else {
+            delete[] buffer;
+        }
+    }
+
+    std::mutex lock_;
+    std::vector<char*> free_;
+};
+
+/** Where the next frame is in the unread bytes. */
+struct Frame {
+    size_t offset;      // Of the blob in the bytes
+    size_t length;      // Of the blob
+    size_t consumed;    // Bytes to move past, with any framing
+    bool found;         // If not, only consumed bytes are skipped
+};
+
+/** Parse unix:<path> or tcp:<host>:<port> into a socket address. */
+bool resolve(const std::string& address, struct sockaddr_storage& storage, socklen_t& length,
+             bool passive) {
+    memset(&storage, 0, sizeof(storage));
+    if (address.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un* local = reinterpret_cast<struct sockaddr_un*>(&storage);
+        std::string path = address.substr(5);
+        if (path.empty() || path.size() >= sizeof(local->sun_path)) return false;
+
+        local->sun_family = AF_UNIX;
+        memcpy(local->sun_path, path.c_str(), path.size() + 1);
+        length = sizeof(struct sockaddr_un);
+        return true;
+    }
+    if (address.compare(0, 4, "tcp:") != 0) return false;
+
+    size_t colon = address.rfind(':');
+    if (colon < 4) return false;
+    std::string host = address.substr(4, colon - 4);
+    std::string port = address.substr(colon + 1);
+    if (host.size() > 1 && '[' == host.front() && ']' == host.back()) {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | (passive ? AI_PASSIVE : 0);
+    struct addrinfo* found = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0) {
+        return false;
+    }
+    memcpy(&storage, found->ai_addr, found->ai_addrlen);
+    length = found->ai_addrlen;
+    freeaddrinfo(found);
+    return true;
+}
+
+/** Make a socket for an address, without Nagle's delay for TCP. */
+int openSocket(const struct sockaddr_storage& storage) {
+    int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && AF_UNIX != storage.ss_family) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+} // namespace
+
+
+class aft::core::SocketStreamImpl : public SocketHandler {
+public:
+    SocketStreamImpl(int a_fd, ParcelType a_parcelType)
+    : fd(a_fd)
+    , parcelType(a_parcelType)
+    , maxLength(std::string::npos)
+    , delimiter("\n")
+    , recordSize(1)
+    , prefixSize(4)
+    , suffixBlob("")
+    , scanned(0)
+    , capacity(0)
+    , begin(0)
+    , end(0)
+    , reading(false)
+    , readClosed(fd < 0)
+    , writeFailed(fd < 0)
+    , paused(false)
+    , registered(false)
+    , queuedBytes(0)
+    , pendingOffset(0)
+    , pendingBytes(0) {
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+        setSuffix();
+    }
+    virtual ~SocketStreamImpl() {
+        if (fd >= 0) {
+            SocketReactor::instance()->remove(fd);
+            close(fd);
+        }
+    }
+
+    /** Handle events on the reactor thread */
+    virtual void handleEvents(uint32_t events) override;
+
+    /** Register with the reactor if needed.  Not called with lock held. */
+    void attach() {
+        std::unique_lock<std::mutex> guard(lock);
+        if (registered || fd < 0 || (readClosed && (writeFailed || pending.empty()))) return;
+
+        registered = true;
+        uint32_t events = interest();
+        guard.unlock();
+        SocketReactor::instance()->add(fd, events, this);
+        // Changes made before it was added were not seen by the reactor
+        guard.lock();
+        update();
+    }
+
+    /** Events wanted now.  Called with lock held. */
+    uint32_t interest() const {
+        uint32_t events = 0;
+        if (reading && !readClosed && !paused) events |= EPOLLIN;
+        if (!pending.empty() && !writeFailed) events |= EPOLLOUT;
+        return events;
+    }
+
+    /** Tell the reactor the events wanted now.  Called with lock held, so the last
+     *  change made is the last one the reactor gets. */
+    void update() {
+        if (registered) {
+            SocketReactor::instance()->modify(fd, interest());
+        }
+    }
+
+    void readable(bool hangup);
+    bool scan(bool eof);
+    Frame nextFrame(const char* bytes, size_t available, bool eof);
+    Frame untilDelimiter(const char* bytes, size_t available, bool eof, const std::string& until);
+    size_t queue(const Blob* blobs, size_t count);
+    bool send();
+
+    /** Set what follows each blob written */
+    void setSuffix() {
+        std::string suffix;
+        switch (parcelType) {
+        case ParcelType::BLOB_WORD:         suffix = " ";       break;
+        case ParcelType::BLOB_LINE:         suffix = "\n";      break;
+        case ParcelType::BLOB_PARAGRAPH:    suffix = "\n\n";    break;
+        case ParcelType::BLOB_DELIMITED:    suffix = delimiter; break;
+        default:                                                break;
+        }
+        suffixBlob = Blob("", Blob::STRING, suffix);
+    }
+
+    int fd;
+
+    // Framing, which scan() uses with lock held
+    ParcelType parcelType;
+    size_t maxLength;
+    std::string delimiter;
+    size_t recordSize;
+    size_t prefixSize;
+    Blob suffixBlob;
+    size_t scanned;     // Unread bytes known not to hold the end of a record
+
+    // Read buffer, which only the reactor thread uses
+    std::shared_ptr<char> buffer;
+    size_t capacity;
+    size_t begin;       // First unread byte
+    size_t end;         // End of the bytes read
+
+    std::mutex lock;
+    std::atomic<bool> reading;
+    bool readClosed;
+    bool writeFailed;
+    bool paused;
+    bool registered;
+    std::deque<Blob> frames;
+    size_t queuedBytes;
+    std::deque<Blob> pending;   // Blobs and framing to send
+    size_t pendingOffset;       // Bytes of the first that were sent
+    size_t pendingBytes;
+
+    DataSignal dataSignal;
+    DataSignal roomSignal;
+};
+
+void SocketStreamImpl::handleEvents(uint32_t events) {
+    bool hangup = (events & (EPOLLHUP | EPOLLERR)) != 0;
+    bool sent = false;
+    if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+        std::lock_guard<std::mutex> guard(lock);
+        sent = send();
+    }
+    if ((events & EPOLLIN) || (hangup && reading)) {
+        readable(hangup);
+    }
+
+    bool detach = false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        // Hang ups are reported until the socket is removed, so remove it once it is
+        // not read and there is nothing to send.  Reading attaches it again.
+        if (hangup && (!reading || readClosed) && (writeFailed || pending.empty())) {
+            registered = false;
+            detach = true;
+        } else {
+            update();
+        }
+    }
+    if (detach) {
+        SocketReactor::instance()->remove(fd);
+    }
+    if (sent) {
+        roomSignal.notify();
+    }
+}
+
+void SocketStreamImpl::readable(bool hangup) {
+    bool added = false;
+    bool closed = false;
+    for (int reads = 0; reads < MaxReadsPerEvent; ++reads) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            // A socket that hung up is read to the end even while paused
+            if (readClosed || (paused && !hangup)) break;
+        }
+
+        // Make room after the unread bytes.  A buffer no blob references is reused.
+        if (end == capacity) {
+            size_t unread = end - begin;
+            if (buffer && buffer.use_count() == 1 && unread < capacity) {
+                memmove(buffer.get(), buffer.get() + begin, unread);
+            } else {
+                std::shared_ptr<char> larger = BufferPool::instance().acquire(
+                    std::max(BufferSize, unread * 2));
+                if (unread > 0) {
+                    memcpy(larger.get(), buffer.get() + begin, unread);
+                }
+                capacity = std::max(BufferSize, unread * 2);
+                buffer = larger;
+            }
+            begin = 0;
+            end = unread;
+        }
+
+        size_t room = capacity - end;
+        ssize_t count = ::read(fd, buffer.get() + end, room);
+        if (count < 0 && EINTR == errno) continue;
+        if (count < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) break;
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (count > 0) {
+            end += count;
+            added |= scan(false);
+            // A bad length prefix closes the stream
+            closed = readClosed;
+            if (closed || size_t(count) < room) break;
+        } else {
+            if (count < 0) {
+                aftlog << loglevel(Error) << "SocketStream: read failed: " << strerror(errno)
+                       << std::endl;
+            }
+            readClosed = true;
+            added |= scan(true);
+            closed = true;
+            break;
+        }
+    }
+    if (added || closed) {
+        dataSignal.notify();
+    }
+}
+
+bool SocketStreamImpl::scan(bool eof) {
+    bool added = false;
+    while (begin < end || eof) {
+        Frame frame = nextFrame(buffer.get() + begin, end - begin, eof);
+        if (frame.found) {
+            Blob::Type type = ParcelType::BLOB_LENGTH_PREFIXED == parcelType ||
+                              ParcelType::BLOB_FIXED_SIZE == parcelType ?
+                              Blob::RAWDATA : Blob::STRING;
+            frames.emplace_back("", type, buffer, buffer.get() + begin + frame.offset,
+                                frame.length);
+            queuedBytes += frame.length;
+            added = true;
+        }
+        if (0 == frame.consumed) break;
+        begin += frame.consumed;
+        scanned = 0;
+    }
+    if (queuedBytes >= MaxQueued) {
+        paused = true;
+    }
+    return added;
+}
+
+Frame SocketStreamImpl::nextFrame(const char* bytes, size_t available, bool eof) {
+    Frame none = { 0, 0, 0, false };
+    switch (parcelType) {
+    case ParcelType::BLOB_CHARACTER:
+        if (available < 1) return none;
+        return { 0, 1, 1, true };
+    case ParcelType::BLOB_FIXED_SIZE:
+        if (available >= recordSize) return { 0, recordSize, recordSize, true };
+        if (eof && available > 0) {
+            aftlog << loglevel(Error) << "SocketStream: ends with a partial record" << std::endl;
+            return { 0, 0, available, false };
+        }
+        return none;
+    case ParcelType::BLOB_WORD: {
+        size_t skip = 0;
+        while (skip < available && isSeparator(bytes[skip])) ++skip;
+        if (skip > 0) return { 0, 0, skip, false };
+        size_t length = scanned;
+        while (length < available && length < maxLength && !isSeparator(bytes[length])) {
+            ++length;
+        }
+        if (length < available || length == maxLength || (eof && length > 0)) {
+            return { 0, length, length, true };
+        }
+        scanned = length;
+        return none;
+    }
+    case ParcelType::BLOB_LINE:
+        return untilDelimiter(bytes, available, eof, "\n");
+    case ParcelType::BLOB_PARAGRAPH: {
+        size_t skip = 0;
+        while (skip < available && '\n' == bytes[skip]) ++skip;
+        if (skip > 0) return { 0, 0, skip, false };
+        return untilDelimiter(bytes, available, eof, "\n\n");
+    }
+    case ParcelType::BLOB_DELIMITED:
+        return untilDelimiter(bytes, available, eof, delimiter);
+    case ParcelType::BLOB_FILE:
+        if (eof && available > 0) return { 0, available, available, true };
+        return none;
+    case ParcelType::BLOB_LENGTH_PREFIXED: {
+        if (available < prefixSize) {
+            if (eof && available > 0) {
+                aftlog << loglevel(Error) << "SocketStream: ends with a partial record"
+                       << std::endl;
+                return { 0, 0, available, false };
+            }
+            return none;
+        }
+        uint64_t length = 0;
+        for (size_t idx = 0; idx < prefixSize; ++idx) {
+            length = (length << 8) | (unsigned char)bytes[idx];
+        }
+        if (length > maxLength) {
+            aftlog << loglevel(Error) << "SocketStream: has a record of " << length
+                   << " bytes" << std::endl;
+            readClosed = true;
+            return { 0, 0, available, false };
+        }
+        if (available - prefixSize >= length) {
+            return { prefixSize, size_t(length), prefixSize + size_t(length), true };
+        }
+        if (eof) {
+            aftlog << loglevel(Error) << "SocketStream: ends with a partial record" << std::endl;
+            return { 0, 0, available, false };
+        }
+        return none;
+    }
+    case ParcelType::RESULT:
+    case ParcelType::TOBJECT:
+        // Not supported, so the bytes are dropped
+        return { 0, 0, available, false };
+    }
+    return none;
+}
+
+Frame SocketStreamImpl::untilDelimiter(const char* bytes, size_t available, bool eof,
+                                       const std::string& until) {
+    // Start where the last scan stopped, less what could be the start of the delimiter
+    size_t from = scanned >= until.size() ? scanned - until.size() + 1 : 0;
+    const char* found = nullptr;
+    while (from + until.size() <= available) {
+        found = static_cast<const char*>(memchr(bytes + from, until[0], available - from));
+        if (nullptr == found || found + until.size() > bytes + available) {
+            found = nullptr;
+            break;
+        }
+        if (memcmp(found, until.data(), until.size()) == 0) break;
+        from = found - bytes + 1;
+        found = nullptr;
+    }
+
+    if (nullptr != found) {
+        size_t length = found - bytes;
+        if (length > maxLength) return { 0, maxLength, maxLength, true };
+        return { 0, length, length + until.size(), true };
+    }
+    if (available >= maxLength) return { 0, maxLength, maxLength, true };
+    if (eof && available > 0) return { 0, available, available, true };
+    scanned = available;
+    return { 0, 0, 0, false };
+}
+
+size_t SocketStreamImpl::queue(const Blob* blobs, size_t count) {
+    size_t queued = 0;
+    for (; queued < count && pendingBytes < MaxPending; ++queued) {
+        const Blob& blob = blobs[queued];
+        if (ParcelType::BLOB_LENGTH_PREFIXED == parcelType) {
+            std::string prefix(prefixSize, '\0');
+            uint64_t length = blob.getLength();
+            for (size_t idx = prefixSize; idx > 0; --idx) {
+                prefix[idx - 1] = char(length & 0xff);
+                length >>= 8;
+            }
+            pendingBytes += prefix.size();
+            pending.emplace_back("", Blob::RAWDATA, std::move(prefix));
+        }
+        if (blob.getLength() > 0) {
+            pendingBytes += blob.getLength();
+            pending.push_back(blob);
+        }
+        if (suffixBlob.getLength() > 0) {
+            pendingBytes += suffixBlob.getLength();
+            pending.push_back(suffixBlob);
+        }
+    }
+    return queued;
+}
+
+bool SocketStreamImpl::send() {
+    size_t before = pendingBytes;
+    while (!pending.empty() && !writeFailed) {
+        struct iovec iov[MaxIovecs];
+        size_t count = 0;
+        for (auto it = pending.begin(); it != pending.end() && count < MaxIovecs; ++it) {
+            size_t skip = 0 == count ? pendingOffset : 0;
+            iov[count].iov_base = const_cast<char*>(it->getBytes()) + skip;
+            iov[count].iov_len = it->getLength() - skip;
+            ++count;
+        }
+        struct msghdr message = {};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (EINTR == errno) continue;
+            if (EAGAIN == errno || EWOULDBLOCK == errno) break;
+            aftlog << loglevel(Error) << "SocketStream: send failed: " << strerror(errno)
+                   << std::endl;
+            writeFailed = true;
+            pending.clear();
+            pendingOffset = 0;
+            pendingBytes = 0;
+            break;
+        }
+
+        pendingBytes -= sent;
+        size_t left = sent;
+        while (left > 0) {
+            size_t rest = pending.front().getLength() - pendingOffset;
+            if (left < rest) {
+                pendingOffset += left;
+                break;
+            }
+            left -= rest;
+            pending.pop_front();
+            pendingOffset = 0;
+        }
+    }
+    return pendingBytes < before || writeFailed;
+}
+
+
+SocketStream::SocketStream(int fd, ParcelType parcelType)
+: impl_(*new SocketStreamImpl(fd, parcelType)) {
+
+}
+
+SocketStream::~SocketStream() {
+    delete &impl_;
+}
+
+int SocketStream::connect(const std::string& address) {
+    struct sockaddr_storage storage;
+    socklen_t length;
+    if (!resolve(address, storage, length, false)) {
+        aftlog << loglevel(Error) << "SocketStream: bad address " << address << std::endl;
+        return -1;
+    }
+
+    int fd = openSocket(storage);
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<struct sockaddr*>(&storage), length) != 0) {
+        aftlog << loglevel(Error) << "SocketStream: cannot connect to " << address << ": "
+               << strerror(errno) << std::endl;
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+bool SocketStream::isOpen() const {
+    std::lock_guard<std::mutex> guard(impl_.lock);
+    return !impl_.readClosed || !impl_.writeFailed;
+}
+
+bool SocketStream::atEnd() {
+    std::lock_guard<std::mutex> guard(impl_.lock);
+    return impl_.readClosed && impl_.frames.empty();
+}
+
+void SocketStream::setMaxLength(size_t maxLength) {
+    std::lock_guard<std::mutex> guard(impl_.lock);
+    impl_.maxLength = maxLength > 0 ? maxLength : std::string::npos;
+}
+
+void SocketStream::setDelimiter(const std::string& delimiter) {
+    std::lock_guard<std::mutex> guard(impl_.lock);
+    if (!delimiter.empty()) {
+        impl_.delimiter = delimiter;
+        impl_.scanned = 0;
+        impl_.setSuffix();
+    }
+}
+
+void SocketStream::setRecordSize(size_t recordSize) {
+    std::lock_guard<std::mutex> guard(impl_.lock);
+    if (recordSize > 0) impl_.recordSize = recordSize;
+}
+
+void SocketStream::setLengthPrefixSize(size_t prefixSize) {
+    std::lock_guard<std::mutex> guard(impl_.lock);
+    if (prefixSize > 0 && prefixSize <= sizeof(uint64_t)) impl_.prefixSize = prefixSize;
+}
+
+bool SocketStream::read(Blob& blob) {
+    if (!impl_.reading.exchange(true)) impl_.attach();
+
+    std::lock_guard<std::mutex> guard(impl_.lock);
+    if (impl_.frames.empty()) return false;
+
+    blob = std::move(impl_.frames.front());
+    impl_.frames.pop_front();
+    impl_.queuedBytes -= blob.getLength();
+    if (impl_.paused && impl_.queuedBytes < MaxQueued / 2) {
+        impl_.paused = false;
+        impl_.update();
+    }
+    return true;
+}
+
+bool SocketStream::hasData() {
+    if (!impl_.reading.exchange(true)) impl_.attach();
+
+    std::lock_guard<std::mutex> guard(impl_.lock);
+    return !impl_.frames.empty();
+}
+
+bool SocketStream::waitForData(const Deadline& deadline) {
+    // No need to wait once the other end stopped sending
+    impl_.dataSignal.waitUntil(deadline, [this] { return hasData() || atEnd(); });
+    return hasData();
+}
+
+int SocketStream::watchData(const std::function<void()>& listener) {
+    int id = impl_.dataSignal.addListener(listener);
+    if (!impl_.reading.exchange(true)) impl_.attach();
+    return id;
+}
+
+void SocketStream::unwatchData(int id) {
+    impl_.dataSignal.removeListener(id);
+}
+
+bool SocketStream::write(const Blob& blob) {
+    return write(&blob, 1) == 1;
+}
+
+size_t SocketStream::write(const Blob* blobs, size_t count) {
+    size_t queued;
+    bool attach;
+    {
+        std::lock_guard<std::mutex> guard(impl_.lock);
+        if (impl_.writeFailed) return 0;
+
+        queued = impl_.queue(blobs, count);
+        impl_.send();
+        attach = !impl_.registered && !impl_.pending.empty();
+        impl_.update();
+    }
+    if (attach) {
+        impl_.attach();
+    }
+    return queued;
+}
+
+bool SocketStream::canAcceptData() {
+    std::lock_guard<std::mutex> guard(impl_.lock);
+    return !impl_.writeFailed && impl_.pendingBytes < MaxPending;
+}
+
+bool SocketStream::waitForRoom(const Deadline& deadline) {
+    return impl_.roomSignal.waitUntil(deadline, [this] { return canAcceptData(); });
+}
+
+bool SocketStream::flush(const Deadline& deadline) {
+    return impl_.roomSignal.waitUntil(deadline, [this] {
+        std::lock_guard<std::mutex> guard(impl_.lock);
+        return impl_.pending.empty() && !impl_.writeFailed;
+    });
+}
+
+
+class aft::core::SocketListenerImpl {
+public:
+    SocketListenerImpl()
+    : fd(-1)
+    , tcp(false) { }
+
+    int fd;
+    bool tcp;
+    std::string address;
+    std::string path;   // Of a unix socket, removed when done
+};
+
+SocketListener::SocketListener(const std::string& address, int backlog)
+: impl_(*new SocketListenerImpl) {
+    struct sockaddr_storage storage;
+    socklen_t length;
+    if (!resolve(address, storage, length, true)) {
+        aftlog << loglevel(Error) << "SocketListener: bad address " << address << std::endl;
+        return;
+    }
+
+    int fd = openSocket(storage);
+    if (fd < 0) return;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&storage), length) != 0 ||
+        listen(fd, backlog) != 0) {
+        aftlog << loglevel(Error) << "SocketListener: cannot listen on " << address << ": "
+               << strerror(errno) << std::endl;
+        close(fd);
+        return;
+    }
+    impl_.fd = fd;
+    impl_.tcp = AF_UNIX != storage.ss_family;
+    impl_.address = address;
+
+    if (AF_UNIX == storage.ss_family) {
+        impl_.path = address.substr(5);
+    } else if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&storage), &length) == 0) {
+        // Report the port that was picked
+        in_port_t port = AF_INET == storage.ss_family ?
+            reinterpret_cast<struct sockaddr_in*>(&storage)->sin_port :
+            reinterpret_cast<struct sockaddr_in6*>(&storage)->sin6_port;
+        impl_.address = address.substr(0, address.rfind(':') + 1) + std::to_string(ntohs(port));
+    }
+}
+
+SocketListener::~SocketListener() {
+    if (impl_.fd >= 0) {
+        close(impl_.fd);
+        if (!impl_.path.empty()) {
+            unlink(impl_.path.c_str());
+        }
+    }
+    delete &impl_;
+}
+
+bool SocketListener::isOpen() const {
+    return impl_.fd >= 0;
+}
+
+const std::string& SocketListener::address() const {
+    return impl_.address;
+}
+
+int SocketListener::accept(const Deadline& deadline) {
+    if (impl_.fd < 0) return -1;
+
+    for (;;) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count();
+        struct pollfd waiting = { impl_.fd, POLLIN, 0 };
+        int ready = poll(&waiting, 1, int(std::max<long long>(left, 0)));
+        if (ready < 0 && EINTR == errno) continue;
+        if (ready <= 0) return -1;
+
+        int fd = accept4(impl_.fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0 || (EINTR != errno && EAGAIN != errno && ECONNABORTED != errno)) {
+            if (fd >= 0 && impl_.tcp) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+            return fd;
+        }
+    }
+}
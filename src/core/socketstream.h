@@ -0,0 +1,122 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "base/datasignal.h"
+#include "base/producttype.h"
+#include <functional>
+#include <string>
+
+namespace aft {
+namespace base {
+// Forward reference
+class Blob;
+}
+
+namespace core {
+// Forward references
+class SocketListenerImpl;
+class SocketStreamImpl;
+
+/**
+ *  A connected socket whose events are handled by the SocketReactor.
+ *
+ *  Bytes are read into pooled buffers and split into blobs the way FileProducer splits
+ *  a file for each ParcelType.  A blob references the buffer it was read into, which
+ *  returns to the pool with the last blob.  Blobs written are framed for the same
+ *  ParcelType: length prefixed, followed by the delimiter, or as they are.  What the
+ *  socket does not take at once is sent when it becomes writable.
+ *  Reading pauses while too many bytes are read but not taken, and writes are refused
+ *  while too many are not sent yet.
+ *
+ *  Reading starts with the first read, hasData, waitForData or watchData, so the
+ *  framing can be set before then.
+ */
+class SocketStream {
+public:
+    /** Take over a connected socket.
+     *  @param fd The socket, which is closed with the stream.  -1 makes a closed stream.
+     *  @param parcelType How bytes are split into blobs and blobs are framed
+     */
+    SocketStream(int fd, base::ParcelType parcelType);
+    ~SocketStream();
+    SocketStream(const SocketStream&) = delete;
+    SocketStream& operator=(const SocketStream&) = delete;
+
+    /** Connect to unix:<path> or tcp:<host>:<port>.
+     *  @return the socket, or -1 if it could not connect.
+     */
+    static int connect(const std::string& address);
+
+    /** Check if the socket can still be read or written */
+    bool isOpen() const;
+    /** Check if the other end stopped sending and every blob has been read */
+    bool atEnd();
+
+    /** Limit the length of lines, paragraphs, words and records, like FileProducer. */
+    void setMaxLength(size_t maxLength);
+    void setDelimiter(const std::string& delimiter);
+    void setRecordSize(size_t recordSize);
+    /** Set the size of the big-endian length before BLOB_LENGTH_PREFIXED records. */
+    void setLengthPrefixSize(size_t prefixSize);
+
+    bool read(base::Blob& blob);
+    bool hasData();
+    /** Wait until a blob is read or the deadline. */
+    bool waitForData(const base::Deadline& deadline);
+    /** Call a listener from the reactor thread whenever blobs are read. */
+    int watchData(const std::function<void()>& listener);
+    void unwatchData(int id);
+
+    /** Frame and send a blob.  @return false if too much is not sent yet or it failed. */
+    bool write(const base::Blob& blob);
+    /** Frame and send as many blobs as there is room for, with one system call. */
+    size_t write(const base::Blob* blobs, size_t count);
+    bool canAcceptData();
+    /** Wait until writes are not refused, or the deadline. */
+    bool waitForRoom(const base::Deadline& deadline);
+    /** Wait until everything written is sent, or the deadline. */
+    bool flush(const base::Deadline& deadline);
+
+private:
+    SocketStreamImpl& impl_;
+};
+
+/**
+ *  Socket that listens for connections, to make SocketStreams of.
+ */
+class SocketListener {
+public:
+    /** Listen on unix:<path> or tcp:<host>:<port>.  Port 0 picks a free port. */
+    SocketListener(const std::string& address, int backlog = 16);
+    /** Stop listening.  A unix socket's path is removed. */
+    ~SocketListener();
+    SocketListener(const SocketListener&) = delete;
+    SocketListener& operator=(const SocketListener&) = delete;
+
+    bool isOpen() const;
+    /** The address listened on, with the port that was picked */
+    const std::string& address() const;
+    /** Accept a connection.
+     *  @return the connected socket, or -1 if there was none by the deadline.
+     */
+    int accept(const base::Deadline& deadline);
+
+private:
+    SocketListenerImpl& impl_;
+};
+
+} // namespace core
+} // namespace aft
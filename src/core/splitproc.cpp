@@ -0,0 +1,166 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "base/blob.h"
+#include "splitproc.h"
+
+using namespace aft::base;
+using namespace aft::core;
+
+
+// Internal implementation class
+class aft::core::SplitProcImpl
+{
+public:
+    struct Output
+    {
+        Output(ConsumerContract* consumer)
+        : consumer(consumer)
+        {  }
+
+        ConsumerContract* consumer;
+        EdgeCounter counter;
+    };
+
+    typedef std::vector<std::unique_ptr<Output>> Outputs;
+
+    Outputs::iterator find(const ConsumerContract* consumer)
+    {
+        return std::find_if(outputs_.begin(), outputs_.end(),
+                            [consumer](const std::unique_ptr<Output>& output)
+                            { return output->consumer == consumer; });
+    }
+
+    bool roomForData() const
+    {
+        if (outputs_.empty()) return false;
+        for (const std::unique_ptr<Output>& output : outputs_)
+        {
+            if (!output->consumer->canAcceptData()) return false;
+        }
+        return true;
+    }
+
+    /** Write the same blob to every output.  The caller holds the lock. */
+    bool pushData(const Blob& blob)
+    {
+        bool taken = false;
+        for (std::unique_ptr<Output>& output : outputs_)
+        {
+            if (output->consumer->write(blob))
+            {
+                output->counter.passed(blob.getLength());
+                taken = true;
+            }
+            else
+            {
+                output->counter.refused();
+            }
+        }
+        return taken;
+    }
+
+    mutable std::mutex mutex_;
+    Outputs outputs_;
+};
+
+
+SplitProc::SplitProc()
+: base::BaseProc(0, 0)
+, impl_(*new SplitProcImpl)
+{
+}
+
+SplitProc::~SplitProc()
+{
+    delete &impl_;
+}
+
+bool SplitProc::addOutput(ConsumerContract* output)
+{
+    if (!output) return false;
+
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    if (impl_.find(output) != impl_.outputs_.end()) return false;
+
+    impl_.outputs_.emplace_back(new SplitProcImpl::Output(output));
+    return true;
+}
+
+bool SplitProc::removeOutput(ConsumerContract* output)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    SplitProcImpl::Outputs::iterator it = impl_.find(output);
+    if (it == impl_.outputs_.end()) return false;
+
+    impl_.outputs_.erase(it);
+    return true;
+}
+
+size_t SplitProc::numOutputs() const
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    return impl_.outputs_.size();
+}
+
+EdgeCounters SplitProc::getCounters(size_t output) const
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    if (output >= impl_.outputs_.size()) return EdgeCounters{ 0, 0, 0 };
+
+    return impl_.outputs_[output]->counter.get();
+}
+
+// Consumer contract
+bool SplitProc::canAcceptData()
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    return impl_.roomForData();
+}
+
+Result SplitProc::write(const base::TObject& object)
+{
+    return false;
+}
+
+Result SplitProc::write(const base::Result& result)
+{
+    return false;
+}
+
+Result SplitProc::write(const base::Blob& blob)
+{
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    return impl_.pushData(blob);
+}
+
+int SplitProc::write(const std::vector<base::Blob>& blobs)
+{
+    // Check for room before each blob so no output is skipped
+    std::lock_guard<std::mutex> lock(impl_.mutex_);
+    int written = 0;
+    for (const Blob& blob : blobs)
+    {
+        if (!impl_.roomForData() || !impl_.pushData(blob)) break;
+        ++written;
+    }
+    return written;
+}
@@ -0,0 +1,75 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "base/proc.h"
+
+namespace aft
+{
+namespace core
+{
+// Forward reference
+class SplitProcImpl;
+
+
+/**
+ *  A proc that writes each blob to all of its outputs.
+ *
+ *  The outputs get copies of the same Blob, which share its bytes, so a blob costs
+ *  the same memory however many outputs it goes to.  It only accepts data when every
+ *  output can, so the slowest output paces the writer.  A blob that an output does
+ *  not take anyway is counted as refused for that output.
+ */
+class SplitProc : public aft::base::BaseProc
+{
+public:
+    SplitProc();
+    virtual ~SplitProc();
+
+    /** Add an output.  Outputs can be added and removed while blobs are written.
+     *  @return false if the output is null or already added, otherwise true.
+     */
+    bool addOutput(base::ConsumerContract* output);
+    /** Remove an output.
+     *  @return false if the output was not added, otherwise true.
+     */
+    bool removeOutput(base::ConsumerContract* output);
+    /** Get the number of outputs. */
+    size_t numOutputs() const;
+    /** Get the counts of blobs written to an output, in the order they were added. */
+    base::EdgeCounters getCounters(size_t output) const;
+
+    // Consumer contract
+    /** Returns true if there is at least one output and all of them can accept data. */
+    virtual bool canAcceptData();
+
+    virtual base::Result write(const base::TObject& object);
+    virtual base::Result write(const base::Result& result);
+    /** Write a blob to all outputs.
+     *  @return true if at least one output took it.
+     */
+    virtual base::Result write(const base::Blob& blob);
+    /** Write blobs to all outputs, stopping when an output has no room.
+     *  @return the number of blobs written
+     */
+    virtual int write(const std::vector<base::Blob>& blobs);
+
+private:
+    SplitProcImpl& impl_;
+};
+
+} // namespace core
+} // namespace aft
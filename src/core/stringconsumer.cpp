@@ -35,6 +35,7 @@ public:
     virtual bool pushData(const TObject& object);
     virtual bool pushData(const Result& result);
     virtual bool pushData(const Blob& blob);
+    virtual size_t pushData(const Blob* blobs, size_t count);
 
     virtual bool roomForData() const;
     virtual bool roomForObject(ProductType productType) const;
@@ -80,6 +81,23 @@ bool StringWriterImpl::pushData(const Blob& blob)
     return true;
 }
 
+size_t StringWriterImpl::pushData(const Blob* blobs, size_t count)
+{
+    // Grow the string once for the whole batch
+    size_t length = buffer_.size();
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        length += blobs[idx].getString().size();
+    }
+    buffer_.reserve(length);
+
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        buffer_.append(blobs[idx].getString());
+    }
+    return count;
+}
+
 bool StringWriterImpl::roomForData() const
 {
     return true;
@@ -126,6 +144,10 @@ Result StringConsumer::write(const Blob& blob) {
     return writer_->pushData(blob);
 }
 
+int StringConsumer::write(const std::vector<Blob>& blobs) {
+    return writer_->pushData(blobs.data(), blobs.size());
+}
+
 void StringConsumer::clear() {
     writer_->buffer_.clear();
 }
@@ -58,6 +58,8 @@ public:
     virtual base::Result write(const aft::base::TObject& object);
     virtual base::Result write(const aft::base::Result& result);
     virtual base::Result write(const aft::base::Blob& blob);
+    /** Append all blobs, growing the string once. */
+    virtual int write(const std::vector<aft::base::Blob>& blobs);
 
     /** Clear the contents of the string. */
     void clear();
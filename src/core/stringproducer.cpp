@@ -105,10 +105,15 @@ public:
             case ParcelType::BLOB_FILE:
                 if (!contents_.empty())
                 {
-                    buffer_ = contents_;
+                    buffer_ = std::move(contents_);
+                    contents_.clear();
                     retval = true;
                 }
                 break;
+            case ParcelType::BLOB_PARAGRAPH:
+            case ParcelType::BLOB_DELIMITED:
+            case ParcelType::BLOB_LENGTH_PREFIXED:
+            case ParcelType::BLOB_FIXED_SIZE:
             case ParcelType::RESULT:
             case ParcelType::TOBJECT:
                 break;
@@ -116,8 +121,7 @@ public:
 
             if (retval)
             {
-                Blob retBlob("string", Blob::STRING, buffer_);
-                blob = retBlob;
+                blob = Blob("string", Blob::STRING, std::move(buffer_));
             }
 
             return retval;
@@ -33,6 +33,7 @@ using namespace aft::core;
 
 TestCase::TestCase(const std::string& name)
 : base::TObjectContainer(base::TObjectType::TypeTestCase, name)
+, serial_(false)
 {
     state_ = INITIAL;
 }
@@ -85,12 +86,23 @@ TestCase::close()
     }
 }
 
+void TestCase::setSerial(bool serial) {
+    serial_ = serial;
+}
+
+bool TestCase::isSerial() const {
+    return serial_;
+}
+
 bool TestCase::addOutlet(Outlet* a_outlet) {
     for (auto outlet : outlets_) {
         if (outlet->name() == a_outlet->name()) {
             return false;
         }
     }
+    if (!outletIndex_.add(a_outlet)) {
+        return false;
+    }
     outlets_.push_back(a_outlet);
     return true;
 }
@@ -107,6 +119,7 @@ Outlet* TestCase::getOutlet(const std::string& name) const {
 bool TestCase::removeOutlet(const std::string& name) {
     for (auto it = std::begin(outlets_); it != std::end(outlets_); ++it) {
         if ((*it)->name() == name) {
+            outletIndex_.remove(*it);
             outlets_.erase(it);
             return true;
         }
@@ -114,19 +127,39 @@ bool TestCase::removeOutlet(const std::string& name) {
     return false;
 }
 
-bool TestCase::serialize(base::Blob& blob) {
-    if (!base::TObject::serialize(blob)) {
+Outlet* TestCase::resolve(const base::Entity& wanted) const {
+    return outletIndex_.first(OutletIndex::Role::Provides, wanted);
+}
+
+bool TestCase::resolve(const Outlet::EntityList& wanted, OutletList& providers) const {
+    providers.clear();
+    for (const auto& entity : wanted) {
+        Outlet* outlet = resolve(entity);
+        if (nullptr == outlet) {
+            return false;
+        }
+        providers.push_back(outlet);
+    }
+    return true;
+}
+
+const OutletIndex& TestCase::getOutletIndex() const {
+    return outletIndex_;
+}
+
+bool TestCase::serializeTo(base::StructuredData& sd) {
+    if (!base::TObject::serializeMembers(sd)) {
         return false;
     }
 
-    base::StructuredData sd("TestCase", blob.getString());
+    if (serial_) {
+        sd.add("serial", 1);
+    }
 
+    // Outlets and commands are written straight into sd
     sd.addArray("outlets");
     for (auto outlet : outlets_) {
-        base::Blob outletBl("");
-        outlet->serialize(outletBl);
-        base::StructuredData sdOutlet("outlet", outletBl.getString());
-        sd.add("outlets.", sdOutlet);
+        sd.addObject("outlets.", *outlet);
     }
 
     sd.addArray("commands");
@@ -135,14 +168,11 @@ bool TestCase::serialize(base::Blob& blob) {
     for (it = cmds.begin(); it != cmds.end(); ++it) {
         TObject* tObj = (*it)->getValue();
         if (tObj) {
-            base::Blob cmdBlob("");
-            tObj->serialize(cmdBlob);
-            base::StructuredData sdcmd("command", cmdBlob.getString());
-            sd.add("commands.", sdcmd);
+            sd.addObject("commands.", *tObj);
         }
     }
 
-    return sd.serialize(blob);
+    return true;
 }
 
 bool TestCase::deserialize(const base::Blob& blob)
@@ -154,29 +184,34 @@ bool TestCase::deserialize(const base::Blob& blob)
     base::StructuredData sd("");
     if (!sd.deserialize(blob)) return false;
 
+    int serial = 0;
+    serial_ = sd.get("serial", serial) && serial != 0;
+
     // outlets
     std::vector<std::string> outletNames;
     if (sd.getArray("outlets", outletNames)) {
         for (const auto& oname : outletNames) {
-            outlets_.push_back(new Outlet(oname));
+            Outlet* outlet = new Outlet(oname);
+            if (!addOutlet(outlet)) {
+                delete outlet;
+            }
         }
     }
 
     // commands
-    std::vector<std::string> cmds;
+    std::vector<base::Blob> cmds;
     if (!sd.getArray("commands", cmds)) {
         return false;
     }
 
     const std::string category("Command");
     base::MecFactory* mec = base::MecFactory::instance();
-    std::vector<std::string>::const_iterator it;
+    std::vector<base::Blob>::const_iterator it;
     for (it = cmds.begin(); it != cmds.end(); ++it)
     {
         base::StructuredData sdParams("", *it);
         std::string cmdName = sdParams.get("name");
-        base::Blob params(cmdName, base::Blob::STRING, *it);
-        base::TObject* tobj = mec->construct(category, cmdName, &params);
+        base::TObject* tobj = mec->construct(category, cmdName, &*it);
         if (!tobj)
         {
             aftlog << loglevel(Error) << "Cannot construct object" << std::endl;
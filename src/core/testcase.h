@@ -16,6 +16,7 @@
  */
 
 #include "outlet.h"
+#include "outletindex.h"
 #include "base/tobject.h"
 #include <string>
 #include <vector>
@@ -68,18 +69,40 @@ public:
     /** Close the test case */
     void close();
 
+    /** Declare that this test case must not run beside other test cases,
+     *  e.g., because it uses a fixed port or device.  Serial test cases are
+     *  run on the calling thread when a test suite runs in parallel.
+     */
+    void setSerial(bool serial);
+    /** Whether this test case must run on its own. */
+    bool isSerial() const;
+
     bool addOutlet(Outlet* outlet);
     Outlet* getOutlet(const std::string& name) const;
     bool removeOutlet(const std::string& name);
 
+    /** Find the first outlet that provides what an entity wants.
+     *  @return The outlet or nullptr if no outlet provides it.
+     */
+    Outlet* resolve(const base::Entity& wanted) const;
+    /** Find an outlet providing each entity in a list, such as a command's requirements.
+     *  @param providers Set to the outlets found, one per wanted entity.
+     *  @return True if every entity is provided, otherwise false.
+     */
+    bool resolve(const Outlet::EntityList& wanted, OutletList& providers) const;
+    /** Index of the outlets in this test case */
+    const OutletIndex& getOutletIndex() const;
+
     //TODO Branch(true, false, exception)
 
     // implement SerializeContract interface
-    virtual bool serialize(base::Blob& blob) override;
     virtual bool deserialize(const base::Blob& blob) override;
+    virtual bool serializeTo(base::StructuredData& sd) override;
 
 private:
     OutletList outlets_;
+    OutletIndex outletIndex_;
+    bool serial_;
 };
 
 } // namespace core
@@ -14,20 +14,27 @@
  *   limitations under the License.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "base/blob.h"
+#include "base/canceltoken.h"
 #include "base/context.h"
 #include "base/result.h"
 #include "base/structureddata.h"
 #include "base/tobjecttree.h"
 #include "base/tobjecttype.h"
 #include "core/logger.h"
+#include "core/runcontext.h"
 #include "core/runpropertyhandler.h"
 #include "core/testcase.h"
 #include "core/testsuite.h"
 using namespace aft;
 using namespace aft::core;
 
-
 TestSuite::TestSuite(const std::string& name)
     : TObjectContainer(base::TObjectType::TypeTestSuite, name) {
     state_ = INITIAL;
@@ -70,8 +77,100 @@ TestSuite::rewind(base::Context* context)
     return TObjectContainer::rewind(context);
 }
 
+bool
+TestSuite::runTestCase(TestCase* testcase, base::Context* context, base::Result& result)
+{
+    const std::string testcaseName = "test case \"" + testcase->getName() + "\"";
+    aftlog << " - Running " << testcaseName << std::endl;
+    if (!testcase->open())
+    {
+        aftlog << " - Error: cannot open " << testcaseName << std::endl;
+        return false;
+    }
+    result = testcase->run(context);
+    testcase->close();
+
+    if (!result) {
+        aftlog << " - FAILED " << testcaseName << std::endl;
+    }
+    else {
+        aftlog << " - SUCCESS " << testcaseName << std::endl;
+    }
+    return true;
+}
+
+bool
+TestSuite::runParallel(const std::vector<TestCase*>& testcases, base::Context* context,
+                       const RunOptions& options, unsigned int workers,
+                       int& ranGood, int& ranBad)
+{
+    if (testcases.empty()) return true;
+
+    std::atomic<size_t> next(0);
+    std::atomic<int> good(0);
+    std::atomic<int> bad(0);
+    std::atomic<bool> stop(false);
+    // TObject::stop() cancels the token of the thread running the suite, so the
+    // other workers run with it too
+    const base::CancelToken token = base::CancelToken::current();
+    auto work = [&](unsigned int id) {
+        base::CancelToken::Scope scope(token);
+        RunContext workerContext(*context, context->getName() + " worker " + std::to_string(id),
+                                 testcases.front());
+        auto propHandler = dynamic_cast<RunPropertyHandler*>(
+            workerContext.handler(base::HandlerType::Run));
+        while (!stop.load(std::memory_order_acquire) && !workerContext.isCancelled()) {
+            const size_t idx = next.fetch_add(1);
+            if (idx >= testcases.size()) break;
+
+            TestCase* testcase = testcases[idx];
+            propHandler->setTestCase(testcase);
+            base::Result result(true);
+            if (!runTestCase(testcase, &workerContext, result)) continue;
+            if (!result) {
+                bad.fetch_add(1);
+                if (options.stopOnError || result.getType() == base::Result::FATAL) {
+                    stop.store(true, std::memory_order_release);
+                }
+            }
+            else {
+                good.fetch_add(1);
+            }
+        }
+    };
+
+    // The calling thread is worker 0
+    workers = static_cast<unsigned int>(std::min<size_t>(workers, testcases.size()));
+    std::vector<std::thread> threads;
+    for (unsigned int id = 1; id < workers; ++id) {
+        threads.emplace_back(work, id);
+    }
+    work(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    ranGood += good.load();
+    ranBad  += bad.load();
+    return !stop.load() && !context->isCancelled();
+}
+
+const base::Result
+TestSuite::run(base::Context* context)
+{
+    return run(context, runOptions_);
+}
+
 const base::Result
 TestSuite::run(base::Context* context, bool stopOnError)
+{
+    RunOptions options;
+    options.stopOnError = stopOnError;
+    return run(context, options);
+}
+
+const base::Result
+TestSuite::run(base::Context* context, const RunOptions& options)
 {
     base::Result result(true);
     if (state_ == PREPARED && children_) {
@@ -81,39 +180,67 @@ TestSuite::run(base::Context* context, bool stopOnError)
         int ranGood = 0;
         int ranBad  = 0;
         state_ = RUNNING;
-        base::TObjectTree::Children& testcases = children_->getChildren();
-        base::TObjectTree::Children::iterator iter;
-        for (iter = testcases.begin(); iter != testcases.end(); ++iter)
-        {
-            TestCase* testcase = dynamic_cast<TestCase *>((*iter)->getValue());
-            if (!testcase) continue;
-            const std::string testcaseName = "test case \"" + testcase->getName() + "\"";
-
-            aftlog << " - Running " << testcaseName << std::endl;
-            if (!testcase->open())
-            {
-                aftlog << " - Error: cannot open " << testcaseName << std::endl;
-                continue;
-            }
-            result = testcase->run(context);
-            testcase->close();
+        std::vector<TestCase*> testcases;
+        for (auto child : children_->getChildren()) {
+            TestCase* testcase = dynamic_cast<TestCase *>(child->getValue());
+            if (testcase) testcases.push_back(testcase);
+        }
+
+        // Run a test case on the calling thread, returns false to stop
+        auto runHere = [&](TestCase* testcase) {
+            if (base::Context::isCancelled(context)) return false;
+            if (!runTestCase(testcase, context, result)) return true;
             if (!result) {
-                aftlog << " - FAILED " << testcaseName << std::endl;
                 ++ranBad;
-                if (stopOnError || result.getType() == base::Result::FATAL) {
-                    break;
+                return !options.stopOnError && result.getType() != base::Result::FATAL;
+            }
+            ++ranGood;
+            return true;
+        };
+
+        const unsigned int workers = options.workers > 0
+            ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+        if (workers == 1) {
+            for (TestCase* testcase : testcases) {
+                if (!runHere(testcase)) break;
+            }
+        }
+        else {
+            // Parallel test cases are run in batches between serial ones
+            base::Context* parent = context ? context : base::Context::global();
+            std::vector<TestCase*> batch;
+            std::vector<TestCase*> serial;
+            bool running = true;
+            for (TestCase* testcase : testcases) {
+                if (!testcase->isSerial()) {
+                    batch.push_back(testcase);
+                }
+                else if (options.order == RunOptions::Order::SerialLast) {
+                    serial.push_back(testcase);
+                }
+                else {
+                    running = runParallel(batch, parent, options, workers, ranGood, ranBad)
+                              && runHere(testcase);
+                    batch.clear();
+                    if (!running) break;
                 }
             }
-            else {
-                aftlog << " - SUCCESS " << testcaseName << std::endl;
-                ++ranGood;
+            if (running && runParallel(batch, parent, options, workers, ranGood, ranBad)) {
+                for (TestCase* testcase : serial) {
+                    if (!runHere(testcase)) break;
+                }
             }
         }
         
         aftlog << "Finished test suite: " << ranGood << " test cases succeeded, "
                << ranBad << " test cases failed." << std::endl;
         
-        if (ranBad > 0) {
+        if (base::Context::isCancelled(context)) {
+            aftlog << "Test suite \"" << getName() << "\" was cancelled." << std::endl;
+            result = base::Result(false);
+            state_ = STOPPED;
+        }
+        else if (ranBad > 0) {
             result = base::Result(false);
             state_ = FINISHED_BAD;
         }
@@ -131,6 +258,18 @@ TestSuite::run(base::Context* context, bool stopOnError)
     return result;
 }
 
+void
+TestSuite::setRunOptions(const RunOptions& options)
+{
+    runOptions_ = options;
+}
+
+const TestSuite::RunOptions&
+TestSuite::getRunOptions() const
+{
+    return runOptions_;
+}
+
 void
 TestSuite::close()
 {
@@ -142,32 +281,28 @@ TestSuite::close()
 }
 
 
-bool TestSuite::serialize(base::Blob& blob) {
-    if (!TObject::serialize(blob)) {
+bool TestSuite::serializeTo(base::StructuredData& sd) {
+    if (!TObject::serializeMembers(sd)) {
         return false;
     }
 
-    base::StructuredData sd(base::TObjectType::NameTestSuite, blob);
-
     sd.addArray("environment");
     for (const auto& envvar : environment_) {
         base::StructuredData sdEnvar(envvar.first, envvar.second);
         sd.add("environment.", sdEnvar);
     }
 
+    // Test cases are written straight into sd
     sd.addArray("testcases");
     base::TObjectTree::Children& testcases = children_->getChildren();
     for (const auto testcase : testcases) {
         TObject* tObj = testcase->getValue();
         if (tObj) {
-            base::Blob tcBlob("");
-            tObj->serialize(tcBlob);
-            base::StructuredData sdtc("testcase", tcBlob.getString());
-            sd.add("testcases.", sdtc);
+            sd.addObject("testcases.", *tObj);
         }
     }
-    
-    return sd.serialize(blob);
+
+    return true;
 }
 
 bool TestSuite::deserialize(const base::Blob& blob)
@@ -199,20 +334,19 @@ bool TestSuite::deserialize(const base::Blob& blob)
     }
     
     // testcases
-    std::vector<std::string> testcases;
+    std::vector<base::Blob> testcases;
     if (!sd.getArray("testcases", testcases))
     {
         return false;
     }
     
-    std::vector<std::string>::const_iterator it;
+    std::vector<base::Blob>::const_iterator it;
     for (it = testcases.begin(); it != testcases.end(); ++it)
     {
         base::StructuredData sdParams("", *it);
         std::string testcaseName = sdParams.get("name");
-        base::Blob params(testcaseName, base::Blob::STRING, *it);
         base::TObject* tobj = new TestCase(testcaseName);
-        if (!tobj->deserialize(params))
+        if (!tobj->deserialize(*it))
         {
             aftlog << loglevel(Error) << "Cannot deserialize testcase" << std::endl;
             delete tobj;
@@ -16,6 +16,7 @@
  */
 
 #include <map>
+#include <vector>
 
 #include "base/tobject.h"
 
@@ -26,6 +27,7 @@ class Context;
 
 namespace core {
 class RunPropertyHandler;
+class TestCase;
 
 /**
  *  Test suite is a collection of test cases.
@@ -37,6 +39,26 @@ class RunPropertyHandler;
  */
 class TestSuite : public aft::base::TObjectContainer {
 public:
+    /** How run() schedules the test cases of the suite. */
+    struct RunOptions {
+        /** Order in which parallel test cases are started. */
+        enum class Order {
+            /** Start in declared order.  A serial test case waits for every
+             *  test case before it, and the ones after it wait for it. */
+            Declared,
+            /** Run all parallel test cases first, then the serial ones. */
+            SerialLast
+        };
+
+        /** Number of worker threads; 1 runs sequentially on the calling thread
+         *  and 0 uses one worker per core. */
+        unsigned int workers = 1;
+        /** Start no more test cases once one fails.  Test cases already running
+         *  on other workers are finished. */
+        bool stopOnError = false;
+        Order order = Order::Declared;
+    };
+
     /** Construct test suite with an optional name. */
     TestSuite(const std::string& name = std::string());
 
@@ -61,6 +83,15 @@ public:
     /** Rewind test suite and prepare to run again, if possble. */
     bool rewind(base::Context* context);
 
+    /**
+     *  Run test suite using context, with the options given to setRunOptions().
+     *  This is also what runs when the suite is started with TObject::start().
+     *
+     *  @param context Context to run test suite.
+     *  @return result of running test cases (summary of run)
+     */
+    virtual const base::Result run(base::Context* context = nullptr) override;
+
     /**
      *  Run test suite using context.
      *
@@ -68,17 +99,46 @@ public:
      *  @param stopOnError if true then stops when a test case fails.
      *  @return result of running test cases (summary of run)
      */
-    const base::Result run(base::Context* context, bool stopOnError = false);
+    const base::Result run(base::Context* context, bool stopOnError);
+
+    /**
+     *  Run test suite using context, possibly on several workers.
+     *
+     *  Each worker runs its test cases in a RunContext of its own, copied from
+     *  context, so environment changes made by those test cases are not seen by
+     *  the caller.  Serial test cases run in context on the calling thread.
+     *  Cancelling the CancelToken of context stops the run between test cases and
+     *  between the commands of each test case.
+     *
+     *  @param context Context to run test suite.
+     *  @param options Number of workers, ordering and stopOnError.
+     *  @return result of running test cases (summary of run)
+     */
+    const base::Result run(base::Context* context, const RunOptions& options);
+
+    /** Set the options that run(context) uses. */
+    void setRunOptions(const RunOptions& options);
+    const RunOptions& getRunOptions() const;
 
     /** Close the testcase. */
     void close();
 
     // implement SerializeContract interface
-    virtual bool serialize(base::Blob& blob);
     virtual bool deserialize(const base::Blob& blob);
+    virtual bool serializeTo(base::StructuredData& sd);
 
 private:
     void copyEnv(base::Context* context) const;
+    /** Open, run and close one test case.
+     *  @return false if the test case could not be opened (result is unchanged).
+     */
+    bool runTestCase(TestCase* testcase, base::Context* context, base::Result& result);
+    /** Run test cases from the list on workers.
+     *  @return false if stopping because of an error.
+     */
+    bool runParallel(const std::vector<TestCase*>& testcases, base::Context* context,
+                     const RunOptions& options, unsigned int workers,
+                     int& ranGood, int& ranBad);
 
 private:
     /** Global environment for the test suite which is copied to the RunPropertyHandler
@@ -87,6 +147,7 @@ private:
      *  own a Context so parts of it can be de/serialized.
      */
     std::map<std::string,std::string> environment_;
+    RunOptions runOptions_;
 };
 
 } // namespace core
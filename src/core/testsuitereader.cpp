@@ -0,0 +1,287 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <cstring>
+#include <string>
+
+#include "base/blob.h"
+#include "base/producer.h"
+#include "core/logger.h"
+#include "testcase.h"
+#include "testsuite.h"
+#include "testsuitereader.h"
+using namespace aft;
+using namespace aft::core;
+
+
+namespace aft {
+namespace core {
+
+class TestSuiteReaderImpl
+{
+public:
+    enum State { START, MEMBERS, TESTCASES, END, FAILED };
+
+    TestSuiteReaderImpl(base::ProducerContract& producer)
+    : producer_(producer)
+    , pos_(0)
+    , state_(START)
+    , eof_(false)
+    {
+    }
+
+    TestCase* next();
+    bool finish(TestSuite& suite);
+    bool hasError() const { return state_ == FAILED; }
+
+private:
+    /** Append the next blob from the producer to the buffer.
+     *  @return false at the end of the input.
+     */
+    bool fill();
+
+    /** Skip white space, reading more input as needed.
+     *  @return false if the input ended first.
+     */
+    bool skipSpace();
+
+    /** Consume the expected character after optional white space. */
+    bool expect(char ch);
+
+    /** Scan one complete json value: an object, array, string or scalar.
+     *  The value is not checked beyond finding where it ends.
+     */
+    bool scanValue(std::string& value);
+
+    TestCase* fail(const char* message);
+
+private:
+    base::ProducerContract& producer_;
+    /** Unconsumed input, starting at pos_.  Consumed input is dropped before each value. */
+    std::string buffer_;
+    size_t pos_;
+    State state_;
+    bool eof_;
+    /** Suite members other than the test cases, as json object members */
+    std::string header_;
+};
+
+} // namespace core
+} // namespace aft
+
+bool TestSuiteReaderImpl::fill()
+{
+    if (eof_) return false;
+
+    base::Blob blob("");
+    if (!producer_.hasData() || !producer_.read(blob)) {
+        eof_ = true;
+        return false;
+    }
+    if (blob.getLength() > 0) {
+        buffer_.append(blob.getBytes(), blob.getLength());
+    }
+    return true;
+}
+
+bool TestSuiteReaderImpl::skipSpace()
+{
+    for (;;) {
+        while (pos_ < buffer_.size()) {
+            if (!isspace(static_cast<unsigned char>(buffer_[pos_]))) {
+                return true;
+            }
+            ++pos_;
+        }
+        if (!fill()) {
+            return false;
+        }
+    }
+}
+
+bool TestSuiteReaderImpl::expect(char ch)
+{
+    if (!skipSpace() || buffer_[pos_] != ch) {
+        return false;
+    }
+    ++pos_;
+    return true;
+}
+
+bool TestSuiteReaderImpl::scanValue(std::string& value)
+{
+    if (!skipSpace()) {
+        return false;
+    }
+
+    // Nothing before pos_ is needed any more
+    buffer_.erase(0, pos_);
+    pos_ = 0;
+
+    const bool scalar = !strchr("{[\"", buffer_[0]);
+    size_t scan = 0;
+    int depth = 0;
+    bool inString = false;
+    bool escaped = false;
+    bool done = false;
+    while (!done) {
+        for (; !done && scan < buffer_.size(); ++scan) {
+            const char ch = buffer_[scan];
+            if (inString) {
+                if (escaped) {
+                    escaped = false;
+                } else if (ch == '\\') {
+                    escaped = true;
+                } else if (ch == '"') {
+                    inString = false;
+                    done = depth == 0;
+                }
+            } else if (scalar) {
+                if (strchr(",}] \t\r\n", ch)) {
+                    done = true;
+                    break;
+                }
+            } else if (ch == '"') {
+                inString = true;
+            } else if (ch == '{' || ch == '[') {
+                ++depth;
+            } else if (ch == '}' || ch == ']') {
+                done = --depth == 0;
+            }
+        }
+        if (!done && !fill()) {
+            if (!scalar || scan == 0) return false;
+            done = true;    // a scalar can end with the input
+        }
+    }
+
+    value.assign(buffer_, 0, scan);
+    pos_ = scan;
+    return true;
+}
+
+TestCase* TestSuiteReaderImpl::fail(const char* message)
+{
+    aftlog << loglevel(Error) << "Cannot read test suite: " << message << std::endl;
+    state_ = FAILED;
+    return nullptr;
+}
+
+TestCase* TestSuiteReaderImpl::next()
+{
+    for (;;) {
+        switch (state_) {
+        case START:
+            if (!expect('{')) return fail("expected an object");
+            state_ = MEMBERS;
+            break;
+        case MEMBERS:
+        {
+            if (!skipSpace()) return fail("unexpected end of input");
+            if (buffer_[pos_] == '}') {
+                ++pos_;
+                state_ = END;
+                break;
+            }
+            if (buffer_[pos_] == ',') {
+                ++pos_;
+                break;
+            }
+
+            std::string key;
+            if (!scanValue(key) || key[0] != '"') return fail("expected a member name");
+            if (!expect(':')) return fail("expected ':'");
+            if (key == "\"testcases\"") {
+                if (!expect('[')) return fail("testcases is not an array");
+                state_ = TESTCASES;
+            } else {
+                std::string value;
+                if (!scanValue(value)) return fail("unexpected end of input");
+                header_ += key + ':' + value + ',';
+            }
+        }
+            break;
+        case TESTCASES:
+        {
+            if (!skipSpace()) return fail("unexpected end of input");
+            if (buffer_[pos_] == ']') {
+                ++pos_;
+                state_ = MEMBERS;
+                break;
+            }
+            if (buffer_[pos_] == ',') {
+                ++pos_;
+                break;
+            }
+
+            std::string testcaseData;
+            if (!scanValue(testcaseData)) return fail("unexpected end of input");
+            TestCase* testcase = new TestCase;
+            if (!testcase->deserialize(base::Blob("", base::Blob::STRING,
+                                                  std::move(testcaseData)))) {
+                delete testcase;
+                return fail("cannot deserialize testcase");
+            }
+            return testcase;
+        }
+        case END:
+        case FAILED:
+            return nullptr;
+        }
+    }
+}
+
+bool TestSuiteReaderImpl::finish(TestSuite& suite)
+{
+    if (state_ != END) {
+        return false;
+    }
+
+    // The test cases have already been added, so deserialize just the suite's own members
+    base::Blob blob("", base::Blob::STRING, '{' + header_ + "\"testcases\":[]}");
+    return suite.deserialize(blob);
+}
+
+// -------------------------------------------
+
+TestSuiteReader::TestSuiteReader(base::ProducerContract& producer)
+: impl_(*new TestSuiteReaderImpl(producer))
+{
+}
+
+TestSuiteReader::~TestSuiteReader()
+{
+    delete &impl_;
+}
+
+TestCase* TestSuiteReader::next()
+{
+    return impl_.next();
+}
+
+bool TestSuiteReader::read(TestSuite& suite)
+{
+    while (TestCase* testcase = next()) {
+        suite.add(testcase);
+    }
+
+    return impl_.finish(suite);
+}
+
+bool TestSuiteReader::hasError() const
+{
+    return impl_.hasError();
+}
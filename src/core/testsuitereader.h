@@ -0,0 +1,74 @@
+#pragma once
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+namespace aft
+{
+namespace base
+{
+// Forward reference
+class ProducerContract;
+}
+
+namespace core
+{
+// Forward reference
+class TestCase;
+class TestSuite;
+class TestSuiteReaderImpl;
+
+/**
+ *  Pull deserializer for a json test suite.
+ *
+ *  The serialized suite is read from a producer (e.g., a FileProducer) a blob at a
+ *  time, and each test case is constructed as soon as its json object closes.
+ *  Only the test case being read is held in memory, so a large suite does not have
+ *  to be loaded as a whole before the first test case is available.
+ *
+ *  The producer's blobs are concatenated as-is, so any parcel type that keeps all
+ *  the characters of the file works (e.g., BLOB_CHARACTER, or BLOB_LINE since json
+ *  needs no line breaks).
+ */
+class TestSuiteReader
+{
+public:
+    /** Construct a reader for a producer, which must outlive the reader. */
+    TestSuiteReader(base::ProducerContract& producer);
+    ~TestSuiteReader();
+
+    /** Read the next test case.
+     *  @return a new test case owned by the caller, or nullptr when there are no more
+     *          test cases or an error occurred.
+     */
+    TestCase* next();
+
+    /** Read the rest of the suite.
+     *
+     *  Remaining test cases are added to suite as they are read, and then the suite's
+     *  own members (name, environment, ...) are deserialized into it.
+     *  @return true if the whole suite was read, otherwise false.
+     */
+    bool read(TestSuite& suite);
+
+    /** Check if the input could not be read as a test suite. */
+    bool hasError() const;
+
+private:
+    TestSuiteReaderImpl& impl_;
+};
+
+} // namespace core
+} // namespace aft
@@ -14,11 +14,12 @@
  *   limitations under the License.
  */
 
+#include <atomic>
 #include <future>
 #include <mutex>
-#include <signal.h>
 #include "osdep/platform.h"
 #include "base/callback.h"
+#include "base/canceltoken.h"
 
 using namespace aft::base;
 using namespace std;
@@ -51,9 +52,10 @@ public:
     TObject* tObject_;
     aft::base::Context* context_;
     aft::base::Callback* callback_;
+    aft::base::CancelToken token_;
     std::future<Result> future_;
     std::mutex lock_;
-    bool stopped_;
+    std::atomic<bool> stopped_;
     //TODO store a Result here for TObject vs thread result
 };
 
@@ -64,11 +66,10 @@ Result runTObject(void* implData)
     // wait for locked mutex to start
     impl.lock_.lock();
 
-    //TODO check stopped_
-
     Result result(false);
     if (!impl.stopped_)
     {
+        CancelToken::Scope scope(impl.token_);
         result = impl.tObject_->run(impl.context_);
     }
 
@@ -77,7 +78,8 @@ Result runTObject(void* implData)
         impl.callback_->callback(&result);
     }
     
-    impl.tObject_->setState(TObject::FINISHED_GOOD);
+    impl.tObject_->setState(impl.token_.isCancelled() ? TObject::STOPPED
+                                                       : TObject::FINISHED_GOOD);
     impl.lock_.unlock();
     return result;
 }
@@ -125,8 +127,9 @@ bool NativeThreadHandler::unnotify(Callback* callback)
 
 void NativeThreadHandler::stop(bool force)
 {
-    // NOTE: No way to kill threads in native c++14 (if force)
+    // Threads are never killed, the TObject stops at its next check of the token
     impl_.stopped_ = true;
+    impl_.token_.cancel();
 }
 
 Result NativeThreadHandler::wait()
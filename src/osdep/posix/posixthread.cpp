@@ -15,9 +15,9 @@
  */
 
 #include <pthread.h>
-#include <signal.h>
 #include "osdep/platform.h"
 #include "base/callback.h"
+#include "base/canceltoken.h"
 
 using namespace aft::base;
 using namespace aft::osdep;
@@ -40,6 +40,7 @@ public:
     aft::base::TObject* tObject_;
     aft::base::Context* context_;
     aft::base::Callback* callback_;
+    aft::base::CancelToken token_;
     pthread_t threadId_;
     //TODO store a Result here too TObject vs thread result
 };
@@ -48,13 +49,18 @@ public:
 void* runTObject(void* implData)
 {
     PosixThreadImpl& impl = *(PosixThreadImpl *)implData;
-    Result result = impl.tObject_->run(impl.context_);
+    Result result(false);
+    {
+        CancelToken::Scope scope(impl.token_);
+        result = impl.tObject_->run(impl.context_);
+    }
     if (impl.callback_)
     {
         impl.callback_->callback(&result);
     }
 
-    impl.tObject_->setState(TObject::FINISHED_GOOD);
+    impl.tObject_->setState(impl.token_.isCancelled() ? TObject::STOPPED
+                                                       : TObject::FINISHED_GOOD);
     return 0;
 }
 
@@ -67,7 +73,8 @@ PosixThreadHandler::PosixThreadHandler(TObject* tObject, Context* context)
 
 PosixThreadHandler::~PosixThreadHandler()
 {
-    //TODO stop tobject and kill thread?
+    stop(true);
+    wait();
     delete &impl_;
 }
 
@@ -101,24 +108,30 @@ bool PosixThreadHandler::unnotify(Callback* callback)
 
 void PosixThreadHandler::stop(bool force)
 {
-    //TODO set stop flag
-    if (force)
-    {
-        const int killSignal = 9;
-        pthread_kill(impl_.threadId_, killSignal);
-        impl_.tObject_->setState(TObject::FINISHED_BAD);
-    }
+    // Never kill the thread, the TObject stops at its next check of the token
+    impl_.token_.cancel();
 }
 
 Result PosixThreadHandler::wait()
 {
+    if (impl_.threadId_ == PTHREAD_INIT)
+    {
+        return result_;
+    }
     void* res;
     pthread_join(impl_.threadId_, &res);
+    impl_.threadId_ = PTHREAD_INIT;
     return result_;
 }
 
 void PosixThreadHandler::run()
 {
+    if (impl_.token_.isCancelled())
+    {
+        result_ = Result(false);
+        impl_.tObject_->setState(TObject::STOPPED);
+        return;
+    }
     result_ = Result(true);
     // create thread
     pthread_t tid;
@@ -0,0 +1,125 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+// Benchmark: write many small blobs with FileConsumer, flushing each blob or batch,
+// and with asynchronous FileConsumers that write groups of blobs.
+// Usage: b_fileconsumer [blobs [blob-size]]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <base/blob.h>
+#include <core/fileconsumer.h>
+using namespace aft::base;
+using namespace aft::core;
+using std::endl;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void report(const char* label, double ms, const std::vector<Blob>& blobs, size_t size)
+{
+    std::cout << label << ": " << ms << " ms, " << blobs.size() / (ms / 1000.0)
+              << " blobs/s, " << (blobs.size() * size / 1048576.0) / (ms / 1000.0)
+              << " MiB/s" << endl;
+}
+
+static void runSync(const std::vector<Blob>& blobs, size_t size)
+{
+    Clock::time_point start = Clock::now();
+    {
+        FileConsumer consumer("/tmp/b_fileconsumer.out", true);
+        for (const Blob& blob : blobs) {
+            consumer.write(blob);
+        }
+        consumer.sync();
+    }
+    report("flush per blob", msSince(start), blobs, size);
+}
+
+static void runBatches(const char* label, FileConsumer& consumer,
+                       const std::vector<Blob>& blobs, size_t size)
+{
+    Clock::time_point start = Clock::now();
+    std::vector<Blob> batch;
+    for (const Blob& blob : blobs) {
+        batch.push_back(blob);
+        if (batch.size() == 256) {
+            consumer.write(batch);
+            batch.clear();
+        }
+    }
+    consumer.write(batch);
+    consumer.sync();
+    report(label, msSince(start), blobs, size);
+}
+
+static void runAsync(const char* label, const FileConsumer::AsyncPolicy& policy,
+                     const std::vector<Blob>& blobs, size_t size)
+{
+    Clock::time_point start = Clock::now();
+    {
+        FileConsumer consumer("/tmp/b_fileconsumer.out", true, policy);
+        for (const Blob& blob : blobs) {
+            consumer.write(blob);
+        }
+        consumer.sync();
+    }
+    report(label, msSince(start), blobs, size);
+}
+
+int main(int argc, char* argv[])
+{
+    int numBlobs = argc > 1 ? atoi(argv[1]) : 200000;
+    size_t size = argc > 2 ? atoi(argv[2]) : 128;
+
+    std::vector<Blob> blobs;
+    blobs.reserve(numBlobs);
+    for (int idx = 0; idx < numBlobs; ++idx) {
+        blobs.push_back(Blob("", Blob::STRING, std::string(size - 1, 'a' + idx % 26) + '\n'));
+    }
+
+    runSync(blobs, size);
+    {
+        FileConsumer consumer("/tmp/b_fileconsumer.out", true);
+        runBatches("flush per batch of 256", consumer, blobs, size);
+    }
+
+    FileConsumer::AsyncPolicy policy;
+    runAsync("async, write when queued", policy, blobs, size);
+    policy.flushBytes = 64 * 1024;
+    runAsync("async, every 64 KiB", policy, blobs, size);
+    policy.flushBytes = 0;
+    policy.flushMilliseconds = 5;
+    runAsync("async, every 5 ms", policy, blobs, size);
+    policy.flushBytes = 1024 * 1024;
+    policy.flushMilliseconds = 0;
+    policy.syncData = true;
+    runAsync("async, every 1 MiB with sync", policy, blobs, size);
+    {
+        FileConsumer consumer("/tmp/b_fileconsumer.out", true, FileConsumer::AsyncPolicy());
+        runBatches("async, batches of 256", consumer, blobs, size);
+    }
+
+    return 0;
+}
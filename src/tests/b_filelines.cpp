@@ -0,0 +1,102 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+// Benchmark: read a large line-oriented file with the old fixed-size getline loop,
+// with FileProducer's chunked line reader and with FileProducer's mapped mode.
+// Usage: b_filelines [lines [long-line-interval]]
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <base/blob.h>
+#include <core/fileconsumer.h>
+#include <core/fileproducer.h>
+using namespace aft::base;
+using namespace aft::core;
+using std::endl;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void report(const char* label, double ms, size_t lines, size_t bytes)
+{
+    std::cout << label << ": " << lines << " lines, " << bytes << " bytes, "
+              << ms << " ms, " << (bytes / 1048576.0) / (ms / 1000.0) << " MiB/s" << endl;
+}
+
+// The BLOB_LINE loop FileProducer used before, which truncates long lines and stops
+static void runFixedBuffer(const std::string& fileName)
+{
+    Clock::time_point start = Clock::now();
+    std::ifstream infile(fileName.c_str());
+    size_t lines = 0;
+    size_t bytes = 0;
+    char lineBuf[1024];
+    for (;;) {
+        infile.getline(lineBuf, 1024);
+        if (infile.gcount() == 0) break;
+        std::string line(lineBuf);
+        ++lines;
+        bytes += line.size();
+    }
+    report("fixed 1024 byte getline", msSince(start), lines, bytes);
+}
+
+static void runProducer(const char* label, const std::string& fileName, bool mapped)
+{
+    Clock::time_point start = Clock::now();
+    FileProducer producer(fileName, ParcelType::BLOB_LINE, mapped);
+    Blob blob("");
+    size_t lines = 0;
+    size_t bytes = 0;
+    while (producer.read(blob)) {
+        ++lines;
+        bytes += blob.getLength();
+    }
+    report(label, msSince(start), lines, bytes);
+}
+
+int main(int argc, char* argv[])
+{
+    int numLines = argc > 1 ? atoi(argv[1]) : 500000;
+    int longInterval = argc > 2 ? atoi(argv[2]) : 500;
+
+    // JSON-lines like corpus with an occasional 100 KB line
+    const std::string fileName("/tmp/b_filelines.txt");
+    {
+        std::string shortLine = "{\"event\":\"sample\",\"payload\":\"" + std::string(200, 'p') + "\"}\n";
+        std::string longLine = "{\"event\":\"bulk\",\"payload\":\"" + std::string(100 * 1024, 'b') + "\"}\n";
+        std::string contents;
+        for (int line = 1; line <= numLines; ++line) {
+            contents += (longInterval > 0 && line % longInterval == 0) ? longLine : shortLine;
+        }
+        FileConsumer consumer(fileName, true);
+        consumer.write(Blob("", Blob::STRING, std::move(contents)));
+    }
+
+    runFixedBuffer(fileName);
+    runProducer("chunked FileProducer", fileName, false);
+    runProducer("mapped FileProducer", fileName, true);
+
+    return 0;
+}
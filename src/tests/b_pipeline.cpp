@@ -0,0 +1,83 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+// Benchmark: move words from a StringProducer through two QueueProc rings to a
+// StringConsumer on a Pipeline, with 1 to N workers and several batch sizes.
+// Usage: b_pipeline [max-workers [words]]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <core/pipeline.h>
+#include <core/queueproc.h>
+#include <core/stringconsumer.h>
+#include <core/stringproducer.h>
+using namespace aft::base;
+using namespace aft::core;
+using std::endl;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void runPipeline(const std::string& text, unsigned int workers, unsigned int batchSize)
+{
+    StringProducer wordprod(text, ParcelType::BLOB_WORD);
+    QueueProc first(1024, QueueProc::SPSC);
+    QueueProc second(1024, QueueProc::SPSC);
+    StringConsumer strcons;
+
+    Pipeline pipeline(workers, batchSize);
+    pipeline.connect(&wordprod, &first);
+    pipeline.connect(&first, &second);
+    pipeline.connect(&second, &strcons);
+
+    Clock::time_point start = Clock::now();
+    pipeline.start();
+    bool drained = pipeline.drain(Clock::now() + std::chrono::minutes(5));
+    double ms = msSince(start);
+    pipeline.stop();
+
+    std::cout << workers << " workers, batch " << batchSize << ": " << ms << " ms, "
+              << pipeline.moved() / (ms / 1000.0) << " blobs/s"
+              << (drained ? "" : " (not drained)") << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    int maxWorkers = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+    int words = argc > 2 ? atoi(argv[2]) : 100000;
+    if (maxWorkers < 1) maxWorkers = 1;
+
+    std::string text;
+    for (int idx = 0; idx < words; ++idx) {
+        text += "word" + std::to_string(idx) + " ";
+    }
+
+    for (int workers = 1; workers <= maxWorkers; workers *= 2) {
+        for (unsigned int batchSize : {1, 16, 256}) {
+            runPipeline(text, workers, batchSize);
+        }
+    }
+
+    return 0;
+}
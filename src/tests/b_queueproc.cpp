@@ -0,0 +1,114 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+// Benchmark: move blobs through QueueProc rings with 1 to N writing threads and
+// 1 to N reading threads.
+// Usage: b_queueproc [max-threads [blobs-per-writer]]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <base/blob.h>
+#include <core/queueproc.h>
+using namespace aft::base;
+using namespace aft::core;
+using std::endl;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void runRing(const char* label, QueueProc::Concurrency concurrency,
+                    int writers, int readers, int blobsPerWriter)
+{
+    QueueProc ring(1024, concurrency);
+    const Blob sample("", Blob::STRING, std::string(64, 's'));
+    const long total = (long)writers * blobsPerWriter;
+    std::atomic<long> read(0);
+    std::vector<std::thread> threads;
+
+    Clock::time_point start = Clock::now();
+    for (int writer = 0; writer < writers; ++writer) {
+        threads.emplace_back([&] {
+            for (int idx = 0; idx < blobsPerWriter; ++idx) {
+                Blob blob(sample);
+                while (!ring.write(std::move(blob))) std::this_thread::yield();
+            }
+        });
+    }
+    for (int reader = 0; reader < readers; ++reader) {
+        threads.emplace_back([&] {
+            Blob blob("");
+            while (read.load(std::memory_order_relaxed) < total) {
+                if (ring.read(blob)) {
+                    read.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double ms = msSince(start);
+
+    std::cout << label << " " << writers << " writers, " << readers << " readers: "
+              << ms << " ms, " << total / (ms / 1000.0) << " blobs/s" << endl;
+}
+
+static void runUnsynchronized(int blobs)
+{
+    QueueProc queue(1024);
+    const Blob sample("", Blob::STRING, std::string(64, 's'));
+    Blob blob("");
+
+    Clock::time_point start = Clock::now();
+    for (int idx = 0; idx < blobs; ++idx) {
+        Blob copy(sample);
+        queue.write(std::move(copy));
+        queue.read(blob);
+    }
+    double ms = msSince(start);
+
+    std::cout << "unsynchronized, one thread: " << ms << " ms, "
+              << blobs / (ms / 1000.0) << " blobs/s" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+    int blobsPerWriter = argc > 2 ? atoi(argv[2]) : 200000;
+    if (maxThreads < 1) maxThreads = 1;
+
+    runUnsynchronized(blobsPerWriter);
+    runRing("SPSC", QueueProc::SPSC, 1, 1, blobsPerWriter);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        runRing("MPMC", QueueProc::MPMC, threads, threads, blobsPerWriter / threads);
+    }
+    runRing("MPMC", QueueProc::MPMC, maxThreads, 1, blobsPerWriter / maxThreads);
+    runRing("MPMC", QueueProc::MPMC, 1, maxThreads, blobsPerWriter);
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+// Benchmark: pass blobs through the robot procs to a consumer that only counts
+// them, one at a time and in batches.
+// Usage: b_robotprocs [blobs [batch-size]]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <base/blob.h>
+#include <base/consumer.h>
+#include <core/robotprocs.h>
+using namespace aft::base;
+using namespace aft::core;
+using std::endl;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+class CountingConsumer : public BaseConsumer
+{
+public:
+    CountingConsumer()
+    : count(0)
+    {  }
+
+    virtual bool canAcceptData() override
+    {
+        return true;
+    }
+    virtual Result write(const Blob& blob) override
+    {
+        ++count;
+        return true;
+    }
+    virtual int write(const std::vector<Blob>& blobs) override
+    {
+        count += blobs.size();
+        return blobs.size();
+    }
+
+    unsigned long count;
+};
+
+static void report(const char* label, int blobs, double ms)
+{
+    std::cout << label << ": " << ms << " ms, " << blobs / (ms / 1000.0) << " blobs/s" << endl;
+}
+
+static void runSingle(const char* label, RobotProc& robot, const Blob& sample, int blobs)
+{
+    Clock::time_point start = Clock::now();
+    for (int idx = 0; idx < blobs; ++idx) {
+        while (!robot.write(sample)) {  }
+    }
+    report(label, blobs, msSince(start));
+}
+
+static void runBatch(const char* label, RobotProc& robot, const Blob& sample,
+                     int blobs, size_t batchSize)
+{
+    std::vector<Blob> batch(batchSize, sample);
+    Clock::time_point start = Clock::now();
+    for (int idx = 0; idx < blobs; idx += batchSize) {
+        robot.write(batch);
+    }
+    report(label, blobs, msSince(start));
+}
+
+int main(int argc, char* argv[])
+{
+    int blobs = argc > 1 ? atoi(argv[1]) : 1000000;
+    size_t batchSize = argc > 2 ? atoi(argv[2]) : 256;
+    if (batchSize < 1) batchSize = 1;
+
+    const Blob sample("", Blob::STRING, std::string(64, 's'));
+    CountingConsumer counter;
+
+    ThrottleProc unlimited(0, 1, &counter);
+    runSingle("throttle, no limit", unlimited, sample, blobs);
+    runBatch("throttle batches, no limit", unlimited, sample, blobs, batchSize);
+
+    // High enough that the bucket is rarely empty, so this times the accounting
+    ThrottleProc throttle(1000000000, batchSize, &counter);
+    runSingle("throttle at 1G/s", throttle, sample, blobs);
+    runBatch("throttle batches at 1G/s", throttle, sample, blobs, batchSize);
+
+    SampleProc oneIn(SampleProc::ONE_IN_N, 10, &counter);
+    runSingle("sample 1 in 10", oneIn, sample, blobs);
+    runBatch("sample batches 1 in 10", oneIn, sample, blobs, batchSize);
+
+    SampleProc reservoir(SampleProc::RESERVOIR, 1000);
+    runSingle("reservoir of 1000", reservoir, sample, blobs);
+    runBatch("reservoir batches of 1000", reservoir, sample, blobs, batchSize);
+
+    BurstProc burst(0.0);
+    Blob blob("");
+    Clock::time_point start = Clock::now();
+    for (int idx = 0; idx < blobs; ++idx) {
+        burst.write(sample);
+        burst.read(blob);
+    }
+    report("burst write and read", blobs, msSince(start));
+
+    return 0;
+}
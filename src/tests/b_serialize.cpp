@@ -0,0 +1,136 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+// Benchmark: save and load a large TestSuite in json and binary formats, and
+// load it from a file either whole or streamed with TestSuiteReader.
+// Usage: b_serialize [testcases [commands-per-testcase [iterations]]]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <base/blob.h>
+#include <base/factory.h>
+#include <core/basiccommands.h>
+#include <core/basicfactory.h>
+#include <core/fileconsumer.h>
+#include <core/fileproducer.h>
+#include <core/testcase.h>
+#include <core/testsuite.h>
+#include <core/testsuitereader.h>
+using namespace aft::base;
+using namespace aft::core;
+using std::endl;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void runFormat(const char* label, Blob::Type type, TestSuite& suite, int iterations)
+{
+    double saveMs = 0;
+    double loadMs = 0;
+    size_t size = 0;
+    for (int iter = 0; iter < iterations; ++iter) {
+        Blob blob("", type, std::string());
+        Clock::time_point start = Clock::now();
+        if (!suite.serialize(blob)) {
+            std::cerr << label << ": cannot serialize" << endl;
+            return;
+        }
+        saveMs += msSince(start);
+        size = blob.getLength();
+
+        TestSuite loaded;
+        start = Clock::now();
+        if (!loaded.deserialize(blob)) {
+            std::cerr << label << ": cannot deserialize" << endl;
+            return;
+        }
+        loadMs += msSince(start);
+    }
+
+    std::cout << label << ": " << size << " bytes, save " << saveMs / iterations
+              << " ms, load " << loadMs / iterations << " ms" << endl;
+}
+
+static void runFile(TestSuite& suite)
+{
+    const std::string fileName("/tmp/b_serialize.aft");
+    Blob blob("");
+    suite.serialize(blob);
+    {
+        FileConsumer consumer(fileName, true);
+        consumer.write(blob);
+    }
+
+    Clock::time_point start = Clock::now();
+    {
+        FileProducer producer(fileName);
+        TestSuite loaded;
+        if (!producer.read(blob) || !loaded.deserialize(blob)) {
+            std::cerr << "file: cannot deserialize" << endl;
+            return;
+        }
+    }
+    std::cout << "file whole : load " << msSince(start) << " ms" << endl;
+
+    start = Clock::now();
+    FileProducer producer(fileName, ParcelType::BLOB_LINE);
+    TestSuiteReader reader(producer);
+    TestSuite loaded;
+    TestCase* first = reader.next();
+    double firstMs = msSince(start);
+    if (first) {
+        loaded.add(first);
+    }
+    if (!reader.read(loaded)) {
+        std::cerr << "file: cannot stream" << endl;
+        return;
+    }
+    std::cout << "file stream: first test case " << firstMs << " ms, load "
+              << msSince(start) << " ms" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    const int numTestCases = argc > 1 ? atoi(argv[1]) : 200;
+    const int numCommands = argc > 2 ? atoi(argv[2]) : 50;
+    const int iterations = argc > 3 ? atoi(argv[3]) : 3;
+
+    MecFactory::instance()->addFactory(new BasicCommandFactory);
+
+    TestSuite suite("benchmark suite");
+    for (int tc = 0; tc < numTestCases; ++tc) {
+        TestCase* testCase = new TestCase("test case " + std::to_string(tc));
+        for (int cmd = 0; cmd < numCommands; ++cmd) {
+            testCase->add(new LogCommand("Message number " + std::to_string(cmd)));
+        }
+        suite.add(testCase);
+    }
+
+    std::cout << numTestCases << " test cases x " << numCommands << " commands, "
+              << iterations << " iterations" << endl;
+    runFormat("json  ", Blob::STRING, suite, iterations);
+    runFormat("binary", Blob::BINARY, suite, iterations);
+    runFile(suite);
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+// Benchmark: move blobs from a child process to this one through a ShmRing, one at
+// a time and in batches.
+// Usage: b_shmring [blobs [blob-size]]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <base/blob.h>
+#include <core/shmring.h>
+using namespace aft::base;
+using namespace aft::core;
+using std::endl;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void runRing(int blobs, int blobSize, size_t batch)
+{
+    const std::string name = "/b_shmring." + std::to_string(getpid());
+    ShmRing reader(name, 4 << 20);
+    if (!reader.isOpen()) {
+        std::cout << "cannot open shared memory " << name << endl;
+        return;
+    }
+
+    Clock::time_point start = Clock::now();
+    pid_t child = fork();
+    if (0 == child) {
+        ShmRing writer(name);
+        std::vector<Blob> batchBlobs(batch, Blob("", Blob::RAWDATA, std::string(blobSize, 'r')));
+        for (int sent = 0; sent < blobs; ) {
+            size_t count = std::min(batch, size_t(blobs - sent));
+            size_t pushed = writer.push(batchBlobs.data(), count);
+            if (0 == pushed) {
+                writer.waitForRoom(0, blobSize, Clock::now() + std::chrono::milliseconds(10));
+            }
+            sent += pushed;
+        }
+        _exit(0);
+    }
+
+    Blob blob("");
+    long bytes = 0;
+    for (int received = 0; received < blobs; ) {
+        if (reader.pop(blob)) {
+            bytes += blob.getLength();
+            ++received;
+        } else {
+            reader.waitForData(Clock::now() + std::chrono::milliseconds(10));
+        }
+    }
+    double ms = msSince(start);
+    waitpid(child, nullptr, 0);
+
+    std::cout << "batches of " << batch << ", " << blobSize << " byte blobs: " << ms
+              << " ms, " << blobs / (ms / 1000.0) << " blobs/s, "
+              << bytes / (ms * 1000.0) << " MB/s" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    int blobs = argc > 1 ? atoi(argv[1]) : 1000000;
+    int blobSize = argc > 2 ? atoi(argv[2]) : 64;
+
+    runRing(blobs, blobSize, 1);
+    runRing(blobs, blobSize, 64);
+    runRing(blobs / 16, blobSize * 64, 16);
+
+    return 0;
+}
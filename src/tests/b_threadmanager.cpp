@@ -0,0 +1,112 @@
+/*
+ *   Copyright 2017 Andy Warner
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+// Benchmark: churn of ThreadManager handlers from 1 to N threads, with many other
+// handlers registered.  Registry churn only adds, finds and removes handlers;
+// start/stop churn also runs each TObject on the executor, stops it and waits.
+// Usage: b_threadmanager [max-threads [ops-per-thread [live-handlers]]]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <base/context.h>
+#include <base/thread.h>
+#include <base/tobject.h>
+using namespace aft::base;
+using std::endl;
+
+typedef std::chrono::steady_clock Clock;
+
+class BenchContext : public Context
+{
+public:
+    BenchContext() : Context("bench") { }
+};
+
+static double msSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void runChurn(const char* label, bool startStop, int threads, int opsPerThread)
+{
+    ThreadManager* tman = ThreadManager::instance();
+    BenchContext context;
+    std::vector<std::thread> workers;
+
+    Clock::time_point start = Clock::now();
+    for (int worker = 0; worker < threads; ++worker) {
+        workers.emplace_back([&] {
+            // A few TObjects per thread, so handlers of one TObject come and go
+            TObject tObjects[4];
+            for (int idx = 0; idx < opsPerThread; ++idx) {
+                TObject& tObject = tObjects[idx % 4];
+                ThreadHandler* thread = tman->thread(&tObject, &context);
+                if (startStop) {
+                    thread->run();
+                    tObject.stop();
+                    thread->wait();
+                } else if (tman->find(&tObject) != thread) {
+                    std::cerr << "find returned the wrong handler" << endl;
+                }
+                delete thread;
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double ms = msSince(start);
+
+    const long total = (long)threads * opsPerThread;
+    std::cout << label << " " << threads << " threads: " << ms << " ms, "
+              << total / (ms / 1000.0) << " handlers/s" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+    int opsPerThread = argc > 2 ? atoi(argv[2]) : 100000;
+    int liveHandlers = argc > 3 ? atoi(argv[3]) : 10000;
+    if (maxThreads < 1) maxThreads = 1;
+
+    // Handlers that stay registered while the others churn
+    ThreadManager* tman = ThreadManager::instance();
+    BenchContext context;
+    std::vector<std::unique_ptr<TObject>> liveTObjects;
+    std::vector<ThreadHandler*> live;
+    for (int idx = 0; idx < liveHandlers; ++idx) {
+        liveTObjects.emplace_back(new TObject);
+        live.push_back(tman->thread(liveTObjects.back().get(), &context));
+    }
+    std::cout << liveHandlers << " live handlers" << endl;
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        runChurn("registry churn", false, threads, opsPerThread);
+    }
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        runChurn("start/stop churn", true, threads, opsPerThread / 10);
+    }
+
+    for (ThreadHandler* thread : live) {
+        delete thread;
+    }
+    return 0;
+}
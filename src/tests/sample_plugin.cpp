@@ -50,16 +50,15 @@ public:
     }
 
     // Implement SerializeContract
-    virtual bool serialize(Blob& blob)
+    virtual bool serializeTo(StructuredData& sd)
     {
-        if (!TObject::serialize(blob))
+        if (!serializeMembers(sd))
         {
             return false;
         }
-        StructuredData sd("TOSample", blob);
         sd.add("value", value_);
-        
-        return sd.serialize(blob);
+
+        return true;
     }
     
     virtual bool deserialize(const Blob& blob)
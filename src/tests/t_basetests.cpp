@@ -14,12 +14,19 @@
  *   limitations under the License.
  */
 
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #include <base/blob.h>
+#include <base/canceltoken.h>
 #include <base/context.h>
 #include <base/entity.h>
+#include <base/executor.h>
 #include <base/factory.h>
 #include <base/hasher.h>
 #include <base/propertyhandler.h>
@@ -144,6 +151,26 @@ private:
     int ordinal_;
 };
 
+/** Counts how often it is processed, and cancels the context on the given count. */
+class CancellingTObject : public TObject
+{
+public:
+    CancellingTObject(int& processed, int cancelAt)
+    : processed_(processed), cancelAt_(cancelAt) { }
+
+    virtual const Result process(Context* context = nullptr)
+    {
+        if (++processed_ == cancelAt_ && context) {
+            context->getCancelToken().cancel();
+        }
+        return Result(true);
+    }
+
+private:
+    int& processed_;
+    const int cancelAt_;
+};
+
 class SubTOBlob : public TOBlob {
 public:
     SubTOBlob(const TObjectType& blobObjType, Blob* blob)
@@ -391,10 +418,20 @@ TEST(BasePackageTest, Blob)
     EXPECT_EQ("basicBlob", blob.getName());
     EXPECT_EQ(strncmp(SOMEDATA, (const char *)blob.getData(), SomeDataLength), 0);
 
-    Blob subBlob("subBlob");
-    blob.addMember(&subBlob);
+    Blob subBlob("subBlob", Blob::STRING, "member");
+    blob.addMember(subBlob);
     EXPECT_EQ(1, blob.getMembers().size());
-    EXPECT_EQ(&subBlob, blob.getMembers().front());
+    EXPECT_EQ("member", blob.getMembers().front()->getString());
+
+    // Members are owned by the blob, and shared by its copies
+    {
+        Blob scoped("scoped", Blob::STRING, "moved member");
+        blob.addMember(std::move(scoped));
+    }
+    Blob copy(blob);
+    ASSERT_EQ(2, copy.getMembers().size());
+    EXPECT_EQ("moved member", copy.getMembers().back()->getString());
+    EXPECT_EQ(blob.getMembers().back(), copy.getMembers().back());
 
     Blob rawBlob("rawBlob", (void *)SOMEDATA, (int)SomeDataLength + 1);
     EXPECT_EQ(rawBlob.getType(), Blob::RAWDATA);
@@ -407,6 +444,123 @@ TEST(BasePackageTest, Blob)
     EXPECT_EQ(aString, stringBlob.getString());
 }
 
+TEST(BasePackageTest, BlobSharing)
+{
+    uint8_t data[4] { 0x01, 0xab, 0x7f, 0x10 };
+    Blob rawBlob("rawBlob", data, sizeof(data));
+    EXPECT_NE((const void *)data, rawBlob.getData());
+    EXPECT_EQ(sizeof(data), rawBlob.getLength());
+    EXPECT_EQ("01 ab 7f 10 \n", rawBlob.getString());
+
+    // Copies share the buffer
+    Blob copyBlob(rawBlob);
+    EXPECT_EQ(rawBlob.getData(), copyBlob.getData());
+    EXPECT_EQ(2, rawBlob.useCount());
+    EXPECT_TRUE(copyBlob == rawBlob);
+
+    // Slices share the buffer
+    Blob sliceBlob = rawBlob.slice(1, 2);
+    EXPECT_EQ(2, sliceBlob.getLength());
+    EXPECT_EQ(rawBlob.getBytes() + 1, sliceBlob.getBytes());
+    EXPECT_EQ("ab 7f \n", sliceBlob.getString());
+    EXPECT_EQ(3, rawBlob.useCount());
+
+    // Moves leave the source empty
+    Blob movedBlob(std::move(copyBlob));
+    EXPECT_EQ(rawBlob.getData(), movedBlob.getData());
+    EXPECT_EQ(nullptr, copyBlob.getData());
+    EXPECT_EQ(0, copyBlob.getLength());
+
+    const std::string aString("Slices of a string blob.");
+    Blob stringBlob("stringBlob", Blob::STRING, aString);
+    Blob stringSlice = stringBlob.slice(12, 6);
+    EXPECT_EQ(Blob::STRING, stringSlice.getType());
+    EXPECT_EQ("string", stringSlice.getString());
+    EXPECT_EQ(nullptr, stringSlice.getData());
+    EXPECT_EQ(aString.size() - 12, stringBlob.slice(12).getLength());
+    EXPECT_EQ(0, stringBlob.slice(100).getLength());
+}
+
+TEST(BasePackageTest, CancelToken)
+{
+    CancelToken token;
+    CancelToken shared(token);
+    EXPECT_FALSE(shared.isCancelled());
+    EXPECT_TRUE(token.sleepUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(1)));
+
+    // Cancelling wakes up a sleeper right away
+    const auto start = std::chrono::steady_clock::now();
+    std::thread canceller([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        shared.cancel();
+    });
+    EXPECT_FALSE(token.sleepUntil(start + std::chrono::seconds(10)));
+    EXPECT_GT(std::chrono::seconds(5), std::chrono::steady_clock::now() - start);
+    canceller.join();
+    EXPECT_TRUE(token.isCancelled());
+
+    // The token of the calling thread
+    EXPECT_FALSE(CancelToken::current().isCancelled());
+    {
+        CancelToken::Scope scope(token);
+        EXPECT_TRUE(CancelToken::current().isCancelled());
+        SampleContext context("scoped");
+        EXPECT_TRUE(context.isCancelled());
+    }
+    EXPECT_FALSE(CancelToken::current().isCancelled());
+
+    // Containers stop between children
+    int processed = 0;
+    SampleTOContainer container("cancelled", 0);
+    std::vector<std::unique_ptr<CancellingTObject>> children;
+    for (int idx = 0; idx < 10; ++idx) {
+        children.emplace_back(new CancellingTObject(processed, 3));
+        container.add(children.back().get());
+    }
+    SampleContext context("cancelling");
+    container.setState(TObject::PREPARED);
+    Result result = container.run(&context);
+    EXPECT_EQ(Result::FATAL, result.getType());
+    EXPECT_EQ(TObject::STOPPED, container.getState());
+    EXPECT_EQ(3, processed);
+}
+
+TEST(BasePackageTest, Executor)
+{
+    std::atomic<int> ran(0);
+    std::atomic<int> nested(0);
+    {
+        Executor executor(3);
+        EXPECT_EQ(3u, executor.size());
+        EXPECT_FALSE(executor.onWorker());
+
+        // Tasks submitted by workers go to their own deque and can be stolen
+        for (int idx = 0; idx < 100; ++idx) {
+            executor.submit([&] {
+                for (int sub = 0; sub < 10; ++sub) {
+                    executor.submit([&] { ++nested; });
+                }
+                ++ran;
+            });
+        }
+
+        // The calling thread can help out
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (nested.load() < 1000 && std::chrono::steady_clock::now() < deadline) {
+            if (!executor.runPending()) {
+                std::this_thread::yield();
+            }
+        }
+        EXPECT_EQ(1000, nested.load());
+
+        // Tasks that are left are run before the executor goes away
+        for (int idx = 0; idx < 50; ++idx) {
+            executor.submit([&] { ++ran; });
+        }
+    }
+    EXPECT_EQ(150, ran.load());
+}
+
 TEST(BasePackageTest, Factory)
 {
     const std::string categoryName("Base");
@@ -584,6 +738,97 @@ TEST(BasePackageTest, StructuredDataParse)
     std::cout << "serialized json: " << blob.getString() << std::endl;
 }
     
+TEST(BasePackageTest, StructuredDataBinary)
+{
+    StructuredData sd("binary", std::string(),
+                      StructuredDataDelegate::create(StructuredDataDelegate::BINARY));
+    EXPECT_EQ(StructuredDataDelegate::BINARY, sd.getFormat());
+    EXPECT_TRUE(sd.add("a", 1));
+    Blob blob("");
+    EXPECT_TRUE(sd.serialize(blob));
+    EXPECT_EQ(Blob::BINARY, blob.getType());
+    EXPECT_EQ(std::string("\xa1\x61\x61\x01", 4), blob.getString());
+
+    EXPECT_TRUE(sd.add("negative", -1000));
+    EXPECT_TRUE(sd.add("text", std::string("with\0zero", 9)));
+    EXPECT_TRUE(sd.add("one.two.three", "nested"));
+    EXPECT_TRUE(sd.addArray("list"));
+    EXPECT_TRUE(sd.add("list.", "element"));
+    StructuredData element("element");
+    EXPECT_TRUE(element.add("value", 70000));
+    EXPECT_TRUE(sd.add("list.", element));
+    EXPECT_TRUE(sd.serialize(blob));
+
+    // A json structured data switches to binary to read a binary blob
+    StructuredData loaded("loaded");
+    EXPECT_TRUE(loaded.deserialize(blob));
+    EXPECT_EQ(StructuredDataDelegate::BINARY, loaded.getFormat());
+    int intValue = 0;
+    EXPECT_TRUE(loaded.get("negative", intValue));
+    EXPECT_EQ(-1000, intValue);
+    EXPECT_EQ(std::string("with\0zero", 9), loaded.get("text"));
+    EXPECT_EQ("nested", loaded.get("one.two.three"));
+    EXPECT_TRUE(loaded.get("list.1.value", intValue));
+    EXPECT_EQ(70000, intValue);
+
+    std::vector<Blob> elements;
+    EXPECT_TRUE(loaded.getArray("list", elements));
+    ASSERT_EQ(2, elements.size());
+    EXPECT_EQ(Blob::STRING, elements[0].getType());
+    EXPECT_EQ("element", elements[0].getString());
+    EXPECT_EQ(Blob::BINARY, elements[1].getType());
+    StructuredData fromElement("", elements[1]);
+    EXPECT_TRUE(fromElement.get("value", intValue));
+    EXPECT_EQ(70000, intValue);
+
+    // Truncated or trailing data is rejected
+    StructuredData bad("bad");
+    const std::string& data = blob.getString();
+    EXPECT_FALSE(bad.deserialize(Blob("", Blob::BINARY, data.substr(0, data.size() - 1))));
+    EXPECT_FALSE(bad.deserialize(Blob("", Blob::BINARY, data + '\0')));
+}
+
+/** Only serializes to a blob, so adding it falls back to parsing the blob */
+class BlobOnlyObject : public SerializeContract
+{
+public:
+    virtual bool serialize(Blob& blob)
+    {
+        StructuredData sd("blobonly", std::string(), StructuredDataDelegate::create(blob));
+        sd.add("kind", "blob only");
+        return sd.serialize(blob);
+    }
+    virtual bool deserialize(const Blob& blob) { return false; }
+};
+
+TEST(BasePackageTest, StructuredDataAddObject)
+{
+    for (auto format : { StructuredDataDelegate::TEXT, StructuredDataDelegate::BINARY }) {
+        StructuredData sd("parent", std::string(), StructuredDataDelegate::create(format));
+        TOInteger number(42, "answer");
+        BlobOnlyObject blobOnly;
+
+        EXPECT_TRUE(sd.addObject("number", number));
+        EXPECT_TRUE(sd.addArray("objects"));
+        EXPECT_TRUE(sd.addObject("objects.", number));
+        EXPECT_TRUE(sd.addObject("objects.", blobOnly));
+
+        int intValue = 0;
+        EXPECT_TRUE(sd.get("number.value", intValue));
+        EXPECT_EQ(42, intValue);
+        EXPECT_EQ("answer", sd.get("objects.0.name"));
+        EXPECT_EQ("blob only", sd.get("objects.1.kind"));
+
+        // The same data as serializing the object by itself
+        Blob numberBlob("", format == StructuredDataDelegate::BINARY ? Blob::BINARY : Blob::STRING,
+                        std::string());
+        EXPECT_TRUE(number.serialize(numberBlob));
+        StructuredData direct("direct", numberBlob);
+        EXPECT_EQ(direct.get("type"), sd.get("number.type"));
+        EXPECT_EQ(direct.get("result"), sd.get("objects.0.result"));
+    }
+}
+
 TEST(BasePackageTest, Hasher)
 {
     enum COMMANDS { First, Second, Third, Fourth };
@@ -14,17 +14,42 @@
  *   limitations under the License.
  */
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
 #include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <base/blob.h>
+#include <base/tobjecttype.h>
+#include <base/typedcontract.h>
 #include <core/basiccommands.h>
 #include <core/commandcontext.h>
 #include <core/fileconsumer.h>
 #include <core/fileproducer.h>
+#include <core/mergerproc.h>
+#include <core/multioutlet.h>
+#include <core/muxproc.h>
 #include <core/outlet.h>
+#include <core/outletindex.h>
+#include <core/pipeline.h>
 #include <core/queueproc.h>
+#include <core/robotprocs.h>
+#include <core/shmconsumer.h>
+#include <core/shmproc.h>
+#include <core/shmproducer.h>
+#include <core/socketconsumer.h>
+#include <core/socketproc.h>
+#include <core/socketproducer.h>
+#include <core/splitproc.h>
 #include <core/stringconsumer.h>
 #include <core/stringproducer.h>
+#include <core/testcase.h>
 #include <gtest/gtest.h>
 using namespace aft::base;
 using namespace aft::core;
@@ -103,6 +128,48 @@ TEST(CorePackageTest, FileConsumer) {
 }
 
 // This test assumes it runs after FileConsumer test
+TEST(CorePackageTest, FileConsumerAsync)
+{
+    std::string expected;
+    {
+        FileConsumer::AsyncPolicy policy;
+        policy.flushBytes = 4096;
+        policy.capacity = 16;
+        FileConsumer filecons("/tmp/test_file_async", true, policy);
+        EXPECT_TRUE(filecons.canAcceptData());
+        for (int idx = 0; idx < 1000; ++idx) {
+            Blob blob("", Blob::STRING, std::to_string(idx) + ' ' + sampleText);
+            EXPECT_TRUE(filecons.write(blob));
+            expected += blob.getString();
+        }
+        EXPECT_TRUE(filecons.sync());
+
+        FileProducer fileprod("/tmp/test_file_async");
+        Blob blob("");
+        EXPECT_TRUE(fileprod.read(blob));
+        EXPECT_EQ(expected, blob.getString());
+
+        // Destroying the consumer writes what is still queued
+        EXPECT_TRUE(filecons.write(Blob("", Blob::STRING, sampleText)));
+        expected += sampleText;
+    }
+    FileProducer fileprod("/tmp/test_file_async");
+    Blob blob("");
+    EXPECT_TRUE(fileprod.read(blob));
+    EXPECT_EQ(expected, blob.getString());
+
+    // A blob is written within flushMilliseconds, even below flushBytes
+    FileConsumer::AsyncPolicy policy;
+    policy.flushBytes = 1 << 20;
+    policy.flushMilliseconds = 10;
+    FileConsumer timedcons("/tmp/test_file_async", true, policy);
+    EXPECT_TRUE(timedcons.write(Blob("", Blob::STRING, sampleText)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    FileProducer timedprod("/tmp/test_file_async");
+    EXPECT_TRUE(timedprod.read(blob));
+    EXPECT_EQ(sampleText, blob.getString());
+}
+
 TEST(CorePackageTest, FileProducer) {
     FileProducer fileprod("/tmp/test_file_cons");
     EXPECT_TRUE(fileprod.hasData());
@@ -137,6 +204,138 @@ TEST(CorePackageTest, FileProducerFlowWords)
     EXPECT_TRUE(fileprod.unregisterDataCallback(&reader));
 }
 
+TEST(CorePackageTest, FileProducerMapped)
+{
+    Blob blob("");
+    {
+        FileProducer fileprod("/tmp/test_file_cons", ParcelType::BLOB_FILE, true);
+        EXPECT_TRUE(fileprod.hasData());
+        EXPECT_TRUE(fileprod.read(blob));
+        EXPECT_FALSE(fileprod.hasData());
+    }
+    // The blob keeps the mapping after the producer is gone
+    EXPECT_EQ(sampleText, blob.getString());
+
+    FileProducer wordprod("/tmp/test_file_cons", ParcelType::BLOB_WORD, true);
+    size_t words = 0;
+    while (wordprod.read(blob)) {
+        EXPECT_EQ(sampleWords[words++], std::string(blob.getBytes(), blob.getLength()));
+    }
+    constexpr size_t numWords = sizeof(sampleWords) / sizeof(sampleWords[0]);
+    EXPECT_EQ(numWords, words);
+    EXPECT_FALSE(wordprod.hasData());
+
+    FileProducer lineprod("/tmp/test_file_cons", ParcelType::BLOB_LINE, true);
+    EXPECT_TRUE(lineprod.read(blob));
+    EXPECT_EQ(sampleText.substr(0, sampleText.size() - 1), blob.getString());
+    EXPECT_FALSE(lineprod.read(blob));
+
+    FileProducer missing("/tmp/no_such_file_here", ParcelType::BLOB_LINE, true);
+    EXPECT_FALSE(missing.hasData());
+}
+
+TEST(CorePackageTest, FileProducerLongLines)
+{
+    const std::string longLine(100 * 1024 + 7, 'x');
+    {
+        Blob blob("lines", Blob::STRING, longLine + "\n\nshort\n" + longLine);
+        FileConsumer filecons("/tmp/test_file_lines", true);
+        EXPECT_TRUE(filecons.write(blob));
+    }
+
+    for (bool mapped : {false, true}) {
+        FileProducer lineprod("/tmp/test_file_lines", ParcelType::BLOB_LINE, mapped);
+        Blob blob("");
+        EXPECT_TRUE(lineprod.read(blob));
+        EXPECT_EQ(longLine, blob.getString());
+        EXPECT_TRUE(lineprod.read(blob));
+        EXPECT_EQ(0u, blob.getLength());
+        EXPECT_TRUE(lineprod.read(blob));
+        EXPECT_EQ("short", blob.getString());
+        EXPECT_TRUE(lineprod.read(blob));
+        EXPECT_EQ(longLine, blob.getString());
+        EXPECT_FALSE(lineprod.hasData());
+        EXPECT_FALSE(lineprod.read(blob));
+
+        FileProducer limited("/tmp/test_file_lines", ParcelType::BLOB_LINE, mapped);
+        limited.setMaxLineLength(50 * 1024);
+        size_t pieces = 0;
+        while (limited.read(blob) && blob.getLength() == 50 * 1024) ++pieces;
+        EXPECT_EQ(2u, pieces);
+        EXPECT_EQ(7u, blob.getLength());
+    }
+}
+
+TEST(CorePackageTest, FileProducerRecords)
+{
+    // Records that cross the 64 KiB blocks that are read
+    const std::string longText(70 * 1024, 'y');
+    const size_t lengths[]{5, longText.size(), 0, 100};
+    std::string records;
+    for (size_t length : lengths) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            records.push_back(char(length >> shift));
+        }
+        records += longText.substr(0, length);
+    }
+    // The last record is truncated
+    records.resize(records.size() - 90);
+    const std::string paragraphs("\n\nfirst line\nsecond line\n\n\n" + longText + "\n\nlast\n\n");
+    {
+        FileConsumer recordcons("/tmp/test_file_records", true);
+        EXPECT_TRUE(recordcons.write(Blob("", Blob::STRING, records)));
+        FileConsumer paracons("/tmp/test_file_paragraphs", true);
+        EXPECT_TRUE(paracons.write(Blob("", Blob::STRING, paragraphs)));
+    }
+
+    for (bool mapped : {false, true}) {
+        Blob blob("");
+        FileProducer paraprod("/tmp/test_file_paragraphs", ParcelType::BLOB_PARAGRAPH, mapped);
+        EXPECT_TRUE(paraprod.read(blob));
+        EXPECT_EQ("first line\nsecond line", blob.getString());
+        EXPECT_TRUE(paraprod.read(blob));
+        EXPECT_EQ(longText, blob.getString());
+        EXPECT_TRUE(paraprod.read(blob));
+        EXPECT_EQ("last", blob.getString());
+        EXPECT_FALSE(paraprod.hasData());
+
+        FileProducer delimprod("/tmp/test_file_paragraphs", ParcelType::BLOB_DELIMITED, mapped);
+        delimprod.setDelimiter("line\n");
+        EXPECT_TRUE(delimprod.read(blob));
+        EXPECT_EQ("\n\nfirst ", blob.getString());
+        EXPECT_TRUE(delimprod.read(blob));
+        EXPECT_EQ("second ", blob.getString());
+        EXPECT_TRUE(delimprod.read(blob));
+        EXPECT_EQ(paragraphs.substr(paragraphs.find("line\n\n") + 5), blob.getString());
+        EXPECT_FALSE(delimprod.read(blob));
+
+        FileProducer prefixprod("/tmp/test_file_records", ParcelType::BLOB_LENGTH_PREFIXED, mapped);
+        size_t count = 0;
+        size_t offset = 0;
+        while (prefixprod.read(blob)) {
+            EXPECT_EQ(Blob::RAWDATA, blob.getType());
+            ASSERT_EQ(lengths[count], blob.getLength());
+            EXPECT_EQ(0, memcmp(records.data() + offset + 4, blob.getBytes(), blob.getLength()));
+            offset += 4 + blob.getLength();
+            ++count;
+        }
+        EXPECT_EQ(3u, count);
+        EXPECT_FALSE(prefixprod.hasData());
+
+        FileProducer fixedprod("/tmp/test_file_records", ParcelType::BLOB_FIXED_SIZE, mapped);
+        fixedprod.setRecordSize(records.size() / 3);
+        count = 0;
+        while (fixedprod.read(blob)) {
+            EXPECT_EQ(records.substr(count * (records.size() / 3), records.size() / 3),
+                      std::string(blob.getBytes(), blob.getLength()));
+            ++count;
+        }
+        // Unless the size divides evenly, the partial record at the end is dropped
+        EXPECT_EQ(3u, count);
+        EXPECT_FALSE(fixedprod.hasData());
+    }
+}
+
 TEST(CorePackageTest, QueueProc)
 {
     QueueProc qproc;
@@ -156,6 +355,616 @@ TEST(CorePackageTest, QueueProc)
     }
 }
     
+TEST(CorePackageTest, QueueProcRings)
+{
+    for (QueueProc::Concurrency concurrency : {QueueProc::SPSC, QueueProc::MPMC}) {
+        // The size is rounded up to 4
+        QueueProc ring(3, concurrency);
+        EXPECT_FALSE(ring.hasData());
+        for (int idx = 0; idx < 4; ++idx) {
+            Blob blob("", Blob::STRING, std::to_string(idx));
+            EXPECT_TRUE(ring.write(std::move(blob)));
+            EXPECT_EQ(0u, blob.getLength());
+        }
+        EXPECT_FALSE(ring.canAcceptData());
+        Blob full("", Blob::STRING, "full");
+        EXPECT_FALSE(ring.write(std::move(full)));
+        EXPECT_EQ("full", full.getString());
+
+        Blob blob("");
+        for (int idx = 0; idx < 4; ++idx) {
+            EXPECT_TRUE(ring.read(blob));
+            EXPECT_EQ(std::to_string(idx), blob.getString());
+        }
+        EXPECT_FALSE(ring.read(blob));
+        EXPECT_TRUE(ring.canAcceptData());
+    }
+
+    // Blobs written by several threads are each read once
+    const int numThreads = 2;
+    const int numBlobs = 10000;
+    QueueProc ring(64, QueueProc::MPMC);
+    std::atomic<long> total(0);
+    std::atomic<int> count(0);
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < numThreads; ++thread) {
+        threads.emplace_back([&] {
+            for (int idx = 1; idx <= numBlobs; ++idx) {
+                Blob blob("", Blob::STRING, std::to_string(idx));
+                while (!ring.write(std::move(blob))) std::this_thread::yield();
+            }
+        });
+        threads.emplace_back([&] {
+            Blob blob("");
+            while (count < numThreads * numBlobs) {
+                if (ring.read(blob)) {
+                    total += std::stol(blob.getString());
+                    ++count;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(numThreads * numBlobs, count);
+    EXPECT_EQ(numThreads * (long)numBlobs * (numBlobs + 1) / 2, total);
+}
+
+/** Producer whose data arrives without a call to notifyData(). */
+class SilentProducer : public BaseProducer {
+public:
+    SilentProducer() : ready(false) {  }
+
+    virtual bool hasData() override
+    {
+        return ready;
+    }
+
+    std::atomic<bool> ready;
+};
+
+TEST(CorePackageTest, WaitForData)
+{
+    typedef std::chrono::steady_clock Clock;
+    QueueProc ring(16, QueueProc::MPMC);
+    Outlet outlet("waiting");
+    EXPECT_FALSE(outlet.waitForData(Clock::now() + std::chrono::seconds(10)));
+    EXPECT_TRUE(outlet.plugin(&ring));
+
+    // Nothing is written, so the wait times out
+    Clock::time_point start = Clock::now();
+    EXPECT_FALSE(ring.waitForData(start + std::chrono::milliseconds(20)));
+    EXPECT_LE(std::chrono::milliseconds(20), Clock::now() - start);
+
+    // A write from another thread wakes the reader
+    std::thread writer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ring.write(Blob("", Blob::STRING, sampleText));
+    });
+    Blob blob("");
+    EXPECT_TRUE(outlet.readUntil(blob, Clock::now() + std::chrono::seconds(10)));
+    EXPECT_EQ(sampleText, blob.getString());
+    writer.join();
+    EXPECT_FALSE(outlet.readUntil(blob, Clock::now() + std::chrono::milliseconds(1)));
+
+    // Producers with data do not wait
+    FileProducer fileprod("/tmp/test_file_cons");
+    EXPECT_TRUE(fileprod.waitForData(Clock::now()));
+
+    // Producers that do not notify are polled
+    SilentProducer silent;
+    start = Clock::now();
+    std::thread setter([&silent] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        silent.ready = true;
+    });
+    EXPECT_TRUE(silent.waitForData(start + std::chrono::seconds(10)));
+    EXPECT_GT(std::chrono::seconds(1), Clock::now() - start);
+    setter.join();
+}
+
+TEST(CorePackageTest, BatchWrite)
+{
+    std::vector<Blob> blobs;
+    std::string expected;
+    for (const std::string& word : sampleWords) {
+        blobs.push_back(Blob("", Blob::STRING, word));
+        expected += word;
+    }
+    const int numBlobs = blobs.size();
+
+    StringConsumer strcons;
+    EXPECT_EQ(numBlobs, strcons.write(blobs));
+    EXPECT_EQ(expected, strcons.getContents());
+
+    QueueProc queue(3);
+    EXPECT_EQ(3, queue.write(blobs));
+    EXPECT_FALSE(queue.canAcceptData());
+    Blob blob("");
+    EXPECT_TRUE(queue.read(blob));
+    EXPECT_EQ(sampleWords[0], blob.getString());
+
+    {
+        FileConsumer filecons("/tmp/test_file_batch", true);
+        EXPECT_EQ(numBlobs, filecons.write(blobs));
+    }
+    FileProducer fileprod("/tmp/test_file_batch");
+    EXPECT_TRUE(fileprod.read(blob));
+    EXPECT_EQ(expected, blob.getString());
+
+    // More blobs than the ring holds
+    FileConsumer::AsyncPolicy policy;
+    policy.capacity = 4;
+    {
+        FileConsumer asynccons("/tmp/test_file_batch", true, policy);
+        EXPECT_EQ(numBlobs, asynccons.write(blobs));
+    }
+    FileProducer asyncprod("/tmp/test_file_batch");
+    EXPECT_TRUE(asyncprod.read(blob));
+    EXPECT_EQ(expected, blob.getString());
+
+    // Readers that do not take batches get one blob at a time
+    ObjectReader reader;
+    BaseConsumer basecons(&reader);
+    EXPECT_EQ(numBlobs, basecons.write(blobs));
+}
+
+TEST(CorePackageTest, Pipeline)
+{
+    typedef std::chrono::steady_clock Clock;
+    constexpr size_t numWords = sizeof(sampleWords) / sizeof(sampleWords[0]);
+    std::string expected;
+    for (const std::string& word : sampleWords) {
+        expected += word;
+    }
+
+    // Small queues between the edges hold the producer back
+    StringProducer wordprod(sampleText, ParcelType::BLOB_WORD);
+    QueueProc first(2, QueueProc::SPSC);
+    QueueProc second(2, QueueProc::SPSC);
+    StringConsumer strcons;
+
+    Pipeline pipeline(2, 4);
+    EXPECT_FALSE(pipeline.connect(nullptr, &strcons));
+    EXPECT_TRUE(pipeline.connect(&wordprod, &first));
+    EXPECT_TRUE(pipeline.connect(&first, &second));
+    EXPECT_TRUE(pipeline.connect(&second, &strcons));
+    EXPECT_TRUE(pipeline.start());
+    EXPECT_FALSE(pipeline.start());
+    EXPECT_FALSE(pipeline.connect(&wordprod, &strcons));
+
+    EXPECT_TRUE(pipeline.drain(Clock::now() + std::chrono::seconds(10)));
+    pipeline.stop();
+    EXPECT_EQ(expected, strcons.getContents());
+    EXPECT_EQ(3 * numWords, pipeline.moved());
+}
+
+/** A reader that collects words while it has room for them */
+class WordReader : public ReaderContract {
+public:
+    WordReader()
+        : room(true) { }
+
+    virtual bool pushData(const TObject& object) override {
+        return false;
+    }
+    virtual bool pushData(const Result& result) override {
+        return false;
+    }
+    virtual bool pushData(const Blob& blob) override {
+        words += blob.getString();
+        return true;
+    }
+    virtual bool roomForData() const override {
+        return room;
+    }
+    virtual bool roomForObject(ProductType productType) const override {
+        return productType == ProductType::BLOB;
+    }
+
+    std::string words;
+    std::atomic<bool> room;
+};
+
+TEST(CorePackageTest, PipelineReader)
+{
+    constexpr size_t numWords = sizeof(sampleWords) / sizeof(sampleWords[0]);
+    std::string expected;
+    for (const std::string& word : sampleWords) {
+        expected += word;
+    }
+
+    StringProducer wordprod(sampleText, ParcelType::BLOB_WORD);
+    WordReader reader;
+    reader.room = false;
+    {
+        Pipeline pipeline(2, 4);
+        EXPECT_TRUE(pipeline.connect(&wordprod, &reader));
+        EXPECT_FALSE(pipeline.connect(&wordprod, &reader));
+        EXPECT_TRUE(pipeline.start());
+
+        // A reader without room holds the words back in the producer
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_EQ(0u, pipeline.moved());
+        EXPECT_TRUE(wordprod.hasData());
+
+        reader.room = true;
+        EXPECT_TRUE(pipeline.drain(std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+        pipeline.stop();
+        EXPECT_EQ(numWords, pipeline.moved());
+    }
+    EXPECT_EQ(expected, reader.words);
+
+    // The pipeline unregistered the reader
+    EXPECT_FALSE(wordprod.unregisterDataCallback(&reader));
+}
+
+TEST(CorePackageTest, PipelineQueues)
+{
+    StringProducer first(sampleText, ParcelType::BLOB_WORD);
+    StringProducer second(sampleText, ParcelType::BLOB_WORD);
+    StringConsumer firstcons;
+    StringConsumer secondcons;
+    QueueProc unsync;
+    QueueProc spsc(4, QueueProc::SPSC);
+    QueueProc mpmc(4, QueueProc::MPMC);
+
+    // Queues are only shared by as many edges as they can be used by at once
+    Pipeline pipeline(2);
+    EXPECT_TRUE(pipeline.connect(&first, &unsync));
+    EXPECT_FALSE(pipeline.connect(&unsync, &firstcons));
+    EXPECT_TRUE(pipeline.connect(&first, &spsc));
+    EXPECT_FALSE(pipeline.connect(&second, &spsc));
+    EXPECT_TRUE(pipeline.connect(&spsc, &firstcons));
+    EXPECT_FALSE(pipeline.connect(&spsc, &secondcons));
+    EXPECT_TRUE(pipeline.connect(&first, &mpmc));
+    EXPECT_TRUE(pipeline.connect(&second, &mpmc));
+    EXPECT_TRUE(pipeline.connect(&mpmc, &firstcons));
+    EXPECT_TRUE(pipeline.connect(&mpmc, &secondcons));
+}
+
+TEST(CorePackageTest, PipelineOutlets)
+{
+    QueueProc input;
+    QueueProc single(64, QueueProc::SPSC);
+    QueueProc multi(64, QueueProc::SPSC);
+    for (const std::string& word : sampleWords) {
+        input.write(Blob("", Blob::STRING, word));
+    }
+    Outlet outlet("single");
+    EXPECT_TRUE(outlet.plugin(&single));
+    MultiOutlet multiOutlet("multi");
+    EXPECT_TRUE(multiOutlet.plugin(&multi));
+
+    // Batches reach what is plugged into outlets
+    Pipeline pipeline(2, 4);
+    EXPECT_TRUE(pipeline.connect(&input, &outlet));
+    EXPECT_TRUE(pipeline.connect(&outlet, &multiOutlet));
+    EXPECT_TRUE(pipeline.start());
+    EXPECT_TRUE(pipeline.drain(std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+    pipeline.stop();
+
+    constexpr size_t numWords = sizeof(sampleWords) / sizeof(sampleWords[0]);
+    EXPECT_EQ(2 * numWords, pipeline.moved());
+    Blob blob("");
+    for (const std::string& word : sampleWords) {
+        ASSERT_TRUE(multi.read(blob));
+        EXPECT_EQ(word, blob.getString());
+    }
+    EXPECT_FALSE(single.hasData());
+}
+
+TEST(CorePackageTest, PipelineWakeup)
+{
+    QueueProc input(16, QueueProc::MPMC);
+    StringConsumer strcons;
+    Pipeline pipeline(2);
+    EXPECT_TRUE(pipeline.connect(&input, &strcons));
+    EXPECT_TRUE(pipeline.start());
+
+    // Idle workers are woken by a write to a watched producer
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(input.write(Blob("", Blob::STRING, "late")));
+    EXPECT_TRUE(pipeline.drain(std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+    pipeline.stop();
+    EXPECT_EQ("late", strcons.getContents());
+}
+
+TEST(CorePackageTest, SplitProc)
+{
+    SplitProc split;
+    QueueProc first(4);
+    QueueProc second(2);
+    EXPECT_FALSE(split.canAcceptData());
+    EXPECT_TRUE(split.addOutput(&first));
+    EXPECT_TRUE(split.addOutput(&second));
+    EXPECT_FALSE(split.addOutput(&second));
+    EXPECT_EQ(2u, split.numOutputs());
+
+    // Both outputs share the bytes of the one blob
+    EXPECT_TRUE(split.canAcceptData());
+    EXPECT_TRUE(split.write(Blob("", Blob::STRING, sampleText)));
+    Blob firstBlob("");
+    Blob secondBlob("");
+    EXPECT_TRUE(first.read(firstBlob));
+    EXPECT_TRUE(second.read(secondBlob));
+    EXPECT_EQ(sampleText, firstBlob.getString());
+    EXPECT_EQ(firstBlob.getBytes(), secondBlob.getBytes());
+
+    // The fuller output holds back the batch
+    std::vector<Blob> blobs;
+    for (const std::string& word : sampleWords) {
+        blobs.push_back(Blob("", Blob::STRING, word));
+    }
+    EXPECT_EQ(2, split.write(blobs));
+    EXPECT_FALSE(split.canAcceptData());
+    // An output without room refuses the blob and the others still take it
+    EXPECT_TRUE(split.write(blobs[2]));
+
+    EdgeCounters counters = split.getCounters(1);
+    EXPECT_EQ(3u, counters.blobs);
+    EXPECT_EQ(1u, counters.refused);
+    EXPECT_EQ(sampleText.size() + sampleWords[0].size() + sampleWords[1].size(), counters.bytes);
+    EXPECT_EQ(4u, split.getCounters(0).blobs);
+    EXPECT_TRUE(split.removeOutput(&second));
+    EXPECT_FALSE(split.removeOutput(&second));
+}
+
+TEST(CorePackageTest, MergerProc)
+{
+    QueueProc first;
+    QueueProc second;
+    QueueProc third;
+    for (const char* text : {"a0", "a1", "a2"}) {
+        first.write(Blob("", Blob::STRING, text));
+    }
+    second.write(Blob("", Blob::STRING, "b0"));
+
+    MergerProc merger;
+    EXPECT_FALSE(merger.hasData());
+    EXPECT_TRUE(merger.addInput(&first));
+    EXPECT_TRUE(merger.addInput(&second));
+    EXPECT_TRUE(merger.addInput(&third));
+    EXPECT_FALSE(merger.addInput(&third));
+    EXPECT_FALSE(merger.canAcceptData());
+
+    // Inputs with data take turns, and one that becomes ready joins the turns
+    std::string merged;
+    Blob blob("");
+    EXPECT_TRUE(merger.read(blob));
+    merged += blob.getString();
+    third.write(Blob("", Blob::STRING, "c0"));
+    while (merger.read(blob)) {
+        merged += blob.getString() + " ";
+    }
+    EXPECT_EQ("a0b0 a1 c0 a2 ", merged);
+    EXPECT_FALSE(merger.hasData());
+
+    EXPECT_EQ(3u, merger.getCounters(0).blobs);
+    EXPECT_EQ(1u, merger.getCounters(1).blobs);
+    EXPECT_EQ(2u, merger.getCounters(2).bytes);
+    EXPECT_TRUE(merger.removeInput(&second));
+    EXPECT_EQ(2u, merger.numInputs());
+
+    // A write to an input wakes up a waiting reader without polling the inputs
+    const auto start = std::chrono::steady_clock::now();
+    std::thread writer([&third] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        third.write(Blob("", Blob::STRING, "c1"));
+    });
+    EXPECT_TRUE(merger.waitForData(start + std::chrono::seconds(10)));
+    EXPECT_GT(std::chrono::seconds(1), std::chrono::steady_clock::now() - start);
+    writer.join();
+    EXPECT_TRUE(merger.read(blob));
+    EXPECT_EQ("c1", blob.getString());
+    EXPECT_FALSE(merger.waitForData(std::chrono::steady_clock::now() + std::chrono::milliseconds(5)));
+}
+
+TEST(CorePackageTest, MergerProcBusyInput)
+{
+    QueueProc busy;
+    QueueProc late;
+    MergerProc merger;
+    EXPECT_TRUE(merger.addInput(&busy));
+    EXPECT_TRUE(merger.addInput(&late));
+
+    // An input that never runs dry does not starve one that gets data later
+    Blob blob("");
+    busy.write(Blob("", Blob::STRING, "busy"));
+    for (int idx = 0; idx < 5; ++idx) {
+        busy.write(Blob("", Blob::STRING, "busy"));
+        EXPECT_TRUE(merger.read(blob));
+        EXPECT_EQ("busy", blob.getString());
+    }
+    late.write(Blob("", Blob::STRING, "late"));
+    busy.write(Blob("", Blob::STRING, "busy"));
+    EXPECT_TRUE(merger.read(blob));
+    busy.write(Blob("", Blob::STRING, "busy"));
+    EXPECT_TRUE(merger.read(blob));
+    EXPECT_EQ("late", blob.getString());
+    EXPECT_EQ(1u, merger.getCounters(1).blobs);
+}
+
+TEST(CorePackageTest, MuxProc)
+{
+    QueueProc inA;
+    QueueProc inB;
+    QueueProc outA;
+    QueueProc outB;
+    inA.write(Blob("", Blob::STRING, "a"));
+    inB.write(Blob("", Blob::STRING, "b"));
+
+    MuxProc mux;
+    Blob blob("");
+    EXPECT_FALSE(mux.read(blob));
+    EXPECT_FALSE(mux.write(blob));
+    EXPECT_TRUE(mux.addInput(&inA));
+    EXPECT_TRUE(mux.addInput(&inB));
+    EXPECT_TRUE(mux.addOutput(&outA));
+    EXPECT_TRUE(mux.addOutput(&outB));
+    EXPECT_FALSE(mux.selectInput(2));
+
+    EXPECT_TRUE(mux.selectInput(1));
+    EXPECT_TRUE(mux.read(blob));
+    EXPECT_EQ("b", blob.getString());
+    EXPECT_FALSE(mux.hasData());
+    EXPECT_TRUE(mux.selectOutput(1));
+    EXPECT_TRUE(mux.write(blob));
+    EXPECT_TRUE(outB.read(blob));
+    EXPECT_FALSE(outA.hasData());
+
+    EXPECT_EQ(1u, mux.getInputCounters(1).blobs);
+    EXPECT_EQ(0u, mux.getInputCounters(0).blobs);
+    EXPECT_EQ(1u, mux.getOutputCounters(1).bytes);
+
+    // An output that takes only part of a batch counts the rest as refused
+    QueueProc small(1);
+    EXPECT_TRUE(mux.addOutput(&small));
+    EXPECT_TRUE(mux.selectOutput(2));
+    EXPECT_EQ(1, mux.write(std::vector<Blob>(3, blob)));
+    EXPECT_EQ(1u, mux.getOutputCounters(2).blobs);
+    EXPECT_EQ(2u, mux.getOutputCounters(2).refused);
+}
+
+TEST(CorePackageTest, ThrottleProc)
+{
+    std::vector<Blob> blobs;
+    for (const std::string& word : sampleWords) {
+        blobs.push_back(Blob("", Blob::STRING, word));
+    }
+
+    QueueProc queue;
+    ThrottleProc throttle(100, 3);
+    EXPECT_FALSE(throttle.canAcceptData());
+    throttle.setOutput(&queue);
+
+    // A full bucket lets a burst through, then holds the writer back
+    EXPECT_EQ(3, throttle.write(blobs));
+    EXPECT_FALSE(throttle.canAcceptData());
+    EXPECT_FALSE(throttle.write(blobs[3]));
+    std::this_thread::sleep_for(std::chrono::milliseconds(15));
+    EXPECT_TRUE(throttle.canAcceptData());
+    EXPECT_TRUE(throttle.write(blobs[3]));
+    EXPECT_EQ(4u, throttle.getSeen());
+    EXPECT_EQ(4u, throttle.getCounters().blobs);
+
+    // No rate passes everything
+    throttle.setRate(0);
+    EXPECT_EQ((int)blobs.size(), throttle.write(blobs));
+}
+
+TEST(CorePackageTest, SampleProc)
+{
+    std::vector<Blob> blobs;
+    for (const std::string& word : sampleWords) {
+        blobs.push_back(Blob("", Blob::STRING, word));
+    }
+
+    QueueProc queue;
+    SampleProc sampler(SampleProc::ONE_IN_N, 3, &queue);
+    EXPECT_TRUE(sampler.write(blobs[0]));
+    EXPECT_EQ((int)blobs.size() - 1, sampler.write(std::vector<Blob>(blobs.begin() + 1, blobs.end())));
+    Blob blob("");
+    for (size_t idx = 2; idx < blobs.size(); idx += 3) {
+        EXPECT_TRUE(queue.read(blob));
+        EXPECT_EQ(sampleWords[idx], blob.getString());
+    }
+    EXPECT_FALSE(queue.hasData());
+
+    // Blobs after a picked one that the output refuses are not consumed, and each
+    // picked blob it refuses is counted
+    QueueProc small(1);
+    SampleProc partial(SampleProc::ONE_IN_N, 3, &small);
+    EXPECT_EQ(5, partial.write(blobs));
+    EXPECT_FALSE(partial.canAcceptData());
+    EXPECT_EQ(2u, partial.getCounters().refused);
+
+    // The reservoir keeps a sample of all blobs
+    SampleProc reservoir(SampleProc::RESERVOIR, 4);
+    for (int idx = 0; idx < 1000; ++idx) {
+        reservoir.write(Blob("", Blob::STRING, std::to_string(idx)));
+    }
+    EXPECT_EQ(1000u, reservoir.getSeen());
+    ASSERT_EQ(4u, reservoir.getSamples().size());
+    int replaced = 0;
+    for (const Blob& sample : reservoir.getSamples()) {
+        if (std::stoi(sample.getString()) >= 4) ++replaced;
+    }
+    EXPECT_LT(0, replaced);
+}
+
+TEST(CorePackageTest, BurstProc)
+{
+    typedef std::chrono::steady_clock Clock;
+    BurstProc burst(10.0);
+    EXPECT_TRUE(burst.write(Blob("", Blob::STRING, "first"), std::chrono::milliseconds(0)));
+    EXPECT_TRUE(burst.write(Blob("", Blob::STRING, "second"), std::chrono::milliseconds(200)));
+
+    // The second blob is due 200 ms / 10 after the first is read
+    Blob blob("");
+    Clock::time_point start = Clock::now();
+    EXPECT_TRUE(burst.read(blob));
+    EXPECT_EQ("first", blob.getString());
+    EXPECT_FALSE(burst.read(blob));
+    EXPECT_TRUE(burst.readUntil(blob, start + std::chrono::seconds(10)));
+    EXPECT_EQ("second", blob.getString());
+    EXPECT_LE(std::chrono::milliseconds(20), Clock::now() - start);
+    EXPECT_FALSE(burst.waitForData(Clock::now() + std::chrono::milliseconds(1)));
+
+    // No speed replays at once
+    BurstProc fast(0.0, 2);
+    EXPECT_EQ(2, fast.write(std::vector<Blob>(3, Blob("", Blob::STRING, sampleText))));
+    EXPECT_FALSE(fast.canAcceptData());
+    EXPECT_TRUE(fast.read(blob));
+    EXPECT_TRUE(fast.read(blob));
+}
+
+TEST(CorePackageTest, TypedContracts)
+{
+    // Batches go in and out of the rings with one call
+    QueueProc ring(8, QueueProc::SPSC);
+    std::vector<Blob> blobs;
+    for (const std::string& word : sampleWords) {
+        blobs.push_back(Blob("", Blob::STRING, word));
+    }
+    TypedConsumer<Blob>& consumer = ring;
+    TypedProducer<Blob>& producer = ring;
+    EXPECT_EQ(8u, consumer.put(blobs.data(), blobs.size()));
+    EXPECT_FALSE(consumer.canAcceptData());
+    std::vector<Blob> taken(10, Blob(""));
+    EXPECT_EQ(3u, producer.take(taken.data(), 3));
+    EXPECT_EQ(5u, producer.take(taken.data() + 3, 7));
+    for (size_t idx = 0; idx < 8; ++idx) {
+        EXPECT_EQ(sampleWords[idx], taken[idx].getString());
+    }
+    EXPECT_FALSE(producer.hasData());
+
+    // Untyped producers and consumers are adapted
+    StringProducer wordprod(sampleText, ParcelType::BLOB_WORD);
+    ContractProducer<Blob> typedprod(wordprod);
+    StringConsumer strcons;
+    ContractConsumer<Blob> typedcons(strcons);
+    EXPECT_EQ(2u, typedprod.take(taken.data(), 2));
+    EXPECT_EQ(2u, typedcons.put(taken.data(), 2));
+    EXPECT_EQ(sampleWords[0] + sampleWords[1], strcons.getContents());
+
+    // Typed producers and consumers work through the old contracts
+    ConsumerBridge<Blob> untypedcons(ring);
+    EXPECT_TRUE(untypedcons.write(Blob("", Blob::STRING, sampleText)));
+    EXPECT_FALSE(untypedcons.write(Result(true)));
+    ProducerBridge<Blob> untypedprod(ring);
+    EXPECT_TRUE(untypedprod.hasObject(ProductType::BLOB));
+    EXPECT_FALSE(untypedprod.hasObject(ProductType::RESULT));
+    Result result;
+    EXPECT_FALSE(untypedprod.read(result));
+    Blob blob("");
+    EXPECT_TRUE(untypedprod.read(blob));
+    EXPECT_EQ(sampleText, blob.getString());
+}
+
 TEST(CorePackageTest, CommandContext)
 {
     const std::string COMMAND("Open");
@@ -278,7 +1087,466 @@ TEST(CorePackageTest, Outlet) {
         virtual Result write(const Result& result) override;
 #endif
     }
-    
+
+/** Producer that counts reads in progress and reads made after it was unplugged. */
+class InFlightProducer : public BaseProducer {
+public:
+    InFlightProducer(const std::string& text)
+    : text(text), inFlight(0), retired(false), lateReads(0)
+    {  }
+
+    virtual Result read(Blob& blob) override
+    {
+        ++inFlight;
+        if (retired) ++lateReads;
+        std::this_thread::yield();
+        blob = Blob("", Blob::STRING, text);
+        --inFlight;
+        return true;
+    }
+    virtual bool hasData() override
+    {
+        return true;
+    }
+
+    const std::string text;
+    std::atomic<int> inFlight;
+    std::atomic<bool> retired;
+    std::atomic<int> lateReads;
+};
+
+TEST(CorePackageTest, OutletReplug)
+{
+    InFlightProducer first("first");
+    InFlightProducer second("second");
+    Outlet outlet("hot swap");
+    EXPECT_TRUE(outlet.plugin(&first));
+    EXPECT_FALSE(outlet.plugin(&second));
+
+    // Readers never find the outlet empty, and never use a producer once replaced
+    std::atomic<bool> stop(false);
+    std::atomic<int> failed(0);
+    std::vector<std::thread> readers;
+    for (int idx = 0; idx < 2; ++idx) {
+        readers.emplace_back([&] {
+            Blob blob("");
+            while (!stop) {
+                if (!outlet.read(blob)) ++failed;
+            }
+        });
+    }
+    for (int swap = 0; swap < 200; ++swap) {
+        InFlightProducer& from = swap % 2 ? second : first;
+        InFlightProducer& to = swap % 2 ? first : second;
+        to.retired = false;
+        EXPECT_TRUE(outlet.replug(&to));
+        from.retired = true;
+        EXPECT_EQ(0, from.inFlight);
+    }
+    stop = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(0, failed);
+    EXPECT_EQ(0, first.lateReads);
+    EXPECT_EQ(0, second.lateReads);
+    EXPECT_EQ(OutletType::In, outlet.type());
+}
+
+TEST(CorePackageTest, OutletReplugWhileWaiting)
+{
+    QueueProc empty;
+    QueueProc full;
+    full.write(Blob("", Blob::STRING, "data"));
+    Outlet outlet("waited on");
+    EXPECT_TRUE(outlet.plugin(&empty));
+
+    // A long wait neither holds up a replug nor misses data on the new proc
+    std::atomic<bool> gotData(false);
+    std::thread waiter([&] {
+        gotData = outlet.waitForData(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(outlet.replug(&full));
+    EXPECT_GT(std::chrono::seconds(1), std::chrono::steady_clock::now() - start);
+    waiter.join();
+    EXPECT_TRUE(gotData);
+    EXPECT_GT(std::chrono::seconds(2), std::chrono::steady_clock::now() - start);
+}
+
+TEST(CorePackageTest, MultiOutletReads)
+{
+    typedef std::chrono::steady_clock Clock;
+    QueueProc first(16, QueueProc::MPMC);
+    QueueProc second(16, QueueProc::MPMC);
+    MultiOutlet multi("endpoints");
+    EXPECT_TRUE(multi.plugin(&first));
+    EXPECT_TRUE(multi.plugin(&second));
+    EXPECT_FALSE(multi.plugin(&second));
+    EXPECT_FALSE(multi.hasData());
+
+    // Watched members join the ready set when written
+    second.write(Blob("", Blob::STRING, "second"));
+    first.write(Blob("", Blob::STRING, "first"));
+    Blob blob("");
+    EXPECT_TRUE(multi.read(blob));
+    EXPECT_EQ("second", blob.getString());
+    EXPECT_TRUE(multi.read(blob));
+    EXPECT_EQ("first", blob.getString());
+    EXPECT_FALSE(multi.read(blob));
+
+    std::thread writer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        first.write(Blob("", Blob::STRING, sampleText));
+    });
+    EXPECT_TRUE(multi.readUntil(blob, Clock::now() + std::chrono::seconds(10)));
+    EXPECT_EQ(sampleText, blob.getString());
+    writer.join();
+
+    // Members that cannot be watched are checked instead
+    QueueProc inner;
+    Outlet outlet("polled");
+    outlet.plugin(&inner);
+    EXPECT_TRUE(multi.plugin(&outlet));
+    inner.write(Blob("", Blob::STRING, "polled"));
+    EXPECT_TRUE(multi.waitForData(Clock::now() + std::chrono::seconds(10)));
+    EXPECT_TRUE(multi.read(blob));
+    EXPECT_EQ("polled", blob.getString());
+    EXPECT_EQ(1u, multi.getCounters(2).blobs);
+    EXPECT_TRUE(multi.unplug(&outlet));
+    EXPECT_EQ(2u, multi.size());
+}
+
+TEST(CorePackageTest, MultiOutletWrites)
+{
+    std::vector<std::unique_ptr<QueueProc>> queues;
+    for (int idx = 0; idx < 3; ++idx) {
+        queues.emplace_back(new QueueProc(64));
+    }
+    Blob blob("", Blob::STRING, sampleText);
+
+    // The first member with room, then the next
+    MultiOutlet firstReady("first ready");
+    QueueProc small(1);
+    firstReady.plugin(&small);
+    firstReady.plugin(queues[0].get());
+    EXPECT_TRUE(firstReady.write(blob));
+    EXPECT_TRUE(firstReady.write(blob));
+    EXPECT_EQ(1u, firstReady.getCounters(0).blobs);
+    EXPECT_EQ(1u, firstReady.getCounters(1).blobs);
+
+    // In turn, skipping a member that has no room within the timeout
+    MultiOutlet inOrder("in order", MultiOutlet::IN_ORDER, std::chrono::milliseconds(1));
+    inOrder.plugin(queues[1].get());
+    inOrder.plugin(&small);
+    for (int idx = 0; idx < 3; ++idx) {
+        EXPECT_TRUE(inOrder.write(blob));
+    }
+    EXPECT_EQ(3u, inOrder.getCounters(0).blobs);
+    EXPECT_EQ(2u, inOrder.getCounters(1).refused);
+
+    // Without writes in progress, the member with the fewest writes
+    MultiOutlet leastLoaded("least loaded", MultiOutlet::LEAST_LOADED);
+    for (std::unique_ptr<QueueProc>& queue : queues) {
+        leastLoaded.plugin(queue.get());
+    }
+    for (int idx = 0; idx < 6; ++idx) {
+        EXPECT_TRUE(leastLoaded.write(blob));
+    }
+    for (size_t idx = 0; idx < queues.size(); ++idx) {
+        EXPECT_EQ(2u, leastLoaded.getCounters(idx).blobs);
+    }
+}
+
+TEST(CorePackageTest, MultiOutletHash)
+{
+    std::vector<std::unique_ptr<QueueProc>> queues;
+    MultiOutlet hashed("hashed", MultiOutlet::CONSISTENT_HASH);
+    for (int idx = 0; idx < 3; ++idx) {
+        queues.emplace_back(new QueueProc(256));
+        hashed.plugin(queues.back().get());
+    }
+
+    // Find which member owns each key
+    auto route = [&](std::map<std::string, size_t>& owners) {
+        for (int key = 0; key < 100; ++key) {
+            EXPECT_TRUE(hashed.write(Blob("key" + std::to_string(key), Blob::STRING, sampleText)));
+        }
+        for (size_t idx = 0; idx < queues.size(); ++idx) {
+            Blob blob("");
+            while (queues[idx]->read(blob)) {
+                owners[blob.getName()] = idx;
+            }
+        }
+    };
+    std::map<std::string, size_t> before;
+    route(before);
+    EXPECT_EQ(100u, before.size());
+    std::map<std::string, size_t> again;
+    route(again);
+    EXPECT_EQ(before, again);
+
+    // Only the keys of a removed member move
+    EXPECT_TRUE(hashed.unplug(queues[2].get()));
+    std::map<std::string, size_t> after;
+    route(after);
+    int owned = 0;
+    for (const std::pair<const std::string, size_t>& owner : before) {
+        if (owner.second == 2) {
+            EXPECT_NE(2u, after[owner.first]);
+        } else {
+            EXPECT_EQ(owner.second, after[owner.first]);
+        }
+        owned += owner.second == 2;
+    }
+    EXPECT_LT(0, owned);
+}
+
+TEST(CorePackageTest, ShmTransport)
+{
+    const std::string name = "t_coretests.shm." + std::to_string(getpid());
+    ShmConsumer consumer(name, 4096);
+    ShmProducer producer(name);
+    ASSERT_TRUE(consumer.isOpen());
+    ASSERT_TRUE(producer.isOpen());
+    EXPECT_FALSE(producer.hasData());
+
+    // Blobs keep their name and type, and reference the ring
+    EXPECT_TRUE(consumer.write(Blob("first", Blob::STRING, sampleText)));
+    EXPECT_TRUE(producer.hasObject(ProductType::BLOB));
+    Blob blob("");
+    EXPECT_TRUE(producer.read(blob));
+    EXPECT_EQ("first", blob.getName());
+    EXPECT_EQ(Blob::STRING, blob.getType());
+    EXPECT_EQ(sampleText, std::string(blob.getBytes(), blob.getLength()));
+    EXPECT_FALSE(producer.read(blob));
+
+    // Space is reused once blobs are released, across the end of the ring
+    const Blob big("big", Blob::RAWDATA, std::string(1500, 'b'));
+    for (int round = 0; round < 10; ++round) {
+        EXPECT_TRUE(consumer.write(big));
+        EXPECT_TRUE(producer.read(blob));
+        EXPECT_EQ(1500u, blob.getLength());
+    }
+    EXPECT_TRUE(consumer.write(big));
+    EXPECT_FALSE(consumer.write(big));     // The blob being held is not released yet
+    blob = Blob("");
+    EXPECT_TRUE(consumer.write(big));
+    EXPECT_FALSE(consumer.write(Blob("huge", Blob::RAWDATA, std::string(4096, 'h'))));
+    EXPECT_TRUE(producer.read(blob));
+    EXPECT_TRUE(producer.read(blob));
+    blob = Blob("");
+    EXPECT_EQ(2, consumer.write(std::vector<Blob>(2, Blob("b", Blob::STRING, sampleText))));
+    EXPECT_TRUE(producer.waitForData(std::chrono::steady_clock::now()));
+
+    // Another process writes and this one reads
+    const std::string procIn = name + ".in";
+    const std::string procOut = name + ".out";
+    ShmProc proc(procIn, procOut, 1 << 16);
+    ASSERT_TRUE(proc.isOpen());
+    pid_t child = fork();
+    if (0 == child) {
+        ShmProc echo(procOut, procIn);
+        Blob request("");
+        for (int idx = 0; idx < 100; ) {
+            if (!echo.readUntil(request, std::chrono::steady_clock::now() + std::chrono::seconds(5))) {
+                _exit(1);
+            }
+            Blob reply(request.getName(), Blob::STRING, "echo");
+            while (!echo.write(reply)) {
+                echo.waitForRoom(reply, std::chrono::steady_clock::now() + std::chrono::seconds(1));
+            }
+            ++idx;
+        }
+        _exit(0);
+    }
+    int replies = 0;
+    for (int idx = 0; idx < 100; ++idx) {
+        EXPECT_TRUE(proc.write(Blob(std::to_string(idx), Blob::STRING, sampleText)));
+        Blob reply("");
+        if (proc.readUntil(reply, std::chrono::steady_clock::now() + std::chrono::seconds(5))) {
+            EXPECT_EQ(std::to_string(idx), reply.getName());
+            replies += "echo" == std::string(reply.getBytes(), reply.getLength());
+        }
+    }
+    int status = -1;
+    waitpid(child, &status, 0);
+    EXPECT_EQ(100, replies);
+    EXPECT_EQ(0, status);
+}
+
+TEST(CorePackageTest, SocketFraming)
+{
+    auto soon = [] { return std::chrono::steady_clock::now() + std::chrono::seconds(5); };
+
+    // Length prefixed blobs keep any bytes
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    SocketConsumer consumer(fds[0], ParcelType::BLOB_LENGTH_PREFIXED);
+    SocketProducer producer(fds[1], ParcelType::BLOB_LENGTH_PREFIXED);
+    const std::string binary("zero\0byte", 9);
+    std::vector<Blob> blobs{ Blob("", Blob::RAWDATA, binary), Blob("", Blob::STRING, ""),
+                             Blob("", Blob::STRING, sampleText) };
+    EXPECT_EQ(3, consumer.write(blobs));
+    for (const Blob& sent : blobs) {
+        Blob blob("");
+        EXPECT_TRUE(producer.readUntil(blob, soon()));
+        EXPECT_EQ(Blob::RAWDATA, blob.getType());
+        EXPECT_EQ(std::string(sent.getBytes(), sent.getLength()),
+                  std::string(blob.getBytes(), blob.getLength()));
+    }
+
+    // Lines split across reads, and the last one has no newline
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    SocketProducer lines(fds[1]);
+    std::atomic<int> wakeups(0);
+    int id = lines.watchData([&] { ++wakeups; });
+    Blob blob("");
+    EXPECT_EQ(3, ::write(fds[0], "hel", 3));
+    EXPECT_FALSE(lines.readUntil(blob, std::chrono::steady_clock::now() +
+                                       std::chrono::milliseconds(20)));
+    EXPECT_EQ(6, ::write(fds[0], "lo\nwor", 6));
+    EXPECT_TRUE(lines.readUntil(blob, soon()));
+    EXPECT_EQ("hello", std::string(blob.getBytes(), blob.getLength()));
+    EXPECT_EQ(2, ::write(fds[0], "ld", 2));
+    close(fds[0]);
+    EXPECT_TRUE(lines.readUntil(blob, soon()));
+    EXPECT_EQ("world", std::string(blob.getBytes(), blob.getLength()));
+    EXPECT_FALSE(lines.waitForData(soon()));
+    EXPECT_TRUE(lines.atEnd());
+    // Listeners are called after the blobs are queued
+    for (int idx = 0; idx < 100 && wakeups.load() < 2; ++idx) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_LE(2, wakeups.load());
+    lines.unwatchData(id);
+
+    // Words, with a limit on their length
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    SocketConsumer wordWriter(fds[0], ParcelType::BLOB_WORD);
+    SocketProducer words(fds[1], ParcelType::BLOB_WORD);
+    words.setMaxLineLength(4);
+    EXPECT_TRUE(wordWriter.write(Blob("", Blob::STRING, "one")));
+    EXPECT_TRUE(wordWriter.write(Blob("", Blob::STRING, "abcdefg")));
+    const char* expected[] = { "one", "abcd", "efg" };
+    for (const char* word : expected) {
+        EXPECT_TRUE(words.readUntil(blob, soon()));
+        EXPECT_EQ(word, std::string(blob.getBytes(), blob.getLength()));
+    }
+}
+
+TEST(CorePackageTest, SocketConnections)
+{
+    auto soon = [] { return std::chrono::steady_clock::now() + std::chrono::seconds(5); };
+
+    // Echo over TCP on localhost
+    SocketListener tcp("tcp:127.0.0.1:0");
+    ASSERT_TRUE(tcp.isOpen());
+    EXPECT_NE("tcp:127.0.0.1:0", tcp.address());
+    SocketProc client(tcp.address());
+    SocketProc server(tcp.accept(soon()));
+    ASSERT_TRUE(client.isOpen());
+    ASSERT_TRUE(server.isOpen());
+    for (int idx = 0; idx < 10; ++idx) {
+        EXPECT_TRUE(client.write(Blob("", Blob::STRING, "ping " + std::to_string(idx))));
+        Blob request("");
+        ASSERT_TRUE(server.readUntil(request, soon()));
+        EXPECT_TRUE(server.write(Blob("", Blob::STRING,
+                                      std::string(request.getBytes(), request.getLength()))));
+        Blob reply("");
+        ASSERT_TRUE(client.readUntil(reply, soon()));
+        EXPECT_EQ("ping " + std::to_string(idx), std::string(reply.getBytes(), reply.getLength()));
+    }
+
+    // More over a unix socket than it buffers, so writes wait for the reactor
+    const std::string path = "/tmp/t_coretests." + std::to_string(getpid()) + ".sock";
+    SocketListener local("unix:" + path);
+    ASSERT_TRUE(local.isOpen());
+    SocketConsumer sender("unix:" + path, ParcelType::BLOB_DELIMITED);
+    SocketProducer receiver(local.accept(soon()), ParcelType::BLOB_DELIMITED);
+    sender.setDelimiter("|");
+    receiver.setDelimiter("|");
+    const Blob chunk("", Blob::STRING, std::string(4000, 'c'));
+    const int count = 2000;
+    std::thread writer([&] {
+        std::vector<Blob> batch(10, chunk);
+        for (int sent = 0; sent < count; ) {
+            int written = sender.write(batch);
+            if (written <= 0) {
+                sender.waitForRoom(soon());
+            }
+            sent += std::max(written, 0);
+            batch.resize(std::min(10, count - sent), chunk);
+        }
+        EXPECT_TRUE(sender.flush(soon()));
+    });
+    int received = 0;
+    Blob blob("");
+    while (received < count && receiver.readUntil(blob, soon())) {
+        EXPECT_EQ(4000u, blob.getLength());
+        ++received;
+    }
+    writer.join();
+    EXPECT_EQ(count, received);
+}
+
+TEST(CorePackageTest, OutletIndex)
+{
+    const TObjectType& logType = TObjectType::get("Log");
+    Outlet logs("logs");
+    Outlet events("events");
+    Outlet sink("sink");
+    logs.provides({ Entity("syslog", logType, "syslog") });
+    events.provides({ Entity("events", TObjectType::TypeBase, "events"),
+                      Entity("audit", logType, "audit") });
+    sink.consumes({ Entity("anylog", logType) });
+
+    TestCase testCase("index");
+    EXPECT_TRUE(testCase.addOutlet(&logs));
+    EXPECT_TRUE(testCase.addOutlet(&events));
+    EXPECT_TRUE(testCase.addOutlet(&sink));
+    const OutletIndex& index = testCase.getOutletIndex();
+    EXPECT_EQ(3u, index.size());
+
+    // By name, by type, and any
+    EXPECT_EQ(&logs, testCase.resolve(Entity("want", logType, "syslog")));
+    EXPECT_EQ(&events, testCase.resolve(Entity("want", logType, "events")));
+    OutletIndex::OutletList found;
+    EXPECT_TRUE(index.find(OutletIndex::Role::Provides, Entity("want", logType), found));
+    EXPECT_EQ((OutletIndex::OutletList{ &logs, &events }), found);
+    found.clear();
+    TObject anything("any");
+    Entity any("any", &anything, Entity::LevelAny);
+    EXPECT_TRUE(index.find(OutletIndex::Role::Provides, any, found));
+    EXPECT_EQ(2u, found.size());
+    EXPECT_EQ(&sink, index.first(OutletIndex::Role::Consumes, Entity("want", logType)));
+    EXPECT_EQ(nullptr, testCase.resolve(Entity("want", logType, "kernel")));
+    // Copies share the TObject synthesized for matching, which the last one frees
+    Entity want("want", logType);
+    EXPECT_EQ(want.getTObject(), Entity(want).getTObject());
+
+    // Requirements resolve all or nothing
+    TestCase::OutletList providers;
+    EXPECT_TRUE(testCase.resolve({ Entity("a", logType, "audit"),
+                                   Entity("b", logType, "syslog") }, providers));
+    EXPECT_EQ((TestCase::OutletList{ &events, &logs }), providers);
+    EXPECT_FALSE(testCase.resolve({ Entity("a", logType, "audit"),
+                                    Entity("c", logType, "kernel") }, providers));
+
+    // Changing what an outlet provides reindexes it
+    logs.provides({ Entity("kernel", logType, "kernel") });
+    EXPECT_EQ(nullptr, testCase.resolve(Entity("want", logType, "syslog")));
+    EXPECT_EQ(&logs, testCase.resolve(Entity("want", logType, "kernel")));
+
+    // Removed outlets are no longer found
+    EXPECT_TRUE(testCase.removeOutlet("logs"));
+    EXPECT_EQ(nullptr, testCase.resolve(Entity("want", logType, "kernel")));
+    EXPECT_EQ(&events, index.first(OutletIndex::Role::Provides, Entity("want", logType)));
+    EXPECT_EQ(2u, index.size());
+    EXPECT_TRUE(testCase.removeOutlet("events"));
+    EXPECT_TRUE(testCase.removeOutlet("sink"));
+}
 
 } // namespace
 
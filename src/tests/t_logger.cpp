@@ -14,7 +14,12 @@
  *   limitations under the License.
  */
 
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 
 #include <core/logger.h>
 #include <gtest/gtest.h>
@@ -25,6 +30,48 @@ using std::endl;
 
 namespace {
 
+TEST(LoggerTest, ThreadLines)
+{
+    const std::string file = "/tmp/t_logger_threads.log";
+    core::LogStreamBuf buf(core::ALERT);
+    ASSERT_TRUE(buf.open(file));
+
+    // Lines written by threads at the same time each come out whole
+    const int threads = 4;
+    const int lines = 200;
+    std::vector<std::thread> writers;
+    for (int id = 0; id < threads; ++id) {
+        writers.emplace_back([&buf, id] {
+            std::ostream out(&buf);
+            for (int idx = 0; idx < lines; ++idx) {
+                buf.setLogLevel(core::Warning);
+                out << "thread " << id << " line " << idx << endl;
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    buf.close();
+
+    std::ifstream in(file);
+    std::vector<int> next(threads, 0);
+    std::string line;
+    int count = 0;
+    while (std::getline(in, line)) {
+        ASSERT_LT(24u, line.size());
+        EXPECT_EQ('W', line[20]);
+        int id = -1;
+        int idx = -1;
+        ASSERT_EQ(2, sscanf(line.c_str() + 24, "thread %d line %d", &id, &idx)) << line;
+        ASSERT_TRUE(id >= 0 && id < threads);
+        EXPECT_EQ(next[id]++, idx);
+        ++count;
+    }
+    EXPECT_EQ(threads * lines, count);
+    unlink(file.c_str());
+}
+
 TEST(LoggerTest, TerminalLog)
 {
     char* currDir = getcwd(0, 0);
@@ -14,8 +14,16 @@
  *   limitations under the License.
  */
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 #include <base/callback.h>
+#include <base/canceltoken.h>
 #include <base/context.h>
 #include <base/thread.h>
 #include <base/tobasictypes.h>
@@ -95,6 +103,179 @@ TEST(OsdepPackageTest, MultiThreads)
     }
 }
 
+/** OS threads that have run a CountingTObject */
+std::mutex threadIdsLock;
+std::set<std::thread::id> threadIds;
+
+/** Counts how many run at the same time, and can start more of itself. */
+class CountingTObject : public TObject
+{
+public:
+    CountingTObject(std::atomic<int>& running, std::atomic<int>& maxRunning, int depth = 0)
+    : running_(running), maxRunning_(maxRunning), depth_(depth) { }
+
+    virtual const Result run(Context* context = nullptr)
+    {
+        const int now = ++running_;
+        int seen = maxRunning_.load();
+        while (now > seen && !maxRunning_.compare_exchange_weak(seen, now)) { }
+        {
+            std::lock_guard<std::mutex> lock(threadIdsLock);
+            threadIds.insert(std::this_thread::get_id());
+        }
+
+        // Waiting for a nested task must not tie up the worker
+        bool good = true;
+        if (depth_ > 0) {
+            CountingTObject child(running_, maxRunning_, depth_ - 1);
+            ThreadHandler* thread = ThreadManager::instance()->thread(&child, context);
+            thread->run();
+            good = bool(thread->wait());
+            delete thread;
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        --running_;
+        return Result(good);
+    }
+
+private:
+    std::atomic<int>& running_;
+    std::atomic<int>& maxRunning_;
+    const int depth_;
+};
+
+/** Sleeps for a while when processed, waking up when cancelled. */
+class SleepyTObject : public TObject
+{
+public:
+    virtual const Result process(Context* context = nullptr)
+    {
+        const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+        return Result(CancelToken::current().sleepUntil(until));
+    }
+};
+
+class SleepyContainer : public TObjectContainer
+{
+public:
+    SleepyContainer(const std::string& name) : TObjectContainer(name) { }
+};
+
+TEST(OsdepPackageTest, StopThread)
+{
+    // Takes 5s unless stopped
+    SleepyContainer container("long running");
+    std::vector<std::unique_ptr<SleepyTObject>> children;
+    for (int idx = 0; idx < 1000; ++idx) {
+        children.emplace_back(new SleepyTObject);
+        container.add(children.back().get());
+    }
+    container.setState(TObject::PREPARED);
+
+    SampleContext context;
+    ThreadHandler* thread = ThreadManager::instance()->thread(&container, &context);
+    thread->run();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    const auto start = std::chrono::steady_clock::now();
+    thread->stop();
+    thread->wait();
+    EXPECT_GT(std::chrono::milliseconds(500), std::chrono::steady_clock::now() - start);
+    EXPECT_EQ(TObject::STOPPED, thread->getState());
+    EXPECT_EQ(Result::FATAL, thread->getResult().getType());
+    delete thread;
+
+    // Other threads in the same context are not stopped
+    ThreadHandler* other = ThreadManager::instance()->thread(&TOTrue, &context);
+    other->run();
+    EXPECT_TRUE(bool(other->wait()));
+    EXPECT_EQ(TObject::FINISHED_GOOD, other->getState());
+    delete other;
+}
+
+TEST(OsdepPackageTest, ThreadCap)
+{
+    ThreadManager* tman = ThreadManager::instance();
+    const unsigned int maxThreads = tman->getMaxThreads();
+    EXPECT_LE(4u, maxThreads);
+    EXPECT_FALSE(tman->setMaxThreads(maxThreads + 1));
+    EXPECT_EQ(maxThreads, tman->getMaxThreads());
+
+    SampleContext context;
+    std::atomic<int> running(0);
+    std::atomic<int> maxRunning(0);
+    const int numTObjects = 500;
+    std::vector<std::unique_ptr<CountingTObject>> tObjects;
+    std::vector<ThreadHandler*> threads;
+    for (int idx = 0; idx < numTObjects; ++idx) {
+        // Some of them wait for deeper chains than there are threads
+        tObjects.emplace_back(new CountingTObject(running, maxRunning, idx % 50 == 0 ? 8 : 0));
+        threads.push_back(tman->thread(tObjects.back().get(), &context));
+        threads.back()->run();
+    }
+
+    for (ThreadHandler* thread : threads) {
+        EXPECT_TRUE(bool(thread->wait()));
+        EXPECT_EQ(TObject::FINISHED_GOOD, thread->getState());
+        delete thread;
+    }
+    EXPECT_EQ(0, running.load());
+    EXPECT_LT(1, maxRunning.load());
+    EXPECT_GE(maxThreads, threadIds.size());
+
+    // A thread stopped before it runs is not run
+    CountingTObject skipped(running, maxRunning);
+    ThreadHandler* thread = tman->thread(&skipped, &context);
+    thread->stop();
+    thread->run();
+    EXPECT_FALSE(bool(thread->wait()));
+    delete thread;
+}
+
+TEST(OsdepPackageTest, FindThread)
+{
+    ThreadManager* tman = ThreadManager::instance();
+    SampleContext context;
+    std::atomic<int> running(0);
+    std::atomic<int> maxRunning(0);
+
+    // The newest handler of a TObject is found
+    CountingTObject tObject(running, maxRunning);
+    EXPECT_EQ(nullptr, tman->find(&tObject));
+    ThreadHandler* first = tman->thread(&tObject, &context);
+    ThreadHandler* second = tman->thread(&tObject, &context);
+    EXPECT_EQ(second, tman->find(&tObject));
+    delete second;
+    EXPECT_EQ(first, tman->find(&tObject));
+
+    // Deleting a handler removes only its own entry
+    delete first;
+    EXPECT_EQ(nullptr, tman->find(&tObject));
+    ThreadHandler* again = tman->thread(&tObject, &context);
+    EXPECT_EQ(again, tman->find(&tObject));
+    EXPECT_TRUE(tObject.stop());
+    delete again;
+    EXPECT_FALSE(tObject.stop());
+
+    // Handlers for many TObjects, some going away
+    std::vector<std::unique_ptr<CountingTObject>> tObjects;
+    std::vector<ThreadHandler*> threads;
+    for (int idx = 0; idx < 1000; ++idx) {
+        tObjects.emplace_back(new CountingTObject(running, maxRunning));
+        threads.push_back(tman->thread(tObjects.back().get(), &context));
+    }
+    for (size_t idx = 0; idx < threads.size(); idx += 2) {
+        delete threads[idx];
+        threads[idx] = nullptr;
+    }
+    for (size_t idx = 0; idx < threads.size(); ++idx) {
+        EXPECT_EQ(threads[idx], tman->find(tObjects[idx].get()));
+        delete threads[idx];
+    }
+}
+
 } // namespace
 
 int main(int argc, char* argv[])
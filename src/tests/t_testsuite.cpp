@@ -14,15 +14,30 @@
  *   limitations under the License.
  */
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <base/blob.h>
+#include <base/canceltoken.h>
+#include <base/command.h>
 #include <base/context.h>
+#include <base/factory.h>
+#include <base/structureddata.h>
+#include <base/thread.h>
 #include <core/basiccommands.h>
+#include <core/basicfactory.h>
+#include <core/fileconsumer.h>
+#include <core/fileproducer.h>
 #include <core/logger.h>
+#include <core/runpropertyhandler.h>
+#include <core/stringproducer.h>
 #include <core/testcase.h>
 #include <core/testsuite.h>
+#include <core/testsuitereader.h>
 #include <gtest/gtest.h>
 using namespace aft::base;
 using namespace aft::core;
@@ -40,6 +55,22 @@ public:
 namespace
 {
 
+/** An object in the old style that only overrides serialize(Blob&) */
+class LegacyObject : public TObject {
+public:
+    LegacyObject()
+        : TObject("legacy") { }
+
+    virtual bool serialize(Blob& blob) {
+        if (!TObject::serialize(blob)) {
+            return false;
+        }
+        StructuredData sd("LegacyObject", blob);
+        sd.add("payload", "PAYLOAD");
+        return sd.serialize(blob);
+    }
+};
+
 class TestSuiteTest : public ::testing::Test {
 protected:
     virtual void SetUp() {
@@ -165,10 +196,320 @@ TEST_F(TestSuiteTest, TwoCaseTestSuiteVisitor) {
     testSuite_.close();
 }
 
+TEST_F(TestSuiteTest, SerializeTestSuite) {
+    createTwoCases("serialized test suite");
+    Blob blob("");
+    EXPECT_TRUE(testSuite_.serialize(blob));
+
+    StructuredData sd("", blob);
+    std::vector<std::string> testcases;
+    EXPECT_TRUE(sd.getArray("testcases", testcases));
+    ASSERT_EQ(2, testcases.size());
+
+    StructuredData sdCase("", testcases[1]);
+    EXPECT_EQ("serialized test suite case 2", sdCase.get("name"));
+    std::vector<std::string> commands;
+    EXPECT_TRUE(sdCase.getArray("commands", commands));
+    EXPECT_EQ(2, commands.size());
+}
+
+TEST_F(TestSuiteTest, SerializeLegacyChild) {
+    createSimple("legacy");
+    testCase_.add(new LegacyObject);
+
+    for (auto type : { Blob::STRING, Blob::BINARY }) {
+        Blob blob("", type, std::string());
+        EXPECT_TRUE(testCase_.serialize(blob));
+
+        StructuredData sd("", blob);
+        std::vector<Blob> commands;
+        ASSERT_TRUE(sd.getArray("commands", commands));
+        ASSERT_EQ(3, commands.size());
+        StructuredData legacy("", commands[2]);
+        EXPECT_EQ("legacy", legacy.get("name"));
+        EXPECT_EQ("PAYLOAD", legacy.get("payload"));
+    }
+}
+
+TEST_F(TestSuiteTest, SerializeTestSuiteBinary) {
+    createTwoCases("binary test suite");
+    Blob binary("", Blob::BINARY, std::string());
+    EXPECT_TRUE(testSuite_.serialize(binary));
+    EXPECT_EQ(Blob::BINARY, binary.getType());
+
+    Blob json("");
+    EXPECT_TRUE(testSuite_.serialize(json));
+    EXPECT_EQ(Blob::STRING, json.getType());
+    EXPECT_LT(binary.getLength(), json.getLength());
+
+    // Loading the binary form gives back the same suite
+    TestSuite loaded;
+    EXPECT_TRUE(loaded.deserialize(binary));
+    EXPECT_EQ("binary test suite suite", loaded.getName());
+    Blob loadedJson("");
+    EXPECT_TRUE(loaded.serialize(loadedJson));
+    EXPECT_EQ(json.getString(), loadedJson.getString());
+}
+
+TEST_F(TestSuiteTest, TestSuiteReader) {
+    createTwoCases("streamed test suite");
+    Blob json("");
+    EXPECT_TRUE(testSuite_.serialize(json));
+    const std::string fileName("/tmp/t_testsuite-reader.aft");
+    {
+        FileConsumer consumer(fileName, true);
+        EXPECT_TRUE(consumer.write(json));
+    }
+
+    // Test cases are available one at a time
+    FileProducer producer(fileName, ParcelType::BLOB_LINE);
+    TestSuiteReader reader(producer);
+    std::unique_ptr<TestCase> first(reader.next());
+    ASSERT_TRUE(first != nullptr);
+    EXPECT_EQ("streamed test suite case", first->getName());
+
+    TestSuite loaded;
+    loaded.add(first.release());
+    EXPECT_TRUE(reader.read(loaded));
+    EXPECT_FALSE(reader.hasError());
+    EXPECT_EQ(nullptr, reader.next());
+
+    Blob loadedJson("");
+    EXPECT_TRUE(loaded.serialize(loadedJson));
+    EXPECT_EQ(json.getString(), loadedJson.getString());
+
+    // Input that ends in the middle of a test case is an error
+    StringProducer truncated(json.getString().substr(0, json.getLength() / 2));
+    TestSuiteReader badReader(truncated);
+    TestSuite badSuite;
+    EXPECT_FALSE(badReader.read(badSuite));
+    EXPECT_TRUE(badReader.hasError());
+}
+
+/** Counts how many test cases run at the same time. */
+struct Probe {
+    std::atomic<int> running{0};
+    std::atomic<int> maxRunning{0};
+    std::atomic<int> ran{0};
+    std::atomic<int> sawEnv{0};
+    std::atomic<int> ownHandler{0};
+    /** Value of ran when the serial test case started */
+    std::atomic<int> ranBeforeSerial{-1};
+};
+
+class ProbeCommand : public Command {
+public:
+    ProbeCommand(Probe& probe, bool pass = true, bool serial = false)
+        : Command("probe"), probe_(probe), pass_(pass), serial_(serial) { }
+
+    virtual const Result process(Context* context = nullptr) {
+        const int now = ++probe_.running;
+        int seen = probe_.maxRunning.load();
+        while (now > seen && !probe_.maxRunning.compare_exchange_weak(seen, now)) { }
+        if (serial_) {
+            probe_.ranBeforeSerial = probe_.ran.load();
+            EXPECT_EQ(1, now);
+        }
+
+        std::string value;
+        if (context && context->getEnv("suite", value) && value == "parallel") {
+            ++probe_.sawEnv;
+        }
+        if (context && dynamic_cast<RunPropertyHandler*>(context->handler(HandlerType::Run))) {
+            ++probe_.ownHandler;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        --probe_.running;
+        ++probe_.ran;
+        return Result(pass_);
+    }
+
+private:
+    Probe& probe_;
+    bool pass_;
+    bool serial_;
+};
+
+/** Cancels the run it is part of. */
+class CancelCommand : public Command {
+public:
+    CancelCommand() : Command("cancel") { }
+
+    virtual const Result process(Context* context = nullptr) {
+        if (context) {
+            context->getCancelToken().cancel();
+        }
+        return Result(true);
+    }
+};
+
+/** Sleeps for a second, waking up when the current token is cancelled. */
+class SleepCommand : public Command {
+public:
+    SleepCommand(Probe& probe) : Command("sleep"), probe_(probe) { }
+
+    virtual const Result process(Context* context = nullptr) {
+        ++probe_.running;
+        const auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        const bool slept = CancelToken::current().sleepUntil(until);
+        --probe_.running;
+        ++probe_.ran;
+        return Result(slept);
+    }
+
+private:
+    Probe& probe_;
+};
+
+class ParallelSuiteTest : public ::testing::Test {
+protected:
+    void createCases(int count, Probe& probe, int failing = -1, int serial = -1) {
+        suite_.setName("parallel suite");
+        suite_.setEnv("suite", "parallel");
+        for (int idx = 0; idx < count; ++idx) {
+            cases_.emplace_back(new TestCase("case " + std::to_string(idx)));
+            cases_.back()->add(new ProbeCommand(probe, idx != failing, idx == serial));
+            cases_.back()->setSerial(idx == serial);
+            suite_.add(cases_.back().get());
+        }
+    }
+
+    std::unique_ptr<SampleContext> context_{new SampleContext("parallel context")};
+    std::vector<std::unique_ptr<TestCase>> cases_;
+    TestSuite suite_;
+};
+
+TEST_F(ParallelSuiteTest, RunOnWorkers) {
+    Probe probe;
+    createCases(24, probe);
+    TestSuite::RunOptions options;
+    options.workers = 4;
+
+    EXPECT_TRUE(suite_.open());
+    Result result = suite_.run(context_.get(), options);
+    EXPECT_FALSE(!result);
+    EXPECT_EQ(TObject::FINISHED_GOOD, suite_.getState());
+    suite_.close();
+
+    EXPECT_EQ(24, probe.ran.load());
+    EXPECT_LT(1, probe.maxRunning.load());
+    EXPECT_GE(4, probe.maxRunning.load());
+    // Workers have their own RunContext with a copy of the environment
+    EXPECT_EQ(24, probe.sawEnv.load());
+    EXPECT_EQ(24, probe.ownHandler.load());
+    std::string value;
+    EXPECT_TRUE(context_->getEnv("suite", value));
+}
+
+TEST_F(ParallelSuiteTest, SerialTestCase) {
+    Probe probe;
+    createCases(12, probe, -1, 5);
+    TestSuite::RunOptions options;
+    options.workers = 3;
+
+    // Declared order: the serial test case waits for the ones before it
+    EXPECT_TRUE(suite_.open());
+    EXPECT_FALSE(!suite_.run(context_.get(), options));
+    suite_.close();
+    EXPECT_EQ(12, probe.ran.load());
+    EXPECT_EQ(5, probe.ranBeforeSerial.load());
+
+    // Serial test cases last
+    options.order = TestSuite::RunOptions::Order::SerialLast;
+    probe.ran = 0;
+    EXPECT_TRUE(suite_.open());
+    EXPECT_FALSE(!suite_.run(context_.get(), options));
+    suite_.close();
+    EXPECT_EQ(12, probe.ran.load());
+    EXPECT_EQ(11, probe.ranBeforeSerial.load());
+
+    // Being serial is part of the test case
+    TestCase serialCase("serial case");
+    serialCase.add(new LogCommand("On its own."));
+    serialCase.setSerial(true);
+    Blob blob("");
+    EXPECT_TRUE(serialCase.serialize(blob));
+    TestCase loaded;
+    EXPECT_TRUE(loaded.deserialize(blob));
+    EXPECT_TRUE(loaded.isSerial());
+
+    serialCase.setSerial(false);
+    EXPECT_TRUE(serialCase.serialize(blob));
+    TestCase loadedAgain;
+    EXPECT_TRUE(loadedAgain.deserialize(blob));
+    EXPECT_FALSE(loadedAgain.isSerial());
+}
+
+TEST_F(ParallelSuiteTest, StopOnError) {
+    Probe probe;
+    createCases(40, probe, 0);
+    TestSuite::RunOptions options;
+    options.workers = 2;
+
+    EXPECT_TRUE(suite_.open());
+    EXPECT_TRUE(!suite_.run(context_.get(), options));
+    EXPECT_EQ(TObject::FINISHED_BAD, suite_.getState());
+    suite_.close();
+    EXPECT_EQ(40, probe.ran.load());
+
+    options.stopOnError = true;
+    probe.ran = 0;
+    EXPECT_TRUE(suite_.open());
+    EXPECT_TRUE(!suite_.run(context_.get(), options));
+    suite_.close();
+    EXPECT_GT(40, probe.ran.load());
+}
+
+TEST_F(ParallelSuiteTest, Cancel) {
+    Probe probe;
+    createCases(200, probe);
+    cases_[10]->add(new CancelCommand);
+    cases_[10]->add(new ProbeCommand(probe));
+    TestSuite::RunOptions options;
+    options.workers = 4;
+
+    // Workers share the token of the context, and stop within a few test cases
+    EXPECT_TRUE(suite_.open());
+    EXPECT_TRUE(!suite_.run(context_.get(), options));
+    EXPECT_EQ(TObject::STOPPED, suite_.getState());
+    suite_.close();
+    EXPECT_GT(30, probe.ran.load());
+    EXPECT_EQ(0, probe.running.load());
+}
+
+TEST_F(ParallelSuiteTest, StopStarted) {
+    Probe probe;
+    createCases(8, probe);
+    for (auto& testcase : cases_) {
+        testcase->add(new SleepCommand(probe));
+    }
+    TestSuite::RunOptions options;
+    options.workers = 4;
+    suite_.setRunOptions(options);
+
+    // Stopping the thread of a started suite wakes up the test cases running on
+    // every worker, not only on the calling thread
+    EXPECT_TRUE(suite_.open());
+    suite_.start(context_.get());
+    ThreadHandler* thread = ThreadManager::instance()->find(&suite_);
+    ASSERT_NE(nullptr, thread);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(suite_.stop());
+    thread->wait();
+    EXPECT_GT(std::chrono::milliseconds(500), std::chrono::steady_clock::now() - start);
+    EXPECT_EQ(TObject::STOPPED, suite_.getState());
+    EXPECT_EQ(0, probe.running.load());
+    delete thread;
+    suite_.close();
+}
+
 } // namespace
 
 int main(int argc, char* argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
+    MecFactory::instance()->addFactory(new BasicCommandFactory);
     return RUN_ALL_TESTS();
 }